@@ -1,41 +1,231 @@
 #pragma once
 
 #include "api.h"
+#include "pros/serial.hpp"
+#include "bench.h"
+#include "controller.h"
+#include "filter.h"
+#include "path.h"
+#include "planner.h"
+#include "profile.h"
+#include "spline.h"
+#include "telemetry.h"
 #include "utils.h"
+#include "wire.h"
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <variant>
 
 namespace appa {
 
 /* Odom */
-class Odom {
+// pose, velocity and history shared by every odom, whatever its sensors. motions and tools take
+// this so they work with any BasicOdom
+class OdomBase {
+  public:
+    enum Status { IDLE, CALIBRATING, RUNNING, FAILED };
+    enum Integrator { ARC, EXPONENTIAL };
+
+    // the geometry an odom's trackers are built with, see Chassis::calibrate_tpu() and
+    // calibrate_offsets()
+    struct Tracking {
+        double tpu;            // ticks per in
+        Point linear_offset;   // in
+        double angular_offset; // deg
+    };
+
+    // how far the robot leans, as the imu reads it
+    struct Tilt {
+        double pitch = 0.0, roll = 0.0;           // deg
+        double pitch_rate = 0.0, roll_rate = 0.0; // deg/s
+    };
+
+    // trackers the loop trusts, see set_fallback()
+    struct Health {
+        bool x = true, y = true; // false once the tracker jumped or disagreed with the drive
+        uint32_t faults = 0;     // trackers dropped so far
+        uint32_t bumps = 0;      // loop readings taken from the drive instead, see max_bump
+    };
+
   private:
+    // everything readers need, with the trig of the heading and the correction done by the
+    // writer so a get() is only a copy
+    struct State {
+        Pose pose;   // of the trackers
+        Pose center; // of the offset point, what get() returns
+        Point offset;
+        Point heading; // cosine and sine of the pose's heading
+        Twist twist;
+        LoopTiming timing;
+        Pose correction;
+        Point correction_rotation;
+        Covariance covariance;
+    };
+
     Pose odom_pose = {0.0, 0.0, 0.0};
+    // sets turn the sensors' heading by this instead of resetting the devices, so they make no
+    // device calls and take effect in the same loop as their position
+    double heading_offset = 0.0;        // rad
+    Point offset_rotation = {1.0, 0.0}; // cosine and sine of it
+    // shift of the tracker frame from correct(), a rotation about the origin then a translation
+    Pose odom_correction = {0.0, 0.0, 0.0};
+    Point correction_rotation = {1.0, 0.0}; // cosine and sine of its angle
+    Pose pending_correction = {0.0, 0.0, 0.0}; // left to blend in, in and rad
+    double blend_time = 150.0;                 // ms, time constant of blend()
+    Covariance odom_covariance;                // of the error of get(), grown every loop
+    Twist odom_twist;
+    Ema<Pose> velocity_filter{0.5, {0.0, 0.0, 0.0}}, accel_filter{0.5, {0.0, 0.0, 0.0}};
+    LoopTiming odom_timing;
     pros::Mutex odom_mutex;
+    Seqlock<State> odom_state;
+    History<Pose, 200> odom_history; // 1 s of samples at 5 ms
     pros::Task* odom_task = nullptr;
+    Seqlock<Tracking> tracking;             // the latest, taken by the loop when pending
+    Seqlock<Tilt> odom_tilt;
+    Derivative<3> pitch_rate, roll_rate;    // deg/s
+    std::atomic<bool> tracking_pending{false};
+    const char* tracking_file = nullptr;    // loaded by start()
+    const char* warm_file = nullptr;        // from set_warm_start()
+    uint32_t warm_period = 500;             // ms
+    pros::Task* warm_task = nullptr;
+    std::atomic<bool> warm{false};
+    std::atomic<OdomRecorder*> odom_recorder{nullptr};
+    OdomRecorder* recording = nullptr; // the recorder the loop wrote the tracking to
+    uint64_t recording_start = 0;      // us
+    std::atomic<bool> pose_set{false}; // by a set since the loop last recorded
+    bool replay_primed = false;        // by the first replayed sample
 
-    pros::adi::Encoder x_tracker, y_tracker;
-    appa::Imu imu;
-    double tpu;
+    Channel debug_channel;
+    std::array<std::atomic<pros::task_t>, 8> subscribers{};
+    std::atomic<Status> odom_status{IDLE};
+
+    // tracker health against the drive motors and the heading, from set_fallback()
+    struct Monitor {
+        MotorTracker left, right;
+        double tpu; // motor degrees per in of wheel travel
+        bool primed = false;
+        Pose prev_track; // as read, ticks and rad
+        Point output, bias = {0.0, 0.0}; // ticks given to the integration, and a tracker's offset
+        double prev_left = 0.0, prev_right = 0.0;
+        std::array<double, 2> error{}, expected{}; // ticks over the window, of each tracker
+        Point prev_moved = {0.0, 0.0};             // ticks each tracker gave the last loop
+        uint32_t window = 0;                       // ms
+    };
+    std::optional<Monitor> monitor;
+    Seqlock<Health> odom_health;
+    std::atomic<bool> health_reset{false};
+
+    // loop state between updates
+    uint64_t prev_time = 0;
+    uint32_t busy = 0; // us, of the previous iteration
+    int count = 0;
+
+    // loop period, from set_period()
+    std::atomic<uint32_t> min_period{period}, max_period{period}; // ms
+    std::atomic<uint32_t> loop_period{period};                    // ms, the loop is waiting
+    std::atomic<bool> woken{false};
+    Pose still_pose = {0.0, 0.0, 0.0}; // tracker frame, where the robot stopped
+    uint32_t still_time = 0;           // ms it has been there
+    Point still_travel = {NAN, NAN};   // in of the trackers, where they stopped
+    uint64_t still_since = 0;          // us
 
+    void publish();
+    void fold();
+    void shift_by(const Pose& error);
+    void place(Pose pose); // tracker frame pose (in, rad) a set moves to, nan keeps that part
+
+  protected:
+    double tpu;
     Point tracker_linear_offset;
     double tracker_angular_offset;
+    std::atomic<Integrator> odom_integrator{ARC};
+    bool selectable = false; // whether the integrator can be changed at runtime
+    bool calibratable = false; // whether the tracking can be changed at runtime
+    Seqlock<Point> odom_ticks; // raw x and y tracker ticks of the last loop
+
+    OdomBase(double tpu, Point tracker_linear_offset, double tracker_angular_offset,
+             const char* tracking_file = nullptr);
+
+    // the sensor side, everything else runs once per loop without virtual calls
+    virtual bool calibrate() = 0;
+    // true when the heading sensors are still calibrated from before a restart, so calibrate()
+    // can be skipped. odoms that can't tell always calibrate
+    virtual bool resume() { return false; }
+    virtual double sensor_heading() { return NAN; } // rad, as read
+    // restores the pose from warm_file when resume() and the robot is still, see set_warm_start()
+    bool warm_start();
+    void save_warm();
+    // the loop's raw tracker ticks with a failed tracker or a bump carried on from the drive, as
+    // they are without set_fallback(). accel (in/s²) is the imu's, nan without one
+    Pose check_trackers(const Pose& track, double accel = NAN);
+    // ms to wait for the next loop, from how the robot moved in this one
+    uint32_t next_period();
+    // integrates one loop's global tracker travel, then publishes and wakes subscribers. the
+    // travel and heading are in the sensors' frame, which sets never reset
+    void update(uint64_t time, const Point& dtrack, double dtheta, double theta);
+    // takes a set_tracking() from another task, at the start of a loop
+    void apply_tracking();
+    // pitch and roll (deg) of a loop, read by the loop while tracking the tilt
+    std::atomic<bool> tilt_tracking{false};
+    void update_tilt(uint64_t time, const Point& tilt);
+    // whether the trackers (in) have stayed within the still distance for zupt_time
+    bool trackers_still(uint64_t time, const Point& travel);
+    // writes a loop's raw ticks and heading (rad) when recording, after it was integrated
+    void record(uint64_t time, const Pose& track, std::span<const Imu::State> imus = {});
+    // integrates a recorded sample, or only takes its readings as the previous ones to prime.
+    // false for odoms that can't replay
+    virtual bool replay_sample(const OdomRecord& sample, bool prime) { return false; }
+    // Chassis::dry_run() moves the pose with its drive model from its task, dropping the loop's
+    // own updates, then puts the frames back as they were. travel in in and rad, along and about
+    // the robot's heading
+    friend class Chassis;
+    struct Frames {
+        Pose pose, correction, pending;
+        double heading_offset;
+        Point offset_rotation, correction_rotation;
+        Covariance covariance;
+    };
+    std::atomic<pros::task_t> simulator{nullptr};
+    Frames simulated_from;
+    void begin_simulation();
+    void simulate(uint64_t time, double distance, double dtheta);
+    void end_simulation();
 
   public:
+    static constexpr uint32_t period = 5; // ms, nominal
+    TaskConfig task_config = {16}; // of the odom task, set before start()
+    TaskConfig warm_task_config = {TASK_PRIORITY_MIN}; // saves for set_warm_start()
     std::atomic<bool> debug{false};
+    // per loop noise model of the covariance, set before start()
+    double travel_noise = 0.01; // in^2 of position variance per in driven, the trackers
+    double turn_noise = 1e-4;   // rad^2 of heading variance per rad turned, the imu's scale
+    double drift_noise = 1e-6;  // rad^2 of heading variance per s, imu drift
 
-    Odom(int8_t x_port, int8_t y_port, Imu imu_port, double tpu, Point tracker_linear_offset,
-         double tracker_angular_offset);
-    Odom(std::array<int8_t, 2> x_port, std::array<int8_t, 2> y_port, Imu imu_port, double tpu,
-         Point tracker_linear_offset, double tracker_angular_offset);
+    virtual ~OdomBase(); // out of line, so the vtable is only emitted in the library
 
-    void task();
-    void start();
+    virtual void task() = 0;
+    // sets up the sensors once PROS is up, so odoms can be globals. start() binds them when this
+    // wasn't called first from initialize()
+    virtual void bind() {}
+    void start(bool async = false, std::function<void(bool)> callback = nullptr);
+    Status get_status();
 
     Pose get();
+    Pose get_raw(); // the bare integration, without corrections
     Pose get_local();
+    Pose get_at(uint64_t time);
+    Pose predict(double dt);
+    Twist get_velocity(bool robot_frame = false);
+    LoopTiming get_timing();
+    // of the pose error, in and rad. sets make what they set exact
+    Covariance get_covariance();
+    void set_covariance(const Covariance& covariance);
+    // reads the imu's pitch and roll every loop while enabled, for odoms with one
+    void track_tilt(bool enabled);
+    Tilt get_tilt();
     void set(Pose pose);
     void set(Point point, double theta = NAN);
     void set(double x, double y, double theta = NAN);
@@ -45,48 +235,1826 @@ class Odom {
     void set_theta(double theta);
 
     void set_offset(Point linear);
+    void set_integrator(Integrator integrator);
+    // trackers are read as ticks and divided each loop, so the tracking can change while running.
+    // files are checked like gains files
+    Tracking get_tracking();
+    void set_tracking(const Tracking& geometry);
+    bool load_tracking(const char* file);
+    bool save_tracking(const char* file);
+    Point get_ticks(); // raw x and y tracker ticks, nan without such trackers
+    // shifts the pose by error (in, rad) about the current pose, so later motion turns with it.
+    // the history moves too, fusion stages like GpsFusion use this instead of set()
+    void correct(const Pose& error);
+    // the same, but eased in by the odom loop over the blend time so motions see no step
+    void blend(const Pose& error);
+    void blend_to(Pose pose); // in and deg like set(), nan keeps that part
+    void set_blend_time(double time); // ms
+    // a kalman update's correction, which also multiplies the covariance by factor (I - KH) in
+    // the same step, from whatever it has grown to since the filter read it
+    void correct(const Pose& error, const Covariance& factor);
+
+    void subscribe(pros::task_t task);
+    void unsubscribe(pros::task_t task);
+
+    // the loop runs every min_period ms while the robot moves, and backs off by doubling towards
+    // max_period once it has stayed within the still distance for backoff_time, or is disabled.
+    // the integration uses the measured time of each loop and subscribers are woken on every one.
+    // both are the nominal 5 ms by default
+    void set_period(uint32_t min_period, uint32_t max_period);
+    uint32_t get_period(); // ms, the loop is at
+    void wake();           // back to min_period at once, such as when a motion starts
+    double still_distance = 0.1; // in the robot can move and still be still
+    double still_angle = 0.01;   // rad
+    uint32_t backoff_time = 250; // ms
+    // the imus learn their drift once the trackers have stayed within the still distance this
+    // long, see Imu::bias_gain
+    uint32_t zupt_time = 200; // ms
+
+    // checks a BasicOdom's trackers every loop against the drive motors and the heading. a tracker
+    // that jumps, or disagrees with the drive while the other agrees, is dropped with a message
+    // and carried on from the drive's travel, like MotorOdom. wheel turns per motor turn, set
+    // before start()
+    void set_fallback(std::initializer_list<int8_t> left_motors,
+                      std::initializer_list<int8_t> right_motors, double wheel_diameter,
+                      double gear_ratio);
+    Health get_health();
+    void reset_health(); // trusts both trackers again, such as after plugging one back in
+    double max_jump = 2.0;    // in a tracker can move in a loop, more is a bad reading
+    double fault_ratio = 0.5; // of the drive's travel a tracker can be off by over 100 ms
+    double min_travel = 1.0;  // in along a tracker in 100 ms before it's compared
+    // a tracker bouncing on a tile seam or a field element spins or stalls for a moment. a loop's
+    // reading more than max_bump off the drive's travel, and changing the tracker's speed faster
+    // than the imu's acceleration and bump_accel allow, is taken from the drive instead
+    double max_bump = 0.25;    // in, 0 turns it off
+    double bump_accel = 150.0; // in/s² on top of the imu's, or alone without one
+
+    // saves the pose to file every period ms from a low priority task, once it moved, so a program
+    // restarted mid run carries on. start() then skips calibrating when every imu is still
+    // calibrated, the robot is still and the imus turned less than max_turn since the save, and
+    // restores the pose in a few ms. set before start()
+    void set_warm_start(const char* file, uint32_t period = 500);
+    bool warm_started(); // whether start() restored the pose instead of calibrating
+    double max_turn = 10.0; // deg
+
+    // records the raw readings of every loop into recorder, nullptr stops recording
+    void set_recorder(OdomRecorder* recorder);
+    // feeds a recorded loop or event to the integration in place of the sensors, for replaying an
+    // OdomRecorder's files on a host. the odom's task must not be running
+    void replay(const OdomRecord& record);
+};
+
+// integration policies, mapping a loop's tracker travel to the global frame. headings include the
+// tracker angular offset
+struct ArcIntegrator {
+    static Point step(Point dtrack, double dtheta, double prev_heading, double heading,
+                      OdomBase::Integrator) {
+        // arc approximation, then rotate the tracker differential to the global frame
+        if (dtheta != 0) dtrack *= 2 * sin(dtheta / 2) / dtheta;
+        return dtrack.rotate(heading);
+    }
+};
+
+struct ExponentialIntegrator {
+    static Point step(Point dtrack, double dtheta, double prev_heading, double heading,
+                      OdomBase::Integrator) {
+        // se(2) exponential map, constant curvature from the previous heading
+        double sine = 1.0, cosine = 0.0;
+        if (fabs(dtheta) > 1e-9) {
+            sine = sin(dtheta) / dtheta;
+            cosine = (1 - cos(dtheta)) / dtheta;
+        }
+        dtrack = Point{sine * dtrack.x - cosine * dtrack.y, cosine * dtrack.x + sine * dtrack.y};
+        return dtrack.rotate(prev_heading);
+    }
+};
+
+// either one, picked with set_integrator()
+struct AnyIntegrator {
+    static Point step(Point dtrack, double dtheta, double prev_heading, double heading,
+                      OdomBase::Integrator selected) {
+        return selected == OdomBase::EXPONENTIAL
+                   ? ExponentialIntegrator::step(dtrack, dtheta, prev_heading, heading, selected)
+                   : ArcIntegrator::step(dtrack, dtheta, prev_heading, heading, selected);
+    }
+};
+
+// odom with its sensors and integrator fixed at compile time, so the loop calls them directly.
+// trackers have double get() in ticks, the heading source bool calibrate(), double get() in
+// degrees counterclockwise and set(angle), like appa::Imu
+template <class XTracker, class YTracker, class Heading, class Integration>
+class BasicOdom : public OdomBase {
+    XTracker x_tracker;
+    YTracker y_tracker;
+    Heading heading;
+    Pose prev_track = {0.0, 0.0, 0.0}; // ticks and rad
+
+    bool calibrate() override;
+    bool resume() override {
+        if constexpr (requires { heading.resume(); }) return heading.resume();
+        else return false;
+    }
+    double sensor_heading() override { return to_rad(heading.get()); }
+    void step(uint64_t time, const Pose& track);
+    bool replay_sample(const OdomRecord& sample, bool prime) override;
+
+  public:
+    // a tracking file from the calibrations, such as "/usd/tracking.cal", replaces the tpu and
+    // offsets when it loads at start()
+    BasicOdom(XTracker x_tracker, YTracker y_tracker, Heading heading, double tpu,
+              Point tracker_linear_offset, double tracker_angular_offset,
+              const char* tracking_file = nullptr)
+        : OdomBase(tpu, tracker_linear_offset, tracker_angular_offset, tracking_file),
+          x_tracker(std::move(x_tracker)),
+          y_tracker(std::move(y_tracker)),
+          heading(std::move(heading)) {
+        selectable = std::is_same_v<Integration, AnyIntegrator>;
+        calibratable = true;
+    }
+
+    void task() override;
+    void bind() override {
+        bind_device(x_tracker);
+        bind_device(y_tracker);
+        bind_device(heading);
+    }
+};
+
+template <class XTracker, class YTracker, class Heading, class Integration>
+bool BasicOdom<XTracker, YTracker, Heading, Integration>::calibrate() {
+    const bool calibrated = heading.calibrate();
+    if constexpr (requires { heading.imus.size(); }) {
+        if (calibrated) printf("imu calibrated (%d ready)\n", (int)heading.imus.size());
+    }
+    return calibrated;
+}
+
+// one loop from the sensor values, ticks and rad
+template <class XTracker, class YTracker, class Heading, class Integration>
+void BasicOdom<XTracker, YTracker, Heading, Integration>::step(uint64_t time, const Pose& track) {
+    odom_ticks.write(track);
+
+    // calculate change in sensor values, then move it to the global frame
+    const double dtheta = track.theta - prev_track.theta;
+    const Point dtrack = Integration::step(
+        (Point(track) - prev_track) * (1 / tpu), dtheta, prev_track.theta + tracker_angular_offset,
+        track.theta + tracker_angular_offset, odom_integrator.load(std::memory_order_relaxed));
+    prev_track = track;
+
+    update(time, dtrack, dtheta, track.theta);
+}
+
+template <class XTracker, class YTracker, class Heading, class Integration>
+bool BasicOdom<XTracker, YTracker, Heading, Integration>::replay_sample(const OdomRecord& sample,
+                                                                        bool prime) {
+    apply_tracking();
+    const uint64_t time = sample.time;
+    Pose track = {sample.values[0], sample.values[1], sample.values[2]};
+    // the imus are fused again from their readings, so changes to the fusion show
+    if constexpr (std::is_same_v<Heading, Imu>) {
+        if (sample.imus > 0) {
+            std::array<double, 4> rotations, rates;
+            const int count = std::min<int>(sample.imus, 4);
+            for (int i = 0; i < count; i++) rotations[i] = sample.rotation[i];
+            for (int i = 0; i < count; i++) rates[i] = sample.rate[i];
+            track.theta = to_rad(heading.fuse(time, {rotations.data(), (size_t)count},
+                                              {rates.data(), (size_t)count}));
+        }
+    }
+    if (prime) {
+        odom_ticks.write(track);
+        prev_track = track;
+    } else step(time, track);
+    return true;
+}
+
+template <class XTracker, class YTracker, class Heading, class Integration>
+void BasicOdom<XTracker, YTracker, Heading, Integration>::task() {
+    printf("odom task started\n");
+    uint32_t now = pros::millis();
+    // from what the sensors read now, rotation sensors and a resumed imu don't start at zero
+    prev_track = {x_tracker.get(), y_tracker.get(), to_rad(heading.get())};
+
+    while (true) {
+        apply_tracking();
+
+        // get current sensor values
+        const uint64_t time = pros::micros();
+        Pose track;
+        {
+            APPA_PROFILE_SCOPE("odom sensors");
+            track.x = x_tracker.get(), track.y = y_tracker.get();
+            if constexpr (std::is_same_v<Heading, Imu>)
+                heading.still = trackers_still(time, Point(track) * (1 / tpu));
+            track.theta = to_rad(heading.get());
+        }
+        double accel = NAN;
+        if constexpr (std::is_same_v<Heading, Imu>) {
+            if (max_bump > 0) accel = heading.accel();
+        }
+        track = check_trackers(track, accel);
+        step(time, track);
+        if constexpr (std::is_same_v<Heading, Imu>) record(time, track, heading.states);
+        else record(time, track);
+        if constexpr (requires { heading.tilt(); }) {
+            if (tilt_tracking.load(std::memory_order_relaxed)) update_tilt(time, heading.tilt());
+        }
+        APPA_TRACE_SPAN("odom loop", time);
+
+        pros::c::task_delay_until(&now, next_period());
+    }
+}
+
+// trackers and integrator picked at runtime, for ports or any Tracker
+using Odom = BasicOdom<AnyTracker, AnyTracker, Imu, AnyIntegrator>;
+
+// two parallel trackers track_width apart and one perpendicular, with the heading from the
+// difference of the parallel wheels at the full loop rate. an imu, when given, pulls that heading
+// towards its own by imu_weight each loop to cancel scrub without its latency
+template <class Left, class Right, class Perpendicular, class Integration = ArcIntegrator>
+class BasicThreeWheelOdom : public OdomBase {
+    Left left_tracker;
+    Right right_tracker;
+    Perpendicular perpendicular_tracker;
+    std::optional<Imu> imu;
+    double track_width, perpendicular_offset; // in
+    double heading = 0.0; // rad
+
+    bool calibrate() override;
+
+  public:
+    double imu_weight = 0.02; // of the imu's disagreement corrected every loop, 0 to 1
+
+    // perpendicular_offset is how far the perpendicular wheel is ahead of the tracking center (in)
+    BasicThreeWheelOdom(Left left_tracker, Right right_tracker, Perpendicular perpendicular_tracker,
+                        double tpu, double track_width, double perpendicular_offset,
+                        Point tracker_linear_offset = {0.0, 0.0},
+                        std::optional<Imu> imu = std::nullopt)
+        : OdomBase(tpu, tracker_linear_offset, 0.0),
+          left_tracker(std::move(left_tracker)),
+          right_tracker(std::move(right_tracker)),
+          perpendicular_tracker(std::move(perpendicular_tracker)),
+          imu(std::move(imu)),
+          track_width(track_width),
+          perpendicular_offset(perpendicular_offset) {
+        selectable = std::is_same_v<Integration, AnyIntegrator>;
+    }
+
+    void task() override;
+    void bind() override {
+        bind_device(left_tracker);
+        bind_device(right_tracker);
+        bind_device(perpendicular_tracker);
+        if (imu) bind_device(*imu);
+    }
+};
+
+template <class Left, class Right, class Perpendicular, class Integration>
+bool BasicThreeWheelOdom<Left, Right, Perpendicular, Integration>::calibrate() {
+    if (!imu) return true; // the trackers need no calibration
+    const bool calibrated = imu->calibrate();
+    if (calibrated) printf("imu calibrated (%d ready)\n", (int)imu->imus.size());
+    return calibrated;
+}
+
+template <class Left, class Right, class Perpendicular, class Integration>
+void BasicThreeWheelOdom<Left, Right, Perpendicular, Integration>::task() {
+    printf("odom task started\n");
+    double prev_left = left_tracker.get() / tpu, prev_right = right_tracker.get() / tpu;
+    double prev_perpendicular = perpendicular_tracker.get() / tpu;
+    uint32_t now = pros::millis();
+    uint64_t prev_time = pros::micros();
+
+    while (true) {
+        // get current sensor values
+        const uint64_t time = pros::micros();
+        double left, right, perpendicular, imu_heading = NAN;
+        {
+            APPA_PROFILE_SCOPE("odom sensors");
+            left = left_tracker.get() / tpu;
+            right = right_tracker.get() / tpu;
+            perpendicular = perpendicular_tracker.get() / tpu;
+            if (imu) {
+                imu->still = trackers_still(time, {left + right, perpendicular});
+                imu_heading = to_rad(imu->get());
+            }
+        }
+
+        // heading from the parallel wheels, corrected towards the imu
+        const double prev_heading = heading;
+        heading += ((right - prev_right) - (left - prev_left)) / track_width;
+        // the pull per nominal period, so it is the same at any loop period
+        if (!std::isnan(imu_heading)) {
+            const double loops = (time - prev_time) / (period * 1000.0);
+            const double weight = 1 - pow(1 - std::clamp(imu_weight, 0.0, 1.0), loops);
+            heading += weight * wrap(imu_heading - heading);
+        }
+        prev_time = time;
+        const double dtheta = heading - prev_heading;
+
+        // travel of the tracking center, the perpendicular wheel also sweeps its offset in turns
+        const Point dtrack = {((left - prev_left) + (right - prev_right)) / 2,
+                              (perpendicular - prev_perpendicular) - perpendicular_offset * dtheta};
+        prev_left = left, prev_right = right, prev_perpendicular = perpendicular;
+
+        update(time,
+               Integration::step(dtrack, dtheta, prev_heading, heading,
+                                 odom_integrator.load(std::memory_order_relaxed)),
+               dtheta, heading);
+        if (imu && tilt_tracking.load(std::memory_order_relaxed)) update_tilt(time, imu->tilt());
+        APPA_TRACE_SPAN("odom loop", time);
+
+        pros::c::task_delay_until(&now, next_period());
+    }
+}
+
+// trackers picked at runtime, for ports or any Tracker
+using ThreeWheelOdom = BasicThreeWheelOdom<AnyTracker, AnyTracker, AnyTracker>;
+
+// the common odoms are instantiated by the library, so their loops link into the cold package once
+// instead of into the hot image of every project that declares one
+extern template class BasicOdom<AnyTracker, AnyTracker, Imu, AnyIntegrator>;
+extern template class BasicOdom<AdiTracker, AdiTracker, Imu, ArcIntegrator>;
+extern template class BasicOdom<RotationTracker, RotationTracker, Imu, ArcIntegrator>;
+extern template class BasicThreeWheelOdom<AnyTracker, AnyTracker, AnyTracker>;
+extern template class BasicThreeWheelOdom<MotorTracker, MotorTracker, NoTracker>;
+
+// odometry from the drive motors' encoders for robots without tracking wheels, taking the same
+// ports as the chassis. the imu gives the heading, or the wheels without one, and gear_ratio is
+// wheel turns per motor turn
+class MotorOdom : public BasicThreeWheelOdom<MotorTracker, MotorTracker, NoTracker> {
+  public:
+    MotorOdom(std::initializer_list<int8_t> left_motors, std::initializer_list<int8_t> right_motors,
+              Imu imu, double wheel_diameter, double gear_ratio, double track_width,
+              Point tracker_linear_offset = {0.0, 0.0});
+    MotorOdom(std::initializer_list<int8_t> left_motors, std::initializer_list<int8_t> right_motors,
+              double wheel_diameter, double gear_ratio, double track_width,
+              Point tracker_linear_offset = {0.0, 0.0});
+};
+
+// any number of tracking wheels, each at its own position and angle. every loop the robot's
+// travel is the least squares fit to all of their readings, through a pseudo-inverse worked out
+// as they are added, so a loop costs a small matrix product. the heading comes from the imu when
+// there is one, otherwise it is solved with the travel, which takes three trackers or more. with
+// two trackers more than that, one that keeps disagreeing with the fit is dropped
+class MultiOdom : public OdomBase {
+  public:
+    static constexpr int capacity = 6;
+
+  private:
+    std::vector<AnyTracker> trackers; // in the order they were added
+    std::optional<Imu> imu;
+    std::array<double, capacity> cosines{}, sines{}, levers{}; // of each axis, lever in/rad
+    std::array<double, capacity> tpus{};                       // ticks per in, 0 for the odom's
+    std::array<std::array<double, capacity>, 3> solve{};       // pseudo-inverse, rows x, y, theta
+    std::array<double, capacity> residuals{}; // in each drifted from the fit, decaying
+    uint32_t dropped = 0;                     // bit per tracker left out of the fit
+    double heading = 0.0;                     // rad
+
+    bool calibrate() override;
+    bool fit(uint32_t left_out); // the pseudo-inverse without those trackers, false if singular
+
+  public:
+    double fault_travel = 0.25; // in a tracker can drift from the fit before it is dropped
+    double fault_time = 500.0;  // ms the drift decays over, so small errors never add up
+
+    explicit MultiOdom(double tpu, std::optional<Imu> imu = std::nullopt);
+
+    // before start(). position is in from the tracking center, x forward and y left, angle is deg
+    // counterclockwise from forward of the direction it measures, and tpu 0 takes the odom's.
+    // the tracker's index, or -1 when full or started
+    int add(AnyTracker tracker, Point position, double angle, double tpu = 0.0);
+    // bit per tracker dropped for disagreeing, in the order they were added
+    uint32_t get_dropped() const;
+
+    void task() override;
+    void bind() override;
+};
+
+/* GpsFusion */
+// corrects an odom's drift with a vex gps through an extended kalman filter in its own low
+// priority task. odom motion and its covariance are the prediction, and each fix is compared with
+// the odom pose from latency ago in the history. the odom loop only applies the resulting shift
+// and covariance, see correct()
+class GpsFusion {
+    OdomBase& odom;
+    pros::Gps gps;
+    Point offset;            // in, of the gps from the tracking center, x forward and y left
+    double heading_offset;   // rad, of the gps from forward, counterclockwise
+    FieldTransform frame;    // gps field coordinates (in, rad) to the odom's
+    int period;              // ms
+    Seqlock<Pose> requested; // deviation requested by reset() for the task to take
+    std::atomic<bool> reset_pending{false};
+    std::atomic<uint32_t> rejects{0};
+    pros::Task* fusion_task = nullptr;
+
+    void task();
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MIN + 1};
+    double min_error = 0.5;       // in, floor on the gps's own error estimate
+    double heading_error = 0.035; // rad, of the gps heading
+    double gate = 11.34;          // chi squared a fix is rejected above, 99% for 3 dof
+    uint32_t latency = 20;        // ms the gps reports behind
+
+    // the frame defaults to a gps field centered on the odom's 144in field, with the same axes
+    GpsFusion(OdomBase& odom, uint8_t port, Point offset = {0.0, 0.0}, double heading_offset = 0.0,
+              FieldTransform frame = FieldTransform::offset({72.0, 72.0, 0.0}), int period = 20);
+    ~GpsFusion();
+
+    void start();
+    // after odom.set() to a known pose, in and rad
+    void reset(const Pose& deviation = {1.0, 1.0, 0.035});
+    Pose get_deviation();      // 1 sigma of the pose, in and rad
+    uint32_t rejected() const; // fixes outside the gate
+};
+
+/* Relocalizer */
+// a distance sensor on the robot, for Relocalizer and ParticleFilter
+struct DistanceSensor {
+    uint8_t port;
+    Pose offset; // in from the tracking center, x forward and y left, and deg counterclockwise
+                 // from forward the sensor faces
+};
+
+// corrects an odom's x and y from distance sensors while a sensor is square to a field wall, in
+// its own low priority task. the odom is expected in field coordinates, walls at 0 and field
+class Relocalizer {
+    OdomBase& odom;
+    std::vector<pros::Distance> sensors;
+    std::vector<Pose> offsets; // in and rad
+    int period;                // ms
+    std::atomic<bool> enabled{false};
+    std::atomic<uint32_t> accepted{0};
+    pros::Task* relocalize_task = nullptr;
+
+    void task();
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MIN + 1};
+    int min_confidence = 45;     // of 63, the sensor's own confidence in a reading
+    double max_distance = 48.0;  // in, readings get noisier further away
+    double max_angle = 5.0;      // deg a sensor can be from square to a wall
+    double max_correction = 4.0; // in, larger disagreements are objects in front of the wall
+    double gain = 0.25;          // of the disagreement corrected per cycle, 0 to 1
+    double field = 144.0;        // in between opposite walls
+    uint32_t latency = 30;       // ms a reading is behind
+
+    Relocalizer(OdomBase& odom, std::initializer_list<DistanceSensor> sensors, int period = 20);
+    ~Relocalizer();
+
+    void start(); // corrects in the background until stop()
+    void stop();
+    // checks every sensor once and corrects from the ones square to a wall, false when none were
+    bool relocalize();
+    uint32_t corrections() const; // readings applied so far
+};
+
+/* ParticleFilter */
+// monte carlo localization on the field walls from distance sensors, in its own low priority
+// task. particles move with the odom's motion, are weighted by how well every reading matches the
+// wall its sensor would see from them, and the odom is pulled towards their mean with correct()
+class ParticleFilter {
+  public:
+    static constexpr int capacity = 512;
+
+  private:
+    // struct of arrays, heading as a unit vector so the loops need no trig
+    struct Particles {
+        alignas(16) std::array<float, capacity> x, y, cos, sin, weight;
+    };
+
+    OdomBase& odom;
+    std::vector<pros::Distance> sensors;
+    std::vector<Pose> offsets; // in and rad
+    int count;
+    int period; // ms
+    Particles particles, resampled;
+    uint32_t random = 0x9E3779B9; // xorshift state
+    Seqlock<Pose> estimate, spread, requested, requested_spread;
+    std::atomic<bool> reset_pending{false};
+    pros::Task* mcl_task = nullptr;
+
+    void task();
+    float uniform(); // 0 to 1
+    float noise();   // about normal, 1 sigma
+    void scatter(const Pose& pose, const Pose& deviation);
+    void move(const Pose& motion);
+    void weigh(size_t sensor, float distance, const Pose& since);
+    void resample();
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MIN + 1};
+    double travel_noise = 0.05;    // in of position noise per in driven, 1 sigma
+    double turn_noise = 0.05;      // rad of heading noise per rad turned, 1 sigma
+    double jitter = 0.05;          // in and deg every cycle, keeps resampled particles apart
+    double sensor_noise = 0.04;    // of the reading, 1 sigma
+    double min_sensor_noise = 0.5; // in
+    int min_confidence = 30;       // of 63
+    double max_distance = 80.0;    // in
+    double max_deviation = 3.0;    // in, spread above which the odom is left alone
+    double gain = 0.2;             // of the difference to the mean corrected per cycle, 0 to 1
+    double field = 144.0;          // in between opposite walls
+    uint32_t latency = 30;         // ms a reading is behind
+
+    // count is rounded up to a multiple of 4, at most capacity
+    ParticleFilter(OdomBase& odom, std::initializer_list<DistanceSensor> sensors, int count = 256,
+                   int period = 20);
+    ~ParticleFilter();
+
+    void start(); // scatters the particles around the odom pose
+    // scatters them around a pose instead, in and deg like odom.set()
+    void reset(const Pose& pose, const Pose& deviation = {2.0, 2.0, 3.0});
+    Pose get();           // weighted mean, in and rad
+    Pose get_deviation(); // spread of the particles, in and rad
+};
+
+/* LineReset */
+// a line tracker or optical sensor looking down at the field, for LineReset
+struct LineSensor {
+    uint8_t port; // 'A' to 'H' for an adi line tracker, 1 to 21 for an optical sensor
+    Point offset; // in from the tracking center, x forward and y left
+};
+
+// a strip of tape on the field, running along x or y
+struct FieldLine {
+    enum Axis { X, Y };
+    Axis axis;
+    double position;               // in, the y of a line along x or the x of one along y
+    double from = 0.0, to = 144.0; // in, where it starts and ends along its axis
+};
+
+// corrects the odom's coordinate across field lines as line sensors cross them, in its own task.
+// a crossing runs from where a sensor went onto the tape to where it came off, with the times
+// interpolated between samples and the poses taken from the odom's history, so its middle is on
+// the line at any speed. the odom is expected in field coordinates
+class LineReset {
+    struct Sensor {
+        std::variant<pros::adi::LineSensor, pros::Optical> device;
+        Point offset;
+        bool over = false; // on the tape
+        double prev = NAN; // brightness of the last sample, 0 to 1
+        uint64_t prev_time = 0, enter_time = 0, leave_time = 0; // us, of the sample and the edges
+    };
+
+    OdomBase& odom;
+    std::vector<Sensor> sensors;
+    std::vector<FieldLine> lines;
+    int period; // ms
+    std::atomic<bool> enabled{false};
+    std::atomic<uint32_t> accepted{0}, rejects{0};
+    pros::Task* line_task = nullptr;
+
+    void task();
+    double read(Sensor& sensor); // nan when it can't be read
+    bool cross(const Sensor& sensor, uint64_t enter, uint64_t leave);
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_DEFAULT};
+    double threshold = 0.5;      // brightness, 0 to 1, above which a sensor is on the tape
+    double hysteresis = 0.1;     // below the threshold it has to fall to come off the tape
+    double width = 2.0;          // in, of the tape
+    double max_correction = 3.0; // in, further from every line is some other mark on the field
+    double gain = 1.0;           // of the disagreement corrected per crossing, 0 to 1
+    bool blend = true;           // eases corrections in over the odom's blend time, false snaps
+    uint32_t max_time = 1000;    // ms on the tape, longer is driving along it or parked on it
+    uint32_t latency = 5;        // ms a reading is behind, half an adi update
+
+    LineReset(OdomBase& odom, std::initializer_list<LineSensor> sensors,
+              std::initializer_list<FieldLine> lines, int period = 5);
+    ~LineReset();
+
+    void start(); // corrects in the background until stop()
+    void stop();
+    uint32_t corrections() const; // crossings applied so far
+    uint32_t rejected() const;    // crossings too far from a line or not across the tape
+};
+
+/* ObjectSensor */
+// where a sensor saw its object, from the tracking center
+struct Sighting {
+    bool seen = false;
+    double bearing = NAN;  // rad counterclockwise from forward
+    double distance = NAN; // in, nan when the sensor can't range it
+    uint64_t time = 0;     // us the image was taken, for the odom history
+};
+
+// a sensor that picks out a game element, for turn_to_object() and drive_to_object(). subclass it
+// for a camera or coprocessor the library doesn't wrap
+class ObjectSensor {
+  public:
+    virtual ~ObjectSensor();
+    virtual Sighting sight() = 0; // the latest sighting, not seen when the object isn't in view
+};
+
+// the largest blob of a vision sensor signature. the bearing comes from the blob's center across
+// the field of view, and the distance from its width when the object's width is set
+class VisionSensor : public ObjectSensor {
+    pros::Vision vision;
+    uint8_t signature;
+    Pose offset; // in and rad
+
+  public:
+    double fov = 61.0;         // deg across the image
+    int image_width = 316;     // px
+    double object_width = 0.0; // in, 0 leaves the distance unknown
+    int min_width = 4;         // px, narrower blobs are noise
+    uint32_t latency = 30;     // ms from the image to the reading
+
+    // offset is in from the tracking center, x forward and y left, and deg counterclockwise from
+    // forward the camera faces
+    VisionSensor(uint8_t port, uint8_t signature, const Pose& offset = {0.0, 0.0, 0.0});
+
+    Sighting sight() override;
+};
+
+// what a distance sensor faces, for move_to_range(). readings out of range or below the
+// confidence are dropped, and the median of the last three filters out single bad ones
+class RangeSensor : public ObjectSensor {
+    pros::Distance sensor;
+    Pose offset; // in and rad
+    std::array<std::pair<double, uint64_t>, 3> readings{}; // in, and us they were taken
+    int count = 0;
+
+  public:
+    int min_confidence = 0;     // of 63, the sensor reports less close in, 0 takes every reading
+    double max_distance = 78.0; // in
+    uint32_t latency = 30;      // ms from the reading to it being reported
+
+    // offset is in from the tracking center, x forward and y left, and deg counterclockwise from
+    // forward the sensor faces
+    RangeSensor(uint8_t port, const Pose& offset = {0.0, 0.0, 0.0});
+
+    Sighting sight() override;
+    // in from the tracking center to what the sensor sees range in away
+    double reach(double range) const;
+};
+
+// a moving target given on the field instead of seen, such as a partner robot's reported pose or
+// an element in FieldObjects, for turn_to_object() and drive_to_object() to chase in one motion.
+// it is read again every control step, and with lead set its velocity from the last few positions
+// carries it forward to where it will be, lead ms after the position was taken
+class MovingTarget : public ObjectSensor {
+    OdomBase& odom;
+    std::function<Point()> position; // in, field coordinates, nan while unknown
+    const FieldObjects* objects = nullptr;
+    int id = -1;
+    Derivative<3> x_rate, y_rate; // in/s
+    Point last = {NAN, NAN};      // the last position the rates took
+    uint64_t last_time = 0;       // us it was taken
+    uint32_t moved_at = 0;        // ms the object was last moved
+
+  public:
+    double lead = 0.0; // ms ahead of the position to aim, 0 aims at it
+
+    // position is read on the chassis task, so it has to be safe to call from there
+    MovingTarget(OdomBase& odom, std::function<Point()> position);
+    // the object with that id, moving as it is moved and lost once it is removed
+    MovingTarget(OdomBase& odom, const FieldObjects& objects, int id);
+
+    Sighting sight() override;
+    Point velocity() const; // in/s, field coordinates
 };
 
 /* Chassis */
+class SensorHub;
+class PowerManager;
+
 class Chassis {
+  public:
+    // why a motion ended, so callers can branch on it
+    enum Result : uint8_t { RUNNING, SETTLED, TIMED_OUT, EXITED, STALLED, CANCELLED };
+    // who a drive command comes from, the actuator applies the highest one that hasn't expired.
+    // tank, arcade and motions post NORMAL, the latest of which always stands
+    enum Priority : uint8_t { NORMAL, MACRO, DRIVER, SAFETY };
+
+    // summary of a finished motion, RUNNING for motions handed off to the chassis task
+    struct MotionResult {
+        Result reason = RUNNING;
+        uint32_t time = 0;       // ms from the start of the motion
+        double error = NAN;      // final linear units, or degrees for turns
+        double peak_speed = 0.0; // in/s, or deg/s for turns
+        uint32_t id = 0;         // command the result is for, to wait on with finished()
+    };
+
+    // curvature drive, where the turn stick sets curvature instead of turn rate
+    struct CurvatureConfig {
+        double sensitivity = 1.0; // turn at full forward speed per unit of turn stick
+        double inertia = 0.5;     // negative inertia, kicks the turn against stick changes
+        double quick_turn = 10.0; // forward % below which controller input turns in place
+        double quick_stop = 0.1;  // 0 to 1, how much quick turn momentum is stopped afterwards
+    };
+
+    // a routine run by dry_run()
+    struct DryRun {
+        double time = 0.0;                 // ms from the start to the end of the last motion
+        std::vector<Pose> trajectory;      // in and deg, every 20 ms of simulated time
+        std::vector<MotionResult> results; // of each motion in the order they ran
+        Pose end;                          // in and deg
+    };
+
+    struct Progress {
+        uint32_t id = 0;        // command the progress is for
+        bool running = false;
+        double percent = 0.0;   // % complete
+        double remaining = 0.0; // linear units, or degrees for turns
+        int segment = -1;       // path segment being followed, -1 when not following a path
+        Result result = RUNNING;
+        Point error = {0.0, 0.0}; // of the latest step, linear units and radians
+    };
+
+    // the hottest drive motor sets the scale, falling from 1 at start to floor at limit. v5 motors
+    // halve their current limit at 55 °C and report temperature in steps of 5 °C, so the scale
+    // eases toward each new step over smoothing
+    struct Derating {
+        double start = 45.0;       // °C
+        double limit = 55.0;       // °C, start or below turns derating off
+        double floor = 0.6;        // scale at and above the limit
+        double current = 0.0;      // mA, a motor's mean draw above this scales by current / draw
+        double smoothing = 5000.0; // ms, time constant of the scale
+        int period = 500;          // ms between reads
+    };
+    struct Heat {
+        double scale = 1.0;    // of the speed and accel of motions starting now
+        double hottest = 0.0;  // °C
+        int8_t port = 0;       // of the hottest motor
+        uint32_t hot = 0;      // bit per motor from start up, the left motors then the right
+        uint32_t limited = 0;  // the same for motors the firmware reports over temperature
+    };
+
+    // a drive motor's means over a health check, flagged where it's off from the rest of its side
+    struct MotorHealth {
+        enum Flag : uint8_t { DISCONNECTED = 1, VELOCITY = 2, CURRENT = 4, EFFICIENCY = 8 };
+        int8_t port = 0;
+        double velocity = 0.0;   // rpm
+        double current = 0.0;    // mA
+        double efficiency = 0.0; // %
+        uint8_t flags = 0;
+    };
+    struct Health {
+        std::array<MotorHealth, 16> motors{}; // the left motors then the right
+        int count = 0;
+        int samples = 0;   // reads the means are over
+        uint8_t flags = 0; // of every motor together, 0 when each side agrees
+    };
+    // how far a motor can be from the median of its side. a failing motor leaves the others to
+    // pull its share, so it draws less current, and a stripped one spins at its own speed
+    struct HealthLimits {
+        double velocity = 0.1;    // share of the median
+        double current = 0.5;     // share of the median
+        double efficiency = 20.0; // % below the median
+        double moving = 30.0;     // rpm of the median before velocity and efficiency are judged
+        double loaded = 200.0;    // mA of the median before current is judged
+    };
+
+    // eases off the speed changes of motions while the robot rocks on its wheels, from the odom
+    // imu's pitch and roll. tipping is leaning past angle, or leaning further faster than rate
+    struct AntiTip {
+        Point level = {0.0, 0.0}; // deg of pitch and roll standing still, for an imu off level
+        double angle = 6.0;       // deg from level
+        double rate = 40.0;       // deg/s
+        double accel = 150.0;     // %/s at most of accel and decel while tipping, 0 is off
+        int hold = 250;           // ms the limit stays on after the robot stops tipping
+    };
+
+    // adapts the accel slew limit to the wheel slip for the first duration ms of motions that
+    // start from a stop: it starts at accel, is cut while the slip is over slip and climbs back by
+    // rise while it's under, so the launch is the fastest the tiles allow instead of a fixed accel
+    struct LaunchControl {
+        int duration = 300;       // ms of a motion, 0 is off
+        double slip = 3.0;        // in/s of wheel slip the launch is kept under
+        double accel = 1000.0;    // %/s it starts at and climbs back to at most
+        double min_accel = 100.0; // %/s it's never cut below
+        double cut = 40.0;        // ms time constant accel is cut with while slipping
+        double rise = 4000.0;     // %/s² accel climbs back by while gripping
+        double standing = 2.0;    // in/s the robot has to be under for a motion to launch
+    };
+
+    // stops the robot at the end of a motion that doesn't hand off, instead of leaving it to the
+    // brake mode. a pulse drives each side against the way it still turns, in proportion to its
+    // speed, and hold holds the motors for the time then puts their brake mode back
+    struct ActiveBrake {
+        int time = 0;       // ms at most, 0 is off
+        double gain = 1.0;  // % reversed per % of full speed a side still turns
+        double max = 50.0;  // % at most reversed
+        double stop = 2.0;  // % of full speed both sides are under when stopped
+        bool hold = false;  // hold instead of pulsing
+    };
+
+    // brake modes the drive is put in as it changes phase, each written only when it changes.
+    // settled is for motions that stop rather than hand off, unless their brake option says
+    // otherwise, and idle is for driver control once the sticks rest for idle_time. INVALID
+    // leaves the mode as it is
+    struct BrakePolicy {
+        pros::motor_brake_mode_e motion = pros::E_MOTOR_BRAKE_INVALID;
+        pros::motor_brake_mode_e settled = pros::E_MOTOR_BRAKE_INVALID;
+        pros::motor_brake_mode_e driver = pros::E_MOTOR_BRAKE_INVALID;
+        pros::motor_brake_mode_e idle = pros::E_MOTOR_BRAKE_INVALID;
+        int idle_time = 250; // ms
+    };
+
+    // an outside force on the drive, such as a robot pushing back or a heavy load, observed while
+    // motions run as the output (%) the drive's feedforward doesn't account for at the measured
+    // speed and acceleration, or its velocity alone without one
+    struct Disturbance {
+        double smoothing = 100.0; // ms time constant of the estimate
+        double gain = 0.0;        // share of it added back to each motion's output, under 1
+        double push = 25.0;       // % of linear disturbance the robot counts as pushed over
+        bool boost = false;       // while pushed, no speed cap or slew, so it pushes back fully
+    };
+
+    // how hold() keeps a pose. inside the deadbands the drive rests, so the motors don't buzz and
+    // heat on the odom's noise, and the current limit caps how hard it pushes back
+    struct Hold {
+        double deadband = 0.5;  // in along the heading
+        double angle = 2.0;     // deg
+        double lateral = 3.0;   // in pushed sideways before it turns to drive back onto the pose
+        int32_t current = 1500; // mA per motor while holding, 0 leaves the limit alone
+        int period = 20;        // ms between control steps
+    };
+
+    // how set_direction() picks the way of moves and turns left on AUTO. instead of the nearest way
+    // round, each goes the way its estimate finishes first, from the robot's speed and the way it
+    // already turns, slower backwards by reverse, and with next the turn into the queued motion
+    // after. the choice holds until the nearest way agrees with it, then AUTO takes over again
+    struct DirectionChoice {
+        bool fastest = false;
+        double reverse = 1.0; // share of its forward speed the robot reaches backwards
+        double accel = 100.0; // in/s² of the wheels, for motions without an accel
+        bool next = true;
+    };
+
+    // called from the motion's task on the control step each happens, so they have to be quick.
+    // plain functions, stored inline like the exits' sensors. start gets the result with only its
+    // id, settle each time the motion enters its exit so far, and exit the final result of a
+    // motion that ends, or cancel of one that's cancelled
+    struct Hooks {
+        void (*start)(const MotionResult& result) = nullptr;
+        void (*settle)(const MotionResult& result) = nullptr;
+        void (*exit)(const MotionResult& result) = nullptr;
+        void (*cancel)(const MotionResult& result) = nullptr;
+    };
+
+    // an inner loop on each side's speed in the actuator task. commands are then % of free speed
+    // rather than of 12 V, and a load that slows a side is pushed through by its pid within a
+    // few ms instead of showing up as error for the motion's controller
+    struct VelocityLoop {
+        Gains gains = {0.0, 0.0, 0.0}; // % per % of free speed off, all 0 is off
+        Feedforward ff = {0.0, 1.0};   // % for the speed (% of free speed) and accel (%/s)
+        bool trackers = false; // side speeds from the odom through the kinematics, not the motors
+    };
+
+    // moves with the mpc option plan the wheel accelerations over a short horizon on a
+    // differential drive model every control step, tracking a route into the target timed to
+    // stop on it, and drive the first step of the plan. the wheels stay within the accel
+    // option, or the drive model's max_accel, and the speed cap
+    struct MpcConfig {
+        int horizon = 16;       // steps planned ahead, at most 32
+        double step = 40.0;     // ms per step
+        double lag = 80.0;      // ms time constant of the wheels following their command
+        double position = 1.0;  // cost per in² off the route at each step
+        double heading = 200.0; // cost of facing away from the route's heading
+        double stop = 0.05;     // cost per (in/s)² of wheel speed at the end of the plan
+        double reach = 12.0;    // in from the target where the stop cost is half
+        double terminal = 10.0; // the last step's position and heading costs, times this
+        double effort = 1e-5;   // cost per (in/s²)² of wheel acceleration
+        int iterations = 10;    // of the solver each control step
+        uint32_t budget = 0;    // us a control step's solve may take, 0 runs every iteration
+    };
+
   private:
     pros::MotorGroup left_motors, right_motors;
-    Odom& odom;
-    Options df_move, df_turn;
-    Point prev_speeds = {0.0, 0.0};
-    double path_length = 0.0;
+    OdomBase& odom;
+    PackedOptions df_options, df_move, df_turn; // defaults, then with each config merged in
+    ExitFn df_exit_fn;
+    Slew left_slew, right_slew;
+    double drive_accel = 0.0, drive_decel = 0.0; // driver control slew limits (%/s)
+    Curve drive_curve, turn_curve; // driver input shaping, turn_curve is for arcade turning
+    void tank_sticks(int32_t left, int32_t right);
+    void arcade_sticks(int32_t forward, int32_t turn);
+
+    // driver assist, the motion assist() started and the cancel token the driver took over on
+    std::atomic<uint32_t> assist_id{0};
+    std::atomic<uint32_t> override_token{UINT32_MAX};
+    bool assisted(const Point& speeds);
+
+    // arcade heading hold, active while driving with the turn stick in its deadzone
+    bool heading_hold = false;
+    PID hold_pid{0.0, 0.0, 0.0};
+    double held_heading = NAN; // rad, NAN while turning
+    uint32_t hold_time = 0;
+    double hold_heading(double linear, double angular);
+
+    CurvatureConfig curvature_config;
+    double prev_turn = 0.0, inertia_accumulator = 0.0, quick_stop_accumulator = 0.0;
+    Point curvature_speeds(double linear, double angular, bool quick_turn);
+    void curvature_sticks(int32_t forward, int32_t turn);
+    uint32_t drive_time = 0;
+
+    // battery compensation, sampled by its own task so commands only read the cached scale
+    pros::Task* battery_task = nullptr;
+    std::atomic<double> nominal_voltage{0.0}; // V, 0 is off
+    std::atomic<double> voltage_scale{1.0};
+    void battery();
+
+    // thermal derating, a low rate task caps the speed and accel of motions as the motors heat
+    pros::Task* derate_task = nullptr;
+    std::atomic<double> derate_scale{1.0};
+    void derate();
+
+    // drive motor health, checked in the background by start_health()
+    pros::Task* health_task = nullptr;
+    Seqlock<Health> health;
+    void watch_health(int period);
+    double voltage(double speed) const;
+
+    // last millivolts written to each side, so unchanged commands skip the smart ports
+    int32_t left_written = INT32_MIN, right_written = INT32_MIN;
+    uint32_t write_time = 0, write_interval = 0; // ms
+    void write(double left_speed, double right_speed);
+
+    // optional actuator stage, producers post the latest command and one task applies it
+    struct ActuatorCommand {
+        int16_t left = 0, right = 0;    // 0.01 %
+        uint16_t accel = 0, decel = 0; // slew limits (%/s), 0 is unlimited
+    };
+    std::atomic<ActuatorCommand> actuator_command{};
+    // a command above NORMAL and the ms it lapses at, 0 when empty. the actuator reads the time
+    // before the command and submit writes it after
+    struct Submission {
+        std::atomic<ActuatorCommand> command{};
+        std::atomic<uint32_t> until{0};
+    };
+    std::array<Submission, SAFETY> submissions{}; // MACRO and up
+    ActuatorCommand arbitrate();
+    std::atomic<int> actuator_period{0}; // ms, 0 writes the motors from the caller
+    pros::Task* actuator_task = nullptr;
+    void actuator();
+    bool post(const Point& speeds, double accel, double decel);
+    static ActuatorCommand pack(const Point& speeds, double accel, double decel);
+    VelocityLoop velocity_loop;
+    PID left_velocity{Gains()}, right_velocity{Gains()};
+    Point velocity_target = {0.0, 0.0}; // after the slew, for the accel feedforward
+    Point side_speeds(bool trackers);   // % of free speed
+
+    // wheel slip from the motors against the trackers
+    Channel slip_channel;
+    double slip_threshold = 0.0, slip_accel = 1.0; // in/s, and the accel scale while above it
+    AntiTip anti_tip = {.accel = 0.0};
+    LaunchControl launch_control = {.duration = 0};
+    ActiveBrake active_brake;
+    void brake(pros::motor_brake_mode_e mode);
+    // the last mode set on each side, INVALID until it's read once, so phases skip the ports
+    BrakePolicy brake_policy;
+    pros::motor_brake_mode_e left_brake = pros::E_MOTOR_BRAKE_INVALID,
+                             right_brake = pros::E_MOTOR_BRAKE_INVALID;
+    uint32_t resting_since = 0; // ms the driver's sticks came to rest, 0 while they move
+    pros::motor_brake_mode_e brake_mode(bool left);
+    void apply_brake(pros::motor_brake_mode_e left, pros::motor_brake_mode_e right);
+    Hold holding;
+    DirectionChoice direction_choice;
+    Seqlock<Hooks> hooks;   // as set, read once as each motion starts
+    Hooks run_hooks;        // the running motion's
+    uint32_t run_start = 0; // ms the running motion started, for its hooks
+    Direction preferred_dir = AUTO, preferred_turn = AUTO; // of the running move or turn
+    std::optional<Disturbance> observer;
+    Seqlock<Point> disturbance;      // linear and angular, %
+    Channel disturbance_channel;
+    uint32_t tip_time = 0; // ms the robot was last tipping
+
+    // the mpc's plan, kept from one control step to start the next solve from. struct of arrays
+    // over the horizon so the solver's updates run four steps at a time with neon
+    struct MpcPlan {
+        static constexpr int capacity = 32;
+        alignas(16) std::array<real, capacity> left, right; // wheel in/s², the plan
+        alignas(16) std::array<real, capacity> grad_left, grad_right;
+        alignas(16) std::array<real, capacity> prev_left, prev_right, prev_grad_left,
+            prev_grad_right; // the iterate before, for the step size
+        // rolled out from the robot, step 0 is where it is, with each wheel's speed and command
+        alignas(16) std::array<real, capacity + 1> x, y, theta, cos, sin, vl, vr, cl, cr;
+        alignas(16) std::array<real, capacity + 1> rx, ry, rtheta; // what the plan tracks
+        Point wheels = {0.0, 0.0}; // in/s last commanded
+        double age = 0.0;          // s since the plan's first step started
+        uint32_t time = 0;         // ms of the last solve
+    };
+    MpcConfig mpc_config;
+    MpcPlan mpc_plan{};
+
+    Kinematics kinematics;
+    double track_width;
+    double move_velocity, turn_velocity; // at full speed, in/s and deg/s
+    double min_lookahead, max_lookahead; // in, adaptive when max is above min
+    double move_ks, turn_ks;             // %, static friction
+    Feedforward move_ff, turn_ff;
+    // lqr gains of turns by control period, from 1 ms, empty when turns use the pid
+    std::array<LqrGains, 32> turn_lqr{};
+    bool lqr_turns = false;
+
+    // path or trajectory being followed, in the frame of path_frame
+    const Path* follow_path = nullptr;
+    const Trajectory* follow_trajectory = nullptr;
+    Pose path_frame;
+    int path_index = 0;
+    const Path* marker_path = nullptr; // path whose markers are fired, through the final move
+    size_t marker_index = 0;
+    std::atomic<const Path*> next_path{nullptr}; // from update_path(), taken on the next step
+    std::atomic<bool> pursuing{false};           // while a follow pursues its path
+    void fire_markers(double distance);
+    double arc_radius = 0.0; // of the running arc or swing, as in Command::radius
+    ObjectSensor* tracking = nullptr; // of the running turn or move, as in Command::object
+    MotionResult motion_result;
+    Seqlock<MotionResult> last_result;
+    Seqlock<Derating> derating;
+    Seqlock<Heat> heat;
+
+    // drive motor reads, from the hub's snapshot while one is running for this chassis
+    friend class SensorHub;
+    friend class PowerManager; // reads the drive's current and whether a motion is running
+    std::atomic<int32_t> hold_limit{0}; // mA per motor a running hold keeps the drive under, or 0
+    std::atomic<const SensorHub*> sensor_hub{nullptr};
+    Point read_velocity();
+    double read_current();
+    double get_current();
+
+    enum Motion { MOVE, PATH, TURN, TRAJECTORY, SWING, ARC, STRAIGHT, HOLD };
+
+    struct Command {
+        Pose target;
+        std::shared_ptr<const Path> path;
+        PackedOptions options;
+        Motion motion;
+        std::shared_ptr<const Trajectory> trajectory = nullptr;
+        ExitFn exit_fn = nullptr; // kept out of the packed options
+        uint32_t token = 0;       // cancel token the command was issued under
+        uint32_t id = 0;          // order the command was issued in
+        double radius = 0.0;      // arc radius (in), or for swings >0 locks the left side
+        ObjectSensor* object = nullptr; // retargets a turn or move on each sighting
+    };
+
+    static constexpr int queue_capacity = 16;
 
     pros::Task* chassis_task = nullptr;
     pros::Mutex chassis_mutex;
-    std::atomic<bool> is_running{false};
+    std::atomic<int> motions{0}; // queued plus running async motions
+
+    // cooperative cancellation, motions run until the token moves on from theirs
+    std::atomic<uint32_t> cancel_token{0};
+    uint32_t run_token = 0;           // token of the running motion, only used by its task
+    std::atomic<int> active{0};       // motions currently running, inline or on the worker
+    std::atomic<pros::task_t> active_task{nullptr};
+    std::atomic<pros::task_t> cancel_waiter{nullptr};
+
+    // progress of the running motion, published every control step
+    std::atomic<uint32_t> issued{0};
+    uint32_t run_id = 0;
+    double progress_total = 0.0; // distance of the whole command, 0 to use the motion's own
+    int progress_segment = -1;
+    Seqlock<Progress> motion_progress;
+    std::atomic<uint32_t> exit_id{0}; // command exit_motion() ended, taken by its control step
+    Seqlock<LoopTiming> motion_timing; // control steps of every motion so far
+    std::atomic<Recorder*> recorder{nullptr};
+    std::atomic<PerformanceLog*> performance{nullptr};
+    std::atomic<const Geofence*> geofence{nullptr};
+    std::atomic<PathLearning*> learning{nullptr};
+    PathLearning* path_learning = nullptr; // of the running follow
+    FieldTransform field; // applied to commands as they're issued, set between routines
+    std::array<std::atomic<pros::task_t>, 4> progress_waiters{};
+    void publish_progress(const Progress& progress);
+    bool wait_for(bool (*reached)(const Progress&, double), double value);
+    std::array<Command, queue_capacity> queue;
+    int queue_head = 0, queue_size = 0;
+
+    PID lin_pid{Gains()}, ang_pid{Gains()};
+    bool chained = false; // previous motion handed off without stopping
+
+    // motions issued from this task are handed off, set by a Runner while it runs a routine
+    std::atomic<pros::task_t> routine_task{nullptr};
+    friend class Runner;
 
-    enum Motion { MOVE, PATH, TURN };
+    // each kind of motion's error and output, one built in place for each run of the shared loop
+    // in motion_task. a new controller goes in the list with the motions it runs
+    struct Step;
+    class MotionController;
+    class MoveController;
+    class StraightController;
+    class PathController;
+    class TurnController;
+    class ArcController;
+    class TrajectoryController;
+    class MpcController;
+    class HoldController;
+    using MotionControllers =
+        std::variant<std::monostate, MpcController, MoveController, StraightController,
+                     PathController, TurnController, ArcController, TrajectoryController,
+                     HoldController>;
+    template <size_t I = 1>
+    MotionController* make_controller(MotionControllers& controllers, const PackedOptions& options,
+                                      const Step& step, Motion motion);
+    void motion_task(Pose target, const PackedOptions& options, const ExitFn& exit_fn,
+                     const Motion motion);
+    ExitFn merge_exit_fn(Options& options, const Options& override);
+    MotionResult motion_handler(const Command& command, bool mapped = false);
+    Command to_field(Command command) const;
+    MotionResult run(const Command& command);
+    void push(const Command& command);
+    bool pop(Command& command);
+    int queued();
+    std::optional<Point> next_point();
+    std::optional<Command> next_command();
+    void choose_direction(const Command& command);
+    void cancel();
+    void drive(const Point& speeds, double accel, double decel, double dt);
+    void drive(const Point& speeds);
 
-    void motion_task(Pose target, const Options options, const Motion motion);
-    void motion_handler(const std::vector<Pose>& target, const Options& options,
-                        const Motion& motion);
+    // commands for each motion, empty when its arguments can't run
+    std::optional<Command> move_command(Pose target, Options options, const Options& override);
+    std::optional<Command> turn_command(const Point& target, Options options,
+                                        const Options& override);
+    std::optional<Command> swing_command(const Point& target, Side locked, Options options,
+                                         const Options& override);
+    std::optional<Command> arc_command(double radius, double angle, Options options,
+                                       const Options& override);
+    std::optional<Command> follow_command(const Path& path, Options options,
+                                          const Options& override);
+    std::optional<Command> follow_command(const std::vector<Point>& path, Options options,
+                                          const Options& override);
+    std::optional<Command> track_command(const Trajectory& trajectory, Options options,
+                                         const Options& override);
+    std::optional<Command> object_command(ObjectSensor& sensor, Motion motion, Options options,
+                                          const Options& override);
+    std::optional<Command> hold_command(Pose target, Options options, const Options& override);
+    MotionResult issue(const std::optional<Command>& command);
+
+    // a dry run's drive model and clock, only touched by the task running dry_run()
+    struct Simulation {
+        uint64_t now;               // us, simulated
+        uint32_t real;              // ms, when the last motion ended
+        double lag, free_speed;     // ms, wheel in/s
+        Point wheels = {0.0, 0.0};  // in/s
+        Point command = {0.0, 0.0}; // mV written
+        uint64_t next_sample;       // us
+        DryRun* report;
+    };
+    std::optional<Simulation> simulation;
+    uint32_t clock_ms() const; // the simulated time in a dry run
+    uint64_t clock_us() const;
+    void simulate(double dt); // ms
+    void catch_up();
+    double extent(const Command& command, const Pose& pose) const;
+    int auto_timeout(const Command& command, double extent);
 
   public:
+    // a motion built ahead of time, with its options merged, its path built and its targets mapped
+    // onto the field, so run() only starts or queues it. copies share the path or trajectory
+    class Prepared {
+        friend class Chassis;
+        Command command, mapped; // as given and on the field it was prepared for
+        FieldTransform field;
+        bool valid = false;
+
+      public:
+        explicit operator bool() const; // false when the motion's arguments can't run
+    };
+
+    struct Characterization {
+        Feedforward linear, angular; // in/s and deg/s
+        double latency;              // ms, from a voltage step until the robot moves
+    };
+    struct Tuning {
+        Gains gains;          // suggested, for lin_PID or ang_PID
+        double ultimate_gain; // % per in or per rad
+        double period;        // ms, of the oscillation at the ultimate gain
+    };
+
+  private:
+    Tuning autotune(bool angular, double amplitude, int cycles, const char* file);
+    Prepared prepare(const std::optional<Command>& command);
+
+  public:
+    // of the tasks the chassis starts, set before the first motion or set_ call that starts them
+    TaskConfig task_config;                                    // async and queued motions
+    TaskConfig battery_task_config = {TASK_PRIORITY_MIN};      // set_voltage_compensation()
+    TaskConfig actuator_task_config = {TASK_PRIORITY_MAX - 1}; // set_actuator()
+    TaskConfig derate_task_config = {TASK_PRIORITY_MIN};       // set_derating()
+    TaskConfig health_task_config = {TASK_PRIORITY_MIN};       // start_health()
+    HealthLimits health_limits;
+
     Chassis(const std::initializer_list<int8_t>& left_motors,
-            const std::initializer_list<int8_t>& right_motors, Odom& odom,
+            const std::initializer_list<int8_t>& right_motors, OdomBase& odom,
             const MoveConfig& move_config, const TurnConfig& turn_config,
-            const Options& default_options = {});
+            const Options& default_options = {}, int period = 10);
     ~Chassis();
 
     void task();
-    void wait();
+    MotionResult wait(int remaining = 0);
+    void clear();
+
+    Progress get_progress();
+    LoopTiming get_timing();
+    bool wait_until(double percent);
+    bool wait_until_distance(double distance);
+    bool finished(uint32_t id); // whether the command with a result's id has ended
+    MotionResult get_result();  // of the last motion to end
 
-    void move(Pose target, Options options = {}, const Options& override = {});
-    void follow(const std::vector<Point>& path, Options options = {}, const Options& override = {});
-    void turn(const Point& target, Options options = {}, const Options& override = {});
+    MotionResult move(Pose target, Options options = {}, const Options& override = {});
+    MotionResult follow(const Path& path, Options options = {}, const Options& override = {});
+    MotionResult follow(const std::vector<Point>& path, Options options = {},
+                        const Options& override = {});
+    MotionResult turn(const Point& target, Options options = {}, const Options& override = {});
+    MotionResult swing(const Point& target, Side locked, Options options = {},
+                       const Options& override = {});
+    MotionResult arc(double radius, double angle, Options options = {},
+                     const Options& override = {});
+    MotionResult track(const Trajectory& trajectory, Options options = {},
+                       const Options& override = {});
+    // swaps the rest of a running follow onto another path, in the same frame and still driving
+    // the same way at the robot. the follower carries on from its closest point without
+    // stopping, and the path has to outlive the motion. false when no follow is pursuing a path
+    bool update_path(const Path& path);
+    // turns or drives to what the sensor sees, retargeting on the odom pose from when each image
+    // was taken so the robot's own motion since doesn't lag the aim. the target holds where the
+    // object was last seen if it drops out of view, and the motion waits for its first sighting
+    // until then. driving needs a sensor that ranges the object, offset stops that far short
+    MotionResult turn_to_object(ObjectSensor& sensor, Options options = {},
+                                const Options& override = {});
+    MotionResult drive_to_object(ObjectSensor& sensor, Options options = {},
+                                 const Options& override = {});
+    // drives until the sensor reads distance (in), such as up to a wall, with the reading as the
+    // linear error so the move decelerates into it. offset adds to the distance
+    MotionResult move_to_range(RangeSensor& sensor, double distance, Options options = {},
+                               const Options& override = {});
+    // keeps the robot on target against pushing, in the background until stop() or another
+    // motion. a target without a heading holds the one it starts on
+    MotionResult hold(Pose target, Options options = {}, const Options& override = {});
+
+    // the same motions prepared in initialize() or competition_initialize() to run later
+    Prepared prepare_move(Pose target, Options options = {}, const Options& override = {});
+    Prepared prepare_turn(const Point& target, Options options = {}, const Options& override = {});
+    Prepared prepare_swing(const Point& target, Side locked, Options options = {},
+                           const Options& override = {});
+    Prepared prepare_arc(double radius, double angle, Options options = {},
+                         const Options& override = {});
+    Prepared prepare_follow(const Path& path, Options options = {}, const Options& override = {});
+    Prepared prepare_follow(const std::vector<Point>& path, Options options = {},
+                            const Options& override = {});
+    Prepared prepare_track(const Trajectory& trajectory, Options options = {},
+                           const Options& override = {});
+    MotionResult run(const Prepared& prepared);
+    // runs a prepared motion on the worker from driver control, such as a move_to a scoring pose
+    // on a button. while it runs, tank, arcade and curvature on the sticks leave the drive to it,
+    // and take it back on the same call the sticks leave their deadzones
+    MotionResult assist(const Prepared& prepared);
+    bool assisting(); // whether an assist is still running
+
+    // predicted run of a prepared motion, for budgeting a routine before it runs on the field
+    struct Estimate {
+        double time = NAN;     // ms, settling included and cut short by the timeout
+        double distance = 0.0; // in the robot's center drives
+        double angle = 0.0;    // deg it turns
+        Pose end;              // where the motion leaves the robot, in and rad
+    };
+    // from the drive's velocity in the configs and the speed and accel limits of the motion's
+    // options, from start or the odom's pose. moves and turns without a profile also close the
+    // last of it at the pace their p gain and ks set. compare with the simulator or a run to fit
+    // the settle option. nan time when the motion can't run or the configs leave out the velocity
+    Estimate estimate(const Prepared& motion, std::optional<Pose> start = std::nullopt);
+    // a routine's motions in order, each starting where the one before it ends
+    Estimate estimate(std::span<const Prepared> motions, std::optional<Pose> start = std::nullopt);
+
+    // runs routine from start (in and deg, or the odom's pose) against the drive model, with the
+    // motors left off and the odom moved by the model instead of its sensors. motions all run
+    // inline, and each control step moves the model on by its period without waiting, so they
+    // take a fraction of their real time. the wheels follow their voltage with lag ms of delay,
+    // from the kinematics' free speed or the move config's velocity. the pose is put back after
+    DryRun dry_run(const std::function<void()>& routine, std::optional<Pose> start = std::nullopt,
+                   double lag = 80.0);
 
     void tank(double left_speed, double right_speed);
     void tank(const Point& speeds);
     void tank(pros::Controller& controller);
+    void tank(const Controller& controller);
     void arcade(double linear, double angular);
     void arcade(pros::Controller& controller);
+    void arcade(const Controller& controller);
+    void curvature(double linear, double angular, bool quick_turn = false);
+    void curvature(pros::Controller& controller);
+    void curvature(const Controller& controller);
+    void velocity(double linear, double angular);
     void stop(bool stop_task = true);
+    // ends the running motion as EXITED now, from any task such as a trigger's callback, waking it
+    // rather than waiting for its next control step
+    void exit_motion();
+    // starts the task async and queued motions run on, otherwise started by the first of them
+    void start_worker();
+    void set_slew(double accel, double decel);
+    void set_curve(const Curve& drive, const Curve& turn);
+    void set_curve(const Curve& curve);
+    void set_heading_hold(const Gains& gains);
+    void set_curvature(const CurvatureConfig& config);
+    void set_voltage_compensation(double nominal = 12.0);
+    void set_derating(const Derating& derating);
+    Heat get_heat();
+    // means of every drive motor read each interval ms over duration ms, judged by health_limits
+    Health check_health(int duration = 500, int interval = 10);
+    // turns in place at speed (%) and checks while turning, printing each motor, for before a
+    // match with room to turn
+    Health self_test(double speed = 40.0, int duration = 1500);
+    // checks over every period ms in the background, printing each flag the first time a motor gets
+    // it. velocity and efficiency are only judged while the drive moves
+    void start_health(int period = 2000);
+    Health get_health(); // of the latest background check
+    void set_write_interval(uint32_t interval);
+    void set_actuator(int period = 5);
+    // holds speeds (%) above the commands of lower priorities for expiry ms, or until released,
+    // slew limited by accel and decel (%/s, 0 is unlimited). false without the actuator running
+    bool submit(Priority priority, const Point& speeds, int expiry, double accel = 0.0,
+                double decel = 0.0);
+    void release(Priority priority);
+    void set_velocity_loop(const VelocityLoop& loop, int period = 5);
+    void set_slip_limit(double threshold, double accel_scale = 0.5);
+    void set_disturbance(const Disturbance& disturbance);
+    void set_anti_tip(const AntiTip& anti_tip);
+    void set_launch_control(const LaunchControl& launch);
+    void set_active_brake(const ActiveBrake& brake);
+    void set_brake_policy(const BrakePolicy& policy);
+    void set_hold(const Hold& hold);
+    void set_direction(const DirectionChoice& choice);
+    void set_hooks(const Hooks& hooks);
+    void set_mpc(const MpcConfig& config);
+    void set_recorder(Recorder* recorder);
+    void set_performance_log(PerformanceLog* log);
+    void set_geofence(const Geofence* geofence);
+    void set_learning(PathLearning* learning);
+    // replaces the configs from the constructor, such as with ones from load_tuning()
+    void set_config(const MoveConfig& move_config, const TurnConfig& turn_config);
+    void set_field(const FieldTransform& field);
+    const FieldTransform& get_field() const;
 
     void set_brake_mode(pros::motor_brake_mode_e mode);
+    Point get_velocity();
+    Point get_slip();
+    Point get_command();
+    std::atomic<bool> debug_slip{false};
+    Point get_disturbance(); // linear and angular, % of output
+    std::atomic<bool> debug_disturbance{false};
+
+    Characterization characterize(double ramp = 10.0, double step = 60.0, int duration = 3000);
+    Tuning autotune_turn(double amplitude = 40.0, int cycles = 6, const char* file = nullptr);
+    Tuning autotune_move(double amplitude = 30.0, int cycles = 6, const char* file = nullptr);
+    // fit the odom's tracking, apply it and save it to file when given. nan when they fail
+    OdomBase::Tracking calibrate_tpu(double distance, double speed = 25.0,
+                                     const char* file = nullptr);
+    OdomBase::Tracking calibrate_offsets(int turns = 5, double speed = 40.0,
+                                         const char* file = nullptr);
+    // fit the scale of each of imu's imus, which can be on the same ports as the odom's, and save
+    // them to file when given. empty when it fails
+    std::vector<double> calibrate_imu(Imu& imu, int turns = 5, double speed = 40.0,
+                                      const char* file = nullptr);
+};
+
+/* Self test */
+// what self_test() checks against, ms
+struct SelfTestLimits {
+    double odom_period = 6.0;       // mean odom loop period
+    double chassis_period = 12.0;   // mean motion control step
+    double heading_interval = 12.0; // mean time between new headings while turning
+    double tracker_interval = 12.0; // mean time between new tracker ticks while moving
+    double motor_latency = 50.0;    // from a command until the drive motors report moving
+    double motion_latency = 80.0;   // from a command until the odom heading moves
+    uint32_t overruns = 0;          // odom and control periods over 1.5x nominal
+};
+
+// measured values, nan when the robot has nothing to measure them with, such as ticks without
+// trackers. a value is judged by the limit of the same name
+struct SelfTest {
+    double odom_period = NAN, chassis_period = NAN, heading_interval = NAN,
+           tracker_interval = NAN, motor_latency = NAN, motion_latency = NAN; // ms
+    uint32_t overruns = 0;
+    bool passed = false;
+};
+
+// a pre-match check of about 5 s that turns in place, drives forward and back and turns back with
+// a motion, timing the odom and control loops, how often new headings and ticks arrive, and the
+// latency from a motor command to the motors and the odom moving. prints each value with its
+// limit, and needs the odom running and a little room
+SelfTest self_test(Chassis& chassis, OdomBase& odom, const SelfTestLimits& limits = {},
+                   double speed = 30.0);
+
+/* Holonomic */
+// x-drive or mecanum chassis, positive motor speeds roll each wheel forward
+class Holonomic {
+    pros::MotorGroup front_left, front_right, back_left, back_right;
+    OdomBase& odom;
+    Options df_move;
+    double turn_exit, turn_speed; // deg and %, from the turn config
+    ScheduledGains heading_gains; // the turn config's, the move config's steer a differential drive
+    pros::Mutex holonomic_mutex;
+    std::atomic<uint32_t> cancel_token{0};
+
+    void sticks(int32_t x, int32_t y, int32_t turn, bool field_relative);
+
+  public:
+    Holonomic(const std::initializer_list<int8_t>& front_left,
+              const std::initializer_list<int8_t>& front_right,
+              const std::initializer_list<int8_t>& back_left,
+              const std::initializer_list<int8_t>& back_right, OdomBase& odom,
+              const MoveConfig& move_config, const TurnConfig& turn_config,
+              const Options& default_options = {});
+
+    // robot relative %, strafe right and turn clockwise are positive like arcade
+    void drive(double forward, double strafe, double turn);
+    // x and y % along the field axes, turn % clockwise
+    void field(double x, double y, double turn);
+    // left stick translates and right stick x turns, from the driver's view when field relative
+    void drive(pros::Controller& controller, bool field_relative = false);
+    void drive(const Controller& controller, bool field_relative = false);
+
+    // translates and rotates to a pose at once, with speed, exit, settle, timeout and pid options
+    Chassis::MotionResult move(Pose target, Options options = {});
+    void stop();
+    void set_brake_mode(pros::motor_brake_mode_e mode);
+};
+
+/* Link */
+// streams wire frames of the odom, and of the chassis when given, out of a smart port in generic
+// serial mode, for tools/telemetry.cpp to decode on a computer
+class Link {
+    OdomBase& odom;
+    Chassis* chassis;
+    pros::Serial serial;
+    int period; // ms
+    wire::Encoder encoder;
+    std::atomic<uint32_t> drops{0};
+    pros::Task* link_task = nullptr;
+
+    void task();
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MIN};
+
+    Link(uint8_t port, OdomBase& odom, Chassis* chassis = nullptr, int32_t baud = 115200,
+         int period = 10);
+    ~Link();
+
+    void start();
+    uint32_t dropped() const; // frames the serial buffer had no room for
+};
+
+/* Partner */
+// the other robot's pose for two robot autonomous and skills, broadcast both ways over a vexlink
+// radio. each frame carries the sender's time and echoes the last one it received, so the fastest
+// round trip gives the offset between the two clocks and the partner's poses go in a history on
+// this robot's clock. the radio is slow, so a frame is 21 bytes and goes out once a period
+class Partner {
+    struct __attribute__((packed)) Frame {
+        uint8_t seq;
+        uint32_t time;           // ms on the sender's clock
+        uint32_t echo;           // ms, the time of the last frame the sender received, 0 for none
+        uint16_t hold;           // ms from receiving that frame to sending this one
+        int16_t x, y, theta;     // 0.01 in and 1e-4 rad
+        int16_t linear, angular; // 0.01 in/s forward and 1e-3 rad/s counterclockwise
+    };
+    struct State {
+        uint64_t time = 0;                // us on this clock of the newest pose, 0 before one
+        Pose velocity = {0.0, 0.0, 0.0};  // in/s and rad/s along the field axes
+        int32_t offset = 0;               // ms from the partner's clock to this one
+        uint32_t round_trip = UINT32_MAX; // ms, of the frame the offset came from
+    };
+
+    OdomBase& odom;
+    pros::Link link;
+    int period; // ms
+    uint8_t seq = 0;
+    uint32_t echo = 0, echo_received = 0; // the partner's last time, and this clock's when it came
+    History<Pose, 64> partner_history;     // 3 s of poses at 50 ms, on this clock
+    Seqlock<State> state;
+    std::atomic<uint32_t> frames{0}, drops{0};
+    pros::Task* partner_task = nullptr;
+
+    void task();
+    void receive(const Frame& frame, uint32_t now);
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MIN};
+    uint32_t timeout = 500; // ms without a frame before the partner counts as lost
+
+    // one robot's radio is the transmitter and the other's the receiver, both send and receive
+    Partner(uint8_t port, OdomBase& odom, pros::link_type_e_t type,
+            const std::string& id = "appa partner", int period = 50);
+    ~Partner();
+
+    void start();
+    bool connected(); // a frame came in the last timeout ms
+    // the partner's pose at a time on this clock (us), between the poses received or carried on
+    // from the newest at its velocity for up to timeout ms. nan before the first frame
+    Pose get_at(uint64_t time);
+    Pose get();
+    // the partner as an obstacle for Planner::set_moving(), a circle of radius in around where it
+    // is and where it will be in lead ms
+    Obstacle obstacle(double radius = 9.0, double lead = 500.0);
+    uint32_t received() const; // frames
+    uint32_t dropped() const;  // frames the radio had no room for
 };
-} // namespace appa
\ No newline at end of file
+
+/* Coprocessor */
+// offloads heavy planning and localization to a raspberry pi or other computer on a smart port in
+// generic serial mode, with the messages in wire.h. a low priority task sends a snapshot of the
+// odom and distance sensors every period and reads whatever came back, so no control loop waits
+// on the link: corrections go to the odom's correct(), and routes are kept until they are taken
+class Coprocessor {
+  public:
+    enum Kind : uint8_t { PATH = wire::PATH_CHUNK, TRAJECTORY = wire::TRAJECTORY_CHUNK };
+    static constexpr int capacity = 4;       // requests waiting at once
+    static constexpr int max_points = 2000; // of a route, longer ones fail
+
+  private:
+    // a slot is filled by request(), worked on by the task while pending and freed by whoever
+    // takes the route. cancel() leaves a pending slot to the task to free
+    enum : uint8_t { FREE, FILLING, PENDING, CANCELLED, READY, FAILED };
+    struct Request {
+        std::atomic<uint8_t> state{FREE};
+        uint16_t id = 0;
+        Kind kind = PATH;
+        Pose start, goal;            // in, rad
+        bool sent = false;
+        uint32_t sent_time = 0;      // ms
+        int tries = 0;
+        int next = 0;                // index of the next point or sample
+        std::vector<Point> points;
+        std::vector<TrajectorySample> samples;
+    };
+
+    OdomBase& odom;
+    pros::Serial serial;
+    std::vector<pros::Distance> ranges;
+    int period; // ms
+    uint8_t seq = 0;
+    std::atomic<uint16_t> next_id{1};
+    std::array<Request, capacity> requests;
+    wire::Unpacker<wire::max_message> unpacker;
+    std::atomic<uint32_t> accepted{0}, rejects{0}, errors{0}, drops{0};
+    pros::Task* coprocessor_task = nullptr;
+
+    void task();
+    void send(const uint8_t* record, size_t size);
+    void handle(const uint8_t* record, int size);
+    void chunk(const wire::ChunkHeader& header, const float* values, int count);
+    void finish(Request& request, uint8_t state); // ready or failed, unless cancelled meanwhile
+    int slot(uint16_t id) const; // of the request with the id, -1 for none
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MIN + 1};
+    double max_correction = 12.0; // in, corrections further than this are ignored
+    double gain = 1.0;            // of each correction applied, 0 to 1
+    uint32_t timeout = 1000;      // ms for a route before the request is sent again
+    int retries = 2;              // times a request is sent again before it fails
+
+    // up to 4 distance sensors are in the snapshots, in this order
+    Coprocessor(uint8_t port, OdomBase& odom, std::initializer_list<uint8_t> distance_ports = {},
+                int32_t baud = 115200, int period = 20);
+    ~Coprocessor();
+
+    void start();
+    // asks for a route from start (nan for the odom's pose when it is sent) to goal, in and rad,
+    // nan headings for any. the id to take it with, 0 when every slot is waiting
+    uint16_t request(Kind kind, const Pose& goal, const Pose& start = {NAN, NAN, NAN});
+    bool ready(uint16_t id) const;   // the route came in, or failed
+    bool pending(uint16_t id) const; // still waiting
+    // the route once it is ready, freeing its slot. empty when there was no route or it failed.
+    // nullopt while it is still pending or was already taken
+    std::optional<Path> path(uint16_t id, const PathProfile& profile = PathProfile());
+    std::optional<Trajectory> trajectory(uint16_t id);
+    void cancel(uint16_t id);
+
+    uint32_t corrections() const; // applied to the odom
+    uint32_t rejected() const;    // corrections further than max_correction
+    uint32_t failures() const;    // frames that failed their crc or were out of order
+    uint32_t dropped() const;     // messages the serial buffer had no room for
+};
+
+/* DriveRecorder */
+// records a driver run as a trajectory of odom poses and velocities at the control rate, so an
+// autonomous can drive it again with Chassis::track, correcting from the pose instead of replaying
+// voltages that depend on the battery and traction
+class DriveRecorder {
+    OdomBase& odom;
+    Chassis* chassis;
+    int period; // ms
+    size_t capacity;
+    std::vector<TrajectorySample> samples;
+    std::vector<Point> commands; // side % the chassis sent at each sample
+    std::atomic<bool> recording{false};
+    pros::Task* record_task = nullptr;
+    pros::Mutex record_mutex;
+
+    void task();
+
+  public:
+    TaskConfig task_config;
+
+    DriveRecorder(OdomBase& odom, Chassis* chassis = nullptr, uint32_t max_time = 60000,
+                  int period = 10);
+    ~DriveRecorder();
+
+    void start(); // clears the previous recording
+    void stop();
+    bool is_recording() const;
+
+    // from the first to the last movement, so a replay doesn't wait out the driver's reaction
+    Trajectory trajectory();
+    std::vector<Point> get_commands();
+    bool save(const char* name);
+};
+
+/* SensorHub */
+// reads the devices several tasks want once per odom loop into one snapshot, so the chassis and
+// user code share a read of the same instant instead of each calling the devices. the odom's own
+// trackers and imus are already read once per loop by the odom, the snapshot carries what that loop
+// measured. a chassis given to the hub takes its motor velocities, currents and the battery from
+// the snapshot while it is fresh
+class SensorHub {
+  public:
+    static constexpr int capacity = 8; // motor groups added with add()
+
+    struct Motors {
+        double velocity = NAN; // rpm, average of the group's motors
+        double position = NAN; // degrees
+        double current = NAN;  // mA
+    };
+    struct Snapshot {
+        uint32_t version = 0;       // counts reads, 0 before the first
+        uint64_t time = 0;          // us, when it was read
+        Pose pose = {0.0, 0.0, 0.0}; // of the odom loop it follows, in and rad
+        Twist twist;
+        Point ticks = {NAN, NAN};          // raw tracker ticks
+        Point drive_velocity = {NAN, NAN}; // % of free speed per side, without a chassis nan
+        double drive_current = NAN;        // mA, average of the drive motors
+        double battery_voltage = NAN;      // mV
+        double battery_current = NAN;      // mA, median of the last three reads
+        std::array<Motors, capacity> motors{}; // in the order they were added
+    };
+
+  private:
+    OdomBase& odom;
+    Chassis* chassis;
+    std::array<pros::MotorGroup*, capacity> groups{};
+    int count = 0;
+    int every; // odom loops between reads
+    pros::Task* hub_task = nullptr;
+    Seqlock<Snapshot> snapshot;
+    MovingMedian<3> battery_current; // spikes with every motor that starts
+
+    void task();
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MAX - 1};
+
+    explicit SensorHub(OdomBase& odom, Chassis* chassis = nullptr, int every = 1);
+    ~SensorHub();
+
+    // before start(), the group's index in Snapshot::motors, -1 once all 8 are taken
+    int add(pros::MotorGroup& motors);
+    void start();
+    Snapshot get() const;
+    // the snapshot when it was read in the last max_age ms, so a stopped hub isn't trusted
+    std::optional<Snapshot> recent(uint32_t max_age = 4 * OdomBase::period) const;
+};
+
+/* Scheduler */
+// mechanism control loops run one after another in a single high priority task, woken by each odom
+// loop, instead of each delaying in its own task. an update runs every few odom loops, in the order
+// the subsystems were added, so every loop sees the pose of the same odom loop
+class Scheduler {
+  public:
+    using Update = std::function<void(double)>; // ms since the subsystem's previous update
+
+  private:
+    static constexpr int capacity = 16;
+    struct Subsystem {
+        Update update;
+        int every;          // odom loops between updates
+        uint64_t last = 0;  // us, of its previous update
+    };
+    OdomBase& odom;
+    std::array<Subsystem, capacity> subsystems;
+    int count = 0;
+    pros::Task* scheduler_task = nullptr;
+    Seqlock<LoopTiming> timing;
+
+    void task();
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MAX - 2};
+
+    explicit Scheduler(OdomBase& odom);
+    ~Scheduler();
+
+    // before start(), false once all 16 are taken
+    bool add(Update update, int every = 1);
+    void start();
+    LoopTiming get_timing(); // of a whole tick, every update that ran in it
+};
+
+/* PowerManager */
+// shares the brain's motor current between the drive and mechanisms. the firmware cuts every
+// motor's limit once the total is over what the brain supplies, so a drive accelerating into a
+// loaded lift browns out both unpredictably. a low priority task reads each group's draw and sets
+// current limits that add up to the budget instead: every group keeps its floor, the rest goes in
+// priority order to what each draws plus headroom to speed up into, with the drive first while a
+// motion runs, and what is left is spread over the groups by their motors. a hold's own lower
+// limit on the drive wins while it runs
+class PowerManager {
+  public:
+    static constexpr int capacity = 8; // groups, a chassis' drive counts as one
+
+    struct Group {
+        double draw = 0.0;  // mA of the whole group, smoothed
+        double limit = 0.0; // mA per motor
+    };
+    struct Status {
+        double draw = 0.0;    // mA of every group
+        bool driving = false; // a motion was running, so the drive went first
+        std::array<Group, capacity> groups{}; // in the order they were added
+    };
+
+  private:
+    struct Subsystem {
+        std::array<pros::MotorGroup*, 2> motors{}; // a drive's two sides
+        int count = 0;        // motors
+        int priority = 0;
+        double floor = 0.0;   // mA per motor
+        bool drive = false;   // first while the chassis runs a motion
+        double draw = 0.0;    // mA, smoothed
+        int32_t written = -1; // mA per motor
+    };
+    Chassis* chassis = nullptr;
+    std::array<Subsystem, capacity> subsystems;
+    int count = 0;
+    int period; // ms
+    pros::Task* power_task = nullptr;
+    Seqlock<Status> status;
+
+    void task();
+    int add(Subsystem subsystem);
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MIN + 1};
+    double budget = 20000.0;   // mA across every group, about what the brain supplies 8 motors
+    double max_limit = 2500.0; // mA per motor, the 11 W motor's own limit
+    double headroom = 800.0;   // mA per motor over its draw a group is given first
+    double smoothing = 60.0;   // ms time constant of the draw readings
+
+    explicit PowerManager(int period = 20);
+    ~PowerManager();
+
+    // before start(), the group's index in Status::groups, -1 once all 8 are taken. a higher
+    // priority is given its share first, and floor mA per motor is always kept
+    int add(pros::MotorGroup& motors, int priority = 0, double floor = 500.0);
+    // the chassis' drive, ahead of every group while a motion runs and at priority otherwise
+    int add(Chassis& chassis, int priority = 0, double floor = 500.0);
+    void start();
+    Status get() const;
+};
+
+/* Triggers */
+// samples adi switches and sensor thresholds every period ms in one high priority task, and calls
+// a trigger's callback from it on each edge. with Chassis::exit_motion() as the callback a bumper
+// or limit switch ends a move within a ms or two, rather than an exit_fn at the motion's next step
+class Triggers {
+  public:
+    static constexpr int capacity = 8;
+    enum Edge : uint8_t { RISING, FALLING, BOTH }; // a switch pressed, or a sensor going over
+
+    using Callback = std::function<void()>;
+
+  private:
+    struct Trigger {
+        std::optional<pros::adi::DigitalIn> input;
+        double (*sensor)() = nullptr; // or a threshold on this
+        double threshold = 0.0;
+        Edge edge = RISING;
+        Callback callback;
+        bool level = false; // at the last sample
+    };
+    std::array<Trigger, capacity> triggers;
+    int count = 0;
+    int period; // ms
+    pros::Task* triggers_task = nullptr;
+
+    bool add(Trigger trigger);
+    bool read(const Trigger& trigger) const;
+    void task();
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MAX - 1};
+
+    explicit Triggers(int period = 1);
+    ~Triggers();
+
+    // before start(), false once all 8 are taken
+    bool add(uint8_t adi_port, Edge edge, Callback callback);
+    bool add(double (*sensor)(), double threshold, Edge edge, Callback callback);
+    void start();
+};
+
+} // namespace appa
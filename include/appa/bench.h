@@ -0,0 +1,25 @@
+#pragma once
+
+#include "utils.h"
+
+namespace appa {
+
+/* Bench */
+namespace bench {
+struct Result {
+    const char* name;
+    double ns;     // per op, with the loop overhead taken out
+    double cycles; // per op at the given clock rate
+    double deviation = NAN; // largest difference from the double path, for the fixed point ops
+    double tolerance = NAN; // % of output the deviation has to stay within
+};
+
+using Clock = uint64_t (*)(); // us
+
+// times the hot path math, pros::micros on the brain (a 667 MHz Cortex-A9) or a host clock
+std::vector<Result> run(int iterations = 20000, double mhz = 667.0, Clock clock = pros::micros);
+void print(const std::vector<Result>& results);
+void print(const char* name, const LoopTiming& timing);
+} // namespace bench
+
+} // namespace appa
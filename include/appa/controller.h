@@ -0,0 +1,46 @@
+#pragma once
+
+#include "utils.h"
+
+namespace appa {
+
+/* Controller */
+// everything a controller reports at one poll, buttons are a bit each from DIGITAL_L1
+struct ControllerState {
+    uint32_t time = 0; // ms of the poll
+    bool connected = false;
+    int8_t analog[4] = {};                         // by pros::controller_analog_e_t
+    uint16_t held = 0, pressed = 0, released = 0; // edges are since the previous poll
+
+    int32_t get_analog(pros::controller_analog_e_t channel) const;
+    bool get_digital(pros::controller_digital_e_t button) const;
+    bool get_new_press(pros::controller_digital_e_t button) const;
+    bool get_new_release(pros::controller_digital_e_t button) const;
+};
+
+// polls every axis and button once per controller update, so readers only copy a snapshot
+class Controller {
+    pros::Controller controller;
+    int period; // ms
+    Seqlock<ControllerState> state;
+    std::atomic<uint16_t> presses{0}; // latched until taken with get_digital_new_press
+    pros::Task* controller_task = nullptr;
+
+    void poll();
+
+  public:
+    TaskConfig task_config;
+
+    Controller(pros::controller_id_e_t id = pros::E_CONTROLLER_MASTER, int period = 10);
+    ~Controller();
+
+    void start();
+    ControllerState get() const;
+    int32_t get_analog(pros::controller_analog_e_t channel) const;
+    bool get_digital(pros::controller_digital_e_t button) const;
+    // true once per press even when polled slower than the controller, like the pros call
+    bool get_digital_new_press(pros::controller_digital_e_t button);
+    pros::Controller& device(); // for rumble and the screen
+};
+
+} // namespace appa
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "appa.h"
+
+// only built when the project has the liblvgl template, and not included by appa.h so projects
+// without it still link
+#if __has_include("liblvgl/lvgl.h")
+#include "liblvgl/lvgl.h"
+#include <deque>
+
+namespace appa {
+
+/* Dashboard */
+// field view of the odom trace and a chart of the motion error on the brain screen. it is redrawn
+// by a timer in lvgl's own low priority task, which only reads the odom and chassis snapshots
+class Dashboard {
+    static constexpr lv_coord_t field_size = 240;       // px, the height of the screen
+    static constexpr double scale = field_size / 144.0; // px per inch of a 12 ft field
+    static constexpr int trace_capacity = 256;
+    static constexpr int chart_points = 100;
+
+    OdomBase& odom;
+    Chassis* chassis;
+    Point origin; // in, where the odom origin is from the bottom left corner of the field
+    uint32_t period;
+
+    lv_obj_t* screen = nullptr;
+    lv_obj_t *trace, *robot, *chart, *label;
+    lv_chart_series_t *linear_series, *angular_series;
+    std::array<lv_point_t, trace_capacity> trace_points;
+    std::array<lv_point_t, 4> robot_points;
+    int trace_size = 0;
+    char text[96] = "";
+    lv_timer_t* timer = nullptr;
+
+    lv_point_t to_screen(const Point& point) const;
+    void update();
+
+  public:
+    Dashboard(OdomBase& odom, Chassis* chassis = nullptr, Point origin = {72, 72},
+              uint32_t period = 100);
+    ~Dashboard();
+
+    void start(); // builds the screen and loads it
+    void clear(); // forgets the trace
+};
+
+/* Selector */
+// autons registered by name and picked on the brain screen. the picked one is prepared in
+// competition_initialize(), its paths loaded, trajectories generated and options merged, so
+// autonomous() only starts its motions
+class Selector {
+  public:
+    // what an entry prepares: its motions in the order they run, and the paths and trajectories
+    // they follow by reference, kept here so they outlive the handles
+    struct Plan {
+        std::vector<Chassis::Prepared> motions;
+        std::deque<Path> paths;
+        std::deque<Trajectory> trajectories;
+    };
+    using Prepare = std::function<void(Plan& plan)>;
+    using Run = std::function<void(const Plan& plan)>;
+
+  private:
+    struct Entry {
+        std::string name;
+        Prepare prepare;
+        Run run; // empty runs the motions in order
+    };
+
+    Chassis& chassis;
+    std::vector<Entry> entries;
+    std::atomic<int> selected{0};
+    std::atomic<int> prepared{-1}; // entry the plan holds, -1 while it's being built
+    Plan plan;
+
+    lv_obj_t* screen = nullptr;
+    lv_obj_t *list, *label;
+    char text[96] = "";
+    lv_timer_t* timer = nullptr;
+
+    void update();
+
+  public:
+    explicit Selector(Chassis& chassis);
+    ~Selector();
+
+    // in initialize(), before start(). returns the entry's index
+    int add(const std::string& name, Prepare prepare, Run run = {});
+    void start(); // builds the screen and loads it
+
+    void select(int index);
+    int get_selected() const;
+    // builds the selected entry's plan unless it's already built, false when there's no entry. call
+    // it in a loop in competition_initialize() to follow the screen while the robot is disabled
+    bool prepare();
+    // runs the selected entry, preparing it first when competition_initialize() didn't
+    void run();
+};
+
+} // namespace appa
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace appa {
+
+/* Filters */
+// fixed size filters for noisy readings, header only so they inline into the loops that use them.
+// none allocate, and each sample costs the same. update() takes a sample and returns the filtered
+// value, get() reads it again and reset() forgets the samples
+
+// exponential moving average, each sample moves the value alpha of the way to it (0 to 1)
+template <typename T = double> class Ema {
+    T value;
+    T initial;
+
+  public:
+    double alpha;
+
+    explicit Ema(double alpha, T initial = T(0.0))
+        : value(initial), initial(initial), alpha(alpha) {}
+    // the alpha of a time constant (ms) at a sample period (ms)
+    static double alpha_of(double time_constant, double period) {
+        return time_constant > 0 ? 1 - exp(-period / time_constant) : 1.0;
+    }
+
+    T update(const T& sample) {
+        value = value + (sample - value) * alpha;
+        return value;
+    }
+    T get() const { return value; }
+    void reset() { value = initial; }
+};
+
+// median of the last N samples, so single bad readings never get through. N should be odd
+template <size_t N> class MovingMedian {
+    static_assert(N > 0, "a median needs a sample");
+    std::array<double, N> samples{};
+    size_t next = 0, count = 0;
+    double value = NAN;
+
+  public:
+    double update(double sample) {
+        samples[next] = sample;
+        next = (next + 1) % N;
+        count = std::min(count + 1, N);
+        // insertion sort, a handful of samples
+        std::array<double, N> sorted;
+        for (size_t i = 0; i < count; i++) {
+            size_t j = i;
+            for (; j > 0 && sorted[j - 1] > samples[i]; j--) sorted[j] = sorted[j - 1];
+            sorted[j] = samples[i];
+        }
+        value = sorted[(count - 1) / 2];
+        return value;
+    }
+    double get() const { return value; }
+    void reset() { next = count = 0, value = NAN; }
+};
+
+// kalman filter of one value that wanders by process variance each sample, read with measurement
+// variance, so it trusts new samples more the noisier the value is than the sensor
+class Kalman1D {
+    double value = NAN;
+    double variance = 0.0;
+
+  public:
+    double process;     // variance added per sample
+    double measurement; // variance of a sample
+
+    Kalman1D(double process, double measurement) : process(process), measurement(measurement) {}
+
+    double update(double sample) {
+        if (std::isnan(value)) {
+            value = sample, variance = measurement;
+            return value;
+        }
+        variance += process;
+        const double gain = variance / (variance + measurement);
+        value += gain * (sample - value);
+        variance *= 1 - gain;
+        return value;
+    }
+    double get() const { return value; }
+    double get_variance() const { return variance; }
+    void reset() { value = NAN, variance = 0.0; }
+};
+
+// rate of change per second, the slope of a least squares line through the last N samples, which
+// is less noisy than the difference of two while lagging only half the window
+template <size_t N> class Derivative {
+    static_assert(N >= 2, "a slope needs two samples");
+    std::array<double, N> samples{};
+    std::array<uint64_t, N> times{}; // us
+    size_t next = 0, count = 0;
+    double value = 0.0;
+
+  public:
+    double update(double sample, uint64_t time) {
+        samples[next] = sample, times[next] = time;
+        next = (next + 1) % N;
+        count = std::min(count + 1, N);
+        if (count < 2) return value;
+        // about the newest time, so the sums stay small
+        const uint64_t newest = times[(next + N - 1) % N];
+        double t_sum = 0.0, x_sum = 0.0, tt_sum = 0.0, tx_sum = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            const double t = ((int64_t)(times[i] - newest)) / 1e6;
+            t_sum += t, x_sum += samples[i], tt_sum += t * t, tx_sum += t * samples[i];
+        }
+        const double spread = count * tt_sum - t_sum * t_sum;
+        if (spread > 0) value = (count * tx_sum - t_sum * x_sum) / spread;
+        return value;
+    }
+    double get() const { return value; }
+    void reset() { next = count = 0, value = 0.0; }
+};
+
+} // namespace appa
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "appa.h"
+
+// not included by appa.h, like routines, so projects without mechanisms don't compile it in
+namespace appa {
+
+/* Mechanism */
+// a lift, arm, intake or flywheel on a motor group, optionally measured by a rotation sensor,
+// closed by the same pid, feedforward, profile and slew as the chassis. update() runs a control
+// step, usually from a Scheduler through attach(), so mechanisms share its task instead of
+// running their own. positions are in output units, the sensor's degrees times scale
+class Mechanism {
+  public:
+    enum Gravity : uint8_t { NONE, ELEVATOR, ARM };
+    struct Config {
+        double scale = 1.0;      // output units per degree of the motors or rotation sensor
+        Gains position_pid;      // % per unit off, for move_to and holding
+        Gains velocity_pid;      // % per unit/s off, for spin
+        Feedforward ff;          // % for the setpoint's velocity (units/s) and accel (units/s²)
+        Gravity gravity = NONE;  // what kg holds up
+        double kg = 0.0;         // % that holds it against gravity, with an arm level
+        double level = 0.0;      // units an arm is level at, which have to be degrees
+        double speed = 0.0;      // units/s of move_to profiles, 0 steps straight to the target
+        double accel = 0.0;      // units/s², 0 is unlimited
+        double decel = 0.0;      // units/s², 0 is the same as accel
+        double jerk = 0.0;       // units/s³, 0 is trapezoidal
+        double slew = 0.0;       // %/s the output changes at most, 0 is unlimited
+        double exit = 1.0;       // units, or units/s for spin, from the target to settle
+        double exit_speed = 0.0; // units/s a move_to has to be under to settle, 0 ignores it
+        int settle = 50;         // ms within exit
+        double min = -INFINITY;  // units, targets are clamped between min and max, and no
+        double max = INFINITY;   // output drives further past them
+    };
+
+  private:
+    enum Mode : uint8_t { IDLE, OPEN_LOOP, POSITION, VELOCITY };
+
+    pros::MotorGroup motors;
+    std::optional<pros::Rotation> rotation;
+    Config config;
+    pros::Mutex mutex;
+
+    // the command, set by callers and read by update
+    Mode mode = IDLE;
+    double target = 0.0; // %, units or units/s
+    ExitSet exits;
+    uint32_t start_time = 0; // ms
+    bool restart = false;    // a new command, the next step starts its profile and exits
+
+    // control state, only touched by update
+    PID position_pid{Gains()}, velocity_pid{Gains()};
+    Slew slew;
+    std::optional<Profile> profile;
+    double profile_start = 0.0, profile_sign = 1.0;
+    double settle_time = 0.0;
+    std::array<double, ExitSet::capacity> stall_time{};
+    double zero = 0.0;                    // sensor degrees at position 0
+    double prev_sensor = NAN, rate = 0.0; // for the rotation sensor's velocity
+    int32_t written = INT32_MIN;          // mV
+
+    std::atomic<double> position{0.0}, velocity{0.0}, output{0.0};
+    std::atomic<Chassis::Result> result{Chassis::SETTLED};
+
+    double read_sensor();  // degrees
+    double read_current(); // mA, mean of the motors
+    double gravity(double at) const;
+    void command(Mode mode, double target, const ExitSet& exits);
+
+  public:
+    Mechanism(const std::initializer_list<int8_t>& ports, const Config& config,
+              int8_t rotation_port = 0);
+
+    // adds update() to the scheduler's task, every odom loops, before scheduler.start()
+    bool attach(Scheduler& scheduler, int every = 1);
+    void update(double dt); // ms since the previous step
+
+    // profiled to a position and held there, ending on settle or the stall, current, time and
+    // sensor exits
+    void move_to(double position, const ExitSet& exits = {});
+    // a velocity (units/s) for flywheels and rollers, settled while within exit of it
+    void spin(double velocity, const ExitSet& exits = {});
+    void move(double percent); // open loop
+    void stop();
+    void set_config(const Config& config);
+    void tare(double position = 0.0); // the sensor reads position from here on
+
+    // blocks until the command settles or exits, or gives up after timeout ms (0 waits on) with
+    // TIMED_OUT while the mechanism keeps its command
+    Chassis::Result wait(int timeout = 0);
+    Chassis::Result get_result(); // RUNNING until it settles or exits
+    double get_position();        // units
+    double get_velocity();        // units/s
+    double get_output();          // % of the last step
+    pros::MotorGroup& get_motors(); // for a SensorHub or PowerManager
+};
+
+} // namespace appa
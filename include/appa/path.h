@@ -0,0 +1,268 @@
+#pragma once
+
+#include "pathfile.h"
+#include "utils.h"
+#include <memory>
+#include <span>
+
+namespace appa {
+
+/* Path */
+struct PathProfile {
+    double speed = 100.0; // max speed (%)
+    double accel = 0.0;   // speed gained per unit of travel out of a curve (%/in), 0 is unlimited
+    double decel = 0.0;   // speed lost per unit of travel into a curve (%/in), 0 is unlimited
+    double turn = 0.0;    // max speed times curve radius (% in), 0 ignores curvature
+    double cusp = 120.0;  // deg, turning back further at a point reverses after it, 0 never does
+};
+
+// action at an arc length, run or notified on the control tick the follower passes it
+struct Marker {
+    double distance;
+    std::function<void()> callback;
+    pros::task_t task = nullptr;
+};
+
+// options a path takes on from a point until the next override, unset (NAN) ones carry over
+struct PathOverride {
+    int point = 0;
+    float speed = NAN;     // max speed (%)
+    float lookahead = NAN; // in
+    float exit = NAN;      // in, of the final move or of a stop on a cusp
+
+    void apply(const PathOverride& other); // takes the values other sets
+};
+
+// precomputed path data that can be built at compile time and followed in place
+template <size_t N> struct PathTable {
+    std::array<Pose, N> poses{};
+    std::array<real, N> distances{}, curvatures{};
+};
+
+class Trajectory;
+class Spline;
+
+class Path {
+    // views of the owned stores below, or of a PathTable
+    std::span<const Pose> poses;        // points with the heading of the segment into them (rad)
+    std::span<const real> distances;  // cumulative arc length at each point
+    std::span<const real> curvatures; // signed curvature at each point (1/in)
+    std::vector<Pose> pose_store;
+    std::vector<real> distance_store, curvature_store;
+
+    // or none of them, the points of a spline evaluated as they're read into a ring of slots
+    // around the last one read, from Spline::lazy(). const reads write the ring, so a lazy path
+    // is read from one task at a time, and references into it last until the next read
+    struct Lazy;
+    std::shared_ptr<Lazy> lazy;
+    friend class Spline;
+    Path(const Spline& spline, double spacing, double cell_size, const PathProfile& profile);
+    const Pose& pose(size_t i) const;
+    int after(double distance) const; // first point further along than distance, or the size
+
+    std::vector<real> velocities; // target speed at each point (%)
+    std::vector<Marker> markers;    // sorted by distance
+    std::vector<PathOverride> overrides; // sorted by point
+    std::vector<uint8_t> reversing; // whether each segment is driven backwards
+    std::vector<int> cusps;         // points where the direction changes, then the last point
+
+    // coarse grid of segment indices for closest point queries
+    Point grid_origin;
+    double cell_size;
+    int cols = 0, rows = 0;
+    std::vector<int> cell_start, cell_segments;
+
+    void bind();
+    void own();
+    void build_distances();
+    void build_grid();
+    void build_profile(const PathProfile& profile);
+    void build_directions(double cusp);
+    void build_cusps();
+    void insert_marker(Marker marker);
+
+  public:
+    Path(const std::vector<Point>& points, double cell_size = 12.0,
+         const PathProfile& profile = PathProfile());
+    Path(const std::vector<Pose>& poses, const std::vector<double>& curvatures,
+         double cell_size = 12.0, const PathProfile& profile = PathProfile());
+    Path(std::span<const Pose> poses, std::span<const real> distances,
+         std::span<const real> curvatures, double cell_size = 12.0,
+         const PathProfile& profile = PathProfile());
+    template <size_t N>
+    Path(const PathTable<N>& table, double cell_size = 12.0,
+         const PathProfile& profile = PathProfile())
+        : Path(std::span<const Pose>(table.poses), std::span<const real>(table.distances),
+               std::span<const real>(table.curvatures), cell_size, profile) {}
+    Path(const Path& other);
+    Path& operator=(const Path& other);
+    Path(Path&& other) = default;
+    Path& operator=(Path&& other) = default;
+
+    static Path load(const char* name, double cell_size = 12.0,
+                     const PathProfile& profile = PathProfile());
+    bool save(const char* name) const;
+
+    // fewer points within tolerance (in) of this path, keeping headings, curvatures and markers
+    Path simplify(double tolerance, const PathProfile& profile = PathProfile()) const;
+    // the same path given relative to frame (rad), such as a routine drawn for one start tile run
+    // from another. arc lengths, curvatures, speeds and markers carry over unchanged
+    Path transform(const Pose& frame) const;
+    // the same path reflected across the line through a pose along its heading (rad), such as
+    // {72, 0, M_PI_2} to run a routine on the other alliance's side. curvatures change sign
+    Path mirror(const Pose& line) const;
+    Path transform(const FieldTransform& field) const;
+
+    size_t size() const;
+    const Pose& operator[](size_t i) const;
+    double distance(size_t i) const;
+    double length() const;
+    double curvature(size_t i) const;
+    // the sharpest curvature (1/in, unsigned) on the points up to distance past a segment's start
+    double curvature(int segment, double distance) const;
+    double velocity(double distance) const;
+    // the speeds of a trajectory generated from this path, as % of full_speed (in/s), so follow()
+    // drives its timing
+    Path& profile(const Trajectory& trajectory, double full_speed);
+
+    Path& marker(double distance, std::function<void()> callback);
+    Path& marker(double distance, pros::task_t task);
+    const std::vector<Marker>& get_markers() const;
+
+    // caps the speed, sets the lookahead or the exit from a point on, read by the follower as it
+    // passes the point, so one follow() can slow down for part of the route
+    Path& override(size_t point, const PathOverride& values);
+    const std::vector<PathOverride>& get_overrides() const;
+    // the overrides in force from a point, merged
+    PathOverride overrides_at(int point) const;
+
+    // drives segments first to last - 1 backwards, or forwards again, stopping to change direction
+    // at the points where it changes. directions otherwise come from the cusps in the points
+    Path& reverse(size_t first, size_t last, bool reverse = true);
+    bool reversed(size_t segment) const;
+    // the first point after a segment's start where the direction changes, or the last point.
+    // closest point and lookahead queries don't look past it
+    int cusp(int segment) const;
+    const std::vector<int>& get_cusps() const;
+
+    int closest(const Point& point) const;
+    Point nearest(const Point& point, int segment) const;
+    Point at(double distance) const;
+
+    int advance(const Point& point, int segment, double window) const;
+    double progress(const Point& point, int segment) const;
+    Point intersect(const Point& point, double radius, int segment, double progress) const;
+};
+
+// ramer-douglas-peucker, drops points within tolerance (in) of the line through their neighbours
+std::vector<Point> simplify(const std::vector<Point>& points, double tolerance);
+
+/* Trajectory */
+struct TrajectorySample {
+    double time;            // s from the start
+    Pose pose;              // rad
+    double velocity, omega; // in/s and rad/s
+};
+
+// drivetrain limits for Trajectory::generate
+struct TrajectoryLimits {
+    double velocity = 0.0;    // in/s of either wheel, 0 is the kinematics' top speed
+    double accel = 60.0;      // in/s² of either wheel, 0 is unlimited
+    double decel = 0.0;       // in/s² of either wheel, 0 is the same as accel
+    double centripetal = 0.0; // in/s² toward the center of a curve, 0 is unlimited
+    double start_velocity = 0.0, end_velocity = 0.0; // in/s
+};
+
+class Trajectory {
+    std::vector<TrajectorySample> samples;
+
+  public:
+    Trajectory(const std::vector<TrajectorySample>& samples);
+
+    // the fastest timing of a path within the limits, with a sample at every point of the path
+    static Trajectory generate(const Path& path, const Kinematics& kinematics,
+                               const TrajectoryLimits& limits = TrajectoryLimits());
+    static Trajectory load(const char* name);
+    bool save(const char* name) const;
+
+    size_t size() const;
+    const TrajectorySample& operator[](size_t i) const;
+    double duration() const;
+    TrajectorySample at(double time) const;
+    // the same trajectory mapped by field, turning the other way when it mirrors
+    Trajectory transform(const FieldTransform& field) const;
+};
+
+// trajectories generated before, so an adaptive auton asking for the same route again doesn't wait
+// for it. entries are keyed by a hash of the waypoints, kinematics and limits, and the least
+// recently used is replaced once every entry is taken. a returned trajectory stays valid until
+// capacity other routes have been generated since it was last asked for. one caller at a time
+class TrajectoryCache {
+    struct Entry {
+        uint64_t key = 0;
+        uint32_t used = 0; // last lookup, 0 for an empty entry
+        Trajectory trajectory{{}};
+    };
+    std::vector<Entry> entries; // fixed at construction
+    uint32_t clock = 0;
+    uint32_t hit_count = 0, miss_count = 0;
+
+    const Trajectory& get(uint64_t key, const std::function<Trajectory()>& generate);
+
+  public:
+    explicit TrajectoryCache(size_t capacity = 8);
+
+    // generated from the path build() returns the first time the waypoints and limits are asked
+    // for, such as the start and goal of a planned route or the points of a spline
+    const Trajectory& get(const std::vector<Point>& waypoints, const Kinematics& kinematics,
+                          const TrajectoryLimits& limits, const std::function<Path()>& build);
+    // keyed by the path's own points and curvatures
+    const Trajectory& get(const Path& path, const Kinematics& kinematics,
+                          const TrajectoryLimits& limits = TrajectoryLimits());
+    void clear();
+
+    uint32_t hits() const;
+    uint32_t misses() const;
+};
+
+/* Learning */
+struct LearningConfig {
+    double spacing = 2.0; // in of path per bin
+    double steer = 1.0;   // % of angular output learned per in of cross track error
+    double speed = 0.5;   // % of linear output learned per in/s short of the profile
+    double lead = 4.0;    // in, a correction acts this far before the error it answers
+    double forget = 0.05; // share of the correction dropped each run, so old mistakes fade
+    double limit = 20.0;  // %, the most either correction adds
+};
+
+// iterative learning control over repeated runs of one route. a follow with it set records the
+// cross track error and the speed short of the path's profile by arc length, and a run that
+// settles folds them into a correction by bin, smoothed over the neighbouring bins, and saves it.
+// the next run adds that correction to the follower's output where the robot is on the path
+class PathLearning {
+    const char* file;
+    LearningConfig config;
+    std::vector<LearningRecord> corrections;
+    std::vector<float> cross_track, short_of; // sums of this run, by bin
+    std::vector<uint16_t> samples;
+    int learned_runs = 0;
+
+    int bin(double distance) const;
+
+  public:
+    explicit PathLearning(const char* file, const LearningConfig& config = LearningConfig());
+
+    bool load();       // the corrections saved by an earlier program
+    bool save() const; // after each run that settles
+    void clear();      // forgets what was learned, in memory
+    int runs() const;  // folded in since load or clear
+
+    // called by the follower. begin drops what a run recorded before, record adds a control step
+    // and finish folds the run in when it settled, otherwise it's dropped
+    void begin(double length);
+    void record(double distance, double cross_track, double short_of);
+    LearningRecord correction(double distance) const; // % to add
+    void finish(bool settled);
+};
+
+} // namespace appa
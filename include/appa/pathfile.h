@@ -0,0 +1,213 @@
+#pragma once
+
+// only depends on the standard library so host tools can write the same files
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace appa {
+
+/* Path files */
+// a header followed by count fixed width records, little endian like the brain and most hosts.
+// the magic is "APTH" for paths, "ATRJ" trajectories, "AGNS" gains, "AREC" recordings, "ATRK"
+// odom tracking, "AIMU" imu scales, "AWRM" warm starts, "ALRN" learned corrections and "ASCR"
+// autonomous scripts
+struct FileHeader {
+    char magic[4];
+    uint16_t version;     // file::version
+    uint16_t record_size; // bytes per record
+    uint32_t count;       // records after the header
+    uint32_t crc;         // crc32 of the records
+};
+
+struct PathRecord {
+    float x, y, theta; // in, rad
+    float distance;    // cumulative arc length (in)
+    float curvature;   // signed (1/in)
+};
+
+struct TrajectoryRecord {
+    float time;            // s from the start
+    float x, y, theta;     // in, rad
+    float velocity, omega; // in/s, rad/s
+};
+
+// one control step of a recorded motion
+struct MotionRecord {
+    uint32_t id;                             // command the sample is from
+    uint32_t time;                           // ms from the start of the motion
+    uint8_t motion;                          // Chassis::Motion
+    uint8_t result;                          // Chassis::Result, RUNNING until the last sample
+    uint8_t settling;                        // within the exit error
+    uint8_t reserved;
+    float target_x, target_y, target_theta;  // in, rad
+    float x, y, theta;                       // in, rad
+    float error_linear, error_angular;       // in, rad
+    float lin_p, lin_i, lin_d;               // pid terms (%)
+    float ang_p, ang_i, ang_d;               // pid terms (%)
+    float command_left, command_right;       // %
+    float velocity_linear, velocity_angular; // measured, in/s and rad/s
+};
+
+// one odom loop's raw readings, or an event between loops, see OdomRecorder. a recording starts
+// with its tracking and is a stream of these without a file header
+struct OdomRecord {
+    enum Kind : uint8_t { SAMPLE, TRACKING, SET, TRUTH };
+
+    uint32_t time; // us from the start of the recording
+    uint8_t kind;
+    uint8_t imus; // readings in rotation and rate
+    uint16_t reserved;
+    // sample: x and y tracker ticks and the heading (rad) the odom read. tracking: tpu, linear
+    // offset (in) and angular offset (deg). set: the tracker frame pose (in, rad) after a set.
+    // truth: the known pose at the end (in, rad)
+    double values[4];
+    float rotation[4], rate[4]; // of each imu as read (deg, deg/s), nan when not
+};
+
+// the odom's pose for a restarted program, see OdomBase::set_warm_start()
+struct WarmRecord {
+    double x, y, theta; // in, rad, what get() returned
+    double sensor;      // rad, the heading the sensors read then, before any set
+};
+
+// a pid's gains, see save_gains(). its fields one by one, so no padding reaches the file
+struct GainsRecord {
+    float p, i, d;
+    float i_zone, i_max, filter;
+    uint8_t sign_reset, on_measurement;
+    uint16_t reserved;
+};
+
+// a motion once it ended, see PerformanceLog. a log is a stream of these without a file header
+struct PerformanceRecord {
+    uint8_t motion; // Chassis::Motion
+    uint8_t result; // Chassis::Result
+    uint16_t reserved;
+    float extent; // in it had to drive, or deg to turn
+    float time;   // ms it took
+    float error;  // final, in or deg
+};
+
+// the correction PathLearning adds at one bin along a route
+struct LearningRecord {
+    float linear, angular; // %
+};
+
+// one instruction of an autonomous script, see appa::Script and tools/compile_script.cpp. a
+// motion's options are the OPTION records just before it, and a follow's points the POINT records
+// just after it
+struct ScriptRecord {
+    enum Op : uint8_t {
+        MOVE,      // relative straight, values[0] in
+        MOVE_TO,   // a point, values[0] and [1] in
+        MOVE_POSE, // a pose, values in, in and deg
+        TURN,      // to a heading, values[0] deg
+        TURN_TO,   // to face a point, values[0] and [1] in
+        ARC,       // values[0] in radius and [1] deg turned
+        FOLLOW,    // count points after it
+        POINT,     // values[0] and [1] in
+        WAIT,      // for the last motion to end
+        DELAY,     // values[0] ms
+        ACTION,    // the registered action called name
+        OPTION     // key is a ScriptRecord::Key, values[0] its value
+    };
+    enum Key : uint8_t {
+        SPEED, ACCEL, DECEL, LEAD, LOOKAHEAD, EXIT, EXIT_SPEED, SETTLE, TIMEOUT, DIR, ASYNC, THRU
+    };
+
+    uint8_t op;
+    uint8_t key;
+    uint16_t count;
+    union {
+        float values[3];
+        char name[12]; // nul padded, not terminated at 12 characters
+    };
+};
+
+namespace file {
+constexpr uint16_t version = 1;
+constexpr char path_magic[4] = {'A', 'P', 'T', 'H'};
+constexpr char trajectory_magic[4] = {'A', 'T', 'R', 'J'};
+constexpr char gains_magic[4] = {'A', 'G', 'N', 'S'};
+constexpr char recording_magic[4] = {'A', 'R', 'E', 'C'};
+constexpr char tracking_magic[4] = {'A', 'T', 'R', 'K'};
+constexpr char imu_magic[4] = {'A', 'I', 'M', 'U'};
+constexpr char warm_magic[4] = {'A', 'W', 'R', 'M'};
+constexpr char learning_magic[4] = {'A', 'L', 'R', 'N'};
+constexpr char script_magic[4] = {'A', 'S', 'C', 'R'};
+
+inline uint32_t crc32(const void* data, size_t size) {
+    static constexpr auto table = [] {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }();
+    uint32_t crc = 0xFFFFFFFF;
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFF;
+}
+
+template <class Record>
+bool write(const char* name, const char (&magic)[4], const Record* records, uint32_t count) {
+    FileHeader header{{magic[0], magic[1], magic[2], magic[3]}, version, sizeof(Record), count,
+                      crc32(records, count * sizeof(Record))};
+    FILE* file = fopen(name, "wb");
+    if (!file) {
+        printf("Could not open %s for writing\n", name);
+        return false;
+    }
+    const bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                    fwrite(records, sizeof(Record), count, file) == count;
+    fclose(file);
+    if (!ok) printf("Could not write %s\n", name);
+    return ok;
+}
+
+// reads every record with a single fread into buffer, which is only grown when too small
+template <class Record>
+bool read(const char* name, const char (&magic)[4], std::vector<Record>& buffer) {
+    FILE* file = fopen(name, "rb");
+    if (!file) {
+        printf("Could not open %s\n", name);
+        return false;
+    }
+    FileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1;
+    if (ok && (memcmp(header.magic, magic, 4) || header.version != version ||
+               header.record_size != sizeof(Record))) {
+        printf("%s is not a version %d %.4s file\n", name, version, magic);
+        ok = false;
+    }
+    // the count is checked against what the file holds before anything is allocated for it
+    if (ok) {
+        const long start = ftell(file);
+        ok = start >= 0 && fseek(file, 0, SEEK_END) == 0;
+        const long end = ok ? ftell(file) : -1;
+        ok = ok && end >= start && fseek(file, start, SEEK_SET) == 0 &&
+             (uint64_t)header.count * sizeof(Record) <= (uint64_t)(end - start);
+        if (!ok) printf("%s is truncated\n", name);
+    }
+    if (ok) {
+        buffer.resize(header.count);
+        ok = fread(buffer.data(), sizeof(Record), header.count, file) == header.count;
+        if (!ok) printf("%s is truncated\n", name);
+    }
+    fclose(file);
+    if (ok && crc32(buffer.data(), header.count * sizeof(Record)) != header.crc) {
+        printf("%s failed its crc check\n", name);
+        ok = false;
+    }
+    if (!ok) buffer.clear();
+    return ok;
+}
+} // namespace file
+
+} // namespace appa
@@ -0,0 +1,164 @@
+#pragma once
+
+#include "path.h"
+
+namespace appa {
+
+/* Planner */
+// a convex field element, its corners in order either way (in, field coordinates)
+struct Obstacle {
+    std::vector<Point> corners;
+
+    static Obstacle rectangle(const Point& corner, const Point& opposite);
+    static Obstacle around(const Point& center, double radius); // an octagon outside the circle
+};
+
+// shortest routes around the field elements for adaptive autons. the visibility graph between
+// the corners of the obstacles, grown by the robot's radius, is built once by the constructor, so
+// a query only links its start and goal to the corners and searches them with a*. the queries
+// share scratch space, one at a time. obstacles that move, such as the partner robot, are set
+// between queries and only check the edges against themselves
+class Planner {
+    std::vector<std::vector<Point>> polygons; // grown by the radius, counterclockwise
+    std::vector<Point> nodes;                 // corners inside the field
+    std::vector<int> edge_start, edges;       // neighbours of node i from edge_start[i]
+    double low, high;                         // in, of the field the robot's center can reach
+    double spacing;                           // in, between the points of a planned path
+    double radius;                            // in, of the robot
+
+    // moving obstacles, their corners after the nodes, and what each of those corners sees
+    std::vector<std::vector<Point>> moving;
+    std::vector<Point> moving_nodes;
+    std::vector<uint8_t> edge_open;   // edges no moving obstacle blocks
+    std::vector<uint8_t> moving_sees; // moving corner j sees node i at j * (nodes + corners) + i
+
+    // a* over the nodes, then the start and goal at the end
+    std::vector<double> cost;
+    std::vector<int> parent;
+    std::vector<uint8_t> state; // unseen, open or closed
+    std::vector<uint8_t> from_start, to_goal;
+
+    // the obstacles whose grown bounds reach each cell of a grid over the field, for check()
+    double cell; // in
+    int cells;   // along each side
+    std::vector<int> cell_start, cell_obstacles;
+
+    bool visible(const Point& a, const Point& b, int ignore = -1) const;
+    bool clear(const Point& a, const Point& b, int ignore = -1) const; // of moving obstacles
+    int inside(const Point& point) const; // obstacle the point is in, -1 for none
+    int inside_moving(const Point& point) const;
+
+  public:
+    explicit Planner(const std::vector<Obstacle>& obstacles, double radius = 9.0,
+                     double field = 144.0, double spacing = 2.0);
+
+    // the corners of the shortest route, including the start and goal, or empty when the goal is
+    // in an obstacle or can't be reached. a start inside an obstacle may drive out of it
+    std::vector<Point> route(const Point& start, const Point& goal);
+    // the route as a path to follow(), with points every spacing
+    Path plan(const Point& start, const Point& goal, const PathProfile& profile = PathProfile());
+
+    // replaces the moving obstacles the next queries route around, grown by the radius like the
+    // others. costs a visibility check of each edge against them
+    void set_moving(const std::vector<Obstacle>& obstacles);
+
+    // where the robot's circle first runs into an obstacle along a path or trajectory, such as one
+    // drawn or generated before the match, checked against the grown obstacles near each segment
+    // and the moving ones, such as Partner::obstacle(). in field coordinates, a relative path has
+    // to be transformed onto its start first
+    struct Collision {
+        enum Kind : uint8_t { NONE, OBSTACLE, MOVING, WALL };
+        Kind kind = NONE;
+        int obstacle = -1;        // index of the fixed or moving one, skipping any under 3 corners
+        double distance = NAN;    // in along the path
+        double time = NAN;        // s into a trajectory
+        Point point = {NAN, NAN}; // in, where the robot's center is when it touches
+        explicit operator bool() const { return kind != NONE; }
+    };
+    Collision check(const Path& path) const;
+    Collision check(const Trajectory& trajectory) const;
+
+    size_t size() const; // corners in the graph
+
+  private:
+    Collision sweep(const Point& a, const Point& b) const; // the first hit along the segment
+};
+
+/* Geofence */
+// speed caps over areas of the field, such as along the walls or around the goals, so the rest of
+// a route can run faster. the areas are rasterized into a grid once, so a lookup is one read
+class Geofence {
+    std::vector<uint8_t> grid; // % cap of each cell, row by row from the origin
+    int cells;                 // along each side
+    double cell, field;        // in
+
+  public:
+    // an area as a polygon in field coordinates, corners in order either way
+    struct Zone {
+        std::vector<Point> corners;
+        double speed; // % at most inside it
+    };
+
+    double lead = 200.0; // ms, where the robot is heading this far ahead is checked too
+
+    // overlapping zones take the lower cap
+    explicit Geofence(const std::vector<Zone>& zones, double field = 144.0, double cell = 2.0);
+    // caps the band within margin in of the walls
+    Geofence& walls(double margin, double speed);
+
+    double speed(const Point& position) const; // % cap at a point, 100 outside every zone
+};
+
+/* FieldObjects */
+// game elements and goals where vision or the auton last put them, for adaptive autons that ask
+// for the nearest one. a fixed number of slots indexed by a uniform grid over the field, so an
+// update allocates nothing and a nearest query checks rings of cells out from the point only
+// until no closer object can be in the next ring. safe to update from a vision task while the
+// auton queries
+class FieldObjects {
+  public:
+    static constexpr int capacity = 64;
+    static constexpr int any = -1; // kind that matches every object
+
+    struct Object {
+        int id = -1;
+        Point position = {NAN, NAN}; // in, field coordinates
+        int kind = 0;                // your own categories, such as rings and goals
+        uint32_t time = 0;           // ms, when it was added or last moved
+    };
+
+  private:
+    std::array<Object, capacity> objects;
+    std::array<int16_t, capacity> next;  // object after each in its cell, -1 ends the cell
+    std::array<int16_t, capacity> cells; // cell each object is listed in, -1 for a free slot
+    std::vector<int16_t> heads;          // first object of each cell, row by row from the origin
+    int count = 0;
+    int side;    // cells along each side of the field
+    double cell; // in
+    mutable pros::Mutex mutex;
+
+    int cell_of(const Point& position) const;
+    void link(int id);
+    void unlink(int id);
+
+  public:
+    explicit FieldObjects(double field = 144.0, double cell = 12.0);
+
+    int add(const Point& position, int kind = 0); // its id, -1 when every slot is taken
+    bool move(int id, const Point& position);     // to where it was seen again
+    bool remove(int id);                          // such as once it's scored
+    void clear();
+    int expire(uint32_t max_age); // removes what wasn't seen for max_age ms, how many were
+    std::optional<Object> get(int id) const;
+    size_t size() const;
+
+    // the closest object of a kind within max_distance in that filter accepts, such as one the
+    // planner finds a route to or one on the robot's side. nothing when there is none
+    std::optional<Object> nearest(const Point& from, int kind = any,
+                                  double max_distance = INFINITY,
+                                  const std::function<bool(const Object&)>& filter = nullptr) const;
+    // the objects of a kind as obstacles of radius in for Planner::set_moving()
+    std::vector<Obstacle> obstacles(int kind, double radius) const;
+};
+
+} // namespace appa
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "api.h"
+#include <atomic>
+#include <vector>
+
+// scoped timing of code inside a loop, compiled out unless APPA_PROFILE is defined
+// (EXTRA_CXXFLAGS=-DAPPA_PROFILE in the Makefile). each scope keeps its stats in static storage,
+// so a timed scope costs two pros::micros() calls and a few atomics, without allocating or printing
+// while a trace is recording, every scope is also a span on its task's row of the timeline, and
+// APPA_TRACE_SPAN(name, start) marks a span from start (us) to now, for loop iterations whose
+// delay at the end shouldn't count
+#ifdef APPA_PROFILE
+#define APPA_TRACE_SPAN(name, start) appa::trace::span(name, start, pros::micros())
+#define APPA_PROFILE_CONCAT_(a, b) a##b
+#define APPA_PROFILE_CONCAT(a, b) APPA_PROFILE_CONCAT_(a, b)
+#define APPA_PROFILE_SCOPE(name)                                                                 \
+    static appa::profile::Site APPA_PROFILE_CONCAT(appa_profile_site_, __LINE__){name};          \
+    const appa::profile::Timer APPA_PROFILE_CONCAT(appa_profile_timer_, __LINE__) {              \
+        APPA_PROFILE_CONCAT(appa_profile_site_, __LINE__)                                        \
+    }
+#else
+#define APPA_PROFILE_SCOPE(name) ((void)0)
+#define APPA_TRACE_SPAN(name, start) ((void)0)
+#endif
+
+namespace appa {
+
+/* Trace */
+// a timeline of begin and end times in a fixed ring, for seeing how tasks preempt each other and
+// which loops overrun. recording one is an atomic increment and a few stores, save() writes
+// chrome trace-event json that chrome://tracing and ui.perfetto.dev open, a row per task
+namespace trace {
+constexpr int max_tasks = 32;
+
+struct Event {
+    const char* name;  // static storage, like scope names
+    uint64_t start;    // us
+    uint32_t duration; // us
+    uint8_t task;      // in the order tasks first recorded
+};
+
+extern std::atomic<bool> recording;
+void record(const char* name, uint64_t start, uint32_t duration);
+inline void span(const char* name, uint64_t start, uint64_t end) {
+    if (recording.load(std::memory_order_relaxed)) record(name, start, end - start);
+}
+
+// keeps the last capacity events from now on, the ring is allocated by the first start
+void start(size_t capacity = 8192);
+void stop();
+// stops recording and writes what was kept, false when the file can't be written
+bool save(const char* file = "/usd/trace.json");
+} // namespace trace
+
+/* Profile */
+namespace profile {
+constexpr int max_sites = 32;
+
+// one per APPA_PROFILE_SCOPE, registered the first time it runs
+struct Site {
+    const char* name;
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> max{0};   // us
+    std::atomic<uint64_t> total{0}; // us
+
+    Site(const char* name);
+
+    void record(uint32_t us) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(us, std::memory_order_relaxed);
+        uint32_t prev = max.load(std::memory_order_relaxed);
+        while (us > prev && !max.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+    }
+};
+
+class Timer {
+    Site& site;
+    const uint64_t start;
+
+  public:
+    explicit Timer(Site& site) : site(site), start(pros::micros()) {}
+    ~Timer() {
+        const uint64_t end = pros::micros();
+        site.record(end - start);
+        trace::span(site.name, start, end);
+    }
+};
+
+struct Stats {
+    const char* name;
+    uint32_t count;
+    uint32_t max;   // us
+    uint64_t total; // us
+
+    double mean() const; // us
+};
+
+// snapshot of every scope that has run, empty when profiling is compiled out
+std::vector<Stats> get();
+void print();
+void reset();
+} // namespace profile
+
+} // namespace appa
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "appa.h"
+#include <coroutine>
+
+// not included by appa.h, so projects that don't use routines don't need coroutine support
+namespace appa {
+
+/* Routine */
+class Runner;
+
+// something a routine is suspended on, checked by the runner every tick. waiters live in the frame
+// of the suspended routine, so waiting allocates nothing
+struct Waiter {
+    std::coroutine_handle<> handle;
+    Waiter* next = nullptr;
+    virtual bool ready() = 0;
+};
+
+// an autonomous step written as a coroutine, which starts when it is run or awaited. motions issued
+// from a routine run on the chassis task, and co_await on one waits until it ends:
+//   appa::Routine score() {
+//       co_await bot.move({24, 0});
+//       co_await appa::when_all(bot.turn(90), intake_for(500));
+//   }
+class Routine {
+  public:
+    struct promise_type {
+        Runner* runner = nullptr;
+        std::coroutine_handle<> continuation; // routine awaiting this one
+        int* pending = nullptr;               // routines left in the when_all this is part of
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept;
+            void await_resume() noexcept {}
+        };
+
+        Routine get_return_object();
+#ifdef APPA_NO_HEAP
+        // frames come from a fixed pool instead of the heap, a routine that doesn't fit in a frame
+        // or finds them all in use prints a message and doesn't run
+        static constexpr size_t frame_size = 8192; // bytes, options and results make frames big
+        static constexpr int frame_count = 16;     // routines alive at once, awaited ones included
+        static void* operator new(size_t size) noexcept;
+        static void operator delete(void* frame);
+        static Routine get_return_object_on_allocation_failure();
+#endif
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Routine(Handle handle);
+    Routine(Routine&& other);
+    Routine& operator=(Routine&& other);
+    ~Routine();
+
+    bool done() const;
+
+    // runs this routine inside the awaiting one, resuming it when this one ends
+    struct Awaiter {
+        Handle handle;
+        bool await_ready() { return !handle || handle.done(); }
+        std::coroutine_handle<> await_suspend(Handle parent);
+        void await_resume() {}
+    };
+    Awaiter operator co_await() const;
+
+  private:
+    friend class Runner;
+    template <size_t N> friend struct WhenAll;
+    Handle handle;
+};
+
+// resumes routines from the calling task, such as autonomous(), every period ms. one runner runs
+// one routine at a time, and its motions replace each other as they do anywhere else, so a routine
+// that starts a motion while another of its branches is driving cancels that one
+class Runner {
+    Chassis& chassis;
+    int period; // ms
+    Waiter *head = nullptr, *tail = nullptr;
+
+  public:
+    explicit Runner(Chassis& chassis, int period = 10);
+
+    void wait(Waiter* waiter); // resumes the waiter's routine on the first tick it is ready
+    Chassis& get_chassis();
+
+    // runs the routine to its end, with every motion it issues async
+    void run(Routine routine);
+};
+
+/* Awaitables */
+// base of the awaiters that suspend until ready() on a tick
+template <typename Derived> struct Wait : Waiter {
+    bool await_ready() { return static_cast<Derived*>(this)->ready(); }
+    void await_suspend(Routine::Handle h) {
+        handle = h;
+        h.promise().runner->wait(this);
+    }
+};
+
+// waits for ms from now
+struct Delay : Wait<Delay> {
+    uint32_t until;
+    explicit Delay(uint32_t ms) : until(pros::millis() + ms) {}
+    bool ready() override { return (int32_t)(pros::millis() - until) >= 0; }
+    void await_resume() {}
+};
+inline Delay delay(uint32_t ms) { return Delay(ms); }
+
+// waits until condition() is true, checked once per tick
+template <typename F> struct Until : Wait<Until<F>> {
+    F condition;
+    explicit Until(F condition) : condition(std::move(condition)) {}
+    bool ready() override { return condition(); }
+    void await_resume() {}
+};
+template <typename F> Until<F> until(F condition) { return Until<F>(std::move(condition)); }
+
+// waits for a motion issued from a routine to end, with the result it ended with
+struct MotionAwaiter : Waiter {
+    Chassis::MotionResult result;
+    Chassis* chassis = nullptr;
+
+    explicit MotionAwaiter(const Chassis::MotionResult& result) : result(result) {}
+    bool await_ready() { return result.reason != Chassis::RUNNING || result.id == 0; }
+    void await_suspend(Routine::Handle h);
+    bool ready() override;
+    Chassis::MotionResult await_resume();
+};
+inline MotionAwaiter operator co_await(const Chassis::MotionResult& result) {
+    return MotionAwaiter(result);
+}
+
+// runs the routines side by side, ending when the last of them does
+template <size_t N> struct WhenAll {
+    std::array<Routine, N> routines;
+    int pending = N + 1; // one more until every routine has started
+
+    bool await_ready() { return false; }
+    bool await_suspend(Routine::Handle parent) {
+        for (Routine& routine : routines) {
+            if (!routine.handle) { // its frame couldn't be allocated
+                pending--;
+                continue;
+            }
+            auto& promise = routine.handle.promise();
+            promise.runner = parent.promise().runner;
+            promise.continuation = parent;
+            promise.pending = &pending;
+            routine.handle.resume();
+        }
+        return --pending > 0; // carry on without suspending if they all ended already
+    }
+    void await_resume() {}
+};
+
+Routine step(Routine routine);
+Routine step(Chassis::MotionResult motion);
+
+// when_all(bot.move(...), intake_for(500)) takes routines and motions
+template <typename... Steps> WhenAll<sizeof...(Steps)> when_all(Steps&&... steps) {
+    return {{step(std::forward<Steps>(steps))...}};
+}
+
+} // namespace appa
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "appa.h"
+
+// not included by appa.h, like routines, so projects that compile their autons in don't carry it
+namespace appa {
+
+/* Script */
+// an autonomous read from the sd card, so reordering motions or moving a target at an event is a
+// file copy instead of a build and upload. tools/compile_script.cpp compiles the text on a host.
+// load() decodes every instruction into prepared motions, with paths built and actions looked up,
+// so run() does no more than a compiled routine of the same motions
+class Script {
+  public:
+    using Action = std::function<void()>;
+
+  private:
+    struct Step {
+        enum Kind : uint8_t { MOTION, WAIT, DELAY, ACTION } kind;
+        uint32_t index; // of the motion or action, or ms of a delay
+    };
+    struct Named {
+        std::string name;
+        Action action;
+    };
+
+    Chassis& chassis;
+    std::vector<Named> actions; // registered, before load()
+    std::vector<Step> steps;
+    std::vector<Chassis::Prepared> motions;
+
+  public:
+    explicit Script(Chassis& chassis);
+
+    // what the script's "action name" lines call, on the task running the script
+    Script& action(const char* name, Action action);
+    // replaces the loaded script, false and empty when the file is unreadable or calls an action
+    // that wasn't registered
+    bool load(const char* file);
+    // the steps in order from the calling task, with the last motion's result
+    Chassis::MotionResult run();
+    size_t size() const; // steps loaded
+};
+
+} // namespace appa
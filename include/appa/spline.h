@@ -0,0 +1,141 @@
+#pragma once
+
+#include "path.h"
+#include <array>
+#include <utility>
+
+namespace appa {
+
+/* Spline */
+struct Waypoint {
+    Point point;
+    double heading = NAN; // deg, NAN to follow the neighbouring waypoints
+};
+
+// cubic hermite spline through waypoints, sampled uniformly by arc length
+class Spline {
+    std::vector<Point> points, tangents;
+    std::vector<double> lengths; // arc length table, samples_per_segment + 1 per segment
+    static constexpr int samples_per_segment = 64;
+
+    void build_tangents(const std::vector<Waypoint>& waypoints);
+    void build_lengths();
+    void positions(int segment, Point* out) const;
+    Point position(int segment, double t) const;
+    Point derivative(int segment, double t) const;
+    Point second_derivative(int segment, double t) const;
+
+  public:
+    Spline(const std::vector<Waypoint>& waypoints);
+
+    double length() const;
+    // the pose (rad) at an arc length, and the signed curvature there (1/in)
+    Pose pose(double distance, real& curvature) const;
+    Path sample(double spacing = 1.0, double cell_size = 12.0,
+                const PathProfile& profile = PathProfile()) const;
+    // the same path evaluated as the follower reads it instead of stored, see Path. its reads
+    // rewrite a ring of points without a lock, so only one task may read it at a time, and an
+    // async follow reads the path it was given. copies have their own ring. a miss re-evaluates
+    // 64 points, so closest() costs about 3x a sampled path's walking forward like the follower
+    // and about 8x jumping around
+    Path lazy(double spacing = 1.0, double cell_size = 12.0,
+              const PathProfile& profile = PathProfile()) const;
+};
+
+/* Constexpr spline */
+// the same spline evaluated at compile time into N samples, so the table can live in flash
+// static constexpr auto table = appa::spline_table<100>(std::array<appa::Waypoint, 3>{...});
+template <size_t N, size_t W>
+constexpr PathTable<N> spline_table(const std::array<Waypoint, W>& waypoints) {
+    static_assert(N >= 2 && W >= 2, "a spline table needs two samples and two waypoints");
+    constexpr int samples = 32; // arc length samples per segment
+    constexpr int stride = samples + 1;
+    const int n = W;
+
+    // given headings keep the chord length as magnitude, otherwise catmull-rom
+    std::array<double, W> px{}, py{}, tx{}, ty{};
+    for (int i = 0; i < n; i++) {
+        px[i] = waypoints[i].point.x;
+        py[i] = waypoints[i].point.y;
+    }
+    for (int i = 0; i < n; i++) {
+        const int prev = i > 0 ? i - 1 : 0, next = i < n - 1 ? i + 1 : n - 1;
+        const double scale = (i == 0 || i == n - 1) ? 1.0 : 0.5;
+        const double dx = px[next] - px[prev], dy = py[next] - py[prev];
+        const double heading = waypoints[i].heading;
+        if (heading != heading) {
+            tx[i] = dx * scale;
+            ty[i] = dy * scale;
+        } else {
+            const double magnitude = std::sqrt(dx * dx + dy * dy) * scale;
+            tx[i] = std::cos(heading * M_PI / 180) * magnitude;
+            ty[i] = std::sin(heading * M_PI / 180) * magnitude;
+        }
+    }
+
+    // hermite basis and its derivatives, order 0..2
+    auto eval = [&](int segment, double t, int order, double& x, double& y) {
+        const double t2 = t * t, t3 = t2 * t;
+        double h[4] = {2 * t3 - 3 * t2 + 1, t3 - 2 * t2 + t, -2 * t3 + 3 * t2, t3 - t2};
+        if (order == 1) {
+            h[0] = 6 * t2 - 6 * t, h[1] = 3 * t2 - 4 * t + 1;
+            h[2] = -6 * t2 + 6 * t, h[3] = 3 * t2 - 2 * t;
+        } else if (order == 2) {
+            h[0] = 12 * t - 6, h[1] = 6 * t - 4, h[2] = -12 * t + 6, h[3] = 6 * t - 2;
+        }
+        x = px[segment] * h[0] + tx[segment] * h[1] + px[segment + 1] * h[2] +
+            tx[segment + 1] * h[3];
+        y = py[segment] * h[0] + ty[segment] * h[1] + py[segment + 1] * h[2] +
+            ty[segment + 1] * h[3];
+    };
+
+    // cumulative arc length at evenly spaced parameters of each segment
+    std::array<double, (W - 1) * stride> lengths{};
+    double length = 0.0;
+    for (int segment = 0; segment < n - 1; segment++) {
+        double last_x = 0, last_y = 0;
+        eval(segment, 0.0, 0, last_x, last_y);
+        lengths[segment * stride] = length;
+        for (int i = 1; i <= samples; i++) {
+            double x = 0, y = 0;
+            eval(segment, (double)i / samples, 0, x, y);
+            length += std::sqrt((x - last_x) * (x - last_x) + (y - last_y) * (y - last_y));
+            lengths[segment * stride + i] = length;
+            last_x = x, last_y = y;
+        }
+    }
+
+    std::array<double, N> xs{}, ys{}, thetas{};
+    std::array<real, N> distances{}, curvatures{};
+    int index = 0;
+    for (int i = 0; i < (int)N; i++) {
+        // invert the arc length table, the targets only ever increase
+        const double distance = i * length / (N - 1);
+        while (index + 2 < (int)lengths.size() && lengths[index + 1] <= distance) index++;
+        const int segment = index / stride;
+        int step = index - segment * stride;
+        if (step >= samples) step = samples - 1;
+        const int base = segment * stride + step;
+        const double span = lengths[base + 1] - lengths[base];
+        double fraction = span > 0 ? (distance - lengths[base]) / span : 0.0;
+        fraction = fraction < 0 ? 0.0 : (fraction > 1 ? 1.0 : fraction);
+        const double t = (step + fraction) / samples;
+
+        // heading and signed curvature from the derivatives
+        double x = 0, y = 0, dx = 0, dy = 0, ddx = 0, ddy = 0;
+        eval(segment, t, 0, x, y);
+        eval(segment, t, 1, dx, dy);
+        eval(segment, t, 2, ddx, ddy);
+        const double speed = std::sqrt(dx * dx + dy * dy);
+        xs[i] = x, ys[i] = y, thetas[i] = std::atan2(dy, dx);
+        distances[i] = distance;
+        curvatures[i] = speed > 0 ? (dx * ddy - dy * ddx) / (speed * speed * speed) : 0.0;
+    }
+
+    // poses are built in place, their assignment operators aren't constexpr
+    return [&]<size_t... I>(std::index_sequence<I...>) {
+        return PathTable<N>{{Pose(xs[I], ys[I], thetas[I])...}, distances, curvatures};
+    }(std::make_index_sequence<N>());
+}
+
+} // namespace appa
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "utils.h"
+#include <cstdarg>
+
+namespace appa {
+
+/* Telemetry */
+struct Record {
+    uint32_t time; // ms
+    float values[6];
+};
+
+// formats a record, called from the telemetry task
+using Format = void (*)(const Record& record);
+
+// single producer channel drained by the telemetry task
+class Channel {
+    SpscQueue<Record, 32> queue;
+    Format format;
+    std::atomic<uint32_t> drops{0};
+
+  public:
+    Channel(Format format);
+
+    void push(const Record& record);
+    bool drain();
+    uint32_t dropped() const;
+};
+
+namespace telemetry {
+extern TaskConfig task_config; // set before the first add()
+void add(Channel& channel);
+void task();
+} // namespace telemetry
+
+/* Recorder */
+// records the control steps of a chassis' motions and writes each one out once it ends.
+// the motion task only copies samples into a preallocated queue, they are collected and written
+// by a low priority task, so recording never waits on the sd card or serial
+class Recorder {
+  public:
+    enum Output { CSV, BINARY, SERIAL };
+
+  private:
+    SpscQueue<MotionRecord, 256> queue;
+    std::vector<MotionRecord> samples; // of the motion being collected
+    const char* name;
+    Output output;
+    std::atomic<uint32_t> count{0}; // motions written
+    std::atomic<uint32_t> drops{0};
+    pros::Task* recorder_task = nullptr;
+    pros::Mutex recorder_mutex;
+
+    void task();
+    void write();
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MIN};
+
+    // files are written to <name>_<n>.csv or <name>_<n>.bin, n counting motions from 0
+    Recorder(const char* name = "/usd/motion", Output output = CSV, int reserve = 1024);
+    ~Recorder();
+
+    void start();
+    void push(const MotionRecord& sample);
+    uint32_t dropped() const;
+    uint32_t written() const;
+};
+
+/* Log */
+// append only file on the sd card for logging from control tasks. records are copied into
+// preallocated blocks and a low priority task writes whole blocks, so a producer never waits on
+// the card. records are dropped instead when every block is waiting to be written or another task
+// is copying in at the same moment
+class Log {
+  public:
+    static constexpr size_t block_size = 4096; // bytes, a multiple of the card's 512 byte sectors
+    static constexpr int max_blocks = 16;
+
+  private:
+    struct alignas(64) Block {
+        char data[block_size];
+        uint32_t size = 0;    // bytes
+        uint32_t records = 0; // dropped with the block if it can't be written
+        uint32_t time = 0;    // ms, when the first record went in
+    };
+
+    std::unique_ptr<Block[]> blocks;
+    SpscQueue<uint8_t, max_blocks> full, free; // block indexes, pushed to full under log_mutex
+    int current = -1;                            // block being filled
+    const char* name;
+    size_t max_size;
+    uint32_t index = 0; // of the open file
+    FILE* file = nullptr;
+    size_t file_size = 0;
+    bool open_failed = false;
+    std::atomic<uint32_t> drops{0};
+    pros::Task* log_task = nullptr;
+    pros::Mutex log_mutex;
+
+    bool reserve(size_t size);
+    void task();
+    void write(Block& block);
+
+  public:
+    TaskConfig task_config = {TASK_PRIORITY_MIN};
+
+    // name is a printf pattern for the file index, such as "/usd/log_%u.csv". a new file is started
+    // once one reaches max_size bytes, numbered after the files already on the card
+    Log(const char* name = "/usd/log_%u.txt", size_t max_size = 1 << 20, int blocks = 8);
+    ~Log();
+
+    void start();
+    bool write(const void* data, size_t size);
+    bool print(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    uint32_t dropped() const;
+};
+
+/* OdomRecorder */
+// takes an odom's raw readings every loop through a Log, so the loop never waits on the card:
+// tracker ticks, the heading, each imu's rotation and rate and the poses it was set to. truth()
+// ends a recording at a measured pose, and tools/odom_replay.cpp replays the recordings through
+// the odom integration on a host to compare changes to it against that pose
+class OdomRecorder {
+    Log log;
+
+  public:
+    // recordings follow each other in a file until it reaches max_size
+    OdomRecorder(const char* name = "/usd/odom_%u.bin", size_t max_size = 16 << 20);
+
+    void start();
+    bool push(const OdomRecord& record); // from the odom loop, never waits
+    // where the robot was measured to be at the end (in and deg like OdomBase::set), after the
+    // odom stopped recording
+    void truth(const Pose& pose);
+    uint32_t dropped() const;
+};
+
+/* PerformanceLog */
+// the result of every motion appended to the sd card through a Log, across programs, and timeouts
+// from how long similar motions took to settle. motions are similar with the same kind and an
+// extent in the same power of two
+class PerformanceLog {
+  public:
+    static constexpr int kinds = 8;    // Chassis::Motion
+    static constexpr int sizes = 8;    // powers of two of the extent, under 2 in or deg up to 128
+    static constexpr int history = 32; // latest durations kept of each kind and size
+
+  private:
+    struct Durations {
+        std::array<float, history> time{}; // ms, a ring
+        uint32_t count = 0;
+    };
+
+    Log log;
+    const char* name;
+    std::array<Durations, kinds * sizes> durations;
+    pros::Mutex performance_mutex;
+
+    void add(const PerformanceRecord& record);
+
+  public:
+    int min_samples = 5;  // settled motions a timeout needs
+    double margin = 1.25; // over their 99th percentile
+
+    // files follow each other as they reach max_size, numbered after the ones already there
+    PerformanceLog(const char* name = "/usd/perf_%u.bin", size_t max_size = 1 << 20);
+
+    int load(); // the motions of earlier programs, before start(). how many were read
+    void start();
+    bool push(const PerformanceRecord& record); // from the motion's task, never waits
+    // ms, margin over the 99th percentile of the similar motions that settled, nan without
+    // min_samples of them
+    double timeout(uint8_t motion, double extent);
+    uint32_t dropped() const;
+};
+
+} // namespace appa
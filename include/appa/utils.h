@@ -1,40 +1,367 @@
 #pragma once
 
 #include "appa.h"
+#include <atomic>
+#include <functional>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <span>
 
 namespace appa {
 
+/* Precision */
+// storage for points, poses and paths, float when built with EXTRA_CXXFLAGS=-DAPPA_SINGLE_PRECISION
+// to halve them and let batch operations run four lanes of neon, math in between stays double
+#ifdef APPA_SINGLE_PRECISION
+using real = float;
+#else
+using real = double;
+#endif
+
+/* Fixed */
+// q16.16 fixed point for control loops that need the same cost every cycle, where double math on
+// the brain's softfp build takes longer for some operands than others. results saturate at about
+// +-32768 instead of wrapping, and division and square roots take a fixed number of steps
+struct Fixed {
+    static constexpr int32_t nan_raw = INT32_MIN; // stands for nan, such as a missing measurement
+    int32_t raw = 0;                              // value * 65536
+
+    constexpr Fixed() = default;
+    constexpr Fixed(double value)
+        : raw(value != value      ? nan_raw
+              : value >= 32767.99 ? INT32_MAX
+              : value <= -32767.99
+                  ? -INT32_MAX
+                  : (int32_t)(value * 65536 + (value < 0 ? -0.5 : 0.5))) {}
+    static constexpr Fixed from_raw(int32_t raw) {
+        Fixed fixed;
+        fixed.raw = raw;
+        return fixed;
+    }
+    static constexpr int32_t saturate(int64_t raw) {
+        return raw > INT32_MAX ? INT32_MAX : raw < -INT32_MAX ? -INT32_MAX : (int32_t)raw;
+    }
+    constexpr explicit operator double() const { return raw == nan_raw ? NAN : raw / 65536.0; }
+
+    constexpr Fixed operator+(Fixed other) const {
+        return from_raw(saturate((int64_t)raw + other.raw));
+    }
+    constexpr Fixed operator-(Fixed other) const {
+        return from_raw(saturate((int64_t)raw - other.raw));
+    }
+    constexpr Fixed operator-() const { return raw == nan_raw ? *this : from_raw(-raw); }
+    constexpr Fixed operator*(Fixed other) const {
+        return from_raw(saturate(((int64_t)raw * other.raw + (1 << 15)) >> 16));
+    }
+    Fixed operator/(Fixed other) const;
+    constexpr Fixed& operator+=(Fixed other) { return *this = *this + other; }
+    constexpr Fixed& operator-=(Fixed other) { return *this = *this - other; }
+    constexpr Fixed& operator*=(Fixed other) { return *this = *this * other; }
+    constexpr auto operator<=>(const Fixed&) const = default;
+
+    // found by argument lookup only, so they don't hide the double versions in appa
+    friend constexpr Fixed fabs(Fixed value) { return value.raw < 0 ? -value : value; }
+    friend Fixed hypot(Fixed x, Fixed y) { return length(x, y); }
+    static Fixed length(Fixed x, Fixed y);
+};
+
+Fixed wrap(Fixed angle); // to about (-pi, pi]
+
+inline bool is_missing(double value) { return std::isnan(value); }
+inline bool is_missing(Fixed value) { return value.raw == Fixed::nan_raw; }
+
 /* PID */
 struct Gains {
-    double p, i, d;
-    Gains(double p = 0.0, double i = 0.0, double d = 0.0) : p(p), i(i), d(d) {}
+    double p = 0.0, i = 0.0, d = 0.0;
+    double i_zone = 0.0;         // only integrate when the error is within this, 0 always does
+    double i_max = 0.0;          // max magnitude of the integral term (%), 0 is unlimited
+    double filter = 0.0;         // derivative low pass smoothing from 0 (none) towards 1
+    bool sign_reset = false;     // clear the integral when the error changes sign
+    bool on_measurement = false; // differentiate the measurement, ignoring setpoint jumps
+};
+
+// gains interpolated from a small table, keyed on the error or the robot's speed
+struct ScheduledGains {
+    static constexpr int capacity = 4;
+    enum Key : uint8_t { BY_ERROR, BY_SPEED };
+    struct Entry {
+        double at; // error (in or deg) or speed (in/s or deg/s), ascending
+        Gains gains;
+    };
+    std::array<Entry, capacity> entries{};
+    int size = 0;
+    Key key = BY_ERROR;
+
+    constexpr ScheduledGains() = default;
+    constexpr ScheduledGains(const Gains& gains) : size(1) { entries[0] = {0.0, gains}; }
+    constexpr ScheduledGains(double p, double i = 0.0, double d = 0.0)
+        : ScheduledGains(Gains{p, i, d}) {}
+    constexpr ScheduledGains(Key key, std::initializer_list<Entry> list) : key(key) {
+        for (const Entry& entry : list) {
+            if (size < capacity) entries[size++] = entry;
+        }
+    }
+
+    Gains get(double value) const;
+    bool scheduled() const;
 };
 
-class PID {
+// gains kept on the SD card between boots, such as from an autotune
+bool load_gains(const char* name, Gains& gains);
+bool save_gains(const char* name, const Gains& gains);
+
+struct Feedforward {
+    double s, v, a, p; // static, velocity, acceleration and velocity error terms
+    constexpr Feedforward(double s = 0.0, double v = 0.0, double a = 0.0, double p = 0.0)
+        : s(s), v(v), a(a), p(p) {}
+    double get(double velocity, double accel, double measured = 0.0) const;
+    explicit operator bool() const;
+};
+
+// in double, or Fixed for loops with a fixed cost. gains stay double and are converted when set
+template <typename T> class BasicPID {
     Gains k;
-    double prev_error, total_error;
+    T p, i, d, i_zone, i_limit, filter, unfiltered; // of k in T, i_limit bounds the total
+    T prev_error, total_error;
+    T prev_measurement, derivative;
+    T prev_dt, seconds, rate; // the last period in ms, s and 1/s, divided again when it changes
+
+  public:
+    struct Terms {
+        double p, i, d;
+    };
+
+    BasicPID(Gains k);
+    BasicPID(double kp, double ki, double kd);
+    void reset(T error = T(0.0), bool clear_integral = true);
+    void set_gains(Gains k);
+    T update(T error, T dt, T measurement = T(NAN));
+    Terms terms() const; // of the last update
+};
+
+using PID = BasicPID<double>;
+using FixedPID = BasicPID<Fixed>;
+extern template class BasicPID<double>;
+extern template class BasicPID<Fixed>;
+
+/* Slew */
+class Slew {
+    double accel, decel; // per second, 0 is unlimited
+    double value = 0.0;
+
+  public:
+    Slew(double accel = 0.0, double decel = 0.0);
+    void set_limits(double accel, double decel);
+    void reset(double value = 0.0);
+    double update(double target, double dt);
+    double get() const;
+};
+
+/* Profile */
+class Profile {
+    double distance, speed, accel, decel, jerk;
+    double position = 0.0, velocity = 0.0, acceleration = 0.0;
 
   public:
-    PID(Gains k);
-    PID(double kp, double ki, double kd);
-    void reset(double error = 0.0);
-    double update(double error, int dt);
+    Profile(double distance, double speed, double accel, double decel, double jerk = 0.0);
+    void update(double dt);
+    // moves the end while keeping the current state, for a target that moves
+    void retarget(double distance);
+    double get_position() const;
+    double get_velocity() const;
+    double get_acceleration() const;
+    bool done() const;
+};
+
+/* Kinematics */
+struct Point {
+    // clang-format off
+    union {
+        struct { real x, y; };
+        struct { real left, right; };
+        struct { real linear, angular; };
+    };
+    // clang-format on
+
+    constexpr Point(double x = NAN, double y = NAN) : x(x), y(y) {}
+
+    Point operator+(const Point& other) const;
+    Point operator-(const Point& other) const;
+    Point operator*(double scalar) const;
+    void operator+=(const Point& other);
+    void operator-=(const Point& other);
+    void operator*=(double scalar);
+    void operator=(const Point& p);
+
+    double dist(const Point& other) const;
+    double angle(const Point& other, double offset = 0.0) const;
+    Point rotate(double theta) const;
+};
+
+// differential drive model, left and right wheel speeds from body velocities and back
+struct Kinematics {
+    double track_width = 0.0;    // in, between the wheel centers
+    double wheel_diameter = 0.0; // in
+    double gear_ratio = 1.0;     // wheel turns per motor turn
+    double motor_rpm = 600.0;    // cartridge free speed
+    double max_accel = 0.0;      // wheel in/s², limits profiles the accel option leaves unset
+
+    double max_speed() const;                           // wheel in/s at full voltage
+    Point inverse(double linear, double angular) const; // in/s and rad/s to wheel in/s
+    Point forward(const Point& wheels) const;           // wheel in/s to in/s and rad/s
+    explicit operator bool() const;
+};
+
+/* Curve */
+// driver input shaping, precomputed over the controller's -128 to 127 range so a lookup is an index
+class Curve {
+    std::array<float, 256> table; // % output, indexed by value + 128
+
+  public:
+    Curve(); // linear, 127 is 100%
+    // deadzone (stick %) reads as 0, outside it output starts at min_output (%) and expo blends
+    // from linear (0) to cubic (1)
+    Curve(double deadzone, double expo = 0.0, double min_output = 0.0);
+    // any odd shape from stick % to output %, evaluated once per entry
+    Curve(const std::function<double(double)>& shape);
+    // {stick %, output %} points for positive inputs in ascending order, mirrored for negative
+    static Curve piecewise(std::initializer_list<Point> points, double deadzone = 0.0);
+
+    double operator()(int32_t value) const;
 };
 
 /* Imu */
 struct Imu {
+    struct State {
+        double rotation = 0.0; // deg, last reading
+        double rate = NAN;     // deg/s, last gyro reading, nan when it wasn't needed
+        double variance = 1.0; // deg^2, of the residual from the fused heading
+        double offset = 0.0;   // deg added to the reading, from set() and the drift taken out
+        double bias = 0.0;     // deg/s the reading drifts, learned while still
+        uint64_t time = 0;     // us, of the last new reading
+        bool connected = true;
+        bool valid = false;
+    };
+
     std::vector<pros::Imu> imus{};
+    std::vector<State> states{};
+
+    // fusion settings
+    bool weighted = false; // weight by residual variance and reject outliers
+    bool gyro = false;     // integrate gyro rate between rotation updates
+    double outlier = 2.0;  // deg from the median to reject a reading
+
+    // zero velocity updates: while the odom sets still, what each imu turns is drift, learned as
+    // its bias and taken out, and the bias is taken out while moving too. a change faster than
+    // max_drift is a real turn however still the trackers are
+    bool still = false;      // set by the odom before each get()
+    double bias_gain = 0.05; // of each still reading's rate taken into the bias, 0 turns it off
+    double max_drift = 1.0;  // deg/s
+
+    // rotation turned per rotation reported, by port, such as from Chassis::calibrate_imu().
+    // loaded from scale_file by calibrate() when set
+    std::array<double, 22> scales;
+    const char* scale_file = nullptr;
+
+    double heading = 0.0;
+    uint64_t prev_time = 0;
+    uint32_t reads = 0;
 
     Imu(std::initializer_list<uint8_t> ports);
     Imu(uint8_t port);
 
     bool calibrate();
+    // true when every imu is still calibrated, such as after the program restarted, so they are
+    // used as they are. the heading starts from what they read
+    bool resume();
     double get();
+    // the fusion step of get() on readings taken elsewhere, such as a replayed recording: scaled
+    // rotations (deg, nan when invalid) and gyro rates (deg/s, nan when not read) by imu
+    double fuse(uint64_t time, std::span<const double> rotations, std::span<const double> rates);
     void set(double angle);
+    Point tilt(); // deg of pitch and roll from the first imu that reads them, nan when none do
+    double accel(); // in/s² across the floor from the first imu that reads it, nan when none do
+    bool load_scales(const char* file);
+    bool save_scales(const char* file) const;
+};
+
+/* Tracker */
+// sensor that reports linear travel of a tracking wheel in ticks. constructors only keep the
+// configuration, so trackers can be globals, and bind() sets up the device from initialize(), by
+// the odom's start() at the latest
+struct Tracker {
+    virtual ~Tracker();
+    virtual void bind() {}
+    virtual double get() = 0;
+};
+
+// binds trackers and heading sources that have a bind()
+template <typename T> void bind_device(T& device) {
+    if constexpr (requires { device.bind(); }) device.bind();
+}
+
+// 3-wire encoder, port or {expander port, port}. negative port reverses
+struct AdiTracker final : Tracker {
+    std::optional<pros::adi::Encoder> encoder; // configures the ports, so made by bind()
+    uint8_t expander = 0, port;                // expander 0 for the brain's ports
+    bool reversed;
+
+    AdiTracker(int8_t port);
+    AdiTracker(std::array<int8_t, 2> port);
+
+    void bind() override;
+    double get() override { return encoder ? encoder->get_value() : 0.0; }
+};
+
+// v5 rotation sensor sampled at data_rate ms. negative port reverses
+struct RotationTracker final : Tracker {
+    pros::Rotation rotation;
+    uint32_t data_rate; // ms, set by bind()
+
+    RotationTracker(int8_t port, uint32_t data_rate = 5);
+
+    void bind() override;
+    double get() override { return rotation.get_position(); }
+};
+
+// median position of one or more motors, so one bad encoder can't drag it. skips motors that
+// report an error. negative port reverses
+struct MotorTracker final : Tracker {
+    std::unique_ptr<pros::MotorGroup> motors; // behind a pointer so the tracker can be moved
+    double last = 0.0;
+
+    MotorTracker(std::initializer_list<int8_t> ports);
+
+    double get() override;
+};
+
+// any tracker chosen at runtime, a virtual call per read. BasicOdom takes the trackers above
+// directly to call them without one
+struct AnyTracker {
+    std::unique_ptr<Tracker> tracker;
+
+    AnyTracker(int8_t port);
+    AnyTracker(int8_t expander, int8_t port);
+    AnyTracker(std::unique_ptr<Tracker> tracker);
+    // straight from make_unique, which would otherwise take two conversions to get here
+    template <class T>
+        requires std::is_base_of_v<Tracker, T>
+    AnyTracker(std::unique_ptr<T> tracker)
+        : AnyTracker(std::unique_ptr<Tracker>(std::move(tracker))) {}
+
+    void bind() { tracker->bind(); }
+    double get() { return tracker->get(); }
+};
+
+// a tracker that never moves, for a missing wheel
+struct NoTracker {
+    double get() { return 0.0; }
 };
 
 /* Utils */
 enum Direction { AUTO, FORWARD, REVERSE, CCW, CW };
+enum class Side { LEFT, RIGHT };
 
 #define AUTO appa::AUTO
 #define FORWARDS appa::FORWARD
@@ -42,64 +369,310 @@ enum Direction { AUTO, FORWARD, REVERSE, CCW, CW };
 #define CCW appa::CCW
 #define CW appa::CW
 
+// built in exit condition, checked without any heap or virtual dispatch
+struct Exit {
+    enum Type : uint8_t {
+        NONE, DISTANCE, TIME, STALL, BELOW, ABOVE, SLIP, STUCK, CURRENT, IMPACT, PUSH
+    };
+
+    Type type = NONE;
+    double value = 0.0;           // in traveled, ms elapsed, speed, current or sensor threshold
+    int time = 0;                 // ms the condition has to hold for
+    double (*sensor)() = nullptr; // for sensor thresholds
+    double output = 0.0;          // commanded output (%) a stuck robot is pushing with at least
+
+    static constexpr Exit distance(double distance) { return {DISTANCE, distance, 0, nullptr}; }
+    static constexpr Exit elapsed(int time) { return {TIME, (double)time, 0, nullptr}; }
+    static constexpr Exit stall(double speed, int time) { return {STALL, speed, time, nullptr}; }
+    static constexpr Exit below(double (*sensor)(), double value) {
+        return {BELOW, value, 0, sensor};
+    }
+    static constexpr Exit above(double (*sensor)(), double value) {
+        return {ABOVE, value, 0, sensor};
+    }
+    static constexpr Exit slip(double speed, int time) { return {SLIP, speed, time, nullptr}; }
+    static constexpr Exit stuck(double speed, int time, double output = 50.0) {
+        return {STUCK, speed, time, nullptr, output};
+    }
+    static constexpr Exit current(double milliamps, int time) {
+        return {CURRENT, milliamps, time, nullptr};
+    }
+    static constexpr Exit impact(double decel) { return {IMPACT, decel, 0, nullptr}; }
+    static constexpr Exit push(double percent, int time) { return {PUSH, percent, time, nullptr}; }
+};
+
+// up to 4 exit conditions, any of which ends a motion
+struct ExitSet {
+    static constexpr int capacity = 4;
+    std::array<Exit, capacity> exits{};
+    int size = 0;
+
+    constexpr ExitSet() = default;
+    constexpr ExitSet(std::initializer_list<Exit> list) {
+        for (const Exit& exit : list) {
+            if (size < capacity) exits[size++] = exit;
+        }
+    }
+};
+
+#ifdef APPA_NO_HEAP
+// custom exit function stored inline and copied with the options, so making one never allocates
+class ExitFn {
+  public:
+    static constexpr size_t capacity = 32; // bytes the function can capture
+
+  private:
+    struct Ops {
+        bool (*call)(void* fn);
+        void (*copy)(void* to, const void* from);
+        void (*destroy)(void* fn);
+    };
+    template <typename F> static const Ops* ops_of() {
+        static constexpr Ops ops = {
+            [](void* fn) -> bool { return (*static_cast<F*>(fn))(); },
+            [](void* to, const void* from) { new (to) F(*static_cast<const F*>(from)); },
+            [](void* fn) { static_cast<F*>(fn)->~F(); }};
+        return &ops;
+    }
+    alignas(alignof(std::max_align_t)) mutable unsigned char storage[capacity] = {};
+    const Ops* ops = nullptr;
+
+  public:
+    constexpr ExitFn() = default;
+    constexpr ExitFn(std::nullptr_t) {}
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, ExitFn> &&
+                                                      std::is_invocable_r_v<bool, F&>>>
+    ExitFn(F fn) : ops(ops_of<F>()) {
+        static_assert(sizeof(F) <= capacity && alignof(F) <= alignof(std::max_align_t),
+                      "exit function captures too much to store without the heap");
+        new (storage) F(std::move(fn));
+    }
+    constexpr ExitFn(const ExitFn& other) : ops(other.ops) {
+        if (ops) ops->copy(storage, other.storage);
+    }
+    constexpr ExitFn& operator=(const ExitFn& other) {
+        if (this == &other) return *this;
+        if (ops) ops->destroy(storage);
+        ops = other.ops;
+        if (ops) ops->copy(storage, other.storage);
+        return *this;
+    }
+    constexpr ~ExitFn() {
+        if (ops) ops->destroy(storage);
+    }
+
+    bool operator()() const;
+    constexpr explicit operator bool() const { return ops != nullptr; }
+};
+#else
+// shared handle to a custom exit function, so copying options never copies the function
+class ExitFn {
+    struct Block {
+        std::function<bool()> fn;
+        std::atomic<int> count;
+    };
+    Block* block = nullptr;
+
+  public:
+    // constexpr while empty, so options without an exit function can be constant
+    constexpr ExitFn() = default;
+    constexpr ExitFn(std::nullptr_t) {}
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, ExitFn> &&
+                                                      std::is_invocable_r_v<bool, F&>>>
+    ExitFn(F fn) : block(new Block{std::move(fn), 1}) {}
+    constexpr ExitFn(const ExitFn& other) : block(other.block) {
+        if (block) block->count.fetch_add(1);
+    }
+    constexpr ExitFn(ExitFn&& other) noexcept : block(other.block) { other.block = nullptr; }
+    constexpr ExitFn& operator=(ExitFn other) noexcept {
+        std::swap(block, other.block);
+        return *this;
+    }
+    constexpr ~ExitFn() {
+        if (block && block->count.fetch_sub(1) == 1) delete block;
+    }
+
+    bool operator()() const;
+    constexpr explicit operator bool() const { return block != nullptr; }
+};
+#endif
+
+// a timeout from the chassis' performance log for motions like it, or from its estimate
+constexpr int AUTO_TIMEOUT = -1;
+
 struct Options {
     std::optional<Direction> dir, turn;
-    std::optional<double> speed, accel, lead, lookahead, exit, offset;
-    std::optional<int> settle, timeout;
-    std::optional<Gains> lin_PID, ang_PID;
-    std::optional<bool> thru, relative, async;
-    std::function<bool()> exit_fn = nullptr;
+    std::optional<double> speed, accel, decel, jerk, lead, close, drift, lookahead, stanley, exit,
+        exit_speed, offset, blend, latency, warp, heading;
+    std::optional<int> settle, timeout, period;
+    std::optional<ScheduledGains> lin_PID, ang_PID;
+    std::optional<Point> tool;
+    std::optional<pros::motor_brake_mode_e> brake;
+    std::optional<bool> thru, relative, async, sync, queue, profile, predict, mpc, unwrap;
+    std::optional<ExitSet> exits;
+    ExitFn exit_fn = nullptr;
 
-    static Options defaults();
+    static constexpr Options defaults();
 
-    Options operator<<(const Options& other) const;
-    Options operator>>(const Options& other) const;
-    void operator<<=(const Options& other);
-    void operator>>=(const Options& other);
+    constexpr Options operator<<(const Options& other) const;
+    constexpr Options operator>>(const Options& other) const;
+    constexpr void operator<<=(const Options& other);
+    constexpr void operator>>=(const Options& other);
+};
+
+// options with a bit per set field, trivially copyable so merging and queueing is a plain copy
+struct PackedOptions {
+    enum Field : uint8_t {
+        DIR, TURN, SPEED, ACCEL, DECEL, JERK, LEAD, CLOSE, DRIFT, LOOKAHEAD, STANLEY, EXIT,
+        EXIT_SPEED, OFFSET, BLEND, LATENCY, WARP, HEADING, SETTLE, TIMEOUT, PERIOD, LIN_PID,
+        ANG_PID, TOOL, BRAKE, THRU, RELATIVE, ASYNC, SYNC, QUEUE, PROFILE, PREDICT, MPC, UNWRAP,
+        EXITS
+    };
+
+    uint64_t fields = 0; // bit per set field
+    uint64_t flags = 0;  // bool values, bit per field
+    Direction dir = AUTO, turn = AUTO;
+    double speed = 0.0, accel = 0.0, decel = 0.0, jerk = 0.0, lead = 0.0, close = 0.0,
+           drift = 0.0, lookahead = 0.0, stanley = 0.0, exit = 0.0, exit_speed = 0.0,
+           offset = 0.0, blend = 0.0, latency = 0.0, warp = 0.0, heading = NAN;
+    int settle = 0, timeout = 0, period = 0;
+    ScheduledGains lin_PID, ang_PID;
+    real tool_x = 0.0, tool_y = 0.0; // in, robot frame, scalars as Point isn't trivially copyable
+    pros::motor_brake_mode_e brake = pros::E_MOTOR_BRAKE_INVALID;
+    ExitSet exits;
+
+    PackedOptions() = default;
+    PackedOptions(const Options& options);
+
+    bool has(Field field) const;
+    bool flag(Field field) const;
+    void set_flag(Field field, bool value);
+
+    PackedOptions operator<<(const PackedOptions& other) const;
+    void operator<<=(const PackedOptions& other);
 };
 
 struct MoveConfig {
     double exit, speed, lead, lookahead;
-    Gains lin_PID, ang_PID;
+    ScheduledGains lin_PID, ang_PID;
+    double track_width = 0.0; // for curvature based pure pursuit, 0 steers with ang_PID
+    double velocity = 0.0;    // in/s at full speed, needed for profiled motions
+    Feedforward feedforward;  // in/s, for profiled motions
+    Kinematics kinematics;    // fills track width and both velocities when they're 0
+    // in, paths look further ahead the faster the robot goes and closer before sharp curves,
+    // within these. 0 keeps the lookahead fixed
+    double min_lookahead = 0.0, max_lookahead = 0.0;
+    // %, the least a move commands outside its exit, to overcome static friction. 0 is off
+    double ks = 0.0;
+
+    constexpr Options options() const;
+};
 
-    Options options() const;
+// weights of an lqr on an axis modelled by a feedforward's v and a terms
+struct LqrWeights {
+    double error = 0.0;  // cost per unit² of error, 0 is off
+    double rate = 0.0;   // cost per (unit/s)² of rate error
+    double effort = 1.0; // cost per %² of output
 };
 
+// state feedback gains from the discrete riccati equation at a control period, % per unit of
+// error and per unit/s of rate error. zero when the model has no v or a
+struct LqrGains {
+    double error = 0.0, rate = 0.0;
+};
+LqrGains solve_lqr(const Feedforward& model, const LqrWeights& weights, double dt);
+
 struct TurnConfig {
     double exit, speed;
-    Gains ang_PID;
-    Options options() const;
+    ScheduledGains ang_PID;
+    double velocity = 0.0; // deg/s at full speed, needed for profiled motions
+    Feedforward feedforward; // deg/s, for profiled motions
+    double ks = 0.0;         // %, the least a turn commands outside its exit, 0 is off
+    LqrWeights lqr;          // deg, turns with it instead of ang_PID, from the feedforward
+    constexpr Options options() const;
 };
 
-struct Point {
-    // clang-format off
-    union {
-        struct { double x, y; };
-        struct { double left, right; };
-        struct { double linear, angular; };
-    };
-    // clang-format on
+// gains and limits kept on the SD card as "key = value" lines, such as "move.lin_p = 12", read
+// once at boot over the compiled configs so they can change without uploading. a file needs
+// "version = 1" and, when it has one, a "crc = " line that matches the lines above it, so a file
+// from save_tuning() that was cut short is caught while one edited by hand can drop the line. keys
+// the file leaves out keep the compiled values, and a file that fails to load changes nothing. the
+// gain keys set the first entry of a schedule
+bool load_tuning(const char* name, MoveConfig& move_config, TurnConfig& turn_config);
+bool save_tuning(const char* name, const MoveConfig& move_config, const TurnConfig& turn_config);
 
-    Point(double x = NAN, double y = NAN) : x(x), y(y) {}
+/* Options */
+// constexpr so presets without an exit function can be merged at compile time
+constexpr Options Options::defaults() {
+    return Options(AUTO, AUTO, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+                   0.0, std::nullopt, 0, 0, 10, Gains(), Gains(), Point(0.0, 0.0), std::nullopt,
+                   false, false, false, false, false, false, false, false, false, ExitSet());
+}
 
-    Point operator+(const Point& other) const;
-    Point operator-(const Point& other) const;
-    Point operator*(double scalar) const;
-    void operator+=(const Point& other);
-    void operator-=(const Point& other);
-    void operator*=(double scalar);
-    void operator=(const Point& p);
+constexpr Options Options::operator<<(const Options& other) const {
+    Options result = *this;
 
-    double dist(const Point& other) const;
-    double angle(const Point& other, double offset = 0.0) const;
-    Point rotate(double theta) const;
-};
+    if (other.dir) result.dir = other.dir;
+    if (other.turn) result.turn = other.turn;
+    if (other.speed) result.speed = other.speed;
+    if (other.accel) result.accel = other.accel;
+    if (other.decel) result.decel = other.decel;
+    if (other.jerk) result.jerk = other.jerk;
+    if (other.lead) result.lead = other.lead;
+    if (other.close) result.close = other.close;
+    if (other.drift) result.drift = other.drift;
+    if (other.lookahead) result.lookahead = other.lookahead;
+    if (other.stanley) result.stanley = other.stanley;
+    if (other.exit) result.exit = other.exit;
+    if (other.exit_speed) result.exit_speed = other.exit_speed;
+    if (other.offset) result.offset = other.offset;
+    if (other.blend) result.blend = other.blend;
+    if (other.latency) result.latency = other.latency;
+    if (other.warp) result.warp = other.warp;
+    if (other.heading) result.heading = other.heading;
+    if (other.settle) result.settle = other.settle;
+    if (other.timeout) result.timeout = other.timeout;
+    if (other.period) result.period = other.period;
+    if (other.lin_PID) result.lin_PID = other.lin_PID;
+    if (other.ang_PID) result.ang_PID = other.ang_PID;
+    if (other.tool) result.tool = other.tool;
+    if (other.brake) result.brake = other.brake;
+    if (other.thru) result.thru = other.thru;
+    if (other.relative) result.relative = other.relative;
+    if (other.async) result.async = other.async;
+    if (other.sync) result.sync = other.sync;
+    if (other.queue) result.queue = other.queue;
+    if (other.profile) result.profile = other.profile;
+    if (other.predict) result.predict = other.predict;
+    if (other.mpc) result.mpc = other.mpc;
+    if (other.unwrap) result.unwrap = other.unwrap;
+    if (other.exits) result.exits = other.exits;
+    if (other.exit_fn) result.exit_fn = other.exit_fn;
+
+    return result;
+}
+constexpr Options Options::operator>>(const Options& other) const { return other << *this; }
+constexpr void Options::operator<<=(const Options& other) { *this = *this << other; }
+constexpr void Options::operator>>=(const Options& other) { *this = *this >> other; }
+
+constexpr Options MoveConfig::options() const {
+    return Options{.speed = speed,
+                   .lead = lead,
+                   .lookahead = lookahead,
+                   .exit = exit,
+                   .lin_PID = lin_PID,
+                   .ang_PID = ang_PID};
+}
+constexpr Options TurnConfig::options() const {
+    return Options{.speed = speed, .exit = exit, .ang_PID = ang_PID};
+}
 
 struct Pose {
-    double x, y, theta;
+    real x, y, theta;
 
-    Pose(double x = NAN, double y = NAN, double theta = NAN) : x(x), y(y), theta(theta) {}
-    Pose(const Point& p, double theta) : x(p.x), y(p.y), theta(theta) {}
+    constexpr Pose(double x = NAN, double y = NAN, double theta = NAN)
+        : x(x), y(y), theta(theta) {}
+    constexpr Pose(const Point& p, double theta) : x(p.x), y(p.y), theta(theta) {}
 
     operator Point() const;
     Point p() const;
@@ -111,6 +684,7 @@ struct Pose {
 
     Pose operator+(const Pose& p) const;
     Pose operator-(const Pose& p) const;
+    Pose operator*(double scalar) const;
     void operator+=(const Pose& p);
     void operator-=(const Pose& p);
     void operator=(const Pose& p);
@@ -120,8 +694,425 @@ struct Pose {
     Point project(double d) const;
 };
 
+struct Twist {
+    Pose vel = {0.0, 0.0, 0.0};   // units/s and rad/s
+    Pose accel = {0.0, 0.0, 0.0}; // units/s^2 and rad/s^2
+
+    double speed() const;
+    Twist rotate(double theta) const;
+};
+
+/* Covariance */
+// 3x3 covariance of a pose error (in, rad). fixed size and inline, so the odom loop and the
+// filters copy it around without calls or allocation
+struct Covariance {
+    std::array<std::array<double, 3>, 3> m{};
+
+    static constexpr Covariance diagonal(const Pose& deviation) {
+        Covariance c;
+        c.m[0][0] = deviation.x * deviation.x;
+        c.m[1][1] = deviation.y * deviation.y;
+        c.m[2][2] = deviation.theta * deviation.theta;
+        return c;
+    }
+
+    // moves a pose error to a pose displacement later, a heading error swings the position with it
+    static constexpr Covariance transport(const Point& displacement) {
+        Covariance c = diagonal({1.0, 1.0, 1.0});
+        c.m[0][2] = -displacement.y;
+        c.m[1][2] = displacement.x;
+        return c;
+    }
+
+    Covariance operator*(const Covariance& other) const {
+        Covariance c;
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                for (int k = 0; k < 3; k++) c.m[i][j] += m[i][k] * other.m[k][j];
+        return c;
+    }
+
+    Covariance transpose() const {
+        Covariance t;
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++) t.m[i][j] = m[j][i];
+        return t;
+    }
+
+    // false when singular
+    bool invert(Covariance& inverse) const {
+        const double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                           m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                           m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        if (!std::isfinite(det) || fabs(det) < 1e-18) return false;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                // cofactor of the transposed element, the indices wrap so no signs are needed
+                const int r0 = (j + 1) % 3, r1 = (j + 2) % 3, c0 = (i + 1) % 3, c1 = (i + 2) % 3;
+                inverse.m[i][j] = (m[r0][c0] * m[r1][c1] - m[r0][c1] * m[r1][c0]) / det;
+            }
+        }
+        return true;
+    }
+
+    // transport(displacement) * this * its transpose, only touching the terms it changes
+    void move(const Point& displacement) {
+        const double a = -displacement.y, b = displacement.x;
+        for (int j = 0; j < 3; j++) {
+            m[0][j] += a * m[2][j];
+            m[1][j] += b * m[2][j];
+        }
+        for (int i = 0; i < 3; i++) {
+            m[i][0] += a * m[i][2];
+            m[i][1] += b * m[i][2];
+        }
+    }
+
+    // a part made exact, such as after setting it
+    void clear(int i) {
+        for (int k = 0; k < 3; k++) m[i][k] = m[k][i] = 0.0;
+    }
+
+    void symmetrize() {
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < i; j++) m[i][j] = m[j][i] = (m[i][j] + m[j][i]) / 2;
+    }
+
+    Pose deviation() const { return {sqrt(m[0][0]), sqrt(m[1][1]), sqrt(m[2][2])}; }
+};
+
+// maps coordinates a routine was written in onto the field it runs on, such as the other
+// alliance's side, built from mirrors, half turns and offsets. the identity by default
+class FieldTransform {
+    // x' = xx x + xy y + x0, y' = yx x + yy y + y0 and theta' = turn theta + theta0, where turn is
+    // 1 for rotations and -1 for reflections
+    double xx = 1.0, xy = 0.0, x0 = 0.0, yx = 0.0, yy = 1.0, y0 = 0.0, turn = 1.0, theta0 = 0.0;
+
+    constexpr FieldTransform(double xx, double xy, double x0, double yx, double yy, double y0,
+                             double turn, double theta0)
+        : xx(xx), xy(xy), x0(x0), yx(yx), yy(yy), y0(y0), turn(turn), theta0(theta0) {}
+
+  public:
+    constexpr FieldTransform() = default;
+
+    static FieldTransform offset(const Pose& frame); // from frame's coordinates (rad)
+    static FieldTransform mirror(const Pose& line);  // across the line along a pose (rad)
+    static constexpr FieldTransform mirror_x(double x = 72.0) { // flips x about the line at x
+        return {-1.0, 0.0, 2 * x, 0.0, 1.0, 0.0, -1.0, M_PI};
+    }
+    static constexpr FieldTransform mirror_y(double y = 72.0) { // flips y about the line at y
+        return {1.0, 0.0, 0.0, 0.0, -1.0, 2 * y, -1.0, 0.0};
+    }
+    static constexpr FieldTransform rotate(const Point& center = {72.0, 72.0}) { // half turn
+        return {-1.0, 0.0, 2 * center.x, 0.0, -1.0, 2 * center.y, 1.0, M_PI};
+    }
+
+    FieldTransform then(const FieldTransform& next) const; // this one first
+    bool mirrored() const;
+    bool identity() const;
+    bool operator==(const FieldTransform& other) const = default;
+
+    Point point(const Point& p) const;
+    Pose pose(const Pose& p) const; // rad, a nan heading stays nan
+    double heading(double theta) const; // rad, not wrapped
+    // four at a time with neon in single precision, only the shorter span's size is written
+    void apply(std::span<const Point> from, std::span<Point> to) const;
+    void apply(std::span<const Pose> from, std::span<Pose> to) const;
+};
+
+/* Timing */
+// histogram buckets are quarters of the nominal period, the last one is 175% and up
+struct LoopTiming {
+    static constexpr int buckets = 8;
+
+    uint32_t nominal = 0;    // us
+    uint32_t period = 0;     // us, last measured
+    uint32_t max_period = 0; // us
+    uint32_t max_jitter = 0; // us, furthest a period has been from nominal
+    uint32_t overruns = 0;   // periods longer than 1.5x nominal
+    uint32_t busy = 0;       // us of work in the last iteration, the rest of the period is idle
+    uint32_t max_busy = 0;   // us
+    uint32_t count = 0;      // iterations
+    uint64_t total_period = 0, total_busy = 0; // us
+    std::array<uint32_t, buckets> period_histogram{}, busy_histogram{};
+
+    // a period of 0 only records the busy time, for a first iteration with nothing before it
+    void record(uint32_t period, uint32_t busy, uint32_t nominal);
+    double load() const; // fraction of the measured time spent working
+};
+
+/* Seqlock */
+// single writer, multi reader store. readers retry instead of blocking the writer
+template <typename T> class Seqlock {
+    std::atomic<uint32_t> seq{0};
+    T data{};
+
+  public:
+    void write(const T& value) {
+        const uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        data = value;
+        std::atomic_thread_fence(std::memory_order_release);
+        seq.store(s + 2, std::memory_order_relaxed);
+    }
+    T read() const {
+        T value;
+        uint32_t start, end;
+        do {
+            start = seq.load(std::memory_order_acquire);
+            value = data;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            end = seq.load(std::memory_order_relaxed);
+        } while (start != end || (start & 1));
+        return value;
+    }
+};
+
+/* History */
+// fixed size ring of timestamped samples. single writer, readers never block the writer
+template <typename T, size_t N> class History {
+  public:
+    struct Sample {
+        uint64_t time;
+        T value;
+    };
+
+  private:
+    std::array<Sample, N> samples{};
+    std::atomic<uint32_t> count{0};
+
+    // copies the sample at absolute index i, fails if it was overwritten while reading
+    bool read(uint32_t i, Sample& sample) const {
+        sample = samples[i % N];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return count.load(std::memory_order_relaxed) - i < N;
+    }
+
+  public:
+    void push(uint64_t time, const T& value) {
+        const uint32_t n = count.load(std::memory_order_relaxed);
+        samples[n % N] = {time, value};
+        count.store(n + 1, std::memory_order_release);
+    }
+
+    // finds the samples surrounding time. both are the same sample when time is out of range
+    bool find(uint64_t time, Sample& before, Sample& after) const {
+        const uint32_t n = count.load(std::memory_order_acquire);
+        if (n == 0) return false;
+        const uint32_t oldest = n > N ? n - N + 1 : 0;
+        if (!read(n - 1, after)) return false;
+        before = after;
+        for (uint32_t i = n - 1; i-- > oldest && time < before.time;) {
+            after = before;
+            if (!read(i, before)) return false;
+        }
+        if (time < before.time || time >= after.time) after = before;
+        return true;
+    }
+};
+
+/* SpscQueue */
+// lock-free single producer, single consumer queue
+template <typename T, size_t N> class SpscQueue {
+    std::array<T, N> buffer{};
+    std::atomic<uint32_t> head{0}, tail{0};
+
+  public:
+    bool push(const T& value) {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N) return false;
+        buffer[h % N] = value;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    bool pop(T& value) {
+        const uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;
+        value = buffer[t % N];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    uint32_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+};
+
+/* Tasks */
+// the stack and control block of a task in static storage, so starting it allocates nothing and
+// its RAM is counted when linking. each task needs its own, declared static:
+//   static appa::TaskStack<4096> odom_stack; // words
+//   odom.task_config.storage = &odom_stack;
+struct TaskStorage {
+    static constexpr size_t control_size = 512; // bytes, more than the kernel's control block
+    alignas(8) uint8_t control[control_size];
+    uint32_t* stack = nullptr;
+    uint16_t depth = 0; // words
+    std::function<void()> function;
+    bool used = false; // by a started task, storage isn't reused
+};
+
+template <uint16_t Depth> struct TaskStack : TaskStorage {
+    alignas(8) std::array<uint32_t, Depth> words;
+    TaskStack() {
+        stack = words.data();
+        depth = Depth;
+    }
+};
+
+// priority and stack of a task appa starts, set before whatever starts it
+struct TaskConfig {
+    uint32_t priority = TASK_PRIORITY_DEFAULT;
+    uint16_t stack_depth = TASK_STACK_DEPTH_DEFAULT; // words, storage has its own
+    TaskStorage* storage = nullptr;                  // static instead of allocated
+};
+
+// starts function as a task, in the config's storage when it has unused storage
+pros::Task* start_task(std::function<void()> function, const TaskConfig& config, const char* name);
+
+// stack use of the tasks start_task() started, to size their stack_depth or TaskStack from
+namespace tasks {
+struct Usage {
+    const char* name;
+    uint16_t depth;  // words
+    uint16_t unused; // words, the least left free since the task started
+    bool stored;     // in TaskStorage instead of allocated
+};
+
+int count();
+Usage usage(int index); // in the order they started
+void report();          // prints each task's usage and the heap's
+} // namespace tasks
+
+/* Heap */
+// built with EXTRA_CXXFLAGS=-DAPPA_NO_HEAP, exit functions and routine frames are stored in fixed
+// space and every operator new is counted once the heap is sealed, so anything that still
+// allocates during a match shows up. without it sealing does nothing and nothing is counted
+namespace heap {
+struct Usage {
+    uint32_t allocations = 0; // since seal()
+    size_t bytes = 0;
+    size_t last_size = 0; // bytes, of the latest allocation
+};
+
+void seal(); // at the end of initialize(), once everything is allocated
+bool sealed();
+Usage usage();
+void report(); // prints the usage
+
+size_t in_use(); // bytes allocated from the heap now, by anything
+size_t stacks(); // bytes of it in the stacks of tasks appa started
+} // namespace heap
+
+/* Arena */
+// bump allocator over one block for what a routine allocates, released all at once by reset(). an
+// allocation moves a pointer and freeing one does nothing. it is a memory_resource for std::pmr
+// containers, and built with APPA_ARENA (or APPA_NO_HEAP) every operator new on a task with a Scope
+// open comes from it, so the paths, trajectories and options a routine builds do too. what comes
+// from an arena has to be gone before it is reset, routine locals and not anything kept for later
+class Arena : public std::pmr::memory_resource {
+    std::byte* block;
+    size_t capacity;
+    bool owned;
+    size_t used = 0, peak = 0;
+    std::atomic<uint32_t> overflows{0};
+    void enroll();
+
+  public:
+    explicit Arena(size_t capacity); // bytes, allocated now
+    explicit Arena(std::span<std::byte> storage);
+    ~Arena() override;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void reset(); // frees everything, once nothing from it is in use
+    size_t get_used() const;
+    size_t get_peak() const;        // bytes, the most in use since it was made
+    uint32_t get_overflows() const; // allocations that didn't fit and went to the heap
+    bool owns(const void* memory) const;
+
+    template <typename T, typename... Args> T* make(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // routes the calling task's operator new to the arena until it is destroyed. one task at a
+    // time, a scope opened on another task while one is open is ignored
+    class Scope {
+        bool active;
+
+      public:
+        explicit Scope(Arena& arena);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // used by the replaced operator new and delete
+    static void* allocate_scoped(size_t size);
+    static bool release(void* memory); // false if no arena owns it
+
+  protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* memory, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+/* Fast math */
+// polynomial kernels with bounded error, used by Point and Pose when APPA_FAST_MATH is defined
+// (EXTRA_CXXFLAGS=-DAPPA_FAST_MATH). sin and cos are within 2e-9 and atan2 within 2e-7 rad
+namespace fast {
+void sincos(double x, double& sine, double& cosine);
+double atan2(double y, double x);
+// the same kernels in fixed point, within about 3e-5
+void sincos(Fixed x, Fixed& sine, Fixed& cosine);
+Fixed atan2(Fixed y, Fixed x);
+} // namespace fast
+
 double to_rad(double deg);
 double to_deg(double rad);
+double wrap(double angle); // to (-pi, pi]
 double limit(double val, double limit);
+Point desaturate(const Point& speeds, double max = 100.0);
+
+/* Control math */
+// the core of a move step in double or Fixed, so a fixed point loop does the same math as the
+// double one: the error to a point as distance along the heading and heading error (in, rad)
+template <typename T>
+void point_error(T x, T y, T theta, T target_x, T target_y, T& linear, T& angular) {
+    using std::hypot;
+    const T dx = target_x - x, dy = target_y - y;
+    angular = wrap(fast::atan2(dy, dx) - theta);
+    T sine, cosine;
+    fast::sincos(angular, sine, cosine);
+    linear = hypot(dx, dy) * cosine;
+}
+
+// wheel speeds from linear and angular outputs, scaled together to stay under max like desaturate
+template <typename T> void tank_speeds(T linear, T angular, T& left, T& right, T max = T(100.0)) {
+    using std::fabs;
+    left = linear - angular;
+    right = linear + angular;
+    const T largest = std::max(fabs(left), fabs(right));
+    if (largest > max) {
+        const T scale = max / largest;
+        left *= scale;
+        right *= scale;
+    }
+}
+
+// batch coordinate changes that work out the rotation once, four at a time with neon in single
+// precision. from and to can be the same storage, and only the shorter span's size is written
+// transform moves points or poses given relative to frame into the frame's coordinates, offsetting
+// headings by the frame's without wrapping
+void transform(std::span<const Point> from, std::span<Point> to, const Pose& frame);
+void transform(std::span<const Pose> from, std::span<Pose> to, const Pose& frame);
+void transform(std::span<Point> points, const Pose& frame);
+void transform(std::span<Pose> poses, const Pose& frame);
+// mirror reflects them across the line through a pose along its heading, such as {72, 0, pi / 2}
+// for the other side of the field, and headings become their reflection
+void mirror(std::span<const Point> from, std::span<Point> to, const Pose& line);
+void mirror(std::span<const Pose> from, std::span<Pose> to, const Pose& line);
+void mirror(std::span<Point> points, const Pose& line);
+void mirror(std::span<Pose> poses, const Pose& line);
 
 } // namespace appa
\ No newline at end of file
@@ -0,0 +1,325 @@
+#pragma once
+
+// only depends on the standard library so host tools can decode the same frames
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace appa {
+
+/* Wire */
+// binary telemetry frames: a record, a crc16 after it, cobs encoded and ended by a 0 byte.
+// key frames carry the absolute pose, and delta frames the change from the previous frame in
+// fixed point, so a 100 Hz stream fits a slow link. a receiver that misses a frame waits for the
+// next key frame. the coprocessor messages below share the framing
+namespace wire {
+enum Type : uint8_t {
+    KEY = 1,
+    DELTA = 2,
+    SNAPSHOT = 3,        // brain to coprocessor
+    REQUEST = 4,         // brain to coprocessor
+    CORRECTION = 5,      // coprocessor to brain
+    PATH_CHUNK = 6,      // coprocessor to brain
+    TRAJECTORY_CHUNK = 7 // coprocessor to brain
+};
+
+constexpr double position_scale = 1000;   // delta units per inch
+constexpr double angle_scale = 10000;     // delta units per radian
+constexpr double velocity_scale = 100;    // units per in/s
+constexpr double omega_scale = 1000;      // units per rad/s
+constexpr double error_scale = 100;       // units per inch
+constexpr double angle_error_scale = 1e4; // units per radian
+constexpr int key_interval = 50;          // frames, a key frame every 0.5 s at 100 Hz
+
+// what a frame carries, as sent and as decoded
+struct Sample {
+    uint32_t time = 0;                                // ms
+    double x = 0, y = 0, theta = 0;                   // in, rad
+    double velocity_linear = 0, velocity_angular = 0; // in/s, rad/s
+    double error_linear = 0, error_angular = 0;       // in, rad
+    uint32_t odom_busy = 0, motion_busy = 0;          // us
+    uint32_t odom_overruns = 0, motion_overruns = 0;  // low byte of the counts
+};
+
+struct __attribute__((packed)) Status {
+    int16_t velocity_linear, velocity_angular;
+    int16_t error_linear, error_angular;
+    uint16_t odom_busy, motion_busy;
+    uint8_t odom_overruns, motion_overruns;
+};
+
+struct __attribute__((packed)) KeyFrame {
+    uint8_t type, seq;
+    uint32_t time;
+    float x, y, theta;
+    Status status;
+};
+
+struct __attribute__((packed)) DeltaFrame {
+    uint8_t type, seq;
+    uint8_t dt; // ms since the previous frame
+    int16_t dx, dy, dtheta;
+    Status status;
+};
+
+// longest encoded frame, with the crc, cobs overhead and the delimiter
+constexpr size_t max_frame = sizeof(KeyFrame) + 2 + 2 + 1;
+
+inline uint16_t crc16(const uint8_t* data, size_t size) {
+    static constexpr auto table = [] {
+        std::array<uint16_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint16_t c = i << 8;
+            for (int k = 0; k < 8; k++) c = c & 0x8000 ? (c << 1) ^ 0x1021 : c << 1;
+            table[i] = c;
+        }
+        return table;
+    }();
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < size; i++) crc = (crc << 8) ^ table[((crc >> 8) ^ data[i]) & 0xFF];
+    return crc;
+}
+
+// writes size + 1 bytes for frames under 254 bytes, without the delimiter
+inline size_t cobs_encode(const uint8_t* in, size_t size, uint8_t* out) {
+    size_t code_index = 0, o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < size; i++) {
+        if (in[i] == 0) {
+            out[code_index] = code;
+            code_index = o++;
+            code = 1;
+        } else {
+            out[o++] = in[i];
+            if (++code == 0xFF) {
+                out[code_index] = code;
+                code_index = o++;
+                code = 1;
+            }
+        }
+    }
+    out[code_index] = code;
+    return o;
+}
+
+// 0 when the frame is malformed
+inline size_t cobs_decode(const uint8_t* in, size_t size, uint8_t* out) {
+    size_t i = 0, o = 0;
+    while (i < size) {
+        const uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > size) return 0;
+        for (int k = 1; k < code; k++) out[o++] = in[i++];
+        if (code != 0xFF && i < size) out[o++] = 0;
+    }
+    return o;
+}
+
+inline int16_t fixed(double value, double scale) {
+    return (int16_t)std::clamp(std::lround(value * scale), -32767L, 32767L);
+}
+
+// frames a record with its crc and delimiter into out, at least size + 5 bytes
+inline size_t pack(const uint8_t* record, size_t size, uint8_t* out) {
+    uint8_t framed[256];
+    memcpy(framed, record, size);
+    const uint16_t crc = crc16(record, size);
+    memcpy(framed + size, &crc, 2);
+    const size_t length = cobs_encode(framed, size + 2, out);
+    out[length] = 0;
+    return length + 1;
+}
+
+// gathers the received bytes into records of up to N bytes, resyncing on the next delimiter
+template <size_t N> class Unpacker {
+    uint8_t buffer[N + 4];
+    size_t size = 0;
+    bool overflow = false;
+
+  public:
+    // the record's length without its crc when byte ended a good frame, -1 when it ended a bad one
+    // and 0 otherwise
+    int push(uint8_t byte, uint8_t* record) {
+        if (byte != 0) {
+            if (size < sizeof(buffer)) buffer[size++] = byte;
+            else overflow = true;
+            return 0;
+        }
+        uint8_t decoded[N + 4];
+        const size_t length = overflow ? 0 : cobs_decode(buffer, size, decoded);
+        const bool empty = size == 0;
+        size = 0;
+        overflow = false;
+        if (empty) return 0;
+        uint16_t crc = 0;
+        if (length >= 3 && length - 2 <= N) memcpy(&crc, decoded + length - 2, 2);
+        if (length < 3 || length - 2 > N || crc != crc16(decoded, length - 2)) return -1;
+        memcpy(record, decoded, length - 2);
+        return length - 2;
+    }
+};
+
+// keeps the pose the receiver reconstructed, so deltas never drift from what was sent
+class Encoder {
+    uint8_t seq = 0;
+    int since_key = key_interval;
+    uint32_t time = 0;
+    double x = 0, y = 0, theta = 0;
+
+  public:
+    // writes a whole frame with its delimiter to out, at least max_frame bytes
+    size_t encode(const Sample& sample, uint8_t* out) {
+        const Status status = {fixed(sample.velocity_linear, velocity_scale),
+                               fixed(sample.velocity_angular, omega_scale),
+                               fixed(sample.error_linear, error_scale),
+                               fixed(sample.error_angular, angle_error_scale),
+                               (uint16_t)std::min<uint32_t>(sample.odom_busy, 0xFFFF),
+                               (uint16_t)std::min<uint32_t>(sample.motion_busy, 0xFFFF),
+                               (uint8_t)sample.odom_overruns,
+                               (uint8_t)sample.motion_overruns};
+        const long dx = std::lround((sample.x - x) * position_scale);
+        const long dy = std::lround((sample.y - y) * position_scale);
+        const long dtheta = std::lround((sample.theta - theta) * angle_scale);
+        const uint32_t dt = sample.time - time;
+        const bool fits = labs(dx) < 32767 && labs(dy) < 32767 && labs(dtheta) < 32767 && dt < 256;
+
+        uint8_t record[sizeof(KeyFrame)];
+        size_t size;
+        if (++since_key >= key_interval || !fits) {
+            const KeyFrame frame = {KEY, seq++, sample.time, (float)sample.x, (float)sample.y,
+                                    (float)sample.theta, status};
+            memcpy(record, &frame, size = sizeof(frame));
+            x = frame.x, y = frame.y, theta = frame.theta;
+            since_key = 0;
+        } else {
+            const DeltaFrame frame = {DELTA,       seq++,       (uint8_t)dt,
+                                      (int16_t)dx, (int16_t)dy, (int16_t)dtheta,
+                                      status};
+            memcpy(record, &frame, size = sizeof(frame));
+            x += dx / position_scale, y += dy / position_scale, theta += dtheta / angle_scale;
+        }
+        time = sample.time;
+        return pack(record, size, out);
+    }
+};
+
+// feed it the received bytes, it resyncs on the next delimiter and key frame after an error
+class Decoder {
+    Unpacker<sizeof(KeyFrame)> unpacker;
+    bool synced = false;
+    uint8_t seq = 0;
+    Sample state;
+
+  public:
+    uint32_t errors = 0; // frames that failed to decode or were missed
+
+    // true when byte completed a frame, which is then in sample
+    bool push(uint8_t byte, Sample& sample) {
+        uint8_t record[sizeof(KeyFrame)];
+        const int length = unpacker.push(byte, record);
+        if (length == 0) return false;
+        if (length < 0) {
+            errors++;
+            synced = false;
+            return false;
+        }
+
+        Status status;
+        if (record[0] == KEY && length == sizeof(KeyFrame)) {
+            KeyFrame frame;
+            memcpy(&frame, record, sizeof(frame));
+            state.time = frame.time;
+            state.x = frame.x, state.y = frame.y, state.theta = frame.theta;
+            status = frame.status;
+            synced = true;
+            seq = frame.seq;
+        } else if (record[0] == DELTA && length == sizeof(DeltaFrame)) {
+            DeltaFrame frame;
+            memcpy(&frame, record, sizeof(frame));
+            if (!synced || frame.seq != (uint8_t)(seq + 1)) {
+                if (synced) errors++;
+                synced = false; // the pose this is relative to was missed
+                return false;
+            }
+            state.time += frame.dt;
+            state.x += frame.dx / position_scale;
+            state.y += frame.dy / position_scale;
+            state.theta += frame.dtheta / angle_scale;
+            status = frame.status;
+            seq = frame.seq;
+        } else {
+            errors++;
+            return false;
+        }
+        state.velocity_linear = status.velocity_linear / velocity_scale;
+        state.velocity_angular = status.velocity_angular / omega_scale;
+        state.error_linear = status.error_linear / error_scale;
+        state.error_angular = status.error_angular / angle_error_scale;
+        state.odom_busy = status.odom_busy;
+        state.motion_busy = status.motion_busy;
+        state.odom_overruns = status.odom_overruns;
+        state.motion_overruns = status.motion_overruns;
+        sample = state;
+        return true;
+    }
+};
+
+/* Coprocessor */
+// messages between the brain and a coprocessor such as a raspberry pi, in the same frames. the
+// brain sends a snapshot every period and a request when it wants a route, and the coprocessor
+// answers with corrections of where the robot was at a snapshot's time and with routes split into
+// chunks sent in order. every message starts with its type. floats are little endian like the
+// brain's
+constexpr int snapshot_ranges = 4; // distance sensors in a snapshot
+constexpr int chunk_points = 24;    // path points in a chunk
+constexpr int chunk_samples = 8;    // trajectory samples in a chunk
+
+struct __attribute__((packed)) SnapshotFrame {
+    uint8_t type, seq;
+    uint32_t time;                           // ms on the brain's clock
+    float x, y, theta;                       // in, rad
+    float velocity_linear, velocity_angular; // in/s forward, rad/s counterclockwise
+    float ticks_x, ticks_y;                  // raw tracker ticks, nan without such trackers
+    uint16_t ranges[snapshot_ranges];        // mm each distance sensor reads, 9999 for nothing
+};
+
+// asks for a route, answered with chunks of the kind asked for and the same id
+struct __attribute__((packed)) RequestFrame {
+    uint8_t type, kind; // PATH_CHUNK or TRAJECTORY_CHUNK
+    uint16_t id;
+    float start_x, start_y, start_theta; // in, rad
+    float goal_x, goal_y, goal_theta;    // nan for any heading
+};
+
+// the pose at the time of the snapshot it was worked out from, nan keeps that part
+struct __attribute__((packed)) CorrectionFrame {
+    uint8_t type;
+    uint32_t time; // ms, the snapshot's
+    float x, y, theta;
+};
+
+// a route of total points or samples, this chunk with count of them from first. a route with
+// none is one chunk with a total of 0, for no route
+struct __attribute__((packed)) ChunkHeader {
+    uint8_t type;
+    uint16_t id, first, total;
+    uint8_t count;
+};
+struct __attribute__((packed)) PathChunk {
+    ChunkHeader header;
+    float points[chunk_points][2]; // in, x and y, only count of them sent
+};
+struct __attribute__((packed)) TrajectoryChunk {
+    ChunkHeader header;
+    float samples[chunk_samples][6]; // s, in, in, rad, in/s, rad/s, only count of them sent
+};
+
+// longest coprocessor message, and its frame with the crc, cobs overhead and the delimiter
+constexpr size_t max_message = std::max({sizeof(SnapshotFrame), sizeof(RequestFrame),
+                                         sizeof(CorrectionFrame), sizeof(PathChunk),
+                                         sizeof(TrajectoryChunk)});
+constexpr size_t max_message_frame = max_message + 2 + 2 + 1;
+} // namespace wire
+
+} // namespace appa
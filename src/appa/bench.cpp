@@ -0,0 +1,171 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Bench */
+namespace bench {
+
+// results are stored here so the ops being timed aren't optimized out
+static volatile double sink;
+
+template <typename F>
+static Result measure(const char* name, int iterations, double mhz, Clock clock, double overhead,
+                      F op) {
+    const uint64_t start = clock();
+    for (int i = 0; i < iterations; i++) sink = op(i);
+    const double ns = std::max((clock() - start) * 1000.0 / iterations - overhead, 0.0);
+    return {name, ns, ns * mhz / 1000};
+}
+
+// runs a fixed point op against its double version from the same state, untimed
+template <typename D, typename F> static double deviation(int iterations, D reference, F op) {
+    double largest = 0.0;
+    for (int i = 0; i < iterations; i++) largest = std::max(largest, fabs(op(i) - reference(i)));
+    return largest;
+}
+
+std::vector<Result> run(int iterations, double mhz, Clock clock) {
+    iterations = std::max(iterations, 1);
+    const double overhead =
+        measure("loop", iterations, mhz, clock, 0.0, [](int i) { return (double)i; }).ns;
+    std::vector<Result> results;
+    auto add = [&](const char* name, auto op) {
+        results.push_back(measure(name, iterations, mhz, clock, overhead, op));
+    };
+
+    add("Point::rotate", [](int i) { return Point{i * 0.01, 1.0}.rotate(i * 1e-3).x; });
+    add("Pose::angle", [](int i) { return Pose{0.0, 0.0, i * 1e-3}.angle({24.0, i * 0.01}); });
+    add("std::remainder", [](int i) { return std::remainder(i * 0.01, 2 * M_PI); });
+    add("wrap", [](int i) { return wrap((i & 1023) * 0.01 - 5); });
+    add("sin + cos", [](int i) { return sin(i * 1e-3) + cos(i * 1e-3); });
+    add("fast::sincos", [](int i) {
+        double sine, cosine;
+        fast::sincos(i * 1e-3, sine, cosine);
+        return sine + cosine;
+    });
+    add("atan2", [](int i) { return atan2(i * 0.01, 24.0); });
+    add("fast::atan2", [](int i) { return fast::atan2(i * 0.01, 24.0); });
+
+    // the integral bounded, as a q16.16 one saturates near 32768 while a double one keeps growing
+    const Gains gains = {.p = 10, .i = 0.5, .d = 2, .i_max = 50};
+    PID pid(gains);
+    add("PID::update", [&](int i) { return pid.update(10 - (i % 100) * 0.1, 10); });
+    PID filtered(
+        Gains{.p = 10, .i = 0.5, .d = 2, .i_zone = 3, .filter = 0.5, .on_measurement = true});
+    add("PID::update filtered", [&](int i) {
+        return filtered.update(10 - (i % 100) * 0.1, 10, (i % 100) * 0.1);
+    });
+    FixedPID fixed_pid(gains);
+    add("FixedPID::update", [&](int i) {
+        return (double)fixed_pid.update(Fixed(10 - (i % 100) * 0.1), Fixed(10.0));
+    });
+    pid.reset(), fixed_pid.reset();
+    results.back().tolerance = 0.1; // % of output, the pid alone rounds only its products
+    results.back().deviation = deviation(
+        iterations, [&](int i) { return pid.update(10 - (i % 100) * 0.1, 10); },
+        [&](int i) { return (double)fixed_pid.update(Fixed(10 - (i % 100) * 0.1), Fixed(10.0)); });
+    const ScheduledGains scheduled(ScheduledGains::BY_ERROR, {{2, {8, 0, 30}}, {24, {4, 0, 10}}});
+    add("ScheduledGains::get", [&](int i) { return scheduled.get(i % 32).p; });
+
+    const Options preset = {.speed = 80, .accel = 200, .exit = 1, .settle = 100, .thru = true};
+    add("Options <<", [&](int i) { return *(preset << Options{.speed = (double)(i & 63)}).speed; });
+    const PackedOptions packed(preset);
+    add("PackedOptions <<", [&](int i) {
+        PackedOptions other;
+        other.speed = i & 63;
+        other.fields = 1ull << PackedOptions::SPEED;
+        return (packed << other).speed;
+    });
+
+    Ema<> ema(0.3);
+    add("Ema::update", [&](int i) { return ema.update((i % 100) * 0.1); });
+    MovingMedian<5> median;
+    add("MovingMedian<5>::update", [&](int i) { return median.update((i * 37 % 100) * 0.1); });
+    Kalman1D kalman(0.01, 1.0);
+    add("Kalman1D::update", [&](int i) { return kalman.update((i % 100) * 0.1); });
+    Derivative<4> derivative;
+    add("Derivative<4>::update",
+        [&](int i) { return derivative.update((i % 100) * 0.1, (uint64_t)i * 10000); });
+
+    Seqlock<Pose> pose_store;
+    add("Seqlock read", [&](int i) {
+        if (!(i & 15)) pose_store.write({i * 0.01, 0.0, 0.0});
+        return pose_store.read().x;
+    });
+
+    std::array<Pose, 64> poses;
+    poses.fill({1.0, 2.0, 0.5});
+    add("transform 64 poses", [&](int i) {
+        transform(poses, {i & 1 ? 1e-3 : -1e-3, 0.0, 0.0});
+        return poses[i & 63].x;
+    });
+
+    // the math of a boomerang move step, without the sensor reads and motor writes
+    PID lin_pid(Gains{10, 0, 1}), ang_pid(Gains{60, 0, 4});
+    Slew left_slew(200, 400), right_slew(200, 400);
+    const Pose target = {24.0, 24.0, M_PI_2};
+    add("control step", [&](int i) {
+        const Pose pose = {i * 1e-3, i * 5e-4, i * 1e-5};
+        const double distance = pose.dist(target);
+        const Point carrot = target.project(-0.5 * distance);
+        const double heading = pose.angle(carrot);
+        const double lin = lin_pid.update(distance * cos(heading), 10);
+        const double ang = ang_pid.update(wrap(heading), 10);
+        const Point speeds = desaturate({lin - ang, lin + ang});
+        return left_slew.update(speeds.left, 10) + right_slew.update(speeds.right, 10);
+    });
+
+    // the core of a move step to a point in double and in fixed point, the same math either way
+    auto core = [](auto& lin, auto& ang, int i) {
+        using T = std::decay_t<decltype(lin.update(0.0, 0.0))>;
+        T linear, angular, left, right;
+        point_error<T>(T(i % 4096 * 5e-3), T(i % 2048 * 2e-3), T(i % 1024 * 3e-3 - 1.5), T(24.0),
+                       T(24.0), linear, angular);
+        tank_speeds<T>(lin.update(linear, T(10.0)), ang.update(angular, T(10.0)), left, right);
+        return (double)left - (double)right;
+    };
+    PID core_lin(Gains{10, 0, 1}), core_ang(Gains{60, 0, 4});
+    FixedPID fixed_lin(Gains{10, 0, 1}), fixed_ang(Gains{60, 0, 4});
+    add("control step core", [&](int i) { return core(core_lin, core_ang, i); });
+    add("control step fixed", [&](int i) { return core(fixed_lin, fixed_ang, i); });
+    core_lin.reset(), core_ang.reset(), fixed_lin.reset(), fixed_ang.reset();
+    results.back().tolerance = 0.5; // the trig approximations add to it
+    results.back().deviation =
+        deviation(iterations, [&](int i) { return core(core_lin, core_ang, i); },
+                  [&](int i) { return core(fixed_lin, fixed_ang, i); });
+    return results;
+}
+
+void print(const std::vector<Result>& results) {
+    for (const Result& result : results) {
+        printf("%-22s %8.1f ns %8.1f cycles", result.name, result.ns, result.cycles);
+        if (!std::isnan(result.deviation)) {
+            const bool ok = !(result.deviation > result.tolerance);
+            printf(" %10.2g from double, %s within %g", result.deviation, ok ? "ok" : "FAILED",
+                   result.tolerance);
+        }
+        printf("\n");
+    }
+}
+
+// measured in place by the odom and motion loops, see Odom::get_timing and Chassis::get_timing
+void print(const char* name, const LoopTiming& timing) {
+    printf("%-22s busy %u us (max %u) of a %u us period (max %u, jitter %u), %u overruns, "
+           "%.1f%% load over %u iterations\n",
+           name, (unsigned)timing.busy, (unsigned)timing.max_busy, (unsigned)timing.period,
+           (unsigned)timing.max_period, (unsigned)timing.max_jitter, (unsigned)timing.overruns,
+           timing.load() * 100, (unsigned)timing.count);
+    printf("%-22s %8s %8s\n", "  % of nominal", "period", "busy");
+    for (int i = 0; i < LoopTiming::buckets; i++) {
+        char range[16];
+        if (i < LoopTiming::buckets - 1)
+            snprintf(range, sizeof(range), "%d-%d", i * 25, i * 25 + 25);
+        else snprintf(range, sizeof(range), "%d+", i * 25);
+        printf("  %-20s %8u %8u\n", range, (unsigned)timing.period_histogram[i],
+               (unsigned)timing.busy_histogram[i]);
+    }
+}
+
+} // namespace bench
+
+} // namespace appa
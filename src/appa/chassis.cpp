@@ -1,309 +1,3742 @@
 #include "appa.h"
+#if defined(__ARM_NEON) && defined(APPA_SINGLE_PRECISION)
+#include <arm_neon.h>
+#define APPA_NEON
+#endif
 
 namespace appa {
 
 /* Chassis */
 Chassis::Chassis(const std::initializer_list<int8_t>& left_motors,
-                 const std::initializer_list<int8_t>& right_motors, Odom& odom,
+                 const std::initializer_list<int8_t>& right_motors, OdomBase& odom,
                  const MoveConfig& move_config, const TurnConfig& turn_config,
-                 const Options& default_options)
-    : left_motors(left_motors), right_motors(right_motors), odom(odom) {
-
-    df_move = Options::defaults() << default_options << move_config.options();
-    df_turn = Options::defaults() << default_options << turn_config.options();
+                 const Options& default_options, int period)
+    : left_motors(left_motors),
+      right_motors(right_motors),
+      odom(odom),
+      slip_channel([](const Record& r) {
+          printf("slip: wheels %6.2f odom %6.2f in/s, slip %6.2f in/s %7.2f deg/s\n", r.values[0],
+                 r.values[1], r.values[2], r.values[3]);
+      }),
+      disturbance_channel([](const Record& r) {
+          printf("disturbance: %6.1f %% linear %6.1f %% angular\n", r.values[0], r.values[1]);
+      }) {
+    df_options = Options::defaults() << Options{.period = period} << default_options;
+    df_exit_fn = default_options.exit_fn;
+    set_config(move_config, turn_config);
 }
 
-Chassis::~Chassis() { stop(true); }
+// such as after load_tuning(), while no motion is running
+void Chassis::set_config(const MoveConfig& move_config, const TurnConfig& turn_config) {
+    kinematics = move_config.kinematics;
+    track_width = move_config.track_width;
+    move_velocity = move_config.velocity;
+    turn_velocity = turn_config.velocity;
+    min_lookahead = move_config.min_lookahead;
+    max_lookahead = move_config.max_lookahead;
+    move_ks = move_config.ks;
+    turn_ks = turn_config.ks;
+    move_ff = move_config.feedforward;
+    turn_ff = turn_config.feedforward;
+    // the lqr's gains at each control period a turn can run at, so a step only looks them up
+    lqr_turns = turn_config.lqr.error > 0;
+    if (lqr_turns && (turn_ff.v <= 0 || turn_ff.a <= 0)) {
+        printf("turn config: lqr needs the feedforward's v and a, turns use ang_PID\n");
+        lqr_turns = false;
+    }
+    for (int i = 0; i < turn_lqr.size(); i++) {
+        turn_lqr[i] = lqr_turns ? solve_lqr(turn_ff, turn_config.lqr, (i + 1) / 1000.0)
+                                : LqrGains{};
+    }
+
+    // the drive model gives the physical limits unless they were measured
+    if (kinematics) {
+        if (track_width <= 0) track_width = kinematics.track_width;
+        if (move_velocity <= 0) move_velocity = kinematics.max_speed();
+        if (turn_velocity <= 0) turn_velocity = to_deg(2 * kinematics.max_speed() / track_width);
+    }
+
+    df_move = df_options << move_config.options();
+    df_turn = df_options << turn_config.options();
+}
 
-void Chassis::wait() {
+Chassis::~Chassis() {
+    stop(true);
     if (chassis_task) {
-        chassis_task->join();
         chassis_task->remove();
         delete chassis_task;
     }
+    if (battery_task) {
+        battery_task->remove();
+        delete battery_task;
+    }
+    if (actuator_task) {
+        actuator_task->remove();
+        delete actuator_task;
+    }
+    if (derate_task) {
+        derate_task->remove();
+        delete derate_task;
+    }
+    if (health_task) {
+        health_task->remove();
+        delete health_task;
+    }
 }
 
-void Chassis::motion_task(Pose target, const Options options, const Motion motion) {
-    // set up variables
-    const int dt = 10; // ms
+// persistent worker that runs queued motions back to back
+void Chassis::task() {
+    Command next;
+    while (true) {
+        pros::c::task_notify_take(true, TIMEOUT_MAX);
+        while (pop(next)) {
+            run(next);
+            motions.fetch_sub(1);
+        }
+    }
+}
 
-    Direction dir = options.dir.value();
-    const bool auto_dir = dir == AUTO;
-    const Direction turn_dir = options.turn.value();
-    const double max_speed = options.speed.value();
-    const double accel_step = options.accel.value() * dt / 1000;
-    const double lead = options.lead.value();
-    const double lookahead = options.lookahead.value();
-    const double exit = options.exit.value();
-    const double offset = options.offset.value();
-    const int settle = options.settle.value();
-    const int timeout = options.timeout.value();
-    PID lin_PID(options.lin_PID.value());
-    PID ang_PID(options.ang_PID.value());
-    const bool thru = options.thru.value();
-    const bool relative = options.relative.value();
-    const std::function<bool()> exit_fn = options.exit_fn;
-
-    Pose pose = odom.get();
-    Point error, carrot, speeds;
-    double lin_speed, ang_speed;
+void Chassis::push(const Command& command) {
+    // wait for room in the queue
+    while (true) {
+        chassis_mutex.take();
+        if (queue_size < queue_capacity) break;
+        chassis_mutex.give();
+        pros::delay(5);
+    }
+    Command& slot = queue[(queue_head + queue_size++) % queue_capacity];
+    slot = command;
+    slot.token = cancel_token.load();
+    motions.fetch_add(1);
+    chassis_mutex.give();
+    chassis_task->notify();
+}
 
-    // convert to radians
-    if (!std::isnan(target.theta)) target.theta = to_rad(target.theta);
+bool Chassis::pop(Command& command) {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    if (queue_size == 0) return false;
+    command = queue[queue_head];
+    queue_head = (queue_head + 1) % queue_capacity;
+    --queue_size;
+    return true;
+}
 
-    // relative motion
-    if (relative)
-        target = Pose{pose.p() + target.p().rotate(pose.theta), target.theta + pose.theta};
+int Chassis::queued() {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    return queue_size;
+}
 
-    // timing
-    uint32_t start_time, now;
-    start_time = now = pros::millis();
-    int settle_time = 0;
-    bool running = true;
-    bool settling = false;
+// the field target of the next queued motion when it's a move to an absolute point
+std::optional<Point> Chassis::next_point() {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    if (queue_size == 0) return std::nullopt;
+    const Command& command = queue[queue_head];
+    if (command.motion != MOVE || command.options.flag(PackedOptions::RELATIVE) ||
+        !std::isnan(command.target.theta) || command.token != cancel_token.load())
+        return std::nullopt;
+    return command.target.p();
+}
 
-    // control loop
-    while (running && is_running.load()) {
-        // find error and direction based on motion type
-        pose = odom.get();
-        switch (motion) {
-        case MOVE:
-            // error
-            error = {pose.dist(target), pose.angle(target)};
-            if (!std::isnan(target.theta)) { // move to pose
-                carrot = target.project(-error.linear * lead);
-                // carrot = (pose - target).p().rotate(-target.theta); // maybe better boomerang?
-                // carrot = target.project(-fabs(carrot.y) - error.linear * lead);
-                error.angular = pose.angle(carrot);
-            }
-            error.linear -= offset;
-            // direction
-            if (auto_dir) dir = fabs(error.angular) > M_PI_2 ? REVERSE : FORWARD;
-            if (dir == REVERSE) {
-                error.angular += error.angular > 0 ? -M_PI : M_PI;
-                error.linear *= -1;
-            }
-            break;
-        case PATH: {
-            // error
-            carrot = (target.p() - pose.p()).rotate(-target.theta);
-            double dist = carrot.x + lookahead - fabs(carrot.y) / 2; // circle approximation
-            if (dist > 0) running = false; // exit when carrot reaches waypoint
-            carrot = target.project(dist);
-            error = {pose.dist(target) + path_length - offset, pose.angle(carrot)};
-            // direction
-            if (dir == REVERSE) {
-                error.angular += error.angular > 0 ? -M_PI : M_PI;
-                error.linear *= -1;
-            }
+// a copy of the queued motion that runs next, for looking ahead
+std::optional<Chassis::Command> Chassis::next_command() {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    if (queue_size == 0 || queue[queue_head].token != cancel_token.load()) return std::nullopt;
+    return queue[queue_head];
+}
+
+// waits until no more than remaining async motions are running or queued
+// result of the last motion to finish
+Chassis::MotionResult Chassis::wait(int remaining) {
+    while (motions.load() > remaining) {
+        pros::delay(5);
+    }
+    return last_result.read();
+}
+
+// runs or notifies every marker up to a distance along the path being followed
+void Chassis::fire_markers(double distance) {
+    const std::vector<Marker>& markers = marker_path->get_markers();
+    while (marker_index < markers.size() && markers[marker_index].distance <= distance) {
+        const Marker& marker = markers[marker_index++];
+        if (marker.callback) marker.callback();
+        if (marker.task) pros::c::task_notify(marker.task);
+    }
+}
+
+// progress of the latest motion, published each control step
+Chassis::Progress Chassis::get_progress() { return motion_progress.read(); }
+
+// ended once a later command has run, or this one stopped running, or nothing is left to run it
+bool Chassis::finished(uint32_t id) {
+    const Progress progress = motion_progress.read();
+    return progress.id > id || (progress.id == id && !progress.running) || motions.load() == 0;
+}
+
+Chassis::MotionResult Chassis::get_result() { return last_result.read(); }
+LoopTiming Chassis::get_timing() { return motion_timing.read(); }
+
+void Chassis::publish_progress(const Progress& progress) {
+    motion_progress.write(progress);
+    for (auto& waiter : progress_waiters) {
+        pros::task_t handle = waiter.load();
+        if (handle) pros::c::task_notify(handle);
+    }
+}
+
+// blocks on progress notifications for the latest issued command, false if it ended first
+bool Chassis::wait_for(bool (*reached)(const Progress&, double), double value) {
+    const uint32_t id = issued.load();
+    const pros::task_t current = pros::c::task_get_current();
+    bool registered = false;
+    for (auto& waiter : progress_waiters) {
+        pros::task_t empty = nullptr;
+        if (waiter.compare_exchange_strong(empty, current)) {
+            registered = true;
             break;
         }
-        case TURN:
-            // error
-            if (std::isnan(target.theta)) error = {0.0, pose.angle(target)}; // turn to point
-            else
-                error = {0.0,
-                         std::remainder(target.theta - pose.theta, 2 * M_PI)}; // turn to heading
-            // direction
-            if (dir == REVERSE) error.angular += error.angular > 0 ? -M_PI : M_PI;
-            if (turn_dir == CW && error.angular < 0) error.angular += 2 * M_PI;
-            else if (turn_dir == CCW && error.angular > 0) error.angular -= 2 * M_PI;
-            break;
-        default:
-            running = false;
+    }
+
+    bool result = false;
+    while (true) {
+        const Progress progress = motion_progress.read();
+        if (progress.id > id) result = true; // finished and a later command started
+        else if (progress.id == id && reached(progress, value)) result = true;
+        else if (progress.id == id && !progress.running) result = progress.percent >= 100;
+        else if (motions.load() == 0 && active.load() == 0) result = false; // never ran
+        else {
+            pros::c::task_notify_take(true, registered ? 50 : 5);
             continue;
         }
+        break;
+    }
+
+    if (registered) {
+        for (auto& waiter : progress_waiters) {
+            pros::task_t expected = current;
+            waiter.compare_exchange_strong(expected, nullptr);
+        }
+    }
+    return result;
+}
+
+bool Chassis::wait_until(double percent) {
+    return wait_for([](const Progress& p, double v) { return p.percent >= v; }, percent);
+}
+bool Chassis::wait_until_distance(double distance) {
+    return wait_for([](const Progress& p, double v) { return p.running && p.remaining <= v; },
+                    distance);
+}
+
+// drops queued motions, the running motion continues
+void Chassis::clear() {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    motions.fetch_sub(queue_size);
+    queue_size = 0;
+}
+
+// stops the running motion at its next control step and waits for it to acknowledge
+void Chassis::cancel() {
+    // commands issued before this, queued or already popped, are now stale
+    chassis_mutex.take();
+    motions.fetch_sub(queue_size);
+    queue_size = 0;
+    cancel_token.fetch_add(1);
+    chassis_mutex.give();
+
+    // a motion cancelling itself can't wait for itself
+    const pros::task_t current = pros::c::task_get_current();
+    if (active_task.load() == current) return;
+
+    // running motions exit within a control period and notify on the way out
+    cancel_waiter.store(current);
+    while (active.load() > 0) {
+        pros::c::task_notify_take(true, 5);
+    }
+    cancel_waiter.store(nullptr);
+}
+
+/* Motion controllers */
+// the step the shared loop is on, as its controller sees it
+struct Chassis::Step {
+    Pose target;             // moved by relative motions and sightings
+    Pose pose;               // where the robot is, or will be once the command takes effect
+    Point measured;          // forward travel and unwrapped heading since the start
+    double loop_dt = 0.0;    // ms
+    uint32_t start_time = 0; // ms
+    double max_speed = 0.0;  // %, derated
+    double total = 0.0;      // progress of the whole motion
+    bool profiled = false;   // the pids track a profile setpoint, with its own feedforward
+    bool handoff = false;    // set by a controller to end the loop after this step
+};
+
+// the error of one kind of motion and how its pid outputs become speeds. the loop around it does
+// the timing, profile, slew, exits, telemetry and writing the motors
+class Chassis::MotionController {
+  protected:
+    Chassis& chassis;
+    const PackedOptions& options;
+
+  public:
+    enum Axis { NONE, LINEAR, ANGULAR }; // what a profile drives
+
+    MotionController(Chassis& chassis, const PackedOptions& options)
+        : chassis(chassis), options(options) {}
+    virtual ~MotionController() = default;
+
+    // in and rad left, in the direction the robot drives
+    virtual Point error(Step& step) = 0;
+    // speeds from the pid outputs, with the profile feedforward added (%)
+    virtual void output(const Step& step, const Point& error, double& lin, double& ang) {}
+    virtual Point wheels(double lin, double ang, double max_speed) const {
+        return {lin - ang, lin + ang};
+    }
 
-        // calculate PID
-        lin_speed = lin_PID.update(error.linear, dt);
-        ang_speed = ang_PID.update(error.angular, dt);
-        if (thru && motion == MOVE) lin_speed = lin_speed > 0 ? max_speed : -max_speed;
-        else if (thru && motion == TURN) ang_speed = ang_speed > 0 ? max_speed : -max_speed;
+    virtual Axis profiles() const { return NONE; }
+    virtual bool angular() const { return false; }                 // settles on the heading
+    virtual bool finished(const Step& step) const { return true; } // can settle yet
+    // drives on into the next motion, the final move of a follow, so it never predicts its stop
+    virtual bool hands_off() const { return false; }
+    virtual double percent(const Step& step, double remaining) const {
+        return step.total > 0 ? std::clamp(100 * (1 - remaining / step.total), 0.0, 100.0) : 0.0;
+    }
+    virtual double marker_distance(double remaining) const {
+        return chassis.progress_total - remaining;
+    }
+    virtual int segment() const { return chassis.progress_segment; }
+};
+
+// static friction, the last few % of the pid don't move the robot, so outside the exit the
+// command is at least ks. profiles have their own in the feedforward
+static void overcome(double& speed, double ks) {
+    if (speed != 0 && fabs(speed) < ks) speed = std::copysign(ks, speed);
+}
 
-        // apply limits
-        lin_speed = limit(lin_speed, max_speed);
-        ang_speed = limit(ang_speed, max_speed);
+// the point a move to pose drives at, behind the target by lead of the distance. with a close
+// radius it also moves back by how far the robot is off the line into the target, so it lines up
+// before it gets there, though never further back than the robot
+static Point boomerang(const Point& position, const Pose& target, double lead, double close) {
+    const double distance = position.dist(target.p());
+    if (close <= 0) return target.project(-distance * lead);
+    const double lateral = fabs((position - target.p()).rotate(-target.theta).y);
+    return target.project(-std::min(lateral + distance * lead, distance));
+}
+
+// to a point, or a pose through the boomerang carrot
+class Chassis::MoveController : public MotionController {
+    Direction dir;
+    Direction preferred;       // chosen by set_direction(), until the nearest way agrees
+    double curvature = 0.0;    // of the arc to the carrot, for the drift limit
+    bool closing = false;      // inside the close radius of a move to pose, latched
+    double along = 1.0;        // cosine of the heading off the target's, while closing
+    Point approach;            // unit direction from the start to the target
+    std::optional<Point> next; // target of the queued move a thru move blends into
+
+  public:
+    static bool runs(Motion motion, const PackedOptions&) { return motion == MOVE; }
+    MoveController(Chassis& chassis, const PackedOptions& options, const Step& step, Motion)
+        : MotionController(chassis, options), dir(options.dir), preferred(chassis.preferred_dir) {
+        const Point to = step.target.p() - step.pose.p();
+        const double length = hypot(to.x, to.y);
+        approach = length > 0 ? to * (1 / length) : Point{0.0, 0.0};
+    }
 
-        // calculate motor speeds
-        speeds = {lin_speed - ang_speed, lin_speed + ang_speed};
+    Axis profiles() const override { return LINEAR; }
 
-        // scale motor speeds
-        if (speeds.left > 100) {
-            speeds.right *= 100 / speeds.left;
-            speeds.left = 100;
+    Point error(Step& step) override {
+        const Pose& pose = step.pose;
+        const Pose& target = step.target;
+        Point error = {pose.dist(target), pose.angle(target)};
+        Point carrot = target.p();
+        const bool to_pose = !std::isnan(target.theta);
+        if (to_pose && options.close > 0 && (closing || error.linear < options.close)) {
+            // close in, hold the final heading and drive the distance left along it, so passing
+            // the target backs up instead of spinning around to chase it
+            closing = true;
+            const Point axis = Point{1.0, 0.0}.rotate(target.theta);
+            const Point left = target.p() - pose.p();
+            along = cos(pose.theta - target.theta);
+            const double heading = dir == REVERSE ? target.theta + M_PI : target.theta;
+            curvature = 0.0;
+            return {left.x * axis.x + left.y * axis.y - options.offset,
+                    wrap(heading - pose.theta)};
         }
-        if (speeds.right > 100) {
-            speeds.left *= 100 / speeds.right;
-            speeds.right = 100;
+        if (to_pose) { // move to pose
+            carrot = boomerang(pose.p(), target, options.lead, options.close);
+            error.angular = pose.angle(carrot);
+        } else if (options.blend > 0 && options.flag(PackedOptions::THRU) &&
+                   error.linear < options.blend) {
+            // within blend of the corner, slide the carrot onto the next move's line so the
+            // heading turns into it, and hand off once past the corner's bisector
+            if (!next) next = chassis.next_point();
+            const Point out = next ? *next - target.p() : Point{0.0, 0.0};
+            const double length = hypot(out.x, out.y);
+            if (length > 0) {
+                const Point unit = out * (1 / length);
+                carrot = target.p() + unit * std::min(options.blend - error.linear, length);
+                error.angular = pose.angle(carrot);
+                const Point from = pose.p() - target.p(), normal = unit - approach;
+                if (from.x * normal.x + from.y * normal.y >= 0) step.handoff = true;
+            }
+        }
+        error.linear -= options.offset;
+        // curvature of the arc to the carrot, for the drift limit
+        const Point arc = (carrot - pose.p()).rotate(-pose.theta);
+        const double arc_dist = arc.x * arc.x + arc.y * arc.y;
+        curvature = arc_dist > 0 ? 2 * arc.y / arc_dist : 0.0;
+        // direction
+        if (options.dir == AUTO) {
+            dir = fabs(error.angular) > M_PI_2 ? REVERSE : FORWARD;
+            if (preferred == dir) preferred = AUTO;
+            else if (preferred != AUTO) dir = preferred;
+        }
+        if (dir == REVERSE) {
+            error.angular += error.angular > 0 ? -M_PI : M_PI;
+            error.linear *= -1;
         }
+        return error;
+    }
 
-        // limit acceleration
-        if (accel_step) {
-            chassis_mutex.take();
-            if (speeds.left - prev_speeds.left > accel_step)
-                speeds.left = prev_speeds.left + accel_step;
-            if (speeds.right - prev_speeds.right > accel_step)
-                speeds.right = prev_speeds.right + accel_step;
-            chassis_mutex.give();
+    void output(const Step& step, const Point& error, double& lin, double& ang) override {
+        if (closing) lin *= along; // the part of its speed along the target's heading
+        const double velocity = chassis.move_velocity;
+        if (options.drift > 0 && velocity > 0 && curvature != 0) {
+            // no faster than the sideways acceleration the wheels hold on the arc to the carrot
+            lin = limit(lin, sqrt(options.drift / fabs(curvature)) / velocity * 100);
         }
+        if (options.flag(PackedOptions::THRU)) lin = lin > 0 ? step.max_speed : -step.max_speed;
+        else if (!step.profiled && fabs(error.linear) > options.exit)
+            overcome(lin, chassis.move_ks);
+    }
+};
 
-        // set motor speeds
-        tank(speeds);
+// a relative straight move, holding the heading it started on and driving the distance left along
+// it, so the heading doesn't swing around as the robot nears the target or gets pushed off line
+class Chassis::StraightController : public MotionController {
+    const Pose start;
+    double sign = 1.0; // -1 backwards
 
-        // check exit conditions
-        //   timeout
-        if (timeout > 0 && pros::millis() - start_time > timeout) running = false;
-        //   exit error
-        if (motion == TURN) settling = fabs(error.angular) < to_rad(exit);
-        else settling = fabs(error.linear) < exit;
-        //   settling
-        if (settling) {
-            settle_time += dt;
-            if (settle_time >= settle) running = false;
-        } else settle_time = 0;
-        //   custom lambda
-        if (exit_fn && exit_fn()) running = false;
+  public:
+    static bool runs(Motion motion, const PackedOptions&) { return motion == STRAIGHT; }
+    StraightController(Chassis& chassis, const PackedOptions& options, const Step& step, Motion)
+        : MotionController(chassis, options), start(step.pose) {
+        if (along(step.target.p()) < 0) sign = -1.0;
+    }
 
-        // delay task
-        pros::c::task_delay_until(&now, dt);
+    // distance from the start along its heading
+    double along(const Point& point) const {
+        const Point from = point - start.p();
+        return from.x * cos(start.theta) + from.y * sin(start.theta);
     }
-    if (!thru && !(motion == PATH)) stop(false);
-}
 
-void Chassis::motion_handler(const std::vector<Pose>& target, const Options& options,
-                             const Motion& motion) {
-    // stop task if chassis is already moving
-    if (chassis_task) {
-        chassis_task->remove();
-        delete chassis_task;
+    Axis profiles() const override { return LINEAR; }
+
+    Point error(Step& step) override {
+        return {along(step.target.p()) - along(step.pose.p()) - sign * options.offset,
+                wrap(start.theta - step.pose.theta)};
     }
 
-    // determine movement lambda
-    std::function<void()> movement;
-    if (motion == PATH) {
-        movement = [this, path = target, options] {
-            is_running.store(true);
-            for (int i = 0; i < path.size() - 1; ++i) {
-                motion_task(path[i], options, PATH);
-                path_length -= path[i].dist(path[i + 1]);
-            }
-            motion_task(path[path.size() - 1], options, MOVE);
-            is_running.store(false);
-        };
-    } else {
-        movement = [this, target, options, motion] {
-            is_running.store(true);
-            motion_task(target[0], options, motion);
-            is_running.store(false);
+    void output(const Step& step, const Point& error, double& lin, double& ang) override {
+        if (options.flag(PackedOptions::THRU)) lin = sign * step.max_speed;
+        else if (!step.profiled && fabs(error.linear) > options.exit)
+            overcome(lin, chassis.move_ks);
+    }
+};
+
+// pure pursuit or stanley along a stretch of the path, up to its next cusp
+class Chassis::PathController : public MotionController {
+    double curvature = 0.0; // of the arc to the carrot, or of the path under stanley
+    double profile_speed;   // %, of the path's speed profile where the robot is
+    double progress = 0.0;  // arc length of the closest point on the path
+    PathOverride in_force;  // the path's overrides up to the closest point
+    size_t next_override = 0;
+
+    // takes on the overrides the closest point has passed since the last step
+    void pass_overrides(const Path& path) {
+        const std::vector<PathOverride>& overrides = path.get_overrides();
+        while (next_override < overrides.size() &&
+               overrides[next_override].point <= chassis.path_index)
+            in_force.apply(overrides[next_override++]);
+    }
+
+  public:
+    static bool runs(Motion motion, const PackedOptions&) { return motion == PATH; }
+    PathController(Chassis& chassis, const PackedOptions& options, const Step& step, Motion)
+        : MotionController(chassis, options), profile_speed(step.max_speed) {}
+
+    bool hands_off() const override { return true; }
+    double percent(const Step& step, double remaining) const override {
+        // remaining is to the next cusp
+        return step.total > 0 ? std::clamp(100 * progress / step.total, 0.0, 100.0) : 0.0;
+    }
+    double marker_distance(double remaining) const override { return progress; }
+    int segment() const override { return chassis.path_index; }
+
+    Point error(Step& step) override {
+        Chassis& c = chassis;
+        // robot pose in the path frame
+        const Pose local = {(step.pose.p() - c.path_frame.p()).rotate(-c.path_frame.theta),
+                            step.pose.theta - c.path_frame.theta};
+        if (const Path* next = c.next_path.exchange(nullptr)) {
+            // carry on along the new path from its closest point, keeping the pid state and
+            // speed, with only the markers still ahead left to fire
+            c.follow_path = c.marker_path = next;
+            c.path_index = next->closest(local.p());
+            const double from = next->progress(local, c.path_index);
+            const std::vector<Marker>& markers = next->get_markers();
+            c.marker_index = 0;
+            while (c.marker_index < markers.size() && markers[c.marker_index].distance <= from)
+                c.marker_index++;
+            c.progress_total = step.total = next->length();
+            in_force = PathOverride();
+            next_override = 0;
+        }
+        const Path& path = *c.follow_path;
+        pass_overrides(path);
+        // lookahead from the fraction of full speed, cut to the radius of the sharpest curve
+        // coming up so the carrot doesn't skip across it, unless the path sets one here
+        const double lookahead =
+            std::isnan(in_force.lookahead) ? options.lookahead : in_force.lookahead;
+        double reach = lookahead;
+        if (std::isnan(in_force.lookahead) && c.max_lookahead > c.min_lookahead &&
+            c.min_lookahead > 0) {
+            const double fraction = c.move_velocity > 0
+                                        ? fabs(c.odom.get_velocity(true).vel.x) / c.move_velocity
+                                        : step.max_speed / 100;
+            reach = c.min_lookahead +
+                    (c.max_lookahead - c.min_lookahead) * std::min(fraction, 1.0);
+            const double sharpest = path.curvature(c.path_index, reach);
+            if (sharpest > 0) reach = std::clamp(1 / sharpest, c.min_lookahead, reach);
+        }
+        // advance the closest point and intersect the lookahead circle with the path
+        c.path_index = path.advance(local, c.path_index, reach);
+        progress = path.progress(local, c.path_index);
+        const Point carrot = path.intersect(local, reach, c.path_index, progress);
+        // to the next cusp, or the end
+        const int end = path.cusp(c.path_index);
+        const double remaining = path.distance(end) - progress;
+        // a final heading of its own hands off sooner, leaving the final move room to turn onto it
+        const bool last = end == (int)path.size() - 1 && !std::isnan(options.heading);
+        if (remaining <= (last ? 3 * lookahead : lookahead)) step.handoff = true;
+        profile_speed = std::min(step.max_speed, path.velocity(progress));
+        if (!std::isnan(in_force.speed))
+            profile_speed = std::min<double>(profile_speed, in_force.speed);
+        // error
+        Point error = {remaining - options.offset, local.angle(carrot)};
+        // curvature of the arc to the carrot
+        const Point arc = (carrot - local.p()).rotate(-local.theta);
+        const double arc_dist = arc.x * arc.x + arc.y * arc.y;
+        curvature = arc_dist > 0 ? 2 * arc.y / arc_dist : 0.0;
+        // left of the closest segment
+        auto cross_track = [&](const Point& tangent) {
+            const Point off = local.p() - path.nearest(local.p(), c.path_index);
+            const double length = hypot(tangent.x, tangent.y);
+            return length > 0 ? (tangent.x * off.y - tangent.y * off.x) / length : 0.0;
         };
+        const Point tangent = path[c.path_index + 1].p() - path[c.path_index].p();
+        if (c.path_learning) {
+            // off the path and short of its speed here, for the next run
+            const double speed = fabs(c.odom.get_velocity(true).vel.x);
+            const double short_of =
+                c.move_velocity > 0 ? profile_speed / 100 * c.move_velocity - speed : 0.0;
+            c.path_learning->record(progress, cross_track(tangent), short_of);
+        }
+        if (options.stanley > 0) {
+            // stanley: the heading of the closest segment, turned toward the path by the cross
+            // track error, slower to turn the faster the robot goes
+            // 1 in/s more keeps it from swinging hard at a standstill
+            const double speed = fabs(c.odom.get_velocity(true).vel.x) + 1.0;
+            const double heading =
+                atan2(tangent.y, tangent.x) - atan2(options.stanley * cross_track(tangent), speed);
+            error.angular = wrap(heading - local.theta);
+            curvature = path.curvature(c.path_index); // of the path, as feedforward
+        }
+        // direction
+        if (options.dir == REVERSE) {
+            error.angular += error.angular > 0 ? -M_PI : M_PI;
+            error.linear *= -1;
+        }
+        return error;
     }
 
-    // start task if async
-    if (options.async.value()) {
-        chassis_task = new pros::Task(movement, "chassis_task");
-    } else {
-        movement();
+    void output(const Step& step, const Point& error, double& lin, double& ang) override {
+        lin = limit(lin, profile_speed); // track the path profile
+        // what earlier runs learned here, on top
+        const LearningRecord learned = chassis.path_learning
+                                           ? chassis.path_learning->correction(progress)
+                                           : LearningRecord{0.0f, 0.0f};
+        lin += options.dir == REVERSE ? -learned.linear : learned.linear;
+        const double track_width = chassis.track_width;
+        if (track_width > 0 && options.stanley > 0) {
+            // the path's own curve, with the heading pid steering onto it
+            ang += fabs(lin) * curvature * track_width / 2;
+        } else if (track_width > 0) {
+            // steer along the pursuit arc
+            ang = lin * curvature * track_width / 2;
+        }
+        ang += learned.angular;
+    }
+};
+
+// in place to a heading or point, or a swing pivoting on the locked side
+// rad left to turn from pose to the target's heading, or to face it without one. odom headings
+// are continuous, so an unwrapped heading is reached the long way round, however many turns away
+static double turn_error(const PackedOptions& options, const Pose& pose, const Pose& target) {
+    if (options.flag(PackedOptions::UNWRAP) && !std::isnan(target.theta)) {
+        const double turn = target.theta - pose.theta;
+        return options.dir == REVERSE ? turn + (turn > 0 ? -M_PI : M_PI) : turn;
     }
+    double turn = std::isnan(target.theta) ? pose.angle(target) : wrap(target.theta - pose.theta);
+    // direction
+    if (options.dir == REVERSE) turn += turn > 0 ? -M_PI : M_PI;
+    if (options.turn == CW && turn < 0) turn += 2 * M_PI;
+    else if (options.turn == CCW && turn > 0) turn -= 2 * M_PI;
+    return turn;
 }
 
-void Chassis::move(Pose target, Options options, const Options& override) {
-    // configure target
-    if (std::isnan(target.y)) { // relative straight
-        target.y = 0.0;
-        options.relative = true;
-        options.dir = AUTO;
+class Chassis::TurnController : public MotionController {
+    const bool swing;
+    Direction preferred; // chosen by set_direction(), until the nearest way agrees
+
+  public:
+    static bool runs(Motion motion, const PackedOptions&) {
+        return motion == TURN || motion == SWING;
     }
+    TurnController(Chassis& chassis, const PackedOptions& options, const Step&, Motion motion)
+        : MotionController(chassis, options), swing(motion == SWING),
+          preferred(chassis.preferred_turn) {}
 
-    // merge options
-    options = df_move << options << override;
+    Axis profiles() const override { return swing ? NONE : ANGULAR; }
+    bool angular() const override { return true; }
 
-    // run motion
-    motion_handler({target}, options, MOVE);
-}
+    Point error(Step& step) override {
+        double turn = turn_error(options, step.pose, step.target);
+        if (preferred != AUTO) { // the long way round, as turn_error() goes for CW and CCW
+            if ((turn > 0) == (preferred == CW)) preferred = AUTO;
+            else turn += turn > 0 ? -2 * M_PI : 2 * M_PI;
+        }
+        return {0.0, turn};
+    }
 
-void Chassis::turn(const Point& target, Options options, const Options& override) {
-    // configure target
-    Pose target_pose;
-    if (std::isnan(target.y)) target_pose.theta = target.x;
-    else target_pose = target;
+    void output(const Step& step, const Point& error, double& lin, double& ang) override {
+        if (options.flag(PackedOptions::THRU)) ang = ang > 0 ? step.max_speed : -step.max_speed;
+        else if (!step.profiled && fabs(error.angular) > to_rad(options.exit))
+            overcome(ang, chassis.turn_ks);
+    }
 
-    // merge options
-    options = df_turn << options << override;
+    Point wheels(double lin, double ang, double max_speed) const override {
+        if (!swing) return MotionController::wheels(lin, ang, max_speed);
+        // pivot on the locked side, the other side turns the whole way
+        const double speed = limit(2 * ang, max_speed);
+        return chassis.arc_radius > 0 ? Point{0.0, speed} : Point{-speed, 0.0};
+    }
+};
 
-    // run motion
-    motion_handler({target_pose}, options, TURN);
-}
+// along a circle of arc_radius, turning by the target's heading
+class Chassis::ArcController : public MotionController {
+    const double side; // of the center, 1 on the left
+    const Point center;
 
-void Chassis::follow(const std::vector<Point>& path, Options options, const Options& override) {
-    // merge options
-    options = df_move << options << override;
-    bool relative = options.relative.value();
-    options.relative = false;
+  public:
+    static bool runs(Motion motion, const PackedOptions&) { return motion == ARC; }
+    // the center on the side the turn and direction need
+    ArcController(Chassis& chassis, const PackedOptions& options, const Step& step, Motion)
+        : MotionController(chassis, options),
+          side((step.target.theta >= 0) != (options.dir == REVERSE) ? 1.0 : -1.0),
+          center(step.pose.p() + Point{cos(step.pose.theta + side * M_PI_2),
+                                       sin(step.pose.theta + side * M_PI_2)} *
+                                     chassis.arc_radius) {}
 
-    // copy points to poses and convert if relative
-    Pose pose = odom.get();
-    std::vector<Pose> poses;
+    Point error(Step& step) override {
+        // arc length left from the heading still to turn, signed by the direction of travel
+        const double radius = chassis.arc_radius;
+        const double travel = options.dir == REVERSE ? -1.0 : 1.0;
+        const double remaining = (step.target.theta - step.measured.angular) * radius * side;
+        // heading along the circle, steering back onto it when off the radius
+        const Point radial = step.pose.p() - center;
+        const double off = radial.dist({0.0, 0.0}) - radius;
+        const double heading =
+            atan2(radial.y, radial.x) + side * M_PI_2 + side * travel * atan(off / radius);
+        return {remaining - options.offset * travel, wrap(heading - step.pose.theta)};
+    }
 
-    for (int i = 0; i < path.size(); i++) {
-        Point target = path[i];
-        if (relative) target = pose.p() + target.rotate(pose.theta);
-        poses.push_back({target, NAN});
+    void output(const Step& step, const Point& error, double& lin, double& ang) override {
+        if (options.flag(PackedOptions::THRU)) lin = lin > 0 ? step.max_speed : -step.max_speed;
+        // wheel speed ratio of the arc, the angular PID only corrects the heading
+        lin = limit(lin, step.max_speed);
+        ang += lin * side * chassis.track_width / (2 * chassis.arc_radius);
     }
+};
+
+// ramsete on the time reference of a trajectory, in the frame of path_frame. with warp the
+// reference's clock slows while the robot lags it by more than warp, and its speeds with it, so a
+// robot that fell behind is brought back onto the reference near it instead of cutting across to
+// one that has run on around a corner. once the reference ends its speeds and gain are 0, so it
+// hands off to a move onto the last sample for whatever lag is left
+class Chassis::TrajectoryController : public MotionController {
+    Point ramsete;          // linear and angular speed (%)
+    bool done = false;      // past the trajectory's duration
+    double time = 0.0;      // s, of the reference
+    uint32_t last_time = 0; // ms of the last step, 0 before the first
+
+  public:
+    static bool runs(Motion motion, const PackedOptions&) { return motion == TRAJECTORY; }
+    TrajectoryController(Chassis& chassis, const PackedOptions& options, const Step&, Motion)
+        : MotionController(chassis, options) {}
 
-    // calculate heading for poses
-    poses[0].theta = to_deg(pose.p().angle(path[0]));
-    path_length = 0;
-    for (int i = 1; i < poses.size(); i++) {
-        poses[i].theta = to_deg(poses[i].p().angle(poses[i - 1]) + M_PI);
-        path_length += poses[i].dist(poses[i - 1]);
+    bool finished(const Step& step) const override { return done; }
+    bool hands_off() const override { return true; }
+    double percent(const Step& step, double remaining) const override {
+        return std::clamp(100 * time / std::max(chassis.follow_trajectory->duration(), 1e-3),
+                          0.0, 100.0);
     }
 
-    // run motion
-    motion_handler(poses, options, PATH);
-}
+    Point error(Step& step) override {
+        Chassis& c = chassis;
+        const Pose& pose = step.pose;
+        auto reference = [&](double t, double rate = 1.0) {
+            TrajectorySample sample = c.follow_trajectory->at(t);
+            sample.pose = {c.path_frame.p() + sample.pose.p().rotate(c.path_frame.theta),
+                           sample.pose.theta + c.path_frame.theta};
+            sample.velocity *= rate, sample.omega *= rate;
+            return sample;
+        };
+        // reference at this time, in the trajectory frame. warped, the clock slows from real time
+        // at warp behind the reference, along the way it drives, to a quarter at twice warp
+        const uint32_t now = c.clock_ms();
+        if (last_time == 0) last_time = step.start_time;
+        double rate = 1.0;
+        if (options.warp > 0) {
+            const TrajectorySample at = reference(time);
+            const Point gap = at.pose.p() - pose.p();
+            const double lag = (gap.x * cos(at.pose.theta) + gap.y * sin(at.pose.theta)) *
+                               (at.velocity < 0 ? -1 : 1);
+            rate = std::clamp(2 - lag / options.warp, 0.25, 1.0);
+        }
+        time += (now - last_time) / 1000.0 * rate;
+        last_time = now;
+        const TrajectorySample ref = reference(time, rate);
+        const TrajectorySample next = reference(time + step.loop_dt / 1000.0 * rate, rate);
+        done = time >= c.follow_trajectory->duration();
+        // with the reference and the robot both three lookaheads from the end, like a path's
+        // pursuit into a final heading, so the move has room to come in on it
+        const double near = 3 * options.lookahead;
+        if (done || (ref.pose.dist(step.target) < near && pose.dist(step.target) < near))
+            step.handoff = true;
+        // error in the robot frame
+        const Point local = (ref.pose.p() - pose.p()).rotate(-pose.theta);
+        const double theta_error = wrap(ref.pose.theta - pose.theta);
+        // ramsete, b and zeta in inches
+        const double b = 2.0 / (39.37 * 39.37), zeta = 0.7;
+        const double k = 2 * zeta * sqrt(ref.omega * ref.omega + b * ref.velocity * ref.velocity);
+        const double sinc = fabs(theta_error) > 1e-6 ? sin(theta_error) / theta_error : 1.0;
+        const double v = ref.velocity * cos(theta_error) + k * local.x;
+        const double omega = ref.omega + k * theta_error + b * ref.velocity * sinc * local.y;
+        // wheel commands through the feedforward
+        const double dt_s = step.loop_dt / 1000.0;
+        const double lin_accel = (next.velocity - ref.velocity) / dt_s;
+        const double ang_accel = (next.omega - ref.omega) / dt_s;
+        ramsete = {c.move_ff ? c.move_ff.get(v, lin_accel) : v / c.move_velocity * 100,
+                   c.turn_ff ? c.turn_ff.get(to_deg(omega), to_deg(ang_accel))
+                             : to_deg(omega) / c.turn_velocity * 100};
+        return {pose.dist(step.target), theta_error};
+    }
 
-void Chassis::tank(double left_speed, double right_speed) {
-    std::lock_guard<pros::Mutex> lock(chassis_mutex);
-    left_motors.move_voltage(left_speed * 120);
-    right_motors.move_voltage(right_speed * 120);
-    prev_speeds = {left_speed, right_speed};
-}
-void Chassis::tank(const Point& speeds) { tank(speeds.left, speeds.right); }
-void Chassis::tank(pros::Controller& controller) {
-    double left_speed = controller.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_Y) / 1.27;
-    double right_speed = controller.get_analog(pros::E_CONTROLLER_ANALOG_RIGHT_Y) / 1.27;
-    tank(left_speed, right_speed);
+    void output(const Step& step, const Point& error, double& lin, double& ang) override {
+        lin = ramsete.linear;
+        ang = ramsete.angular;
+    }
+};
+
+// keeps a pose against pushing, and never settles. the drive rests inside the deadbands, and the
+// motors are held to the hold's current limit until it ends
+class Chassis::HoldController : public MotionController {
+    std::array<int32_t, 2> limits{}; // of each side before the hold, put back after
+    bool returning = false;          // pushed off sideways, driving back onto the pose
+
+  public:
+    static bool runs(Motion motion, const PackedOptions&) { return motion == HOLD; }
+    HoldController(Chassis& chassis, const PackedOptions& options, const Step&, Motion)
+        : MotionController(chassis, options) {
+        if (chassis.holding.current <= 0) return;
+        limits = {chassis.left_motors.get_current_limit(), chassis.right_motors.get_current_limit()};
+        chassis.left_motors.set_current_limit_all(chassis.holding.current);
+        chassis.right_motors.set_current_limit_all(chassis.holding.current);
+        chassis.hold_limit.store(chassis.holding.current);
+    }
+    ~HoldController() override {
+        if (chassis.holding.current <= 0) return;
+        chassis.hold_limit.store(0);
+        chassis.left_motors.set_current_limit_all(limits[0]);
+        chassis.right_motors.set_current_limit_all(limits[1]);
+    }
+
+    bool finished(const Step& step) const override { return false; }
+
+    Point error(Step& step) override {
+        const Pose& pose = step.pose;
+        Pose& target = step.target;
+        if (std::isnan(target.theta)) target.theta = pose.theta; // the heading it starts on
+        const Point off = (target.p() - pose.p()).rotate(-pose.theta);
+        // sideways can't be driven straight back, so past lateral it turns the nearer way round
+        // to drive back onto the pose, then back onto the heading once there
+        const double distance = hypot(off.x, off.y);
+        if (fabs(off.y) > chassis.holding.lateral) returning = true;
+        else if (distance < chassis.holding.deadband) returning = false;
+        if (!returning) return {off.x, wrap(target.theta - pose.theta)};
+        const double facing = atan2(off.y, off.x);
+        return off.x >= 0 ? Point{distance, facing} : Point{-distance, wrap(facing + M_PI)};
+    }
+
+    void output(const Step& step, const Point& error, double& lin, double& ang) override {
+        if (returning) lin *= std::max(0.0, cos(error.angular)); // once it faces the pose
+        else if (fabs(error.linear) < chassis.holding.deadband) lin = 0.0;
+        if (!returning && fabs(error.angular) < to_rad(chassis.holding.angle)) ang = 0.0;
+    }
+};
+
+// the mpc plan's batch updates, four horizon steps at a time with neon
+#ifdef APPA_NEON
+static float sum_lanes(float32x4_t v) {
+    const float32x2_t half = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(half, half), 0);
 }
-void Chassis::arcade(double linear, double angular) { tank(linear + angular, linear - angular); }
-void Chassis::arcade(pros::Controller& controller) {
-    double linear = controller.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_Y) / 1.27;
-    double angular = controller.get_analog(pros::E_CONTROLLER_ANALOG_RIGHT_X) / 1.27;
-    arcade(linear, angular);
+#endif
+
+// accelerations down their gradient by t, within the wheels' acceleration
+static void mpc_descend(real* accel, const real* grad, double t, double limit, int n) {
+    int i = 0;
+#ifdef APPA_NEON
+    const float32x4_t low = vdupq_n_f32(-limit), high = vdupq_n_f32(limit);
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t a = vmlsq_n_f32(vld1q_f32(accel + i), vld1q_f32(grad + i), t);
+        vst1q_f32(accel + i, vminq_f32(vmaxq_f32(a, low), high));
+    }
+#endif
+    for (; i < n; i++) accel[i] = std::clamp<double>(accel[i] - t * grad[i], -limit, limit);
 }
 
-void Chassis::stop(bool stop_task) {
-    is_running.store(false);
-    if (stop_task && chassis_task) {
-        chassis_task->remove();
-        delete chassis_task;
-        chassis_task = nullptr;
+// s·s and s·y of the step from the iterate before, s in the accelerations and y in the gradient
+static void mpc_secant(const real* accel, const real* prev, const real* grad,
+                       const real* prev_grad, int n, double& ss, double& sy) {
+    int i = 0;
+#ifdef APPA_NEON
+    float32x4_t lanes_ss = vdupq_n_f32(0.0f), lanes_sy = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4) {
+        const float32x4_t s = vsubq_f32(vld1q_f32(accel + i), vld1q_f32(prev + i));
+        const float32x4_t y = vsubq_f32(vld1q_f32(grad + i), vld1q_f32(prev_grad + i));
+        lanes_ss = vmlaq_f32(lanes_ss, s, s);
+        lanes_sy = vmlaq_f32(lanes_sy, s, y);
+    }
+    ss += sum_lanes(lanes_ss);
+    sy += sum_lanes(lanes_sy);
+#endif
+    for (; i < n; i++) {
+        const double s = accel[i] - prev[i], y = grad[i] - prev_grad[i];
+        ss += s * s;
+        sy += s * y;
     }
-    tank(0, 0);
 }
 
-void Chassis::set_brake_mode(const pros::motor_brake_mode_e_t mode) {
-    std::lock_guard<pros::Mutex> lock(chassis_mutex);
-    left_motors.set_brake_mode_all(mode);
-    right_motors.set_brake_mode_all(mode);
+// a move planned over a short horizon. each step moves the last plan on by the time since and
+// improves it from the measured pose and wheel speeds with a fixed number of projected gradient
+// iterations, barzilai-borwein step sizes, then drives its first step
+class Chassis::MpcController : public MotionController {
+    const MpcConfig config;
+    MpcPlan& plan;
+    int n;                       // steps in the horizon
+    double h;                    // s per step
+    double width;                // in, the track width
+    double max_accel, max_speed; // of a wheel's command, in/s² and in/s
+    double follow;               // share of the way to its command a wheel gets each step
+    double sign = 1.0;           // -1 backing up
+    double heading = NAN;        // rad the robot ends on, nan for a point
+    Point axis = {1.0, 0.0};     // the way the robot drives into the target pose
+    bool fresh;                  // no plan to carry on from
+    Point command = {0.0, 0.0};  // linear and angular speed (%)
+    // the route from where the move started, a cubic bezier leaving the way the robot drives
+    // and coming into the target along its heading, and how far along it the robot got
+    static constexpr int samples = 16;
+    std::array<Point, samples + 1> curve;
+    std::array<double, samples + 1> length, limit; // in along it, and in/s the robot can take
+    double progress = 0.0;                         // in
+    int segment = 0;
+    bool closing = false; // inside the close radius, latched
+
+    // the reference the plan tracks: the route into the target and how far along it the robot
+    // is, timed from the robot's speed by how fast the wheels speed up and still stop on the
+    // target. a move that hands off carries on past it
+    void reference(const Pose& pose, double speed) {
+        MpcPlan& p = plan;
+        // the nearest point of the route, a little past where it was last
+        double best = INFINITY;
+        for (int i = segment; i < std::min(segment + 4, samples); i++) {
+            const Point a = curve[i], b = curve[i + 1];
+            const double span = length[i + 1] - length[i];
+            const Point d = b - a;
+            const double along =
+                span > 0 ? std::clamp(((pose.x - a.x) * d.x + (pose.y - a.y) * d.y) / (span * span),
+                                      0.0, 1.0)
+                         : 0.0;
+            const double off = pose.p().dist(a + d * along);
+            if (off < best) {
+                best = off;
+                progress = std::max(progress, length[i] + along * span);
+            }
+        }
+        while (segment < samples - 1 && length[segment + 1] < progress) segment++;
+
+        const bool thru = options.flag(PackedOptions::THRU);
+        const double total = length[samples];
+        double s = progress, v = std::clamp(speed, 0.0, max_speed);
+        for (int k = 0, i = segment; k <= n; k++) {
+            if (k > 0) {
+                // the speed limit where the reference got to, with the acceleration to reach it
+                const double span = length[i + 1] - length[i];
+                const double along = span > 0 ? std::clamp((s - length[i]) / span, 0.0, 1.0) : 1.0;
+                v = std::min(v + h * max_accel, limit[i] + (limit[i + 1] - limit[i]) * along);
+                s = thru ? s + v * h : std::min(s + v * h, total);
+                while (i < samples - 1 && length[i + 1] < s) i++;
+            }
+            const double span = length[i + 1] - length[i];
+            const Point r = span > 0 ? curve[i] + (curve[i + 1] - curve[i]) *
+                                                      ((s - length[i]) / span)
+                                     : curve[samples];
+            p.rx[k] = r.x;
+            p.ry[k] = r.y;
+            if (span > 0) p.rtheta[k] = curve[i].angle(curve[i + 1]) + (sign < 0 ? M_PI : 0.0);
+            else p.rtheta[k] = std::isnan(heading) ? pose.theta : heading;
+        }
+    }
+
+    // rolls the plan out from the robot, keeping each wheel's command within the speed cap on
+    // the way. the wheels follow their commands with the drive's lag
+    void roll_out() {
+        MpcPlan& p = plan;
+        for (int k = 0; k < n; k++) {
+            // a command over the cap, such as after the speed dropped, slows as fast as it can
+            auto capped = [&](double speed, double accel) {
+                return std::clamp(speed + h * accel, std::min(-max_speed, speed + h * max_accel),
+                                  std::max(max_speed, speed - h * max_accel));
+            };
+            const double cl = capped(p.cl[k], p.left[k]), cr = capped(p.cr[k], p.right[k]);
+            p.left[k] = (cl - p.cl[k]) / h;
+            p.right[k] = (cr - p.cr[k]) / h;
+            const double l = p.vl[k] + follow * (cl - p.vl[k]);
+            const double r = p.vr[k] + follow * (cr - p.vr[k]);
+            const Point facing = Point{1.0, 0.0}.rotate(p.theta[k]);
+            const double travel = (l + r) / 2 * h;
+            p.cos[k] = facing.x;
+            p.sin[k] = facing.y;
+            p.x[k + 1] = p.x[k] + travel * facing.x;
+            p.y[k + 1] = p.y[k] + travel * facing.y;
+            p.theta[k + 1] = p.theta[k] + (r - l) / width * h;
+            p.cl[k + 1] = cl;
+            p.cr[k + 1] = cr;
+            p.vl[k + 1] = l;
+            p.vr[k + 1] = r;
+        }
+    }
+
+    // the cost's gradient in each acceleration of the rolled out plan, from the costates of the
+    // steps after it. turn and stop are the heading and wheel speed costs
+    void gradient(double turn, double stop) {
+        MpcPlan& p = plan;
+        const double wrong_way = config.position * h * h;
+        double gx = 0.0, gy = 0.0, gtheta = 0.0, gl = 0.0, gr = 0.0, gcl = 0.0, gcr = 0.0;
+        for (int k = n; k >= 1; k--) {
+            const double weight = k == n ? config.terminal : 1.0;
+            const double v = (p.vl[k] + p.vr[k]) / 2;
+            gx += 2 * weight * config.position * (p.x[k] - p.rx[k]);
+            gy += 2 * weight * config.position * (p.y[k] - p.ry[k]);
+            if (turn > 0)
+                gtheta += weight * turn * Point{1.0, 0.0}.rotate(p.theta[k] - p.rtheta[k]).y;
+            // driving the wrong way costs as much as being that far off
+            if (sign * v < 0) {
+                gl += wrong_way * v;
+                gr += wrong_way * v;
+            }
+            if (k == n) {
+                gl += 2 * stop * p.vl[k];
+                gr += 2 * stop * p.vr[k];
+                gcl += 2 * stop * p.cl[k];
+                gcr += 2 * stop * p.cr[k];
+            }
+            // through the wheel speeds, which follow the commands the step's accelerations set
+            const double c = p.cos[k - 1], s = p.sin[k - 1];
+            const double travel = (gx * c + gy * s) * h / 2, spin = gtheta * h / width;
+            const double left = gl + travel - spin, right = gr + travel + spin;
+            gcl += follow * left;
+            gcr += follow * right;
+            p.grad_left[k - 1] = h * gcl + 2 * config.effort * p.left[k - 1];
+            p.grad_right[k - 1] = h * gcr + 2 * config.effort * p.right[k - 1];
+            gtheta += h * v * (gy * c - gx * s);
+            gl = (1 - follow) * left;
+            gr = (1 - follow) * right;
+        }
+    }
+
+    // near is how close in the robot is, 1 on the target and half at reach
+    void solve(const Step& step, double near) {
+        MpcPlan& p = plan;
+        const uint64_t start = pros::micros();
+        // the plan from the last step, on by the time since
+        p.age += step.loop_dt / 1000;
+        for (; p.age >= h; p.age -= h) {
+            std::copy(p.left.begin() + 1, p.left.begin() + n, p.left.begin());
+            std::copy(p.right.begin() + 1, p.right.begin() + n, p.right.begin());
+            p.left[n - 1] = p.right[n - 1] = 0;
+        }
+        // from the measured pose and wheel speeds, and the commands from the step before. a new
+        // plan starts with the commands at the measured speeds
+        const Twist twist = chassis.odom.get_velocity(true);
+        const double spin = twist.vel.theta * width / 2;
+        const Point measured = {twist.vel.x - spin, twist.vel.x + spin};
+        if (fresh) p.wheels = measured;
+        fresh = false;
+        p.x[0] = step.pose.x;
+        p.y[0] = step.pose.y;
+        p.theta[0] = step.pose.theta;
+        p.vl[0] = measured.left;
+        p.vr[0] = measured.right;
+        p.cl[0] = p.wheels.left;
+        p.cr[0] = p.wheels.right;
+        reference(step.pose, sign * (p.wheels.left + p.wheels.right) / 2);
+
+        // the first step size from the cost's curvature in a first acceleration, the largest of
+        // any, times the steps and wheels so it's past the largest eigenvalue
+        const double turn = std::isnan(heading) ? 0.0 : config.heading;
+        const double stop = options.flag(PackedOptions::THRU) ? 0.0 : config.stop * near;
+        double curvature = 2 * stop * h * h + 2 * config.effort;
+        for (int k = 1; k <= n; k++) {
+            const double weight = k == n ? config.terminal : 1.0;
+            const double travel = h * h * k / 2, spin = h * h * k / width;
+            curvature += weight * (2 * config.position * travel * travel + turn * spin * spin);
+        }
+        const double first = 1 / (4 * n * std::max(curvature, 1e-12));
+
+        double t = first;
+        const int iterations = std::max(config.iterations, 1);
+        for (int i = 0; i < iterations; i++) {
+            roll_out();
+            gradient(turn, stop);
+            if (i > 0) {
+                double ss = 0.0, sy = 0.0;
+                mpc_secant(p.left.data(), p.prev_left.data(), p.grad_left.data(),
+                           p.prev_grad_left.data(), n, ss, sy);
+                mpc_secant(p.right.data(), p.prev_right.data(), p.grad_right.data(),
+                           p.prev_grad_right.data(), n, ss, sy);
+                t = sy > 0 ? std::clamp(ss / sy, first, 100 * first) : first;
+            }
+            std::copy_n(p.left.begin(), n, p.prev_left.begin());
+            std::copy_n(p.right.begin(), n, p.prev_right.begin());
+            std::copy_n(p.grad_left.begin(), n, p.prev_grad_left.begin());
+            std::copy_n(p.grad_right.begin(), n, p.prev_grad_right.begin());
+            mpc_descend(p.left.data(), p.grad_left.data(), t, max_accel, n);
+            mpc_descend(p.right.data(), p.grad_right.data(), t, max_accel, n);
+            if (config.budget > 0 && pros::micros() - start >= config.budget) break;
+        }
+        roll_out();
+        p.time = chassis.clock_ms();
+
+        // the commands a control period into the plan. the lag is modelled, so the feedforward
+        // only gives the voltage for the speed
+        const Chassis& c = chassis;
+        const double dt = std::min<double>(std::max(1, options.period) / 1000.0, h);
+        p.wheels = {p.cl[0] + p.left[0] * dt, p.cr[0] + p.right[0] * dt};
+        auto wheel = [&](double speed) {
+            return c.move_ff ? c.move_ff.get(speed, 0.0, speed) : speed / c.move_velocity * 100;
+        };
+        const double left = wheel(p.wheels.left), right = wheel(p.wheels.right);
+        command = {(left + right) / 2, (right - left) / 2};
+    }
+
+    // the plan has no way closer over its horizon, it moves less than half the exit
+    bool at_rest() const {
+        const MpcPlan& p = plan;
+        return hypot(p.x[n] - p.x[0], p.y[n] - p.y[0]) < 0.5 * options.exit;
+    }
+
+  public:
+    static bool runs(Motion motion, const PackedOptions& options) {
+        return motion == MOVE && options.flag(PackedOptions::MPC);
+    }
+    // settles once at rest at the end of the route, rather than passing through the exit
+    bool finished(const Step& step) const override {
+        return options.flag(PackedOptions::THRU) || (progress >= length[samples] && at_rest());
+    }
+    MpcController(Chassis& chassis, const PackedOptions& options, const Step& step, Motion)
+        : MotionController(chassis, options),
+          config(chassis.mpc_config),
+          plan(chassis.mpc_plan),
+          n(std::clamp(config.horizon, 1, MpcPlan::capacity)),
+          h(std::max(config.step, 1.0) / 1000),
+          width(chassis.track_width),
+          max_speed(chassis.move_velocity * step.max_speed / 100) {
+        // the accel option limits each side, otherwise the drive model's wheels do
+        const double derated = chassis.derate_scale.load();
+        max_accel = options.accel > 0 ? options.accel * derated / 100 * chassis.move_velocity
+                                      : chassis.kinematics.max_accel * derated;
+        if (max_accel <= 0) max_accel = 4 * chassis.move_velocity; // full speed in 250 ms
+        // the share of the way to its command a wheel gets in a step, from the feedforward's
+        // time constant when it has one
+        const Feedforward& ff = chassis.move_ff;
+        const double lag = ff.v > 0 && ff.a > 0 ? ff.a / ff.v : config.lag / 1000;
+        follow = lag > 0 ? 1 - exp(-h / lag) : 1.0;
+        const Pose& pose = step.pose;
+        const Pose& target = step.target;
+        // a pose is driven onto forwards unless the move reverses, a point whichever way it faces
+        const bool behind = std::isnan(target.theta) && fabs(pose.angle(target.p())) > M_PI_2;
+        if (options.dir == REVERSE || (options.dir == AUTO && behind)) sign = -1.0;
+        if (!std::isnan(target.theta)) {
+            heading = sign < 0 ? target.theta + M_PI : target.theta;
+            axis = Point{1.0, 0.0}.rotate(target.theta);
+        }
+        const Point start = pose.p(), end = target.p();
+        const double handle = std::isnan(heading) ? 0.0 : start.dist(end) * options.lead;
+        const Point c1 = start + Point{sign * handle, 0.0}.rotate(pose.theta);
+        const Point c2 = end - axis * handle;
+        for (int i = 0; i <= samples; i++) {
+            const double t = (double)i / samples, u = 1 - t;
+            curve[i] = start * (u * u * u) + c1 * (3 * u * u * t) + c2 * (3 * u * t * t) +
+                       end * (t * t * t);
+            length[i] = i > 0 ? length[i - 1] + curve[i].dist(curve[i - 1]) : 0.0;
+        }
+        // the outer wheel keeps under the cap and the sideways acceleration within the wheels',
+        // slowing in time for the bends and the end
+        const bool thru = options.flag(PackedOptions::THRU);
+        for (int i = 0; i <= samples; i++) {
+            double bend = 0.0;
+            if (i > 0 && i < samples && length[i + 1] > length[i - 1]) {
+                const double turned = wrap(curve[i].angle(curve[i + 1]) -
+                                           curve[i - 1].angle(curve[i]));
+                bend = fabs(turned) * 2 / (length[i + 1] - length[i - 1]);
+            }
+            limit[i] = std::min(max_speed / (1 + bend * width / 2),
+                                bend > 0 ? sqrt(max_accel / bend) : max_speed);
+        }
+        if (!thru) limit[samples] = 0.0;
+        for (int i = samples - 1; i >= 0; i--) {
+            const double span = length[i + 1] - length[i];
+            limit[i] = std::min(limit[i], sqrt(limit[i + 1] * limit[i + 1] + 2 * max_accel * span));
+        }
+        // a plan left by a move that handed off into this one still fits, an older one doesn't
+        fresh = chassis.clock_ms() - plan.time > 100;
+        if (fresh) {
+            plan.left.fill(0);
+            plan.right.fill(0);
+            plan.age = 0.0;
+        }
+    }
+
+    Point error(Step& step) override {
+        const Pose& pose = step.pose;
+        const Pose& target = step.target;
+        const double distance = pose.dist(target.p());
+        const double reach = std::max(config.reach, 0.1);
+        solve(step, 1 / (1 + distance * distance / (reach * reach)));
+        // a move that hands off is done once it's level with its target, on the route or off it
+        double linear = sign * distance;
+        if (options.flag(PackedOptions::THRU) && progress >= length[samples]) linear = 0.0;
+        else if (!std::isnan(heading) &&
+                 (closing || (options.close > 0 && distance < options.close) ||
+                  (progress >= length[samples] && at_rest()))) {
+            // inside close, or at rest at the end of the route, it settles on the distance left
+            // along the heading like the boomerang with close. what's left sideways needs a back
+            // up the horizon doesn't see
+            closing = closing || (options.close > 0 && distance < options.close);
+            const Point left = target.p() - pose.p();
+            linear = sign * (left.x * axis.x + left.y * axis.y);
+        }
+        if (std::isnan(heading))
+            return {linear, wrap(pose.angle(target.p()) + (sign < 0 ? M_PI : 0.0))};
+        return {linear, wrap(heading - pose.theta)};
+    }
+
+    void output(const Step& step, const Point& error, double& lin, double& ang) override {
+        lin = command.linear;
+        ang = command.angular;
+    }
+};
+
+// the first controller in the list that runs the motion
+template <size_t I>
+Chassis::MotionController* Chassis::make_controller(MotionControllers& controllers,
+                                                    const PackedOptions& options, const Step& step,
+                                                    Motion motion) {
+    if constexpr (I < std::variant_size_v<MotionControllers>) {
+        using Controller = std::variant_alternative_t<I, MotionControllers>;
+        if (Controller::runs(motion, options))
+            return &controllers.template emplace<I>(*this, options, step, motion);
+        return make_controller<I + 1>(controllers, options, step, motion);
+    } else return nullptr;
 }
 
-} // namespace appa
+void Chassis::motion_task(Pose target, const PackedOptions& options, const ExitFn& exit_fn,
+                          const Motion motion) {
+    // set up variables
+    const int dt = std::max(1, options.period); // ms
 
-/**
- * TODO: maybe make path struct. calculate headings in constructor and store path length
- * TODO: maybe add radius to turn so you can do arc movements
- * TODO: add new op control setting for fancy curves and scaling and deadzone
- */
+    const double derated = derate_scale.load();
+    const double max_speed = options.speed * derated;
+    const double accel = options.accel * derated;
+    const double decel = options.decel * derated;
+    const double jerk = options.jerk;
+    const double exit = options.exit;
+    const double exit_speed = options.exit_speed;
+    const double latency = options.latency;
+    const int settle = options.settle;
+    const int timeout = options.timeout;
+    const bool thru = options.flag(PackedOptions::THRU);
+    const bool relative = options.flag(PackedOptions::RELATIVE);
+    const bool sync = options.flag(PackedOptions::SYNC);
+    const bool profile = options.flag(PackedOptions::PROFILE);
+    const bool predict = options.flag(PackedOptions::PREDICT);
+    const bool lqr = lqr_turns && motion == TURN;
+    const ExitSet exits = options.exits;
+    const Point tool(options.tool_x, options.tool_y);
+    const bool tooled = tool.x != 0.0 || tool.y != 0.0;
+
+    // control on where the robot will be once the command takes effect, at the tool if it has one
+    Step step;
+    Pose& pose = step.pose;
+    pose = latency > 0 ? odom.predict(latency) : odom.get();
+    if (tooled) pose = Pose{pose.p() + tool.rotate(pose.theta), pose.theta};
+    step.max_speed = max_speed;
+    Point error, speeds;
+    double lin_speed, ang_speed;
+
+    // carry pid state over from a motion that handed off without stopping
+    const bool chain = chained;
+    chained = false;
+    const ScheduledGains& lin_gains = options.lin_PID;
+    const ScheduledGains& ang_gains = options.ang_PID;
+    if (chain) {
+        lin_pid.set_gains(lin_gains.get(0));
+        ang_pid.set_gains(ang_gains.get(0));
+    } else {
+        lin_pid = PID(lin_gains.get(0));
+        ang_pid = PID(ang_gains.get(0));
+    }
+
+    // relative motion
+    if (relative)
+        target = Pose{pose.p() + target.p().rotate(pose.theta), target.theta + pose.theta};
+    step.target = target;
+
+    // the motion's own error and output
+    MotionControllers controllers;
+    MotionController* const controller = make_controller(controllers, options, step, motion);
+    if (!controller) return;
+    const bool turning = controller->angular();
+    const MotionController::Axis axis = controller->profiles();
+
+    // a tracked object sets the target from where it was seen, from the pose the image was
+    // taken at. a move needs its range
+    bool sighted = false;
+    auto sight = [&] {
+        const Sighting sighting = tracking->sight();
+        const bool ranged = std::isfinite(sighting.distance);
+        if (!sighting.seen || (!ranged && motion != TURN)) return;
+        const Pose then = odom.get_at(sighting.time);
+        const double heading = then.theta + sighting.bearing;
+        if (ranged)
+            step.target = {then.x + sighting.distance * cos(heading),
+                           then.y + sighting.distance * sin(heading), NAN};
+        else step.target = {NAN, NAN, heading};
+        sighted = true;
+    };
+    if (tracking) sight();
+
+    // profiled motions track a position and velocity setpoint, in/s or rad/s at full speed. a
+    // tracked object has to be in sight from the start
+    const bool angular_profile = axis == MotionController::ANGULAR;
+    const double velocity = angular_profile ? to_rad(turn_velocity) : move_velocity;
+    // the drive model's wheel acceleration bounds what the options leave unset, turning at twice
+    // the wheel's acceleration over the track width (% of velocity per second). an unset decel
+    // brakes the profile at accel, only the slew takes 0 as unlimited
+    double profile_accel = accel, profile_decel = decel > 0 ? decel : accel;
+    if (kinematics.max_accel > 0 && velocity > 0) {
+        const double wheel = angular_profile && track_width > 0 ? 2 / track_width : 1.0;
+        const double limit = kinematics.max_accel * wheel / velocity * 100 * derated;
+        if (profile_accel <= 0) profile_accel = limit;
+        if (profile_decel <= 0) profile_decel = limit;
+    }
+    const bool profiled = profile && !thru && (!tracking || sighted) &&
+                          axis != MotionController::NONE && velocity > 0 && profile_accel > 0;
+    step.profiled = profiled;
+    std::optional<Profile> motion_profile;
+    double profile_sign = 1.0, profile_distance = 0.0;
+    double profile_goal = 0.0; // unwrapped heading a profiled turn ends on
+
+    // timing
+    uint32_t now;
+    step.start_time = now = clock_ms();
+    const uint32_t start_time = step.start_time;
+    uint64_t prev_time = 0;
+    double settle_time = 0;
+    bool running = true;
+    bool settling = false;
+    double traveled = 0.0;
+    Point& measured = step.measured; // forward travel and unwrapped heading, for the derivatives
+    measured = {0.0, 0.0};
+    double& total = step.total; // progress of the whole motion
+    std::array<double, ExitSet::capacity> stall_time{};
+    std::array<MovingMedian<3>, ExitSet::capacity> sensor_median; // a single bad read can't exit
+    bool track_slip = slip_threshold > 0 || launch_control.duration > 0 || debug_slip.load();
+    for (int i = 0; i < exits.size; i++) {
+        if (exits.exits[i].type == Exit::SLIP) track_slip = true;
+    }
+    Point slip = {0.0, 0.0};
+    int slip_count = 0;
+    // %/s accel limit of a launch from a stop, 0 once it's over or when the robot was moving
+    double launch_accel = launch_control.duration > 0 &&
+                                  fabs(odom.get_velocity(true).vel.x) < launch_control.standing
+                              ? launch_control.accel
+                              : 0.0;
+    // registered here rather than by the constructor, which can run before telemetry exists
+    if (debug_slip.load()) telemetry::add(slip_channel);
+    if (debug_disturbance.load()) telemetry::add(disturbance_channel);
+    const std::optional<Disturbance> observe = observer;
+    Point observed = {0.0, 0.0}; // %, the disturbance estimate
+    bool pushed = false;
+    int observe_count = 0;
+    Result result = SETTLED;
+    double final_error = NAN, peak_speed = 0.0;
+    Recorder* const record = recorder.load();
+    const Geofence* const fence = geofence.load();
+    MotionRecord sample{};
+    auto finish = [&](Result reason) {
+        if (running) result = reason;
+        running = false;
+    };
+
+    // run each step on a fresh odom sample, with the odom at its fastest from the first
+    odom.wake();
+    const pros::task_t current_task = pros::c::task_get_current();
+    if (sync) {
+        pros::c::task_notify_clear(current_task);
+        odom.subscribe(current_task);
+    }
+
+    // control loop
+    while (running && run_token == cancel_token.load()) {
+        // measure loop period
+        const uint64_t time = clock_us();
+        const bool first_step = prev_time == 0;
+        const double loop_dt = first_step ? dt : (time - prev_time) / 1000.0; // ms
+        prev_time = time;
+        step.loop_dt = loop_dt;
+
+        // find error from the motion's controller
+        const Pose prev_pose = pose;
+        pose = latency > 0 ? odom.predict(latency) : odom.get();
+        const double cos_theta = cos(pose.theta), sin_theta = sin(pose.theta);
+        if (tooled) {
+            pose.x += tool.x * cos_theta - tool.y * sin_theta;
+            pose.y += tool.x * sin_theta + tool.y * cos_theta;
+        }
+        traveled += pose.dist(prev_pose);
+        measured.linear += (pose.x - prev_pose.x) * cos_theta + (pose.y - prev_pose.y) * sin_theta;
+        measured.angular += wrap(pose.theta - prev_pose.theta);
+        if (tracking && !first_step) sight();
+        error = controller->error(step);
+        if (step.handoff) running = false;
+        if (tracking && !sighted) error = {0.0, 0.0}; // hold still until the object is seen
+
+        // publish progress
+        const double remaining = turning ? fabs(to_deg(error.angular)) : fabs(error.linear);
+        const Twist twist = odom.get_velocity(true);
+        final_error = remaining;
+        peak_speed =
+            std::max(peak_speed, turning ? fabs(to_deg(twist.vel.theta)) : fabs(twist.vel.x));
+        if (marker_path) fire_markers(controller->marker_distance(remaining));
+        if (first_step || (tracking && total == 0))
+            total = progress_total > 0 ? progress_total : remaining;
+        publish_progress({run_id, true, controller->percent(step, remaining), remaining,
+                          controller->segment(), RUNNING, error});
+
+        // replace the error with the error from the profile setpoint
+        Point pid_error = error;
+        double profile_ff = 0.0, profile_rate = 0.0; // %, and rad/s of an angular setpoint
+        if (profiled) {
+            real& profile_error = angular_profile ? pid_error.angular : pid_error.linear;
+            if (!motion_profile) {
+                profile_sign = profile_error < 0 ? -1.0 : 1.0;
+                profile_distance = fabs(profile_error);
+                profile_goal = measured.angular + error.angular;
+                const double scale = velocity / 100;
+                motion_profile.emplace(profile_distance, max_speed * scale, profile_accel * scale,
+                                       profile_decel * scale, jerk * scale);
+            } else {
+                // a point's heading changes as the robot moves, and a tracked object's as it is
+                // seen again, so the profile's end follows it from where the setpoint is
+                if (angular_profile) {
+                    const double shift = wrap(measured.angular + error.angular - profile_goal);
+                    if (shift != 0) {
+                        profile_goal += shift;
+                        profile_distance = std::max(profile_distance + profile_sign * shift,
+                                                    motion_profile->get_position());
+                        motion_profile->retarget(profile_distance);
+                    }
+                }
+                motion_profile->update(loop_dt);
+            }
+            // error from where the setpoint is, and its velocity as feedforward (%)
+            const double setpoint = profile_distance - motion_profile->get_position();
+            profile_error -= profile_sign * setpoint;
+            const double profile_vel = profile_sign * motion_profile->get_velocity();
+            const double profile_accel = profile_sign * motion_profile->get_acceleration();
+            if (angular_profile) profile_rate = profile_vel;
+            const Feedforward& ff = angular_profile ? turn_ff : move_ff;
+            if (ff) {
+                // model based feedforward with feedback from the measured wheel velocity
+                const Point wheels = get_velocity();
+                if (angular_profile)
+                    profile_ff = ff.get(to_deg(profile_vel), to_deg(profile_accel),
+                                        (wheels.right - wheels.left) / 2 * turn_velocity / 100);
+                else
+                    profile_ff = ff.get(profile_vel, profile_accel,
+                                        (wheels.left + wheels.right) / 2 * move_velocity / 100);
+            } else profile_ff = profile_vel / velocity * 100;
+        }
+
+        // scheduled gains from the error or the measured speed
+        if (lin_gains.scheduled() || ang_gains.scheduled()) {
+            const Pose vel = lin_gains.key == ScheduledGains::BY_SPEED ||
+                                     ang_gains.key == ScheduledGains::BY_SPEED
+                                 ? odom.get_velocity(true).vel
+                                 : Pose(0, 0, 0);
+            if (lin_gains.scheduled())
+                lin_pid.set_gains(lin_gains.get(lin_gains.key == ScheduledGains::BY_SPEED
+                                                    ? vel.x
+                                                    : pid_error.linear));
+            if (ang_gains.scheduled())
+                ang_pid.set_gains(ang_gains.get(to_deg(ang_gains.key == ScheduledGains::BY_SPEED
+                                                           ? vel.theta
+                                                           : pid_error.angular)));
+        }
+
+        // calculate PID, without a derivative kick from the new target when chained
+        if (chain && first_step) {
+            lin_pid.reset(pid_error.linear, false);
+            ang_pid.reset(pid_error.angular, false);
+        }
+        lin_speed = lin_pid.update(pid_error.linear, loop_dt, measured.linear);
+        ang_speed = ang_pid.update(pid_error.angular, loop_dt, measured.angular);
+        if (lqr) {
+            // state feedback on the heading error and the rate's error from the setpoint's
+            const LqrGains& k = turn_lqr[std::clamp(dt, 1, (int)turn_lqr.size()) - 1];
+            ang_speed = k.error * to_deg(pid_error.angular) +
+                        k.rate * to_deg(profile_rate - twist.vel.theta);
+        }
+        if (angular_profile) ang_speed += profile_ff;
+        else lin_speed += profile_ff;
+        controller->output(step, error, lin_speed, ang_speed);
+
+        // disturbance observer, the output of the last step the drive model doesn't explain at
+        // the measured motion, smoothed, and a share of it added back
+        if (observe && !first_step) {
+            const Point command = get_command();
+            const double linear = (command.left + command.right) / 2;
+            const double angular = (command.right - command.left) / 2;
+            const double expected_linear = move_ff ? move_ff.get(twist.vel.x, twist.accel.x)
+                                           : move_velocity > 0 ? twist.vel.x / move_velocity * 100
+                                                               : linear;
+            const double expected_angular =
+                turn_ff ? turn_ff.get(to_deg(twist.vel.theta), to_deg(twist.accel.theta))
+                : turn_velocity > 0 ? to_deg(twist.vel.theta) / turn_velocity * 100
+                                    : angular;
+            const double blend = 1 - exp(-loop_dt / std::max(observe->smoothing, 1.0));
+            observed.linear += (linear - expected_linear - observed.linear) * blend;
+            observed.angular += (angular - expected_angular - observed.angular) * blend;
+            disturbance.write(observed);
+            pushed = fabs(observed.linear) > observe->push;
+            const double gain = std::clamp(observe->gain, 0.0, 0.9);
+            lin_speed += gain * observed.linear;
+            ang_speed += gain * observed.angular;
+            if (debug_disturbance.load() && !(++observe_count % 10))
+                disturbance_channel.push(
+                    {pros::millis(), {(float)observed.linear, (float)observed.angular}});
+        }
+        const bool boosted = pushed && observe->boost;
+
+        // no faster than the geofence allows where the robot is or is about to be
+        if (fence) {
+            const double cap = std::min(fence->speed(pose.p()),
+                                        fence->speed(odom.predict(fence->lead).p()));
+            lin_speed = limit(lin_speed, cap);
+        }
+
+        // apply limits, lifted while a boost pushes back
+        lin_speed = limit(lin_speed, boosted ? 100.0 : max_speed);
+        ang_speed = limit(ang_speed, boosted ? 100.0 : max_speed);
+
+        // calculate and scale motor speeds
+        speeds = desaturate(controller->wheels(lin_speed, ang_speed, max_speed));
+
+        // wheel slip, easing off the acceleration while the wheels spin faster than the robot moves
+        if (track_slip) slip = get_slip();
+        if (debug_slip.load() && !(++slip_count % 10)) {
+            const double odom_speed = odom.get_velocity(true).vel.x;
+            slip_channel.push({pros::millis(),
+                               {(float)(odom_speed + slip.linear), (float)odom_speed,
+                                (float)slip.linear, (float)slip.angular}});
+        }
+        const double slip_scale =
+            slip_threshold > 0 && fabs(slip.linear) > slip_threshold ? slip_accel : 1.0;
+
+        // anti tip, leaning past the angle or further at the rate caps the slew limits
+        double tip_accel = 0.0;
+        if (anti_tip.accel > 0) {
+            const OdomBase::Tilt tilt = odom.get_tilt();
+            auto tipping = [&](double angle, double rate) {
+                return fabs(angle) > anti_tip.angle ||
+                       (angle * rate > 0 && fabs(rate) > anti_tip.rate);
+            };
+            if (tipping(tilt.pitch - anti_tip.level.x, tilt.pitch_rate) ||
+                tipping(tilt.roll - anti_tip.level.y, tilt.roll_rate))
+                tip_time = std::max(clock_ms(), 1u);
+            if (tip_time && clock_ms() - tip_time < anti_tip.hold) tip_accel = anti_tip.accel;
+        }
+        auto capped = [&](double limit) {
+            return tip_accel > 0 && (limit <= 0 || limit > tip_accel) ? tip_accel : limit;
+        };
+
+        // launch control, the accel limit cut while the wheels slip and climbing back while they
+        // grip, until the launch is over
+        if (launch_accel > 0) {
+            if (clock_ms() - start_time >= (uint32_t)launch_control.duration) launch_accel = 0.0;
+            else if (fabs(slip.linear) > launch_control.slip)
+                launch_accel = std::max(launch_accel * exp(-loop_dt / launch_control.cut),
+                                        launch_control.min_accel);
+            else
+                launch_accel = std::min(launch_accel + launch_control.rise * loop_dt / 1000,
+                                        launch_control.accel);
+        }
+        auto launched = [&](double limit) {
+            return launch_accel > 0 && (limit <= 0 || limit > launch_accel) ? launch_accel : limit;
+        };
+
+        // set motor speeds, slew limited unless the profile already limits them. a cancel since
+        // the step started leaves the drive to whoever cancelled, and exit_motion() to the brake
+        if (run_token != cancel_token.load()) break;
+        if (exit_id.load() == run_id) {
+            finish(EXITED);
+            break;
+        }
+        if ((profiled && tip_accel == 0 && launch_accel == 0) || boosted) tank(speeds);
+        else drive(speeds, launched(capped(accel * slip_scale)), capped(decel), loop_dt);
+
+        // check exit conditions
+        //   timeout
+        if (timeout > 0 && clock_ms() - start_time > timeout) finish(TIMED_OUT);
+        //   exit error
+        const double exit_error = turning ? to_rad(exit) : exit;
+        const double settle_error = turning ? error.angular : error.linear;
+        settling = fabs(settle_error) < exit_error && controller->finished(step) &&
+                   (!tracking || sighted);
+        //   settling
+        if (settling) {
+            if (settle_time == 0 && run_hooks.settle) {
+                MotionResult result = motion_result;
+                result.time = clock_ms() - run_start;
+                result.error = final_error;
+                result.peak_speed = std::max(result.peak_speed, peak_speed);
+                run_hooks.settle(result);
+            }
+            settle_time += loop_dt;
+            if (settle_time >= settle) finish(SETTLED);
+        } else settle_time = 0;
+        //   stopped in tolerance, or predicted to stop in tolerance at the current decel
+        if ((exit_speed > 0 && settling) || (predict && !controller->hands_off())) {
+            const Twist twist = odom.get_velocity(true);
+            const double vel = turning ? twist.vel.theta : twist.vel.x;
+            const double acc = turning ? twist.accel.theta : twist.accel.x;
+            const double speed = turning ? fabs(to_deg(vel)) : twist.vel.p().dist({0, 0});
+            if (exit_speed > 0 && settling && speed < exit_speed) finish(SETTLED);
+            if (predict && vel * acc < 0 && controller->finished(step) &&
+                (!tracking || sighted)) {
+                const double stop_distance = vel * fabs(vel) / (2 * fabs(acc));
+                if (fabs(settle_error - stop_distance) < exit_error) finish(SETTLED);
+            }
+        }
+        //   built in conditions
+        for (int i = 0; i < exits.size; i++) {
+            const Exit& condition = exits.exits[i];
+            switch (condition.type) {
+            case Exit::DISTANCE:
+                if (traveled >= condition.value) finish(EXITED);
+                break;
+            case Exit::TIME:
+                if (clock_ms() - start_time >= condition.value) finish(EXITED);
+                break;
+            case Exit::STALL: {
+                const Twist twist = odom.get_velocity();
+                const double speed = turning ? fabs(to_deg(twist.vel.theta)) : twist.speed();
+                stall_time[i] = speed < condition.value ? stall_time[i] + loop_dt : 0.0;
+                if (stall_time[i] >= condition.time) finish(STALLED);
+                break;
+            }
+            case Exit::SLIP:
+                stall_time[i] = fabs(slip.linear) > condition.value ? stall_time[i] + loop_dt : 0.0;
+                if (stall_time[i] >= condition.time) finish(STALLED);
+                break;
+            case Exit::STUCK: {
+                // pushing hard without moving
+                const Twist twist = odom.get_velocity();
+                const double speed = turning ? fabs(to_deg(twist.vel.theta)) : twist.speed();
+                const double output = std::max(fabs(speeds.left), fabs(speeds.right));
+                const bool stuck = speed < condition.value && output >= condition.output;
+                stall_time[i] = stuck ? stall_time[i] + loop_dt : 0.0;
+                if (stall_time[i] >= condition.time) finish(STALLED);
+                break;
+            }
+            case Exit::CURRENT:
+                stall_time[i] = get_current() > condition.value ? stall_time[i] + loop_dt : 0.0;
+                if (stall_time[i] >= condition.time) finish(STALLED);
+                break;
+            case Exit::PUSH:
+                stall_time[i] = observe && fabs(observed.linear) > condition.value
+                                    ? stall_time[i] + loop_dt
+                                    : 0.0;
+                if (stall_time[i] >= condition.time) finish(STALLED);
+                break;
+            case Exit::IMPACT: {
+                // slowing down harder than the drive can brake
+                const Twist twist = odom.get_velocity(true);
+                if (twist.vel.x * twist.accel.x < 0 && fabs(twist.accel.x) > condition.value)
+                    finish(STALLED);
+                break;
+            }
+            case Exit::BELOW:
+                if (condition.sensor &&
+                    sensor_median[i].update(condition.sensor()) < condition.value)
+                    finish(EXITED);
+                break;
+            case Exit::ABOVE:
+                if (condition.sensor &&
+                    sensor_median[i].update(condition.sensor()) > condition.value)
+                    finish(EXITED);
+                break;
+            default:
+                break;
+            }
+        }
+        //   custom lambda
+        if (exit_fn && exit_fn()) finish(EXITED);
+
+        // trace of this step, copied into the recorder's queue
+        if (record) {
+            const PID::Terms lin = lin_pid.terms(), ang = ang_pid.terms();
+            const Twist twist = odom.get_velocity(true);
+            sample = {.id = run_id,
+                      .time = clock_ms() - start_time,
+                      .motion = (uint8_t)motion,
+                      .result = RUNNING,
+                      .settling = settling,
+                      .target_x = (float)step.target.x,
+                      .target_y = (float)step.target.y,
+                      .target_theta = (float)step.target.theta,
+                      .x = (float)pose.x,
+                      .y = (float)pose.y,
+                      .theta = (float)pose.theta,
+                      .error_linear = (float)error.linear,
+                      .error_angular = (float)error.angular,
+                      .lin_p = (float)lin.p,
+                      .lin_i = (float)lin.i,
+                      .lin_d = (float)lin.d,
+                      .ang_p = (float)ang.p,
+                      .ang_i = (float)ang.i,
+                      .ang_d = (float)ang.d,
+                      .command_left = (float)speeds.left,
+                      .command_right = (float)speeds.right,
+                      .velocity_linear = (float)twist.vel.x,
+                      .velocity_angular = (float)twist.vel.theta};
+            record->push(sample);
+        }
+
+        // cost of this step, motions run one at a time so there is a single writer
+        LoopTiming timing = motion_timing.read();
+        timing.record(first_step ? 0 : loop_dt * 1000, clock_us() - time, dt * 1000);
+        motion_timing.write(timing);
+        APPA_TRACE_SPAN("motion step", time);
+
+        // delay task, or in a dry run move the drive model on by the period instead
+        if (simulation) {
+            simulate(dt);
+            now = clock_ms();
+        } else if (sync) {
+            // wake on the first odom sample close to the next period
+            const uint32_t deadline = now + dt;
+            const int32_t early = std::min(2, dt / 2);
+            while (pros::c::task_notify_take(true, dt) &&
+                   (int32_t)(deadline - pros::millis()) > early && exit_id.load() != run_id) {}
+            now = pros::millis();
+        } else {
+            // like task_delay_until, but woken by exit_motion()
+            now += dt;
+            while ((int32_t)(now - pros::millis()) > 0 && exit_id.load() != run_id)
+                pros::c::task_notify_take(true, now - pros::millis());
+        }
+    }
+    if (sync) odom.unsubscribe(current_task);
+
+    motion_result.reason = run_token == cancel_token.load() ? result : CANCELLED;
+    if (record && prev_time) {
+        // the last step again with how the motion ended, which closes the recording
+        sample.result = motion_result.reason;
+        record->push(sample);
+    }
+    motion_result.error = final_error;
+    motion_result.peak_speed = std::max(motion_result.peak_speed, peak_speed);
+
+    // keep driving into the next segment or queued motion
+    const bool handoff = thru || controller->hands_off() || queued() > 0;
+    chained = run_token == cancel_token.load() && handoff;
+    if (!handoff && run_token == cancel_token.load())
+        brake(options.has(PackedOptions::BRAKE) ? options.brake : brake_policy.settled);
+    else if (!handoff && override_token.load() != cancel_token.load()) tank(0, 0);
+}
+
+Chassis::MotionResult Chassis::run(const Command& command) {
+    if (command.token != cancel_token.load()) return {CANCELLED}; // cancelled before it started
+    PerformanceLog* const log = performance.load();
+    const double size = log || command.options.timeout == AUTO_TIMEOUT
+                            ? extent(command, odom.get())
+                            : NAN;
+    if (command.options.timeout == AUTO_TIMEOUT) {
+        Command timed = command;
+        timed.options.timeout = auto_timeout(command, size);
+        return run(timed);
+    }
+    APPA_PROFILE_SCOPE("motion");
+    if (simulation) catch_up();
+    preferred_dir = preferred_turn = AUTO;
+    if (direction_choice.fastest) choose_direction(command);
+    apply_brake(brake_policy.motion, brake_policy.motion);
+    const uint32_t start_time = clock_ms();
+    motion_result = {};
+    motion_result.id = command.id;
+    run_start = start_time;
+    run_hooks = hooks.read();
+    if (run_hooks.start) run_hooks.start(motion_result);
+    run_token = command.token;
+    run_id = command.id;
+    active.fetch_add(1);
+    const pros::task_t previous_task = active_task.exchange(pros::c::task_get_current());
+
+    if (command.motion == PATH) {
+        const Path* path = command.path.get(); // until update_path() replaces it
+        PackedOptions options = command.options;
+
+        // relative paths are transformed from the pose at the start of the motion
+        const Pose start = odom.get();
+        const bool relative = options.flag(PackedOptions::RELATIVE);
+        options.set_flag(PackedOptions::RELATIVE, false);
+        auto target = [&](int i) {
+            const Pose& pose = (*path)[i];
+            if (!relative) return pose;
+            return Pose{start.p() + pose.p().rotate(start.theta), pose.theta + start.theta};
+        };
+
+        // pursue each stretch between cusps in one loop, stopping on the cusp before the next
+        // drives the other way, then finish with a move to the last pose
+        path_learning = learning.load();
+        if (path_learning) path_learning->begin(path->length());
+        marker_path = path;
+        path_frame = relative ? start : Pose{0.0, 0.0, 0.0};
+        path_index = 0;
+        marker_index = 0;
+        progress_total = path->length();
+        next_path.store(nullptr);
+        const Direction dir = options.dir;
+        const double offset = options.offset;
+        // a move onto a point under the path's overrides there
+        auto overridden = [&](PackedOptions move, int point) {
+            const PathOverride at = path->overrides_at(point);
+            if (!std::isnan(at.speed)) move.speed = std::min<double>(move.speed, at.speed);
+            if (!std::isnan(at.exit)) move.exit = at.exit;
+            return move;
+        };
+        while (path->size() > 1) {
+            const int first = path_index;
+            options.dir = !path->reversed(first) ? dir : dir == REVERSE ? FORWARD : REVERSE;
+            options.offset = path->cusp(first) == path->size() - 1 ? offset : 0.0;
+            follow_path = path;
+            pursuing.store(true);
+            motion_task(target(path->cusp(first)), options, command.exit_fn, PATH);
+            pursuing.store(false);
+            path = follow_path; // the stretch may have moved onto a new path
+            follow_path = nullptr;
+            const int end = path->cusp(path_index);
+            const bool last = end == path->size() - 1;
+            if (last || motion_result.reason == STALLED || run_token != cancel_token.load()) break;
+
+            // come to a stop on the cusp, without carrying pid state into the other direction
+            PackedOptions stop = overridden(options, end);
+            stop.set_flag(PackedOptions::THRU, false);
+            progress_total = path->distance(end);
+            progress_segment = end - 1;
+            motion_task(Pose{target(end).p(), NAN}, stop, command.exit_fn, MOVE);
+            progress_total = path->length();
+            chained = false;
+            tank(0, 0);
+            if (motion_result.reason == STALLED || run_token != cancel_token.load()) break;
+            path_index = end;
+        }
+        next_path.store(nullptr); // too late for the final move
+        options.offset = offset;
+        progress_segment = std::max(0, (int)path->size() - 2);
+        Pose last = target(path->size() - 1);
+        if (path->size() == 1) last.theta = start.p().angle(last);
+        // a final heading of its own turns the robot onto it on the way in, instead of after
+        if (!std::isnan(command.target.theta))
+            last.theta = command.target.theta + (relative ? start.theta : 0.0);
+        if (motion_result.reason != STALLED)
+            motion_task(last, overridden(options, path->size() - 1), command.exit_fn, MOVE);
+        if (run_token == cancel_token.load()) fire_markers(path->length()); // reached the end
+        // a run that settled on the route it learns, not one updated partway
+        if (path_learning) {
+            path_learning->finish(run_token == cancel_token.load() &&
+                                  path == command.path.get() && motion_result.reason == SETTLED);
+        }
+        path_learning = nullptr;
+        marker_path = nullptr;
+        progress_total = 0.0;
+        progress_segment = -1;
+    } else if (command.motion == TRAJECTORY) {
+        const Trajectory& trajectory = *command.trajectory;
+        PackedOptions options = command.options;
+
+        // relative trajectories are transformed from the pose at the start of the motion
+        const Pose start = odom.get();
+        path_frame = options.flag(PackedOptions::RELATIVE) ? start : Pose{0.0, 0.0, 0.0};
+        options.set_flag(PackedOptions::RELATIVE, false);
+        follow_trajectory = &trajectory;
+        const TrajectorySample last = trajectory.at(trajectory.duration());
+        const Pose end = {path_frame.p() + last.pose.p().rotate(path_frame.theta),
+                          last.pose.theta + path_frame.theta};
+        motion_task(end, options, command.exit_fn, TRAJECTORY);
+        follow_trajectory = nullptr;
+        // then onto the end from wherever the robot lags it, as a path's final move
+        if (motion_result.reason != STALLED && run_token == cancel_token.load())
+            motion_task(end, options, command.exit_fn, MOVE);
+    } else if (command.motion == SWING) {
+        // hold the locked side so the robot pivots on it
+        const bool left = command.radius > 0;
+        const pros::motor_brake_mode_e brake = brake_mode(left);
+        constexpr pros::motor_brake_mode_e hold = pros::E_MOTOR_BRAKE_HOLD;
+        constexpr pros::motor_brake_mode_e keep = pros::E_MOTOR_BRAKE_INVALID;
+        apply_brake(left ? hold : keep, left ? keep : hold);
+        arc_radius = command.radius;
+        motion_task(command.target, command.options, command.exit_fn, SWING);
+        // put back unless the motion stopped into a mode of its own
+        const bool settled = !chained && motion_result.reason != CANCELLED &&
+                             (command.options.has(PackedOptions::BRAKE) ||
+                              brake_policy.settled != pros::E_MOTOR_BRAKE_INVALID);
+        if (!settled) apply_brake(left ? brake : keep, left ? keep : brake);
+    } else {
+        arc_radius = command.radius;
+        tracking = command.object;
+        motion_task(command.target, command.options, command.exit_fn, command.motion);
+        tracking = nullptr;
+    }
+
+    // finished unless cancelled
+    Progress progress = motion_progress.read();
+    progress.id = run_id;
+    progress.running = false;
+    motion_result.time = clock_ms() - start_time;
+    if (run_token != cancel_token.load()) motion_result.reason = CANCELLED;
+    progress.result = motion_result.reason;
+    last_result.write(motion_result);
+    if (progress.result != CANCELLED) progress.percent = 100.0;
+    if (simulation) {
+        simulation->report->results.push_back(motion_result);
+        simulation->real = pros::millis();
+    }
+    // a hold has no length to learn, and a dry run's model isn't the robot
+    if (log && command.motion != HOLD && std::isfinite(size) && !simulation)
+        log->push({(uint8_t)command.motion, (uint8_t)motion_result.reason, 0, (float)size,
+                   (float)motion_result.time, (float)motion_result.error});
+    publish_progress(progress);
+    const auto hook = motion_result.reason == CANCELLED ? run_hooks.cancel : run_hooks.exit;
+    if (hook) hook(motion_result);
+
+    // acknowledge to a cancel waiting on this motion
+    active_task.store(previous_task);
+    active.fetch_sub(1);
+    const pros::task_t waiter = cancel_waiter.load();
+    if (waiter) pros::c::task_notify(waiter);
+    return motion_result;
+}
+
+Chassis::MotionResult Chassis::motion_handler(const Command& command, bool mapped) {
+    // stop the current motion if chassis is already moving, unless queueing
+    const bool queue = command.options.flag(PackedOptions::QUEUE) && !simulation;
+    if (!queue) cancel();
+    Command issued_command = mapped || field.identity() ? command : to_field(command);
+    issued_command.id = issued.fetch_add(1) + 1;
+
+    // run inline if not async, as every motion of a dry run does
+    const bool async = !simulation && (command.options.flag(PackedOptions::ASYNC) ||
+                                       pros::c::task_get_current() == routine_task.load());
+    if (!async && !queue) {
+        issued_command.token = cancel_token.load();
+        return run(issued_command);
+    }
+
+    // hand off to the worker, starting it the first time
+    start_worker();
+    push(issued_command);
+    MotionResult handed_off;
+    handed_off.id = issued_command.id;
+    return handed_off;
+}
+
+// maps a command's targets onto the field once, so the control loop never transforms anything
+Chassis::Command Chassis::to_field(Command command) const {
+    // relative targets are in the robot's frame, where only a mirror changes anything
+    const bool mirrored = field.mirrored();
+    const FieldTransform frame = !command.options.flag(PackedOptions::RELATIVE) ? field
+                                 : mirrored ? FieldTransform::mirror_y(0.0)
+                                            : FieldTransform();
+
+    switch (command.motion) {
+    case MOVE:
+    case STRAIGHT:
+    case TURN:
+    case SWING:
+    case HOLD:
+        command.target = frame.pose(command.target);
+        if (command.motion == SWING && mirrored) command.radius = -command.radius; // other side
+        break;
+    case ARC:
+        if (mirrored) command.target.theta = -command.target.theta;
+        break;
+    case PATH:
+        if (!frame.identity())
+            command.path = std::make_shared<const Path>(command.path->transform(frame));
+        command.target.theta = frame.heading(command.target.theta); // the final heading
+        break;
+    case TRAJECTORY:
+        if (!frame.identity())
+            command.trajectory =
+                std::make_shared<const Trajectory>(command.trajectory->transform(frame));
+        break;
+    }
+
+    // a mirrored routine turns the other way
+    if (mirrored && command.options.turn == CW) command.options.turn = CCW;
+    else if (mirrored && command.options.turn == CCW) command.options.turn = CW;
+    return command;
+}
+
+/* Motions */
+// each motion's command is built the same way whether it runs now or is prepared for later
+std::optional<Chassis::Command> Chassis::move_command(Pose target, Options options,
+                                                      const Options& override) {
+    // configure target
+    Motion motion = MOVE;
+    if (std::isnan(target.y)) { // relative straight, holding the heading
+        target.y = 0.0;
+        options.relative = true;
+        options.dir = AUTO;
+        motion = STRAIGHT;
+    }
+    if (!std::isnan(target.theta)) target.theta = to_rad(target.theta);
+
+    // merge options
+    PackedOptions merged = df_move << options << override;
+    if (merged.flag(PackedOptions::MPC) && (track_width <= 0 || move_velocity <= 0)) {
+        printf("move: mpc needs the track width and velocity in the move config\n");
+        merged.set_flag(PackedOptions::MPC, false);
+    }
+    if (merged.flag(PackedOptions::MPC)) motion = MOVE; // mpc drives to the point itself
+    return Command{target, nullptr, merged, motion, nullptr, merge_exit_fn(options, override)};
+}
+
+std::optional<Chassis::Command> Chassis::turn_command(const Point& target, Options options,
+                                                      const Options& override) {
+    // configure target
+    Pose target_pose;
+    if (std::isnan(target.y)) target_pose.theta = to_rad(target.x);
+    else target_pose = target;
+
+    // merge options
+    const PackedOptions merged = df_turn << options << override;
+    return Command{target_pose, nullptr, merged, TURN, nullptr, merge_exit_fn(options, override)};
+}
+
+// turns with one side held still, pivoting on it
+std::optional<Chassis::Command> Chassis::swing_command(const Point& target, Side locked,
+                                                       Options options, const Options& override) {
+    // configure target
+    Pose target_pose;
+    if (std::isnan(target.y)) target_pose.theta = to_rad(target.x);
+    else target_pose = target;
+
+    // merge options
+    const PackedOptions merged = df_turn << options << override;
+    Command command = {target_pose, nullptr, merged, SWING, nullptr,
+                       merge_exit_fn(options, override)};
+    command.radius = locked == Side::LEFT ? 1.0 : -1.0;
+    return command;
+}
+
+// drives a circular arc of radius (in) turning by angle (deg, counterclockwise)
+std::optional<Chassis::Command> Chassis::arc_command(double radius, double angle, Options options,
+                                                     const Options& override) {
+    if (radius <= 0 || track_width <= 0) {
+        printf("arc: needs a positive radius and the track width in the move config\n");
+        return std::nullopt;
+    }
+
+    // merge options, arcs always start from the current pose
+    PackedOptions merged = df_move << options << override;
+    merged.set_flag(PackedOptions::RELATIVE, false);
+    Command command = {{0.0, 0.0, to_rad(angle)}, nullptr, merged, ARC, nullptr,
+                       merge_exit_fn(options, override)};
+    command.radius = radius;
+    return command;
+}
+
+// the path must outlive the motion when running async
+std::optional<Chassis::Command> Chassis::follow_command(const Path& path, Options options,
+                                                        const Options& override) {
+    if (path.size() == 0) return std::nullopt;
+
+    // merge options, referencing the path without taking ownership. the target only holds the
+    // final heading, nan for the path's own
+    const PackedOptions merged = df_move << options << override;
+    return Command{{NAN, NAN, to_rad(merged.heading)},
+                   std::shared_ptr<const Path>(std::shared_ptr<const Path>(), &path), merged, PATH,
+                   nullptr, merge_exit_fn(options, override)};
+}
+
+std::optional<Chassis::Command> Chassis::follow_command(const std::vector<Point>& path,
+                                                        Options options,
+                                                        const Options& override) {
+    if (path.empty()) return std::nullopt;
+
+    // merge options, owning a path built from the points
+    const PackedOptions merged = df_move << options << override;
+    return Command{{NAN, NAN, to_rad(merged.heading)}, std::make_shared<const Path>(path), merged,
+                   PATH, nullptr, merge_exit_fn(options, override)};
+}
+
+std::optional<Chassis::Command> Chassis::track_command(const Trajectory& trajectory,
+                                                       Options options, const Options& override) {
+    // the controller outputs velocities, so it needs the drivetrain speed
+    if (trajectory.size() == 0 || move_velocity <= 0 || turn_velocity <= 0) {
+        printf("track: needs a trajectory and the velocity in both configs\n");
+        return std::nullopt;
+    }
+
+    // merge options
+    const PackedOptions merged = df_move << options << override;
+    return Command{{}, nullptr, merged, TRAJECTORY,
+                   std::shared_ptr<const Trajectory>(std::shared_ptr<const Trajectory>(),
+                                                     &trajectory),
+                   merge_exit_fn(options, override)};
+}
+
+// the target is filled in by the sightings, on the odom's own frame
+std::optional<Chassis::Command> Chassis::object_command(ObjectSensor& sensor, Motion motion,
+                                                        Options options, const Options& override) {
+    // merge options
+    PackedOptions merged = (motion == TURN ? df_turn : df_move) << options << override;
+    merged.set_flag(PackedOptions::RELATIVE, false);
+    Command command{{NAN, NAN, NAN}, nullptr, merged, motion, nullptr,
+                    merge_exit_fn(options, override)};
+    command.object = &sensor;
+    return command;
+}
+
+std::optional<Chassis::Command> Chassis::hold_command(Pose target, Options options,
+                                                      const Options& override) {
+    if (!std::isnan(target.theta)) target.theta = to_rad(target.theta);
+
+    // in the background at the hold's period until cancelled, with no exit a push could trip
+    PackedOptions merged = df_move << Options{.timeout = 0,
+                                              .period = holding.period,
+                                              .thru = false,
+                                              .async = true,
+                                              .profile = false,
+                                              .predict = false};
+    merged.exits = ExitSet();
+    merged <<= PackedOptions(options) << override;
+    return Command{target, nullptr, merged, HOLD, nullptr, merge_exit_fn(options, override)};
+}
+
+Chassis::MotionResult Chassis::issue(const std::optional<Command>& command) {
+    if (!command) return {CANCELLED};
+    return motion_handler(*command);
+}
+
+// in a motion drives, or deg it turns, from pose. nan for a tracked object, only found as it runs
+double Chassis::extent(const Command& command, const Pose& pose) const {
+    if (command.object) return NAN;
+    Pose target = command.target;
+    if (command.options.flag(PackedOptions::RELATIVE))
+        target = Pose{pose.p() + target.p().rotate(pose.theta), target.theta + pose.theta};
+    switch (command.motion) {
+    case MOVE:
+    case STRAIGHT:
+    case HOLD:
+        return pose.dist(target);
+    case TURN:
+    case SWING:
+        return fabs(to_deg(turn_error(command.options, pose, target)));
+    case ARC:
+        return fabs(command.radius * command.target.theta);
+    case PATH:
+        return command.path->length();
+    case TRAJECTORY: {
+        const Trajectory& trajectory = *command.trajectory;
+        double distance = 0.0;
+        for (size_t i = 1; i < trajectory.size(); i++)
+            distance += trajectory[i].pose.dist(trajectory[i - 1].pose);
+        return distance;
+    }
+    }
+    return NAN;
+}
+
+// ms for an AUTO_TIMEOUT, from how long similar motions took in the performance log, or without
+// enough of them well over the estimate, which leaves out the controllers slowing the last inches.
+// 0, none, without either
+int Chassis::auto_timeout(const Command& command, double extent) {
+    PerformanceLog* const log = performance.load();
+    double time = log && std::isfinite(extent) ? log->timeout(command.motion, extent) : NAN;
+    if (std::isnan(time) && !command.object && move_velocity > 0 && turn_velocity > 0) {
+        Prepared prepared;
+        prepared.command = prepared.mapped = command; // already on the field
+        prepared.field = field;
+        prepared.valid = true;
+        time = 3 * estimate(prepared).time + 1000;
+    }
+    return std::isfinite(time) ? (int)ceil(time) : 0;
+}
+
+Chassis::MotionResult Chassis::move(Pose target, Options options, const Options& override) {
+    return issue(move_command(target, std::move(options), override));
+}
+Chassis::MotionResult Chassis::turn(const Point& target, Options options,
+                                    const Options& override) {
+    return issue(turn_command(target, std::move(options), override));
+}
+Chassis::MotionResult Chassis::swing(const Point& target, Side locked, Options options,
+                                     const Options& override) {
+    return issue(swing_command(target, locked, std::move(options), override));
+}
+Chassis::MotionResult Chassis::arc(double radius, double angle, Options options,
+                                   const Options& override) {
+    return issue(arc_command(radius, angle, std::move(options), override));
+}
+Chassis::MotionResult Chassis::follow(const Path& path, Options options,
+                                      const Options& override) {
+    return issue(follow_command(path, std::move(options), override));
+}
+Chassis::MotionResult Chassis::follow(const std::vector<Point>& path, Options options,
+                                      const Options& override) {
+    return issue(follow_command(path, std::move(options), override));
+}
+Chassis::MotionResult Chassis::track(const Trajectory& trajectory, Options options,
+                                     const Options& override) {
+    return issue(track_command(trajectory, std::move(options), override));
+}
+Chassis::MotionResult Chassis::turn_to_object(ObjectSensor& sensor, Options options,
+                                              const Options& override) {
+    return issue(object_command(sensor, TURN, std::move(options), override));
+}
+Chassis::MotionResult Chassis::drive_to_object(ObjectSensor& sensor, Options options,
+                                               const Options& override) {
+    return issue(object_command(sensor, MOVE, std::move(options), override));
+}
+Chassis::MotionResult Chassis::move_to_range(RangeSensor& sensor, double distance,
+                                             Options options, const Options& override) {
+    // stop where the tracking center is as far from what the sensor sees as at the distance
+    std::optional<Command> command = object_command(sensor, MOVE, std::move(options), override);
+    command->options.offset += sensor.reach(distance);
+    return issue(command);
+}
+Chassis::MotionResult Chassis::hold(Pose target, Options options, const Options& override) {
+    return issue(hold_command(target, std::move(options), override));
+}
+
+// taken by the follower on its next control step, a later call before then replaces this one
+bool Chassis::update_path(const Path& path) {
+    if (path.size() < 2) {
+        printf("update_path: needs at least 2 points\n");
+        return false;
+    }
+    if (!pursuing.load()) return false;
+    next_path.store(&path);
+    return true;
+}
+
+/* Prepared motions */
+Chassis::Prepared::operator bool() const { return valid; }
+
+Chassis::Prepared Chassis::prepare(const std::optional<Command>& command) {
+    Prepared prepared;
+    if (!command) return prepared;
+    prepared.command = *command;
+    prepared.field = field;
+    prepared.mapped = field.identity() ? *command : to_field(*command);
+    prepared.valid = true;
+
+    // start the worker now rather than when the first async motion runs
+    const bool async = command->options.flag(PackedOptions::ASYNC) ||
+                       command->options.flag(PackedOptions::QUEUE);
+    if (async) start_worker();
+    return prepared;
+}
+
+Chassis::Prepared Chassis::prepare_move(Pose target, Options options, const Options& override) {
+    return prepare(move_command(target, std::move(options), override));
+}
+Chassis::Prepared Chassis::prepare_turn(const Point& target, Options options,
+                                        const Options& override) {
+    return prepare(turn_command(target, std::move(options), override));
+}
+Chassis::Prepared Chassis::prepare_swing(const Point& target, Side locked, Options options,
+                                         const Options& override) {
+    return prepare(swing_command(target, locked, std::move(options), override));
+}
+Chassis::Prepared Chassis::prepare_arc(double radius, double angle, Options options,
+                                       const Options& override) {
+    return prepare(arc_command(radius, angle, std::move(options), override));
+}
+Chassis::Prepared Chassis::prepare_follow(const Path& path, Options options,
+                                          const Options& override) {
+    return prepare(follow_command(path, std::move(options), override));
+}
+Chassis::Prepared Chassis::prepare_follow(const std::vector<Point>& path, Options options,
+                                          const Options& override) {
+    return prepare(follow_command(path, std::move(options), override));
+}
+Chassis::Prepared Chassis::prepare_track(const Trajectory& trajectory, Options options,
+                                         const Options& override) {
+    return prepare(track_command(trajectory, std::move(options), override));
+}
+
+// runs the motion as it was prepared, mapping it again only if the field changed since
+Chassis::MotionResult Chassis::run(const Prepared& prepared) {
+    if (!prepared) return {CANCELLED};
+    if (prepared.field != field) return motion_handler(prepared.command);
+    return motion_handler(prepared.mapped, true);
+}
+
+// async on the worker whatever the options say, replacing any running motion
+Chassis::MotionResult Chassis::assist(const Prepared& prepared) {
+    if (!prepared) return {CANCELLED};
+    Prepared copy = prepared;
+    for (Command* command : {&copy.command, &copy.mapped}) {
+        command->options.set_flag(PackedOptions::ASYNC, true);
+        command->options.set_flag(PackedOptions::QUEUE, false);
+    }
+    const MotionResult result = run(copy);
+    assist_id.store(result.id);
+    return result;
+}
+
+bool Chassis::assisting() {
+    const uint32_t id = assist_id.load();
+    return id != 0 && !finished(id);
+}
+
+// true while an assist has the drive and the driver leaves it. the first speed off zero cancels
+// it without waiting, and the motion then leaves the motors to the driver instead of stopping
+bool Chassis::assisted(const Point& speeds) {
+    if (assist_id.load() == 0) return false;
+    if (!assisting()) {
+        assist_id.store(0);
+        return false;
+    }
+    if (speeds.left == 0 && speeds.right == 0) return true;
+    assist_id.store(0);
+    override_token.store(cancel_token.fetch_add(1) + 1);
+    return false;
+}
+
+/* Estimates */
+// s from rest to rest over distance at speed, ramping at accel and decel (units/s and units/s²).
+// an unlimited accel or decel is infinite, and a limited jerk adds a/jerk to each ramp
+static double ramp_time(double distance, double speed, double accel, double decel, double jerk) {
+    if (distance <= 0) return 0.0;
+    const double inverse = 1 / accel + 1 / decel; // s² per unit/s of speed ramped up and down
+    const double peak =
+        speed * speed * inverse / 2 <= distance ? speed : sqrt(2 * distance / inverse);
+    double time = peak * inverse + (distance - peak * peak * inverse / 2) / peak;
+    if (jerk > 0) time += (std::isfinite(accel) ? accel : 0.0) / jerk +
+                         (std::isfinite(decel) ? decel : 0.0) / jerk;
+    return time;
+}
+
+// s for a pid to close an error to the exit. it drives the error down at output% of velocity, so
+// an exponential with a time constant of 100 / (kp * velocity), until static friction holds its
+// output at ks and the rest closes at that speed
+static double approach_time(double error, double exit, double kp, double ks, double velocity) {
+    if (error <= exit || kp <= 0 || velocity <= 0) return 0.0;
+    const double floor = std::max(exit, ks / kp); // where ks takes over from the pid
+    double time = 0.0;
+    if (error > floor) time += 100 / (kp * velocity) * log(error / std::max(floor, 1e-3));
+    if (ks > 0 && floor > exit) time += (std::min(error, floor) - exit) / (ks / 100 * velocity);
+    return time;
+}
+
+Chassis::Estimate Chassis::estimate(const Prepared& motion, std::optional<Pose> start) {
+    Estimate estimate;
+    if (!motion) return estimate;
+    if (move_velocity <= 0 || turn_velocity <= 0) {
+        printf("estimate: needs the velocity in both configs\n");
+        return estimate;
+    }
+    const Command command = motion.field != field ? to_field(motion.command) : motion.mapped;
+    const PackedOptions& options = command.options;
+    const Pose pose = start ? *start : odom.get();
+    estimate.end = pose;
+
+    // limits in units of the motion, the options' % of full speed converted by its velocity
+    const bool thru = options.flag(PackedOptions::THRU);
+    auto limits = [&](double velocity, double& speed, double& accel, double& decel) {
+        const double scale = velocity / 100;
+        speed = options.speed * scale;
+        accel = options.accel > 0 ? options.accel * scale : INFINITY;
+        decel = thru ? INFINITY : options.decel > 0 ? options.decel * scale : accel;
+    };
+    Pose target = command.target;
+    if (options.flag(PackedOptions::RELATIVE))
+        target = Pose{pose.p() + target.p().rotate(pose.theta), target.theta + pose.theta};
+    double distance = 0.0, velocity = move_velocity, time = 0.0; // in or rad, in/s or rad/s
+    double speed, accel, decel;
+    // the pid closing the last of it, in the units of the motion, with no gain for the rest
+    double kp = 0.0, ks = 0.0, exit = 0.0, approach_velocity = 0.0;
+
+    switch (command.motion) {
+    case MOVE:
+    case STRAIGHT: {
+        // boomerang moves curve toward the carrot, so walk it an inch at a time
+        Point position = pose.p();
+        double left = pose.dist(target);
+        for (int i = 0; i < 1000 && left > 0.5; i++) {
+            const Point aim = std::isnan(target.theta) || left < options.close
+                                  ? target.p()
+                                  : boomerang(position, target, options.lead, options.close);
+            const double step = std::min(1.0, position.dist(aim));
+            if (step <= 0) break;
+            position += (aim - position) * (step / position.dist(aim));
+            distance += step;
+            left = position.dist(target);
+        }
+        distance += left;
+        bool reverse = options.dir == REVERSE;
+        if (options.dir == AUTO) reverse = fabs(pose.angle(target)) > M_PI_2;
+        estimate.end.x = target.x;
+        estimate.end.y = target.y;
+        estimate.end.theta = !std::isnan(target.theta) ? target.theta
+                             : distance > 0 ? pose.p().angle(target) + (reverse ? M_PI : 0.0)
+                                            : pose.theta;
+        distance = std::max(0.0, distance - options.offset - options.exit);
+        estimate.distance = distance;
+        kp = options.lin_PID.get(0).p, ks = move_ks, exit = options.exit;
+        approach_velocity = move_velocity;
+        break;
+    }
+    case TURN:
+    case SWING: {
+        // the same way around as the turn would go
+        const double turn = turn_error(options, pose, target);
+        estimate.end.theta = pose.theta + turn;
+        estimate.angle = fabs(to_deg(turn));
+        distance = std::max(0.0, fabs(turn) - to_rad(options.exit));
+        velocity = to_rad(turn_velocity);
+        // a swing's one side at twice the output turns it as fast as a turn
+        kp = options.ang_PID.get(0).p, ks = turn_ks, exit = to_rad(options.exit);
+        approach_velocity = velocity;
+        if (command.motion == SWING) {
+            // one side drives the whole turn, pivoting the center around the locked wheel
+            velocity /= 2;
+            const Point pivot = pose.p() + Point{0.0, command.radius > 0 ? track_width / 2
+                                                                         : -track_width / 2}
+                                               .rotate(pose.theta);
+            const Point end = pivot + (pose.p() - pivot).rotate(turn);
+            estimate.end.x = end.x;
+            estimate.end.y = end.y;
+            estimate.distance = fabs(turn) * track_width / 2;
+        }
+        break;
+    }
+    case ARC: {
+        // the outer wheel at speed, so the center drives slower the tighter the arc
+        const double side = (target.theta >= 0) != (options.dir == REVERSE) ? 1.0 : -1.0;
+        const Point center =
+            pose.p() + Point{cos(pose.theta + side * M_PI_2), sin(pose.theta + side * M_PI_2)} *
+                           command.radius;
+        const Point end = center + (pose.p() - center).rotate(target.theta);
+        estimate.end = {end.x, end.y, pose.theta + target.theta};
+        estimate.angle = fabs(to_deg(target.theta));
+        estimate.distance = fabs(target.theta) * command.radius;
+        distance = std::max(0.0, estimate.distance - options.exit);
+        velocity = move_velocity / (1 + track_width / (2 * command.radius));
+        break;
+    }
+    case PATH: {
+        // speed capped by the path's own profile, ramped up from rest and down to the final move's
+        // stop, at an inch a step
+        const Path& path = *command.path;
+        const Pose frame = options.flag(PackedOptions::RELATIVE) ? pose : Pose{0.0, 0.0, 0.0};
+        const Pose last = path[path.size() - 1];
+        const double heading = std::isnan(command.target.theta) ? last.theta : command.target.theta;
+        estimate.end = {frame.p() + last.p().rotate(frame.theta), heading + frame.theta};
+        if (std::isnan(estimate.end.theta)) estimate.end.theta = pose.theta;
+        limits(move_velocity, speed, accel, decel);
+        const double length = std::max(0.0, path.length() - options.exit);
+        const int steps = std::max(1, (int)ceil(length));
+        const double ds = length / steps;
+        std::vector<double> caps(steps + 1, 0.0);
+        for (int i = 1; i <= steps; i++) {
+            const double ramp = sqrt(caps[i - 1] * caps[i - 1] + 2 * accel * ds);
+            caps[i] = std::min({speed, path.velocity(i * ds) * move_velocity / 100, ramp});
+        }
+        if (!thru) caps[steps] = 0.0;
+        const std::vector<int>& cusps = path.get_cusps();
+        for (size_t i = 0; i + 1 < cusps.size(); i++) // stopped to change direction
+            caps[std::min(steps, (int)round(path.distance(cusps[i]) / ds))] = 0.0;
+        for (int i = steps - 1; i >= 0; i--)
+            caps[i] = std::min(caps[i], sqrt(caps[i + 1] * caps[i + 1] + 2 * decel * ds));
+        for (int i = 1; i <= steps; i++) {
+            const double mean = (caps[i - 1] + caps[i]) / 2;
+            time += mean > 0 ? ds / mean : 0.0;
+        }
+        estimate.distance = path.length();
+        break;
+    }
+    case TRAJECTORY: {
+        const Trajectory& trajectory = *command.trajectory;
+        const Pose frame = options.flag(PackedOptions::RELATIVE) ? pose : Pose{0.0, 0.0, 0.0};
+        const Pose last = trajectory.at(trajectory.duration()).pose;
+        estimate.end = {frame.p() + last.p().rotate(frame.theta), last.theta + frame.theta};
+        for (size_t i = 1; i < trajectory.size(); i++)
+            estimate.distance += trajectory[i].pose.dist(trajectory[i - 1].pose);
+        time = trajectory.duration();
+        break;
+    }
+    case HOLD: // runs until cancelled
+        return estimate;
+    }
+
+    // the timed motions drive their own limits, the rest up to speed and back down
+    if (command.motion != PATH && command.motion != TRAJECTORY) {
+        limits(velocity, speed, accel, decel);
+        if (speed <= 0) return estimate;
+        const double jerk = options.jerk * velocity / 100;
+        time = ramp_time(distance, speed, accel, decel, jerk);
+        // unprofiled, the pid takes over from the speed once its output drops under it and
+        // closes the rest itself, which takes longer than the decel unless the gain is high
+        if (kp > 0 && !thru && !options.flag(PackedOptions::PROFILE)) {
+            const double full = distance + exit;
+            const double handover = std::min(full, options.speed / kp);
+            time = std::max(time, ramp_time(full - handover, speed, accel, INFINITY, jerk) +
+                                      approach_time(handover, exit, kp, ks, approach_velocity));
+        }
+    }
+    time = time * 1000 + options.settle;
+    for (int i = 0; i < options.exits.size; i++) {
+        if (options.exits.exits[i].type == Exit::TIME)
+            time = std::min(time, options.exits.exits[i].value);
+    }
+    if (options.timeout > 0) time = std::min(time, (double)options.timeout);
+    estimate.time = time;
+    return estimate;
+}
+
+Chassis::Estimate Chassis::estimate(std::span<const Prepared> motions, std::optional<Pose> start) {
+    Estimate total;
+    total.time = 0.0;
+    total.end = start ? *start : odom.get();
+    for (const Prepared& motion : motions) {
+        const Estimate next = estimate(motion, total.end);
+        total.time += next.time;
+        total.distance += next.distance;
+        total.angle += next.angle;
+        total.end = next.end;
+    }
+    return total;
+}
+
+/* Direction choice */
+// s over distance to rest from speed v, negative when moving the other way, which it first stops
+// from. one already moving its way starts as if it had ramped up from rest earlier
+static double reach_time(double distance, double v, double speed, double accel, double decel) {
+    if (v < 0) {
+        const double over = std::isfinite(decel) ? v * v / (2 * decel) : 0.0;
+        return -v / decel + ramp_time(distance + over, speed, accel, decel, 0.0);
+    }
+    v = std::min(v, speed);
+    const double ahead = std::isfinite(accel) ? v * v / (2 * accel) : 0.0;
+    return std::max(0.0, ramp_time(distance + ahead, speed, accel, decel, 0.0) - v / accel);
+}
+
+// sets preferred_dir or preferred_turn to the way of an AUTO move or turn that finishes first
+void Chassis::choose_direction(const Command& command) {
+    const PackedOptions& options = command.options;
+    const bool move = command.motion == MOVE && options.dir == AUTO &&
+                      !options.flag(PackedOptions::MPC) && !command.object;
+    const bool turn = (command.motion == TURN || command.motion == SWING) &&
+                      options.turn == AUTO && !options.flag(PackedOptions::UNWRAP);
+    if ((!move && !turn) || move_velocity <= 0 || turn_velocity <= 0) return;
+    const DirectionChoice& choice = direction_choice;
+    const Pose pose = odom.get();
+    const Twist twist = odom.get_velocity(true);
+    Pose target = command.target;
+    if (options.flag(PackedOptions::RELATIVE))
+        target = Pose{pose.p() + target.p().rotate(pose.theta), target.theta + pose.theta};
+
+    // limits of the motion, or of the choice when it has none
+    const double scale = options.speed / 100;
+    const double accel = options.accel > 0 ? options.accel * move_velocity / 100 : choice.accel;
+    const double decel = options.decel > 0 ? options.decel * move_velocity / 100 : accel;
+    const double spin = to_rad(turn_velocity) * scale;
+    const double spin_accel = track_width > 0 ? 2 * accel / track_width : INFINITY;
+    auto turn_time = [&](double angle) {
+        return reach_time(fabs(angle), angle > 0 ? twist.vel.theta : -twist.vel.theta, spin,
+                          spin_accel, spin_accel);
+    };
+
+    if (turn) {
+        // the end heading is the same either way, only the start differs
+        const double nearest = turn_error(options, pose, target);
+        const double other = nearest + (nearest > 0 ? -2 * M_PI : 2 * M_PI);
+        if (turn_time(other) < turn_time(nearest)) preferred_turn = other > 0 ? CW : CCW;
+        return;
+    }
+
+    // turning onto the target, driving to it and turning into the motion after
+    const std::optional<Command> next = choice.next ? next_command() : std::nullopt;
+    const double distance = pose.dist(target);
+    double best = INFINITY;
+    for (const Direction dir : {FORWARD, REVERSE}) {
+        const bool reverse = dir == REVERSE;
+        const double facing = wrap(pose.angle(target) + (reverse ? M_PI : 0.0));
+        // the robot's speed left along its heading once it faces the target
+        const double along = twist.vel.x * cos(facing);
+        double time = turn_time(facing);
+        time += reach_time(distance, reverse ? -along : along,
+                           move_velocity * scale * (reverse ? choice.reverse : 1.0), accel, decel);
+        const double heading = !std::isnan(target.theta) ? target.theta + (reverse ? M_PI : 0.0)
+                                                         : pose.theta + facing;
+        if (next && !next->options.flag(PackedOptions::RELATIVE) &&
+            (next->motion == MOVE || next->motion == TURN)) {
+            const Pose& after = next->target;
+            double into = next->motion == TURN && !std::isnan(after.theta)
+                              ? wrap(after.theta - heading)
+                              : Pose{target.x, target.y, heading}.angle(after);
+            if (next->options.dir == REVERSE) into = wrap(into + M_PI);
+            else if (next->motion == MOVE && next->options.dir == AUTO && fabs(into) > M_PI_2)
+                into = wrap(into + M_PI);
+            time += reach_time(fabs(into), 0.0, spin, spin_accel, spin_accel);
+        }
+        if (time < best) best = time, preferred_dir = dir;
+    }
+}
+
+Chassis::DryRun Chassis::dry_run(const std::function<void()>& routine, std::optional<Pose> start,
+                                 double lag) {
+    DryRun report;
+    const double free_speed = kinematics ? kinematics.max_speed() : move_velocity;
+    if (free_speed <= 0 || track_width <= 0) {
+        printf("dry_run: needs the drive's velocity and track width in the configs\n");
+        return report;
+    }
+    stop();
+    odom.begin_simulation();
+    if (start) odom.set(*start);
+
+    const uint64_t begin = pros::micros();
+    simulation = Simulation{.now = begin,
+                            .real = pros::millis(),
+                            .lag = lag,
+                            .free_speed = free_speed,
+                            .next_sample = begin,
+                            .report = &report};
+    left_written = right_written = INT32_MIN;
+    routine();
+    report.time = (simulation->now - begin) / 1000.0;
+    simulation.reset();
+    left_written = right_written = INT32_MIN;
+
+    const Pose end = odom.get();
+    report.end = {end.x, end.y, to_deg(end.theta)};
+    odom.end_simulation();
+    return report;
+}
+
+// the routine's time between motions passes as it does on the robot, which coasts through it
+void Chassis::catch_up() {
+    const uint32_t time = pros::millis();
+    for (double left = time - simulation->real; left > 0; left -= 10)
+        simulate(std::min(left, 10.0));
+    simulation->real = time;
+}
+
+uint32_t Chassis::clock_ms() const { return simulation ? simulation->now / 1000 : pros::millis(); }
+uint64_t Chassis::clock_us() const { return simulation ? simulation->now : pros::micros(); }
+
+// the wheels ease towards the speed of their voltage, and the odom moves by their mean over dt
+void Chassis::simulate(double dt) {
+    Simulation& model = *simulation;
+    const Point before = model.wheels;
+    const double blend = 1 - exp(-dt / std::max(model.lag, 1.0));
+    model.wheels += (model.command * (model.free_speed / 12000) - model.wheels) * blend;
+    const Point wheels = (before + model.wheels) * 0.5;
+    model.now += (uint64_t)(dt * 1000);
+    odom.simulate(model.now, (wheels.left + wheels.right) / 2 * dt / 1000,
+                  (wheels.right - wheels.left) / track_width * dt / 1000);
+    while (model.now >= model.next_sample) {
+        const Pose pose = odom.get();
+        model.report->trajectory.push_back({pose.x, pose.y, to_deg(pose.theta)});
+        model.next_sample += 20000;
+    }
+}
+
+// override, then options, then the default exit function, moving rather than copying
+ExitFn Chassis::merge_exit_fn(Options& options, const Options& override) {
+    if (override.exit_fn) return override.exit_fn;
+    if (options.exit_fn) return std::move(options.exit_fn);
+    return df_exit_fn;
+}
+
+// slew limits each side and sets the motors under a single lock
+void Chassis::drive(const Point& speeds, double accel, double decel, double dt) {
+    if (post(speeds, accel, decel)) return;
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    left_slew.set_limits(accel, decel);
+    right_slew.set_limits(accel, decel);
+    write(left_slew.update(speeds.left, dt), right_slew.update(speeds.right, dt));
+}
+
+// only sends a side when its command changed, at most once per write interval unless stopping
+void Chassis::write(double left_speed, double right_speed) {
+    APPA_PROFILE_SCOPE("motor write");
+    const int32_t left = std::lround(voltage(left_speed));
+    const int32_t right = std::lround(voltage(right_speed));
+    if (simulation) { // to the drive model, not the motors
+        simulation->command = {(double)(left_written = left), (double)(right_written = right)};
+        return;
+    }
+    const bool left_changed = left != left_written, right_changed = right != right_written;
+    if (!left_changed && !right_changed) return;
+    const uint32_t now = pros::millis();
+    const bool stopping = (left_changed && left == 0) || (right_changed && right == 0);
+    if (write_interval > 0 && now - write_time < write_interval && !stopping) return;
+    write_time = now;
+    if (left_changed) left_motors.move_voltage(left_written = left);
+    if (right_changed) right_motors.move_voltage(right_written = right);
+}
+
+Chassis::ActuatorCommand Chassis::pack(const Point& speeds, double accel, double decel) {
+    auto round = [](double value, double min, double max) {
+        return std::clamp(std::round(value), min, max);
+    };
+    return {(int16_t)round(speeds.left * 100, -10000, 10000),
+            (int16_t)round(speeds.right * 100, -10000, 10000),
+            (uint16_t)round(accel, 0, UINT16_MAX), (uint16_t)round(decel, 0, UINT16_MAX)};
+}
+
+// hands the command to the actuator task when it runs, without taking any lock
+bool Chassis::post(const Point& speeds, double accel, double decel) {
+    if (actuator_period.load(std::memory_order_relaxed) <= 0 || simulation) return false;
+    actuator_command.store(pack(speeds, accel, decel), std::memory_order_release);
+    return true;
+}
+
+bool Chassis::submit(Priority priority, const Point& speeds, int expiry, double accel,
+                     double decel) {
+    if (actuator_period.load(std::memory_order_relaxed) <= 0) {
+        printf("submit: needs the actuator, call set_actuator() first\n");
+        return false;
+    }
+    if (priority == NORMAL) return post(speeds, accel, decel);
+    Submission& slot = submissions[priority - 1];
+    slot.command.store(pack(speeds, accel, decel), std::memory_order_relaxed);
+    slot.until.store(std::max(pros::millis() + std::max(expiry, 1), 1u),
+                     std::memory_order_release);
+    return true;
+}
+
+void Chassis::release(Priority priority) {
+    if (priority != NORMAL) submissions[priority - 1].until.store(0);
+}
+
+// the highest submission still standing, or the latest posted
+Chassis::ActuatorCommand Chassis::arbitrate() {
+    const uint32_t now = pros::millis();
+    for (int i = submissions.size() - 1; i >= 0; i--) {
+        const uint32_t until = submissions[i].until.load(std::memory_order_acquire);
+        if (until != 0 && (int32_t)(until - now) > 0)
+            return submissions[i].command.load(std::memory_order_relaxed);
+    }
+    return actuator_command.load(std::memory_order_acquire);
+}
+
+// applies the command that wins arbitration at a fixed rate, slew limited and voltage compensated
+void Chassis::actuator() {
+    uint32_t now = pros::millis();
+    while (true) {
+        const int period = std::max(1, actuator_period.load());
+        const ActuatorCommand command = arbitrate();
+        {
+            std::lock_guard<pros::Mutex> lock(chassis_mutex);
+            left_slew.set_limits(command.accel, command.decel);
+            right_slew.set_limits(command.accel, command.decel);
+            const Point target = {left_slew.update(command.left / 100.0, period),
+                                  right_slew.update(command.right / 100.0, period)};
+            const Gains& k = velocity_loop.gains;
+            if ((k.p == 0 && k.i == 0 && k.d == 0) || (target.left == 0 && target.right == 0)) {
+                // stops are left to the brake mode
+                write(target.left, target.right);
+                left_velocity.reset();
+                right_velocity.reset();
+            } else {
+                // each side's speed held by its pid, on top of the feedforward for it
+                const Point measured = side_speeds(velocity_loop.trackers);
+                const Point accel = (target - velocity_target) * (1000.0 / period);
+                const Feedforward& ff = velocity_loop.ff;
+                write(ff.get(target.left, accel.left) +
+                          left_velocity.update(target.left - measured.left, period),
+                      ff.get(target.right, accel.right) +
+                          right_velocity.update(target.right - measured.right, period));
+            }
+            velocity_target = target;
+        }
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+// driver control with the driver slew limits, timed from the previous call
+void Chassis::drive(const Point& speeds) {
+    const uint32_t now = pros::millis();
+    const double dt = drive_time == 0 ? 10.0 : std::min<uint32_t>(now - drive_time, 50);
+    drive_time = now;
+    // the driver's brake mode, or the idle one once the sticks have rested long enough
+    if (speeds.left != 0 || speeds.right != 0) resting_since = 0;
+    else if (resting_since == 0) resting_since = std::max<uint32_t>(now, 1);
+    const BrakePolicy& policy = brake_policy;
+    const bool idle = resting_since != 0 && policy.idle != pros::E_MOTOR_BRAKE_INVALID &&
+                      (int)(now - resting_since) >= policy.idle_time;
+    const pros::motor_brake_mode_e mode = idle ? policy.idle : policy.driver;
+    apply_brake(mode, mode);
+    drive(speeds, drive_accel, drive_decel, dt);
+}
+
+// the end of a motion, cut short by a cancel so the next motion takes over right away. the motors
+// are left in mode, or as they were when it's INVALID
+void Chassis::brake(pros::motor_brake_mode_e mode) {
+    if (simulation) { // the model's wheels stop with their lag, while whatever comes next runs
+        tank(0, 0);
+        return;
+    }
+    const ActiveBrake config = active_brake;
+    const uint32_t start = pros::millis();
+    auto braking = [&] {
+        return (int)(pros::millis() - start) < config.time && run_token == cancel_token.load();
+    };
+    if (config.time <= 0) {
+        apply_brake(mode, mode);
+        tank(0, 0);
+    } else if (config.hold) {
+        const pros::motor_brake_mode_e left = brake_mode(true), right = brake_mode(false);
+        apply_brake(pros::E_MOTOR_BRAKE_HOLD, pros::E_MOTOR_BRAKE_HOLD);
+        tank(0, 0);
+        while (braking()) pros::delay(5);
+        if (mode != pros::E_MOTOR_BRAKE_INVALID) apply_brake(mode, mode);
+        else apply_brake(left, right);
+    } else {
+        // against each side's own speed until both are about stopped
+        while (braking()) {
+            const Point wheels = get_velocity();
+            if (fabs(wheels.left) < config.stop && fabs(wheels.right) < config.stop) break;
+            tank(limit(-config.gain * wheels.left, config.max),
+                 limit(-config.gain * wheels.right, config.max));
+            pros::delay(5);
+        }
+        apply_brake(mode, mode);
+        tank(0, 0);
+    }
+}
+
+// the mode a side was last put in, read from its motors only the first time
+pros::motor_brake_mode_e Chassis::brake_mode(bool left) {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    pros::motor_brake_mode_e& mode = left ? left_brake : right_brake;
+    if (mode == pros::E_MOTOR_BRAKE_INVALID)
+        mode = static_cast<pros::motor_brake_mode_e>((left ? left_motors : right_motors)
+                                                         .get_brake_mode());
+    return mode;
+}
+
+// sets the sides whose mode changes and leaves the rest, INVALID keeps a side as it is. a dry run
+// leaves the real motors alone
+void Chassis::apply_brake(pros::motor_brake_mode_e left, pros::motor_brake_mode_e right) {
+    if (simulation) return;
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    auto side = [](pros::MotorGroup& motors, pros::motor_brake_mode_e mode,
+                   pros::motor_brake_mode_e& current, int32_t& written) {
+        if (mode == pros::E_MOTOR_BRAKE_INVALID || mode == current) return;
+        motors.set_brake_mode_all(mode);
+        current = mode;
+        written = INT32_MIN; // resend so a stopped side takes the new mode
+    };
+    side(left_motors, left, left_brake, left_written);
+    side(right_motors, right, right_brake, right_written);
+}
+
+void Chassis::tank(double left_speed, double right_speed) {
+    if (post({left_speed, right_speed}, 0.0, 0.0)) return;
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    write(left_speed, right_speed);
+    left_slew.reset(left_speed);
+    right_slew.reset(right_speed);
+}
+void Chassis::tank(const Point& speeds) { tank(speeds.left, speeds.right); }
+void Chassis::tank(pros::Controller& controller) {
+    tank_sticks(controller.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_Y),
+                controller.get_analog(pros::E_CONTROLLER_ANALOG_RIGHT_Y));
+}
+void Chassis::tank(const Controller& controller) {
+    const ControllerState state = controller.get();
+    tank_sticks(state.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_Y),
+                state.get_analog(pros::E_CONTROLLER_ANALOG_RIGHT_Y));
+}
+void Chassis::tank_sticks(int32_t left, int32_t right) {
+    Point speeds;
+    {
+        std::lock_guard<pros::Mutex> lock(chassis_mutex);
+        speeds = {drive_curve(left), drive_curve(right)};
+    }
+    if (assisted(speeds)) return;
+    drive(speeds);
+}
+void Chassis::arcade(double linear, double angular) {
+    tank(desaturate({linear + angular, linear - angular}));
+}
+void Chassis::arcade(pros::Controller& controller) {
+    arcade_sticks(controller.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_Y),
+                  controller.get_analog(pros::E_CONTROLLER_ANALOG_RIGHT_X));
+}
+void Chassis::arcade(const Controller& controller) {
+    const ControllerState state = controller.get();
+    arcade_sticks(state.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_Y),
+                  state.get_analog(pros::E_CONTROLLER_ANALOG_RIGHT_X));
+}
+void Chassis::arcade_sticks(int32_t forward, int32_t turn) {
+    double linear, angular;
+    {
+        std::lock_guard<pros::Mutex> lock(chassis_mutex);
+        linear = drive_curve(forward);
+        angular = turn_curve(turn);
+    }
+    if (assisted({linear, angular})) return;
+    angular = hold_heading(linear, angular);
+    drive(desaturate({linear + angular, linear - angular}));
+}
+
+// the turn is scaled by forward speed so fast driving curves gently, quick turn spins in place
+Point Chassis::curvature_speeds(double linear, double angular, bool quick_turn) {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    const CurvatureConfig& config = curvature_config;
+    const double forward = linear / 100, stick = angular / 100;
+
+    // negative inertia, decaying back to zero
+    inertia_accumulator += (stick - prev_turn) * config.inertia;
+    prev_turn = stick;
+    double turn = stick + inertia_accumulator;
+    inertia_accumulator -= std::clamp(inertia_accumulator, -1.0, 1.0);
+
+    if (quick_turn) {
+        if (fabs(forward) < 0.2) {
+            quick_stop_accumulator = (1 - config.quick_stop) * quick_stop_accumulator +
+                                     config.quick_stop * std::clamp(turn, -1.0, 1.0) * 2;
+        }
+    } else {
+        turn = fabs(forward) * turn * config.sensitivity - quick_stop_accumulator;
+        quick_stop_accumulator -= std::clamp(quick_stop_accumulator, -1.0, 1.0);
+    }
+    return desaturate({linear + turn * 100, linear - turn * 100});
+}
+void Chassis::curvature(double linear, double angular, bool quick_turn) {
+    tank(curvature_speeds(linear, angular, quick_turn));
+}
+void Chassis::curvature(pros::Controller& controller) {
+    curvature_sticks(controller.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_Y),
+                     controller.get_analog(pros::E_CONTROLLER_ANALOG_RIGHT_X));
+}
+void Chassis::curvature(const Controller& controller) {
+    const ControllerState state = controller.get();
+    curvature_sticks(state.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_Y),
+                     state.get_analog(pros::E_CONTROLLER_ANALOG_RIGHT_X));
+}
+void Chassis::curvature_sticks(int32_t forward, int32_t turn) {
+    double linear, angular;
+    bool quick_turn;
+    {
+        std::lock_guard<pros::Mutex> lock(chassis_mutex);
+        linear = drive_curve(forward);
+        angular = turn_curve(turn);
+        quick_turn = fabs(linear) < curvature_config.quick_turn;
+    }
+    if (assisted({linear, angular})) return;
+    drive(curvature_speeds(linear, angular, quick_turn));
+}
+
+// holds the heading from when the turn stick was let go, until the driver turns or stops
+double Chassis::hold_heading(double linear, double angular) {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    if (!heading_hold || angular != 0 || linear == 0) {
+        held_heading = NAN;
+        return angular;
+    }
+    const double theta = odom.get().theta;
+    const uint32_t now = pros::millis();
+    if (std::isnan(held_heading)) {
+        held_heading = theta;
+        hold_time = now;
+        hold_pid.reset();
+        return 0.0;
+    }
+    const double dt = std::min<uint32_t>(now - hold_time, 50);
+    hold_time = now;
+    return hold_pid.update(wrap(held_heading - theta), dt);
+}
+
+// body velocity in in/s and rad/s (counterclockwise), through the drive model
+void Chassis::velocity(double linear, double angular) {
+    if (!kinematics) {
+        printf("Chassis velocity needs kinematics in the move config\n");
+        return;
+    }
+    const Point wheels = kinematics.inverse(linear, angular);
+    tank(desaturate(wheels * (100 / kinematics.max_speed())));
+}
+
+void Chassis::start_worker() {
+    if (chassis_task == nullptr)
+        chassis_task = start_task([this] { task(); }, task_config, "chassis_task");
+}
+
+void Chassis::stop(bool stop_task) {
+    // without stop_task the running motion is signalled but not waited for
+    if (stop_task) cancel();
+    else cancel_token.fetch_add(1);
+    tank(0, 0);
+}
+
+void Chassis::exit_motion() {
+    const Progress progress = motion_progress.read();
+    if (!progress.running) return;
+    exit_id.store(progress.id);
+    const pros::task_t task = active_task.load();
+    if (task) pros::c::task_notify(task);
+}
+
+void Chassis::set_slew(double accel, double decel) {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    drive_accel = accel;
+    drive_decel = decel;
+}
+
+// curves are built by the caller, so changing them here is only a copy
+void Chassis::set_curve(const Curve& drive, const Curve& turn) {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    drive_curve = drive;
+    turn_curve = turn;
+}
+void Chassis::set_curve(const Curve& curve) { set_curve(curve, curve); }
+
+void Chassis::set_curvature(const CurvatureConfig& config) {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    curvature_config = config;
+    prev_turn = inertia_accumulator = quick_stop_accumulator = 0.0;
+}
+
+// gains on the heading error in radians like the turn gains, all zero turns it off
+void Chassis::set_heading_hold(const Gains& gains) {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    heading_hold = gains.p != 0 || gains.i != 0 || gains.d != 0;
+    hold_pid = PID(gains);
+    held_heading = NAN;
+}
+
+// scales commands by nominal / battery voltage, so speeds don't drop as the battery does
+void Chassis::set_voltage_compensation(double nominal) {
+    nominal_voltage.store(nominal);
+    if (nominal <= 0) voltage_scale.store(1.0);
+    else if (battery_task == nullptr)
+        battery_task = start_task([this] { battery(); }, battery_task_config, "battery_task");
+}
+
+// a few samples a second is plenty for a voltage that sags over a match
+void Chassis::battery() {
+    while (true) {
+        const double nominal = nominal_voltage.load();
+        const SensorHub* hub = sensor_hub.load();
+        const std::optional<SensorHub::Snapshot> snapshot =
+            hub ? hub->recent() : std::optional<SensorHub::Snapshot>();
+        const int32_t millivolts =
+            snapshot ? std::lround(snapshot->battery_voltage) : pros::battery::get_voltage();
+        if (nominal > 0 && millivolts > 0 && millivolts != PROS_ERR)
+            voltage_scale.store(std::clamp(nominal * 1000 / millivolts, 0.5, 1.5));
+        pros::delay(200);
+    }
+}
+
+// caps motions from the drive motors' temperatures, easing off before the firmware does
+void Chassis::set_derating(const Derating& config) {
+    derating.write(config);
+    if (config.limit <= config.start) {
+        derate_scale.store(1.0);
+        heat.write({});
+    } else if (derate_task == nullptr)
+        derate_task = start_task([this] { derate(); }, derate_task_config, "derate_task");
+}
+
+Chassis::Heat Chassis::get_heat() { return heat.read(); }
+
+// temperatures change over seconds, so a couple of reads a second is plenty
+void Chassis::derate() {
+    std::array<double, 32> draws{}; // mA, mean of each motor
+    double scale = 1.0;
+    uint32_t reported = 0;
+    while (true) {
+        const Derating config = derating.read();
+        const int period = std::max(config.period, 10);
+        if (config.limit <= config.start) {
+            pros::delay(period);
+            continue;
+        }
+        const double blend = 1 - exp(-period / std::max(config.smoothing, 1.0));
+
+        // the most any one motor needs its side eased off
+        Heat now;
+        double target = 1.0;
+        int index = 0;
+        for (pros::MotorGroup* group : {&left_motors, &right_motors}) {
+            for (int i = 0; i < group->size() && index < 32; i++, index++) {
+                const double temperature = group->get_temperature(i);
+                if (temperature == PROS_ERR_F) continue;
+                const double heated = (temperature - config.start) / (config.limit - config.start);
+                double motor = 1 - (1 - config.floor) * std::clamp(heated, 0.0, 1.0);
+                const int32_t current = group->get_current_draw(i);
+                if (current != PROS_ERR) draws[index] += (abs(current) - draws[index]) * blend;
+                if (config.current > 0 && draws[index] > config.current)
+                    motor *= config.current / draws[index];
+                target = std::min(target, motor);
+
+                if (temperature > now.hottest) {
+                    now.hottest = temperature;
+                    now.port = group->get_port(i);
+                }
+                if (temperature >= config.start) now.hot |= 1u << index;
+                if (group->is_over_temp(i) == 1) now.limited |= 1u << index;
+                if (temperature >= config.start && !(reported & 1u << index))
+                    printf("derate: motor %d is at %.0f C\n", group->get_port(i), temperature);
+            }
+        }
+        reported = now.hot;
+
+        // ease toward it, so a 5 °C step in the reading doesn't show up as a step in speed
+        scale += (std::max(target, config.floor) - scale) * blend;
+        now.scale = scale;
+        derate_scale.store(scale);
+        heat.write(now);
+        pros::delay(period);
+    }
+}
+
+// millivolts for a speed (%)
+double Chassis::voltage(double speed) const {
+    return std::clamp(speed * 120 * voltage_scale.load(std::memory_order_relaxed), -12000.0,
+                      12000.0);
+}
+
+// minimum time between motor writes while the command keeps changing, 0 writes every change
+void Chassis::set_write_interval(uint32_t interval) {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    write_interval = interval;
+}
+
+// moves motor writes onto a high priority task running every period ms
+void Chassis::set_actuator(int period) {
+    if (period <= 0) {
+        printf("set_actuator: the period must be positive\n");
+        return;
+    }
+    actuator_command.store({});
+    actuator_period.store(period);
+    if (actuator_task == nullptr)
+        actuator_task = start_task([this] { actuator(); }, actuator_task_config, "actuator_task");
+}
+
+// closes a loop on each side's speed in the actuator task, which it starts at period ms when it
+// isn't running. commands become % of free speed, gains of 0 leave them as voltage
+void Chassis::set_velocity_loop(const VelocityLoop& loop, int period) {
+    if (loop.trackers && !kinematics)
+        printf("set_velocity_loop: trackers need kinematics in the move config, using motors\n");
+    {
+        std::lock_guard<pros::Mutex> lock(chassis_mutex);
+        velocity_loop = loop;
+        left_velocity.set_gains(loop.gains);
+        right_velocity.set_gains(loop.gains);
+        left_velocity.reset();
+        right_velocity.reset();
+    }
+    if (actuator_task == nullptr) set_actuator(period);
+}
+
+// until the brake policy's next phase, if it sets one
+void Chassis::set_brake_mode(const pros::motor_brake_mode_e_t mode) { apply_brake(mode, mode); }
+
+// last voltage sent to each side, as % of 12 V
+Point Chassis::get_command() {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    auto percent = [](int32_t mv) { return mv == INT32_MIN ? 0.0 : mv / 120.0; };
+    return {percent(left_written), percent(right_written)};
+}
+
+// average wheel velocity of each side, as % of the cartridge free speed
+Point Chassis::get_velocity() {
+    if (simulation) return simulation->wheels * (100 / simulation->free_speed);
+    const SensorHub* hub = sensor_hub.load();
+    if (hub)
+        if (const std::optional<SensorHub::Snapshot> snapshot = hub->recent())
+            return snapshot->drive_velocity;
+    return read_velocity();
+}
+
+Point Chassis::read_velocity() {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    return side_speeds(false);
+}
+
+// with the chassis locked. the trackers' speeds lead the motor encoders' filtered ones
+Point Chassis::side_speeds(bool trackers) {
+    if (trackers && kinematics) {
+        const Twist twist = odom.get_velocity(true);
+        return kinematics.inverse(twist.vel.x, twist.vel.theta) * (100 / kinematics.max_speed());
+    }
+    // a motor at a time, the _all reads return vectors and this runs every control step
+    auto side = [](pros::MotorGroup& motors) {
+        double total = 0.0;
+        int count = 0;
+        for (int i = 0; i < motors.size(); i++) {
+            const double rpm = motors.get_actual_velocity(i);
+            if (rpm == PROS_ERR_F) continue;
+            const pros::MotorGears gears = motors.get_gearing(i);
+            const double free_speed = gears == pros::MotorGears::red    ? 100
+                                      : gears == pros::MotorGears::blue ? 600
+                                                                        : 200;
+            total += rpm / free_speed * 100;
+            count++;
+        }
+        return count > 0 ? total / count : 0.0;
+    };
+    return {side(left_motors), side(right_motors)};
+}
+
+// average current draw of the drive motors (mA)
+double Chassis::get_current() {
+    const SensorHub* hub = sensor_hub.load();
+    if (hub)
+        if (const std::optional<SensorHub::Snapshot> snapshot = hub->recent())
+            return snapshot->drive_current;
+    return read_current();
+}
+
+double Chassis::read_current() {
+    std::lock_guard<pros::Mutex> lock(chassis_mutex);
+    double total = 0.0;
+    int count = 0;
+    for (pros::MotorGroup* motors : {&left_motors, &right_motors}) {
+        for (int i = 0; i < motors->size(); i++) {
+            const int32_t current = motors->get_current_draw(i);
+            if (current == PROS_ERR) continue;
+            total += current;
+            count++;
+        }
+    }
+    return count > 0 ? total / count : 0.0;
+}
+
+// wheel velocity from the motors minus the tracked velocity, in/s and deg/s
+Point Chassis::get_slip() {
+    if (move_velocity <= 0) return {0.0, 0.0};
+    const Point wheels = get_velocity() * (move_velocity / 100);
+    const Twist twist = odom.get_velocity(true);
+    const double angular =
+        track_width > 0 ? to_deg((wheels.right - wheels.left) / track_width - twist.vel.theta)
+                        : 0.0;
+    return {(wheels.left + wheels.right) / 2 - twist.vel.x, angular};
+}
+
+// the motions after it observe the disturbance, and the exits and telemetry read it
+void Chassis::set_disturbance(const Disturbance& disturbance) {
+    observer = disturbance;
+    this->disturbance.write({0.0, 0.0});
+}
+Point Chassis::get_disturbance() { return disturbance.read(); }
+
+// scales the slew acceleration of motions while the linear slip is above threshold (in/s)
+void Chassis::set_slip_limit(double threshold, double accel_scale) {
+    slip_threshold = threshold;
+    slip_accel = accel_scale;
+}
+
+// set_anti_tip({}) turns it on with the defaults, and accel 0 off again. the odom reads its imu's
+// tilt from then on
+void Chassis::set_anti_tip(const AntiTip& anti_tip) {
+    this->anti_tip = anti_tip;
+    if (anti_tip.accel > 0) odom.track_tilt(true);
+}
+
+// for the motions that start after it, duration 0 turns it off
+void Chassis::set_launch_control(const LaunchControl& launch) {
+    launch_control = launch;
+    launch_control.cut = std::max(launch_control.cut, 1.0);
+}
+
+void Chassis::set_active_brake(const ActiveBrake& brake) { active_brake = brake; }
+
+// from the next phase on, the modes already set stay until then
+void Chassis::set_brake_policy(const BrakePolicy& policy) { brake_policy = policy; }
+
+// for the holds that start after it
+void Chassis::set_hold(const Hold& hold) { holding = hold; }
+
+// for the moves and turns that start after it
+void Chassis::set_direction(const DirectionChoice& choice) { direction_choice = choice; }
+
+// for the motions that start after it, the running one keeps the hooks it started with. from one
+// task at a time
+void Chassis::set_hooks(const Hooks& hooks) { this->hooks.write(hooks); }
+
+// for the moves that start after it
+void Chassis::set_mpc(const MpcConfig& config) { mpc_config = config; }
+
+// records every control step of the following motions, nullptr stops recording
+void Chassis::set_recorder(Recorder* recorder) {
+    if (recorder) recorder->start();
+    this->recorder.store(recorder);
+}
+
+// logs the result of each following motion, and gives AUTO_TIMEOUT its timeouts. nullptr stops
+void Chassis::set_performance_log(PerformanceLog* log) {
+    if (log) log->start();
+    performance.store(log);
+}
+
+// caps the linear speed of motions by where the robot is on the field, nullptr turns it off. the
+// geofence has to outlive the motions
+void Chassis::set_geofence(const Geofence* geofence) { this->geofence.store(geofence); }
+
+// learns a correction over repeated runs of the follows after it, nullptr stops. the learning
+// has to outlive the motions and belongs to one route
+void Chassis::set_learning(PathLearning* learning) { this->learning.store(learning); }
+
+// maps the targets of every following command, such as FieldTransform::mirror_x() to run a
+// routine written for one alliance on the other, set before issuing them
+void Chassis::set_field(const FieldTransform& field) { this->field = field; }
+const FieldTransform& Chassis::get_field() const { return field; }
+
+/* Diagnostics */
+static void print_health(const Chassis::MotorHealth& motor) {
+    using Flag = Chassis::MotorHealth::Flag;
+    if (motor.flags & Flag::DISCONNECTED) {
+        printf("health: motor %d is disconnected\n", motor.port);
+        return;
+    }
+    printf("health: motor %d at %.0f rpm, %.0f mA, %.0f%%%s%s%s\n", motor.port, motor.velocity,
+           motor.current, motor.efficiency, motor.flags & Flag::VELOCITY ? ", velocity off" : "",
+           motor.flags & Flag::CURRENT ? ", current off" : "",
+           motor.flags & Flag::EFFICIENCY ? ", efficiency low" : "");
+}
+
+// the motors on a side are geared together, so a healthy side reads nearly the same on each
+Chassis::Health Chassis::check_health(int duration, int interval) {
+    struct Sum {
+        double velocity = 0.0, current = 0.0, efficiency = 0.0;
+        int samples = 0;
+    };
+    std::array<Sum, 16> sums{};
+    Health result;
+    int left_count = 0;
+    for (pros::MotorGroup* group : {&left_motors, &right_motors}) {
+        for (int i = 0; i < group->size() && result.count < 16; i++)
+            result.motors[result.count++].port = group->get_port(i);
+        if (group == &left_motors) left_count = result.count;
+    }
+
+    // the motors that fail a read are the ones that aren't answering
+    uint32_t now = pros::millis();
+    const uint32_t start = now;
+    while (true) {
+        int index = 0;
+        for (pros::MotorGroup* group : {&left_motors, &right_motors}) {
+            for (int i = 0; i < group->size() && index < 16; i++, index++) {
+                const double velocity = group->get_actual_velocity(i);
+                const int32_t current = group->get_current_draw(i);
+                const double efficiency = group->get_efficiency(i);
+                if (velocity == PROS_ERR_F || current == PROS_ERR || efficiency == PROS_ERR_F)
+                    continue;
+                Sum& sum = sums[index];
+                sum.velocity += velocity;
+                sum.current += abs(current);
+                sum.efficiency += efficiency;
+                sum.samples++;
+            }
+        }
+        result.samples++;
+        if (now - start >= duration) break;
+        pros::c::task_delay_until(&now, std::max(interval, 1));
+    }
+
+    // each motor against the median of the others on its side
+    const HealthLimits limits = health_limits;
+    auto median = [](std::array<double, 16> values, int count) {
+        std::sort(values.begin(), values.begin() + count);
+        return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+    };
+    auto judge = [&](int begin, int end) {
+        std::array<double, 16> velocities, currents, efficiencies;
+        int count = 0;
+        for (int k = begin; k < end; k++) {
+            MotorHealth& motor = result.motors[k];
+            const Sum& sum = sums[k];
+            if (sum.samples < result.samples) motor.flags |= MotorHealth::DISCONNECTED;
+            if (sum.samples == 0) continue;
+            motor.velocity = sum.velocity / sum.samples;
+            motor.current = sum.current / sum.samples;
+            motor.efficiency = sum.efficiency / sum.samples;
+            if (motor.flags) continue;
+            velocities[count] = motor.velocity;
+            currents[count] = motor.current;
+            efficiencies[count++] = motor.efficiency;
+        }
+        if (count < 2) return; // nothing to compare with
+        const double velocity = median(velocities, count);
+        const double current = median(currents, count);
+        const double efficiency = median(efficiencies, count);
+        const bool moving = fabs(velocity) >= limits.moving;
+        for (int k = begin; k < end; k++) {
+            MotorHealth& motor = result.motors[k];
+            if (motor.flags & MotorHealth::DISCONNECTED) continue;
+            if (moving && fabs(motor.velocity - velocity) > limits.velocity * fabs(velocity))
+                motor.flags |= MotorHealth::VELOCITY;
+            if (current >= limits.loaded && fabs(motor.current - current) > limits.current * current)
+                motor.flags |= MotorHealth::CURRENT;
+            if (moving && motor.efficiency < efficiency - limits.efficiency)
+                motor.flags |= MotorHealth::EFFICIENCY;
+        }
+    };
+    judge(0, left_count);
+    judge(left_count, result.count);
+    for (int k = 0; k < result.count; k++) result.flags |= result.motors[k].flags;
+    return result;
+}
+
+Chassis::Health Chassis::self_test(double speed, int duration) {
+    stop(true);
+    tank(-speed, speed);
+    pros::delay(500); // up to speed
+    const Health result = check_health(duration);
+    tank(0, 0);
+    for (int k = 0; k < result.count; k++) print_health(result.motors[k]);
+    printf("health: %s\n", result.flags ? "check the flagged motors" : "every motor agrees");
+    return result;
+}
+
+void Chassis::start_health(int period) {
+    if (health_task) return;
+    health_task =
+        start_task([this, period] { watch_health(period); }, health_task_config, "health_task");
+}
+
+Chassis::Health Chassis::get_health() { return health.read(); }
+
+// reads a few times a second, which is plenty for means over seconds
+void Chassis::watch_health(int period) {
+    std::array<uint8_t, 16> reported{};
+    while (true) {
+        const Health result = check_health(std::max(period, 100), 100);
+        health.write(result);
+        for (int k = 0; k < result.count; k++) {
+            const MotorHealth& motor = result.motors[k];
+            if (motor.flags & ~reported[k]) print_health(motor);
+            reported[k] |= motor.flags;
+        }
+    }
+}
+
+/* Characterization */
+// quasistatic ramps and dynamic steps in each direction, fitting feedforward from odom velocity
+Chassis::Characterization Chassis::characterize(double ramp, double step, int duration) {
+    struct Sample {
+        uint32_t time;
+        float voltage, velocity, accel;
+    };
+    static std::array<Sample, 1024> samples;
+    const int dt = 10; // ms
+    stop(true);
+
+    // drives straight or turns at a voltage, sampling velocity until the duration is up
+    auto run = [&](bool angular, auto voltage) {
+        int count = 0;
+        uint32_t now = pros::millis();
+        const uint32_t start = now;
+        while (now - start < duration && count < samples.size()) {
+            const double volts = voltage(now - start);
+            if (angular) tank(-volts, volts);
+            else tank(volts, volts);
+            pros::c::task_delay_until(&now, dt);
+            const Twist twist = odom.get_velocity(true);
+            samples[count++] = {
+                now - start, (float)volts,
+                (float)(angular ? to_deg(twist.vel.theta) : twist.vel.x),
+                (float)(angular ? to_deg(twist.accel.theta) : twist.accel.x)};
+        }
+        tank(0, 0);
+        pros::delay(1000);
+        return count;
+    };
+
+    auto fit = [&](bool angular, double& latency) {
+        const double threshold = angular ? 5.0 : 1.0; // deg/s or in/s of noise
+        Feedforward ff;
+
+        // quasistatic: voltage = s + v * velocity while moving
+        int count = run(angular, [&](uint32_t t) { return std::min(100.0, ramp * t / 1000.0); });
+        double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (int i = 0; i < count; i++) {
+            if (fabs(samples[i].velocity) < threshold) continue;
+            const double x = samples[i].velocity, y = samples[i].voltage;
+            n++, sx += x, sy += y, sxx += x * x, sxy += x * y;
+        }
+        if (n > 2 && n * sxx - sx * sx != 0) {
+            ff.v = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+            ff.s = (sy - ff.v * sx) / n;
+        }
+
+        // dynamic: the voltage left over from s and v goes into acceleration, in reverse
+        count = run(angular, [&](uint32_t) { return -step; });
+        double sar = 0, saa = 0;
+        latency = NAN;
+        for (int i = 0; i < count; i++) {
+            const Sample& sample = samples[i];
+            if (std::isnan(latency) && fabs(sample.velocity) > threshold) latency = sample.time;
+            if (fabs(sample.accel) < threshold * 10) continue;
+            const double sign = sample.velocity < 0 ? -1.0 : 1.0;
+            const double residual = sample.voltage - ff.s * sign - ff.v * sample.velocity;
+            sar += sample.accel * residual;
+            saa += sample.accel * sample.accel;
+        }
+        if (saa > 0) ff.a = sar / saa;
+        return ff;
+    };
+
+    Characterization result;
+    double linear_latency, angular_latency;
+    result.linear = fit(false, linear_latency);
+    result.angular = fit(true, angular_latency);
+    result.latency = std::isnan(angular_latency) ? linear_latency
+                     : std::isnan(linear_latency) ? angular_latency
+                                                  : (linear_latency + angular_latency) / 2;
+
+    printf("characterize: linear {%.4f, %.4f, %.4f}, angular {%.4f, %.4f, %.4f}, latency %.0f ms\n",
+           result.linear.s, result.linear.v, result.linear.a, result.angular.s, result.angular.v,
+           result.angular.a, result.latency);
+    return result;
+}
+
+/* Autotune */
+// relay feedback around the starting position, ziegler-nichols gains from the oscillation
+Chassis::Tuning Chassis::autotune(bool angular, double amplitude, int cycles, const char* file) {
+    const int dt = 10;                                     // ms
+    const int timeout = 15000;                             // ms
+    const double hysteresis = angular ? to_rad(0.5) : 0.1; // rad or in of noise
+    const int skip = 2;                                    // cycles before it is steady
+    stop(true);
+
+    Pose prev = odom.get();
+    double measured = 0.0, output = amplitude;
+    double low = INFINITY, high = -INFINITY;
+    double amplitudes = 0.0, periods = 0.0;
+    int count = 0, rises = 0;
+    uint32_t now = pros::millis(), last_rise = 0;
+    const uint32_t start = now;
+    while (count < cycles && now - start < timeout) {
+        // error from the start, the relay switches once it passes the hysteresis band
+        const Pose pose = odom.get();
+        if (angular) measured += wrap(pose.theta - prev.theta);
+        else measured += (pose.x - prev.x) * cos(pose.theta) + (pose.y - prev.y) * sin(pose.theta);
+        prev = pose;
+        const double error = -measured;
+        low = std::min(low, error);
+        high = std::max(high, error);
+
+        if (error < -hysteresis && output > 0) output = -amplitude;
+        else if (error > hysteresis && output < 0) {
+            // a full cycle ends on each rising switch
+            output = amplitude;
+            if (rises++ >= skip) {
+                amplitudes += (high - low) / 2;
+                periods += now - last_rise;
+                count++;
+            }
+            last_rise = now;
+            low = INFINITY, high = -INFINITY;
+        }
+
+        if (angular) tank(-output, output);
+        else tank(output, output);
+        pros::c::task_delay_until(&now, dt);
+    }
+    tank(0, 0);
+
+    Tuning result{Gains(), NAN, NAN};
+    if (count == 0) {
+        printf("autotune: no steady oscillation within %d ms\n", timeout);
+        return result;
+    }
+    // describing function of a relay with hysteresis
+    const double a = amplitudes / count;
+    result.ultimate_gain = 4 * amplitude / (M_PI * sqrt(std::max(a * a - hysteresis * hysteresis,
+                                                                 hysteresis * hysteresis)));
+    result.period = periods / count;
+    const double period_s = result.period / 1000;
+    result.gains.p = 0.6 * result.ultimate_gain;
+    result.gains.i = 1.2 * result.ultimate_gain / period_s;
+    result.gains.d = 0.075 * result.ultimate_gain * period_s;
+
+    printf("autotune: ultimate gain %.3f, period %.0f ms, gains {%.4f, %.4f, %.4f}\n",
+           result.ultimate_gain, result.period, result.gains.p, result.gains.i, result.gains.d);
+    if (file) save_gains(file, result.gains);
+    return result;
+}
+Chassis::Tuning Chassis::autotune_turn(double amplitude, int cycles, const char* file) {
+    return autotune(true, amplitude, cycles, file);
+}
+Chassis::Tuning Chassis::autotune_move(double amplitude, int cycles, const char* file) {
+    return autotune(false, amplitude, cycles, file);
+}
+
+/* Tracking calibration */
+// ticks the trackers read per rad turned in place about the tracking center, from the offsets
+static Point turn_ticks(const OdomBase::Tracking& tracking) {
+    // the point the trackers measure, from the center in the tracker frame
+    const Point point = (tracking.linear_offset * -1).rotate(-to_rad(tracking.angular_offset));
+    return Point{-point.y, point.x} * tracking.tpu;
+}
+
+// drives straight into a wall distance in ahead of the robot's front, and takes the tpu from how
+// far the trackers went and the angular offset from the direction they went in. what turning on the
+// way put into the trackers is taken out with the current linear offset
+OdomBase::Tracking Chassis::calibrate_tpu(double distance, double speed, const char* file) {
+    const int dt = 10;              // ms
+    const int timeout = 10000;      // ms
+    const double stall_speed = 0.5; // in/s, under the tpu there was
+    const int stall_time = 250;     // ms
+    const OdomBase::Tracking failed = {NAN, {NAN, NAN}, NAN};
+    stop(true);
+
+    const Point start = odom.get_ticks();
+    if (std::isnan(start.x)) {
+        printf("calibrate_tpu: this odom has no x and y trackers\n");
+        return failed;
+    }
+    if (!(distance > 0)) {
+        printf("calibrate_tpu: the wall has to be ahead of the robot\n");
+        return failed;
+    }
+    Pose prev = odom.get();
+    double turned = 0.0;
+    bool moving = false;
+    int still = 0;
+    uint32_t now = pros::millis();
+    const uint32_t begin = now;
+    while (still < stall_time && now - begin < timeout) {
+        tank(speed, speed);
+        pros::c::task_delay_until(&now, dt);
+        const Pose pose = odom.get();
+        turned += wrap(pose.theta - prev.theta);
+        prev = pose;
+
+        // stopped by the wall once it got going
+        const double velocity = odom.get_velocity().speed();
+        if (velocity > stall_speed * 4) moving = true;
+        still = moving && velocity < stall_speed ? still + dt : 0;
+    }
+    const Point ticks = odom.get_ticks() - start;
+    tank(0, 0);
+    if (still < stall_time) {
+        printf("calibrate_tpu: no wall within %d ms\n", timeout);
+        return failed;
+    }
+
+    OdomBase::Tracking tracking = odom.get_tracking();
+    const Point travel = ticks - turn_ticks(tracking) * turned;
+    tracking.tpu = hypot(travel.x, travel.y) / distance;
+    tracking.angular_offset = to_deg(-atan2(travel.y, travel.x));
+    printf("calibrate_tpu: tpu %.3f, angular offset %.2f deg after %.1f deg of turning\n",
+           tracking.tpu, tracking.angular_offset, to_deg(turned));
+    odom.set_tracking(tracking);
+    if (file) odom.save_tracking(file);
+    return tracking;
+}
+
+// turns in place, where the trackers only go around the center, so what they read per rad turned
+// places the point they measure. the heading comes from the odom's imu, and the drift of the
+// center while turning is spread over every turn
+OdomBase::Tracking Chassis::calibrate_offsets(int turns, double speed, const char* file) {
+    const int dt = 10;                             // ms
+    const int timeout = 4000 * std::max(turns, 1); // ms
+    const double still_speed = to_rad(2);          // rad/s
+    const int still_time = 250;                    // ms
+    const OdomBase::Tracking failed = {NAN, {NAN, NAN}, NAN};
+    stop(true);
+
+    const Point start = odom.get_ticks();
+    if (std::isnan(start.x)) {
+        printf("calibrate_offsets: this odom has no x and y trackers\n");
+        return failed;
+    }
+    Pose prev = odom.get();
+    double turned = 0.0;
+    int still = 0;
+    uint32_t now = pros::millis();
+    const uint32_t begin = now;
+    while (still < still_time && now - begin < timeout) {
+        // turn, then wait until the robot stops
+        if (turned < 2 * M_PI * turns) tank(-speed, speed);
+        else tank(0, 0);
+        pros::c::task_delay_until(&now, dt);
+        const Pose pose = odom.get();
+        turned += wrap(pose.theta - prev.theta);
+        prev = pose;
+        const bool stopped = turned >= 2 * M_PI * turns &&
+                             fabs(odom.get_velocity().vel.theta) < still_speed;
+        still = stopped ? still + dt : 0;
+    }
+    const Point ticks = odom.get_ticks() - start;
+    tank(0, 0);
+    if (still < still_time) {
+        printf("calibrate_offsets: did not finish %d turns within %d ms\n", turns, timeout);
+        return failed;
+    }
+
+    // the point turns about the center, so its ticks per rad are its offset turned a quarter
+    OdomBase::Tracking tracking = odom.get_tracking();
+    const Point rate = ticks * (1 / (tracking.tpu * turned));
+    const Point point = Point{rate.y, -rate.x}.rotate(to_rad(tracking.angular_offset));
+    tracking.linear_offset = point * -1;
+    printf("calibrate_offsets: linear offset {%.3f, %.3f} after %.2f turns\n",
+           tracking.linear_offset.x, tracking.linear_offset.y, turned / (2 * M_PI));
+    odom.set_tracking(tracking);
+    if (file) odom.save_tracking(file);
+    return tracking;
+}
+
+/* Imu calibration */
+// squares the robot against the wall behind it, turns in place and squares it again, so the wall
+// says it turned exactly that many times and each imu's scale is the turns over what it read.
+// the turns are counted by the odom's heading, close enough for the wall to take out the rest
+std::vector<double> Chassis::calibrate_imu(Imu& imu, int turns, double speed, const char* file) {
+    const int dt = 10;              // ms
+    const int push_time = 500;      // ms, against the wall once stopped
+    const double clearance = 8.0;   // in, from the wall to turn in
+    const double stall_speed = 0.5; // in/s
+    const double max_error = 0.05;  // of a scale, past it the turns were miscounted
+    turns = std::max(turns, 1);
+    stop(true);
+
+    // backs up until stopped for the push time, then waits for the robot to settle
+    auto square = [&] {
+        int still = 0;
+        uint32_t now = pros::millis();
+        const uint32_t begin = now;
+        while (still < push_time && now - begin < 5000) {
+            tank(-speed / 2, -speed / 2);
+            pros::c::task_delay_until(&now, dt);
+            still = odom.get_velocity().speed() < stall_speed ? still + dt : 0;
+        }
+        tank(0, 0);
+        pros::delay(500);
+        return still >= push_time;
+    };
+    // deg clockwise, as the imus report it
+    auto read = [&] {
+        std::vector<double> rotations;
+        for (auto& device : imu.imus) rotations.push_back(device.get_rotation());
+        return rotations;
+    };
+
+    if (imu.imus.empty() || !square()) {
+        printf("calibrate_imu: no imu or no wall behind the robot\n");
+        return {};
+    }
+    const std::vector<double> start = read();
+
+    // out from the wall, then around
+    Pose prev = odom.get();
+    double traveled = 0.0, turned = 0.0;
+    uint32_t now = pros::millis();
+    const uint32_t begin = now;
+    while (traveled < clearance && now - begin < 3000) {
+        tank(speed / 2, speed / 2);
+        pros::c::task_delay_until(&now, dt);
+        const Pose pose = odom.get();
+        traveled += pose.dist(prev);
+        prev = pose;
+    }
+    while (turned < 2 * M_PI * turns && now - begin < 3000 + 4000 * turns) {
+        // slowing down over the last half turn, so it doesn't coast far past
+        const double output = std::clamp(to_deg(2 * M_PI * turns - turned) / 180 * speed,
+                                         speed / 5, speed);
+        tank(-output, output);
+        pros::c::task_delay_until(&now, dt);
+        const Pose pose = odom.get();
+        turned += wrap(pose.theta - prev.theta);
+        prev = pose;
+    }
+    tank(0, 0);
+    pros::delay(500);
+    if (turned < 2 * M_PI * turns || !square()) {
+        printf("calibrate_imu: did not finish %d turns back at the wall\n", turns);
+        return {};
+    }
+    const std::vector<double> end = read();
+
+    std::vector<double> scales;
+    for (size_t i = 0; i < imu.imus.size(); i++) {
+        const uint8_t port = imu.imus[i].get_port();
+        const double scale = 360.0 * turns / (start[i] - end[i]);
+        if (!(fabs(scale - 1) < max_error)) {
+            printf("calibrate_imu: imu %d read %.1f deg for %d turns\n", port, start[i] - end[i],
+                   turns);
+            return {};
+        }
+        scales.push_back(scale);
+    }
+    for (size_t i = 0; i < imu.imus.size(); i++) {
+        imu.scales[imu.imus[i].get_port()] = scales[i];
+        printf("calibrate_imu: imu %d scale %.5f\n", imu.imus[i].get_port(), scales[i]);
+    }
+    if (file) imu.save_scales(file);
+    return scales;
+}
+
+} // namespace appa
 
 /**
  * TESTING:
@@ -328,6 +3761,7 @@ void Chassis::set_brake_mode(const pros::motor_brake_mode_e_t mode) {
  *      accel - any
  *      lead - move (pose)
  *      lookahead - follow
+ *      stanley - follow (straight and curved, on and off the path)
  *      lin_PID - move (any)
  *      ang_PID - move (any) and turn (any)
  *      thru - move (point + pose) and turn (any)
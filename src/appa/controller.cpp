@@ -0,0 +1,78 @@
+#include "appa.h"
+
+namespace appa {
+
+/* ControllerState */
+static uint16_t button_bit(pros::controller_digital_e_t button) {
+    return 1 << (button - pros::E_CONTROLLER_DIGITAL_L1);
+}
+
+int32_t ControllerState::get_analog(pros::controller_analog_e_t channel) const {
+    return analog[channel];
+}
+bool ControllerState::get_digital(pros::controller_digital_e_t button) const {
+    return held & button_bit(button);
+}
+bool ControllerState::get_new_press(pros::controller_digital_e_t button) const {
+    return pressed & button_bit(button);
+}
+bool ControllerState::get_new_release(pros::controller_digital_e_t button) const {
+    return released & button_bit(button);
+}
+
+/* Controller */
+Controller::Controller(pros::controller_id_e_t id, int period)
+    : controller(id), period(std::max(1, period)) {}
+
+Controller::~Controller() {
+    if (controller_task != nullptr) {
+        controller_task->remove();
+        delete controller_task;
+    }
+}
+
+void Controller::start() {
+    if (controller_task != nullptr) return;
+    controller_task = start_task([this] { poll(); }, task_config, "controller_task");
+}
+
+// the only task that talks to the controller, the radio only updates every few ms anyway
+void Controller::poll() {
+    ControllerState previous;
+    uint32_t now = pros::millis();
+    while (true) {
+        ControllerState current;
+        current.time = now;
+        current.connected = controller.is_connected() == 1;
+        if (current.connected) {
+            for (int i = 0; i < 4; i++) {
+                current.analog[i] = controller.get_analog((pros::controller_analog_e_t)i);
+            }
+            for (int i = pros::E_CONTROLLER_DIGITAL_L1; i <= pros::E_CONTROLLER_DIGITAL_A; i++) {
+                const auto button = (pros::controller_digital_e_t)i;
+                if (controller.get_digital(button) == 1) current.held |= button_bit(button);
+            }
+        }
+        current.pressed = current.held & ~previous.held;
+        current.released = previous.held & ~current.held;
+        if (current.pressed) presses.fetch_or(current.pressed, std::memory_order_relaxed);
+        state.write(current);
+        previous = current;
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+ControllerState Controller::get() const { return state.read(); }
+int32_t Controller::get_analog(pros::controller_analog_e_t channel) const {
+    return get().get_analog(channel);
+}
+bool Controller::get_digital(pros::controller_digital_e_t button) const {
+    return get().get_digital(button);
+}
+bool Controller::get_digital_new_press(pros::controller_digital_e_t button) {
+    const uint16_t bit = button_bit(button);
+    return presses.fetch_and(~bit, std::memory_order_relaxed) & bit;
+}
+pros::Controller& Controller::device() { return controller; }
+
+} // namespace appa
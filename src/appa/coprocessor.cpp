@@ -0,0 +1,240 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Coprocessor */
+Coprocessor::Coprocessor(uint8_t port, OdomBase& odom,
+                         std::initializer_list<uint8_t> distance_ports, int32_t baud, int period)
+    : odom(odom), serial(port, baud), period(std::max(1, period)) {
+    for (uint8_t distance_port : distance_ports) {
+        if (ranges.size() < wire::snapshot_ranges) ranges.emplace_back(distance_port);
+    }
+}
+
+Coprocessor::~Coprocessor() {
+    if (coprocessor_task) {
+        coprocessor_task->remove();
+        delete coprocessor_task;
+    }
+}
+
+void Coprocessor::start() {
+    if (coprocessor_task == nullptr)
+        coprocessor_task = start_task([this] { task(); }, task_config, "coprocessor_task");
+}
+
+uint32_t Coprocessor::corrections() const { return accepted.load(std::memory_order_relaxed); }
+uint32_t Coprocessor::rejected() const { return rejects.load(std::memory_order_relaxed); }
+uint32_t Coprocessor::failures() const { return errors.load(std::memory_order_relaxed); }
+uint32_t Coprocessor::dropped() const { return drops.load(std::memory_order_relaxed); }
+
+int Coprocessor::slot(uint16_t id) const {
+    for (int i = 0; i < capacity; i++) {
+        const uint8_t state = requests[i].state.load(std::memory_order_acquire);
+        if (state != FREE && state != FILLING && requests[i].id == id) return i;
+    }
+    return -1;
+}
+
+uint16_t Coprocessor::request(Kind kind, const Pose& goal, const Pose& start) {
+    for (Request& request : requests) {
+        uint8_t free = FREE;
+        if (!request.state.compare_exchange_strong(free, FILLING)) continue;
+        uint16_t id = next_id.fetch_add(1);
+        if (id == 0) id = next_id.fetch_add(1); // 0 is no request
+        request.id = id;
+        request.kind = kind;
+        request.start = start;
+        request.goal = goal;
+        request.sent = false;
+        request.tries = 0;
+        request.next = 0;
+        request.state.store(PENDING, std::memory_order_release);
+        return id;
+    }
+    printf("coprocessor: all %d requests are waiting\n", capacity);
+    return 0;
+}
+
+bool Coprocessor::ready(uint16_t id) const {
+    const int i = slot(id);
+    if (i < 0) return false;
+    const uint8_t state = requests[i].state.load(std::memory_order_acquire);
+    return state == READY || state == FAILED;
+}
+
+bool Coprocessor::pending(uint16_t id) const {
+    const int i = slot(id);
+    return i >= 0 && requests[i].state.load(std::memory_order_acquire) == PENDING;
+}
+
+std::optional<Path> Coprocessor::path(uint16_t id, const PathProfile& profile) {
+    const int i = slot(id);
+    if (i < 0 || requests[i].kind != PATH || !ready(id)) return std::nullopt;
+    Request& request = requests[i];
+    std::vector<Point> points;
+    if (request.state.load(std::memory_order_acquire) == READY) points.swap(request.points);
+    request.state.store(FREE, std::memory_order_release);
+    return Path(points, 12.0, profile);
+}
+
+std::optional<Trajectory> Coprocessor::trajectory(uint16_t id) {
+    const int i = slot(id);
+    if (i < 0 || requests[i].kind != TRAJECTORY || !ready(id)) return std::nullopt;
+    Request& request = requests[i];
+    std::vector<TrajectorySample> samples;
+    if (request.state.load(std::memory_order_acquire) == READY) samples.swap(request.samples);
+    request.state.store(FREE, std::memory_order_release);
+    return Trajectory(samples);
+}
+
+void Coprocessor::cancel(uint16_t id) {
+    const int i = slot(id);
+    if (i < 0) return;
+    uint8_t pending = PENDING;
+    if (!requests[i].state.compare_exchange_strong(pending, CANCELLED))
+        requests[i].state.store(FREE, std::memory_order_release); // ready or failed
+}
+
+void Coprocessor::send(const uint8_t* record, size_t size) {
+    uint8_t frame[wire::max_message_frame];
+    const size_t length = wire::pack(record, size, frame);
+    if (serial.get_write_free() >= (int32_t)length) serial.write(frame, length);
+    else drops.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Coprocessor::handle(const uint8_t* record, int size) {
+    if (record[0] == wire::CORRECTION && size == sizeof(wire::CorrectionFrame)) {
+        wire::CorrectionFrame frame;
+        memcpy(&frame, record, sizeof(frame));
+        // against where the odom had the robot when the snapshot was taken
+        const Pose then = odom.get_at((uint64_t)frame.time * 1000);
+        const Pose error = {std::isnan(frame.x) ? 0.0 : frame.x - then.x,
+                            std::isnan(frame.y) ? 0.0 : frame.y - then.y,
+                            std::isnan(frame.theta) ? 0.0 : wrap(frame.theta - then.theta)};
+        if (hypot(error.x, error.y) > max_correction) {
+            rejects.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        odom.correct(error * std::clamp(gain, 0.0, 1.0));
+        accepted.fetch_add(1, std::memory_order_relaxed);
+    } else if ((record[0] == wire::PATH_CHUNK || record[0] == wire::TRAJECTORY_CHUNK) &&
+               size >= (int)sizeof(wire::ChunkHeader)) {
+        wire::ChunkHeader header;
+        memcpy(&header, record, sizeof(header));
+        const int width = record[0] == wire::PATH_CHUNK ? 2 : 6;
+        const int limit = record[0] == wire::PATH_CHUNK ? wire::chunk_points : wire::chunk_samples;
+        if (header.count > limit ||
+            size != (int)(sizeof(header) + header.count * width * sizeof(float))) {
+            errors.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        float values[wire::chunk_samples * 6];
+        memcpy(values, record + sizeof(header), header.count * width * sizeof(float));
+        chunk(header, values, header.count);
+    } else errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+// only from pending, a cancel since the check before it keeps the slot cancelled, to be freed
+void Coprocessor::finish(Request& request, uint8_t state) {
+    uint8_t pending = PENDING;
+    request.state.compare_exchange_strong(pending, state, std::memory_order_acq_rel);
+}
+
+void Coprocessor::chunk(const wire::ChunkHeader& header, const float* values, int count) {
+    const int i = slot(header.id);
+    if (i < 0) return; // taken, cancelled or from before a restart
+    Request& request = requests[i];
+    if (request.state.load(std::memory_order_acquire) != PENDING ||
+        request.kind != header.type)
+        return;
+    if (header.total > max_points) {
+        printf("coprocessor: route %u has %u points, more than %d\n", header.id, header.total,
+               max_points);
+        finish(request, FAILED);
+        return;
+    }
+    // chunks come in order, so a gap means one was lost and the request goes out again
+    if (header.first != request.next || header.first + count > header.total) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+        request.sent_time = pros::millis() - timeout;
+        return;
+    }
+    if (request.kind == PATH) {
+        if (header.first == 0) request.points.resize(header.total);
+        for (int k = 0; k < count; k++)
+            request.points[header.first + k] = {values[2 * k], values[2 * k + 1]};
+    } else {
+        if (header.first == 0) request.samples.resize(header.total);
+        for (int k = 0; k < count; k++) {
+            const float* v = values + 6 * k;
+            request.samples[header.first + k] = {v[0], {v[1], v[2], v[3]}, v[4], v[5]};
+        }
+    }
+    request.next = header.first + count;
+    if (request.next >= header.total) finish(request, READY);
+}
+
+void Coprocessor::task() {
+    uint32_t now = pros::millis();
+    uint8_t bytes[64], record[wire::max_message];
+    while (true) {
+        // everything that came in since the last period
+        for (int32_t available = serial.get_read_avail(); available > 0 && available != PROS_ERR;) {
+            const int32_t read = serial.read(bytes, std::min<int32_t>(available, sizeof(bytes)));
+            if (read <= 0 || read == PROS_ERR) break;
+            for (int32_t k = 0; k < read; k++) {
+                const int size = unpacker.push(bytes[k], record);
+                if (size < 0) errors.fetch_add(1, std::memory_order_relaxed);
+                else if (size > 0) handle(record, size);
+            }
+            available -= read;
+        }
+
+        // new requests, and ones that timed out again until they run out of tries
+        const uint32_t time = pros::millis();
+        for (Request& request : requests) {
+            const uint8_t state = request.state.load(std::memory_order_acquire);
+            if (state == CANCELLED) request.state.store(FREE, std::memory_order_release);
+            if (state != PENDING || (request.sent && time - request.sent_time < timeout)) continue;
+            if (request.tries > retries) {
+                finish(request, FAILED);
+                continue;
+            }
+            const Pose start = std::isnan(request.start.x) ? odom.get() : request.start;
+            const wire::RequestFrame frame = {wire::REQUEST,        request.kind,
+                                              request.id,           (float)start.x,
+                                              (float)start.y,       (float)start.theta,
+                                              (float)request.goal.x, (float)request.goal.y,
+                                              (float)request.goal.theta};
+            send(reinterpret_cast<const uint8_t*>(&frame), sizeof(frame));
+            request.sent = true;
+            request.sent_time = time;
+            request.tries++;
+            request.next = 0;
+        }
+
+        // the snapshot the coprocessor works from
+        const Pose pose = odom.get();
+        const Twist twist = odom.get_velocity(true);
+        const Point ticks = odom.get_ticks();
+        wire::SnapshotFrame snapshot = {.type = wire::SNAPSHOT,
+                                        .seq = seq++,
+                                        .time = time,
+                                        .x = (float)pose.x,
+                                        .y = (float)pose.y,
+                                        .theta = (float)pose.theta,
+                                        .velocity_linear = (float)twist.vel.x,
+                                        .velocity_angular = (float)twist.vel.theta,
+                                        .ticks_x = (float)ticks.x,
+                                        .ticks_y = (float)ticks.y};
+        for (int k = 0; k < wire::snapshot_ranges; k++) {
+            const int32_t mm = k < ranges.size() ? ranges[k].get_distance() : PROS_ERR;
+            snapshot.ranges[k] = mm == PROS_ERR || mm < 0 ? 9999 : std::min<int32_t>(mm, 9999);
+        }
+        send(reinterpret_cast<const uint8_t*>(&snapshot), sizeof(snapshot));
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+} // namespace appa
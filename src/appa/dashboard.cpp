@@ -0,0 +1,230 @@
+#include "dashboard.h"
+
+#if __has_include("liblvgl/lvgl.h")
+namespace appa {
+
+/* Dashboard */
+Dashboard::Dashboard(OdomBase& odom, Chassis* chassis, Point origin, uint32_t period)
+    : odom(odom), chassis(chassis), origin(origin), period(std::max<uint32_t>(period, 20)) {}
+
+Dashboard::~Dashboard() {
+    if (timer) lv_timer_del(timer);
+    if (screen) lv_obj_del(screen);
+}
+
+void Dashboard::start() {
+    if (screen) return;
+    screen = lv_obj_create(nullptr);
+    lv_obj_set_style_bg_color(screen, lv_color_black(), 0);
+
+    // field, odom y up on the screen
+    lv_obj_t* field = lv_obj_create(screen);
+    lv_obj_set_size(field, field_size, field_size);
+    lv_obj_set_pos(field, 0, 0);
+    lv_obj_clear_flag(field, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_pad_all(field, 0, 0);
+    lv_obj_set_style_radius(field, 0, 0);
+    lv_obj_set_style_border_width(field, 1, 0);
+    lv_obj_set_style_border_color(field, lv_color_hex(0x808080), 0);
+    lv_obj_set_style_bg_color(field, lv_color_hex(0x202020), 0);
+
+    trace = lv_line_create(field);
+    lv_obj_set_style_line_width(trace, 2, 0);
+    lv_obj_set_style_line_color(trace, lv_palette_main(LV_PALETTE_BLUE), 0);
+    robot = lv_line_create(field);
+    lv_obj_set_style_line_width(robot, 2, 0);
+    lv_obj_set_style_line_color(robot, lv_palette_main(LV_PALETTE_ORANGE), 0);
+
+    // errors, linear in tenths of an inch on the left axis and angular in degrees on the right
+    chart = lv_chart_create(screen);
+    lv_obj_set_size(chart, 230, 160);
+    lv_obj_set_pos(chart, field_size + 5, 5);
+    lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
+    lv_chart_set_update_mode(chart, LV_CHART_UPDATE_MODE_SHIFT);
+    lv_chart_set_point_count(chart, chart_points);
+    lv_chart_set_range(chart, LV_CHART_AXIS_PRIMARY_Y, -120, 120);
+    lv_chart_set_range(chart, LV_CHART_AXIS_SECONDARY_Y, -45, 45);
+    lv_obj_set_style_size(chart, 0, LV_PART_INDICATOR);
+    linear_series =
+        lv_chart_add_series(chart, lv_palette_main(LV_PALETTE_GREEN), LV_CHART_AXIS_PRIMARY_Y);
+    angular_series =
+        lv_chart_add_series(chart, lv_palette_main(LV_PALETTE_RED), LV_CHART_AXIS_SECONDARY_Y);
+    lv_chart_set_all_value(chart, linear_series, 0);
+    lv_chart_set_all_value(chart, angular_series, 0);
+
+    label = lv_label_create(screen);
+    lv_obj_set_pos(label, field_size + 5, 170);
+    lv_obj_set_style_text_color(label, lv_color_white(), 0);
+    lv_label_set_text(label, "");
+
+    lv_scr_load(screen);
+    timer = lv_timer_create([](lv_timer_t* timer) { ((Dashboard*)timer->user_data)->update(); },
+                            period, this);
+}
+
+void Dashboard::clear() {
+    if (!screen) return;
+    trace_size = 0;
+    lv_line_set_points(trace, trace_points.data(), 0);
+}
+
+lv_point_t Dashboard::to_screen(const Point& point) const {
+    return {(lv_coord_t)std::lround((origin.x + point.x) * scale),
+            (lv_coord_t)std::lround(field_size - (origin.y + point.y) * scale)};
+}
+
+// runs in the lvgl task, only redrawing what changed
+void Dashboard::update() {
+    const Pose pose = odom.get();
+
+    // trace, extended once the robot moved a pixel and thinned out when full
+    const lv_point_t point = to_screen(pose.p());
+    const lv_point_t* last = trace_size ? &trace_points[trace_size - 1] : nullptr;
+    if (!last || last->x != point.x || last->y != point.y) {
+        if (trace_size == trace_capacity) {
+            for (int i = 0; i < trace_capacity / 2; i++) trace_points[i] = trace_points[2 * i];
+            trace_size = trace_capacity / 2;
+        }
+        trace_points[trace_size++] = point;
+        lv_line_set_points(trace, trace_points.data(), trace_size);
+    }
+
+    // robot, a triangle pointing along the heading
+    const std::array<Point, 4> corners = {Point{9, 0}, Point{-7, 7}, Point{-7, -7}, Point{9, 0}};
+    for (int i = 0; i < 4; i++)
+        robot_points[i] = to_screen(pose.p() + corners[i].rotate(pose.theta));
+    lv_line_set_points(robot, robot_points.data(), robot_points.size());
+
+    // errors of the running motion
+    Point error = {0.0, 0.0};
+    uint32_t motion_busy = 0;
+    if (chassis) {
+        const Chassis::Progress progress = chassis->get_progress();
+        if (progress.running) error = progress.error;
+        motion_busy = chassis->get_timing().busy;
+    }
+    lv_chart_set_next_value(chart, linear_series,
+                            std::clamp(std::lround(error.linear * 10), -120L, 120L));
+    lv_chart_set_next_value(chart, angular_series,
+                            std::clamp(std::lround(to_deg(error.angular)), -45L, 45L));
+
+    char next[sizeof(text)];
+    snprintf(next, sizeof(next),
+             "x %.1f  y %.1f  %.1f deg\nerror %.1f in  %.1f deg\nodom %u us  motion %u us",
+             pose.x, pose.y, to_deg(pose.theta), error.linear, to_deg(error.angular),
+             (unsigned)odom.get_timing().busy, (unsigned)motion_busy);
+    if (strcmp(next, text)) {
+        memcpy(text, next, sizeof(text));
+        lv_label_set_text_static(label, text);
+    }
+}
+
+/* Selector */
+Selector::Selector(Chassis& chassis) : chassis(chassis) {}
+
+Selector::~Selector() {
+    if (timer) lv_timer_del(timer);
+    if (screen) lv_obj_del(screen);
+}
+
+int Selector::add(const std::string& name, Prepare prepare, Run run) {
+    entries.push_back({name, std::move(prepare), std::move(run)});
+    return entries.size() - 1;
+}
+
+void Selector::start() {
+    if (screen) return;
+    screen = lv_obj_create(nullptr);
+    lv_obj_set_style_bg_color(screen, lv_color_black(), 0);
+
+    list = lv_list_create(screen);
+    lv_obj_set_size(list, 280, 240);
+    lv_obj_set_pos(list, 0, 0);
+    for (const Entry& entry : entries) {
+        lv_obj_t* button = lv_list_add_btn(list, nullptr, entry.name.c_str());
+        lv_obj_add_flag(button, LV_OBJ_FLAG_CHECKABLE);
+        lv_obj_add_event_cb(
+            button,
+            [](lv_event_t* event) {
+                ((Selector*)lv_event_get_user_data(event))
+                    ->select(lv_obj_get_index(lv_event_get_target(event)));
+            },
+            LV_EVENT_CLICKED, this);
+    }
+
+    label = lv_label_create(screen);
+    lv_obj_set_pos(label, 290, 10);
+    lv_obj_set_width(label, 185);
+    lv_obj_set_style_text_color(label, lv_color_white(), 0);
+    lv_label_set_text(label, "");
+
+    lv_scr_load(screen);
+    // the list and label follow the selection and preparing from lvgl's own task
+    timer = lv_timer_create([](lv_timer_t* timer) { ((Selector*)timer->user_data)->update(); },
+                            100, this);
+    update();
+}
+
+void Selector::update() {
+    const int index = selected.load();
+    for (int i = 0; i < entries.size(); i++) {
+        lv_obj_t* button = lv_obj_get_child(list, i);
+        if (i == index) lv_obj_add_state(button, LV_STATE_CHECKED);
+        else lv_obj_clear_state(button, LV_STATE_CHECKED);
+    }
+
+    char next[sizeof(text)];
+    if (entries.empty()) snprintf(next, sizeof(next), "no autons");
+    else {
+        snprintf(next, sizeof(next), "%s\n%s", entries[index].name.c_str(),
+                 prepared.load() == index ? "ready" : "preparing");
+    }
+    if (strcmp(next, text)) {
+        memcpy(text, next, sizeof(text));
+        lv_label_set_text_static(label, text);
+    }
+}
+
+void Selector::select(int index) {
+    if (index >= 0 && index < entries.size()) selected.store(index);
+}
+
+int Selector::get_selected() const { return selected.load(); }
+
+bool Selector::prepare() {
+    const int index = selected.load();
+    if (index < 0 || index >= entries.size()) return false;
+    if (prepared.load() == index) return true;
+
+    // marked unprepared while it builds, so a competition_initialize() ended halfway leaves it to
+    // run() to build again
+    prepared.store(-1);
+    const uint32_t start = pros::millis();
+    plan.motions.clear();
+    plan.paths.clear();
+    plan.trajectories.clear();
+    entries[index].prepare(plan);
+    int invalid = 0;
+    for (const Chassis::Prepared& motion : plan.motions) invalid += !motion;
+    printf("selector: prepared %s, %d motions in %u ms", entries[index].name.c_str(),
+           (int)plan.motions.size(), (unsigned)(pros::millis() - start));
+    if (invalid) printf(", %d of them can't run", invalid);
+    printf("\n");
+    prepared.store(index);
+    return true;
+}
+
+void Selector::run() {
+    if (!prepare()) {
+        printf("selector: no auton to run\n");
+        return;
+    }
+    const Entry& entry = entries[prepared.load()];
+    if (entry.run) entry.run(plan);
+    else {
+        for (const Chassis::Prepared& motion : plan.motions) chassis.run(motion);
+    }
+}
+
+} // namespace appa
+#endif
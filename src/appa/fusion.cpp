@@ -0,0 +1,105 @@
+#include "appa.h"
+
+namespace appa {
+
+/* GpsFusion */
+GpsFusion::GpsFusion(OdomBase& odom, uint8_t port, Point offset, double heading_offset,
+                     FieldTransform frame, int period)
+    : odom(odom),
+      gps(port),
+      offset(offset),
+      heading_offset(to_rad(heading_offset)),
+      frame(frame),
+      period(std::max(5, period)) {
+    reset();
+}
+
+GpsFusion::~GpsFusion() {
+    if (fusion_task) {
+        fusion_task->remove();
+        delete fusion_task;
+    }
+}
+
+void GpsFusion::start() {
+    if (fusion_task == nullptr)
+        fusion_task = start_task([this] { task(); }, task_config, "fusion_task");
+}
+
+void GpsFusion::reset(const Pose& initial) {
+    requested.write(initial);
+    reset_pending.store(true);
+}
+
+Pose GpsFusion::get_deviation() { return odom.get_covariance().deviation(); }
+
+uint32_t GpsFusion::rejected() const { return rejects.load(std::memory_order_relaxed); }
+
+void GpsFusion::task() {
+    uint32_t now = pros::millis();
+    while (true) {
+        if (reset_pending.exchange(false))
+            odom.set_covariance(Covariance::diagonal(requested.read()));
+
+        // the prediction is the odom's, which grows its covariance every loop
+        const Pose pose = odom.get();
+        const Covariance P = odom.get_covariance();
+
+        // a fix of the gps, in m and deg clockwise from the gps field's y axis. calibrating or
+        // disconnected gps read as PROS_ERR_F
+        const pros::gps_status_s_t fix = gps.get_position_and_orientation();
+        const double error = gps.get_error() / 0.0254; // in
+        if (std::isfinite(fix.x) && std::isfinite(fix.y) && std::isfinite(fix.yaw) &&
+            std::isfinite(error)) {
+            // the robot's pose from the sensor's, in the odom frame
+            const Pose sensor =
+                frame.pose({fix.x / 0.0254, fix.y / 0.0254, M_PI / 2 - to_rad(fix.yaw)});
+            const double heading = sensor.theta - heading_offset;
+            const Point position = Point(sensor) - offset.rotate(heading);
+
+            // compare with where odom had the robot when the fix was taken, the error then maps
+            // to now through the motion since
+            const uint64_t time = pros::micros() - (uint64_t)latency * 1000;
+            const Pose past = odom.get_at(time);
+            const Covariance H = Covariance::transport({past.x - pose.x, past.y - pose.y});
+            const double innovation[3] = {position.x - past.x, position.y - past.y,
+                                          wrap(heading - past.theta)};
+
+            const double r = std::max(error, min_error);
+            Covariance S = H * P * H.transpose();
+            S.m[0][0] += r * r;
+            S.m[1][1] += r * r;
+            S.m[2][2] += heading_error * heading_error;
+
+            Covariance S_inv;
+            double distance2 = INFINITY;
+            if (S.invert(S_inv)) {
+                distance2 = 0.0;
+                for (int i = 0; i < 3; i++)
+                    for (int j = 0; j < 3; j++)
+                        distance2 += innovation[i] * S_inv.m[i][j] * innovation[j];
+            }
+
+            if (distance2 > gate) {
+                rejects.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                // kalman gain, then the error of the current pose and its covariance
+                const Covariance K = P * H.transpose() * S_inv;
+                Pose correction = {0.0, 0.0, 0.0};
+                for (int j = 0; j < 3; j++) {
+                    correction.x += K.m[0][j] * innovation[j];
+                    correction.y += K.m[1][j] * innovation[j];
+                    correction.theta += K.m[2][j] * innovation[j];
+                }
+                Covariance I_KH = K * H;
+                for (int i = 0; i < 3; i++)
+                    for (int j = 0; j < 3; j++) I_KH.m[i][j] = (i == j) - I_KH.m[i][j];
+                odom.correct(correction, I_KH);
+            }
+        }
+
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+} // namespace appa
@@ -0,0 +1,172 @@
+#include "appa.h"
+#include <cstdlib>
+#include <malloc.h>
+
+namespace appa::heap {
+
+static std::atomic<bool> is_sealed{false};
+static std::atomic<uint32_t> allocations{0};
+static std::atomic<size_t> bytes{0}, last_size{0};
+
+void seal() {
+#ifdef APPA_NO_HEAP
+    allocations.store(0);
+    bytes.store(0);
+    is_sealed.store(true);
+#endif
+}
+
+bool sealed() { return is_sealed.load(); }
+
+Usage usage() { return {allocations.load(), bytes.load(), last_size.load()}; }
+
+void report() {
+    const Usage current = usage();
+    if (!sealed()) printf("heap: not sealed\n");
+    else if (current.allocations == 0) printf("heap: nothing allocated since sealed\n");
+    else
+        printf("heap: %u allocations (%u bytes) since sealed, the latest %u bytes\n",
+               (unsigned)current.allocations, (unsigned)current.bytes, (unsigned)current.last_size);
+}
+
+size_t in_use() {
+#ifdef __GLIBC__
+    return mallinfo2().uordblks; // on the computer
+#else
+    return mallinfo().uordblks;
+#endif
+}
+
+#if defined(APPA_NO_HEAP) || defined(APPA_ARENA)
+// only counts, printing from inside an allocation could allocate again
+static void count(size_t size) {
+    if (!is_sealed.load(std::memory_order_relaxed)) return;
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    last_size.store(size, std::memory_order_relaxed);
+}
+#endif
+
+} // namespace appa::heap
+
+namespace appa {
+
+/* Arena */
+// arenas a delete might belong to, and the one task routed to an arena at a time
+static constexpr int max_arenas = 4;
+static std::atomic<Arena*> arenas[max_arenas];
+static std::atomic<Arena*> scoped{nullptr};
+static std::atomic<pros::task_t> scoped_task{nullptr};
+
+Arena::Arena(size_t capacity)
+    : block(static_cast<std::byte*>(malloc(capacity))), capacity(block ? capacity : 0),
+      owned(true) {
+    enroll();
+}
+
+Arena::Arena(std::span<std::byte> storage)
+    : block(storage.data()), capacity(storage.size()), owned(false) {
+    enroll();
+}
+
+void Arena::enroll() {
+    for (auto& slot : arenas) {
+        Arena* empty = nullptr;
+        if (slot.compare_exchange_strong(empty, this)) return;
+    }
+    // a delete couldn't tell this one's memory from the heap's, so everything overflows instead
+    printf("arena: more than %d arenas\n", max_arenas);
+    capacity = 0;
+}
+
+Arena::~Arena() {
+    for (auto& slot : arenas) {
+        Arena* self = this;
+        slot.compare_exchange_strong(self, nullptr);
+    }
+    if (owned) free(block);
+}
+
+void Arena::reset() { used = 0; }
+size_t Arena::get_used() const { return used; }
+size_t Arena::get_peak() const { return peak; }
+uint32_t Arena::get_overflows() const { return overflows.load(); }
+
+bool Arena::owns(const void* memory) const {
+    const std::byte* byte = static_cast<const std::byte*>(memory);
+    return capacity > 0 && byte >= block && byte < block + capacity;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    const uintptr_t start = reinterpret_cast<uintptr_t>(block) + used;
+    const size_t padding = (alignment - start % alignment) % alignment;
+    if (used + padding + bytes > capacity) {
+        overflows.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+    void* memory = block + used + padding;
+    used += padding + bytes;
+    peak = std::max(peak, used);
+    return memory;
+}
+
+void Arena::do_deallocate(void* memory, size_t bytes, size_t alignment) {
+    if (!owns(memory)) ::operator delete(memory, bytes, std::align_val_t(alignment));
+}
+
+bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+Arena::Scope::Scope(Arena& arena) {
+    pros::task_t none = nullptr;
+    active = scoped_task.compare_exchange_strong(none, pros::c::task_get_current());
+    if (active) scoped.store(&arena);
+}
+
+Arena::Scope::~Scope() {
+    if (!active) return;
+    scoped.store(nullptr);
+    scoped_task.store(nullptr);
+}
+
+void* Arena::allocate_scoped(size_t size) {
+    // the common case, no scope open, is one load
+    if (scoped_task.load(std::memory_order_relaxed) == nullptr) return nullptr;
+    if (scoped_task.load() != pros::c::task_get_current()) return nullptr;
+    Arena* arena = scoped.load();
+    if (arena == nullptr || arena->used + size + alignof(std::max_align_t) > arena->capacity)
+        return nullptr; // to the heap, as an overflow would
+    return arena->allocate(size ? size : 1, alignof(std::max_align_t));
+}
+
+bool Arena::release(void* memory) {
+    for (auto& slot : arenas) {
+        const Arena* arena = slot.load(std::memory_order_relaxed);
+        if (arena && arena->owns(memory)) return true;
+    }
+    return false;
+}
+
+} // namespace appa
+
+#if defined(APPA_NO_HEAP) || defined(APPA_ARENA)
+// replace the global allocation functions, which the nothrow news go through too
+void* operator new(size_t size) {
+    if (void* memory = appa::Arena::allocate_scoped(size)) return memory;
+    appa::heap::count(size);
+    void* memory = malloc(size ? size : 1);
+    if (memory == nullptr) {
+        printf("heap: out of memory allocating %u bytes\n", (unsigned)size);
+        abort();
+    }
+    return memory;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* memory) noexcept {
+    if (!appa::Arena::release(memory)) free(memory);
+}
+void operator delete[](void* memory) noexcept { operator delete(memory); }
+void operator delete(void* memory, size_t) noexcept { operator delete(memory); }
+void operator delete[](void* memory, size_t) noexcept { operator delete(memory); }
+#endif
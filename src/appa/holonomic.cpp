@@ -0,0 +1,126 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Holonomic */
+Holonomic::Holonomic(const std::initializer_list<int8_t>& front_left,
+                     const std::initializer_list<int8_t>& front_right,
+                     const std::initializer_list<int8_t>& back_left,
+                     const std::initializer_list<int8_t>& back_right, OdomBase& odom,
+                     const MoveConfig& move_config, const TurnConfig& turn_config,
+                     const Options& default_options)
+    : front_left(front_left),
+      front_right(front_right),
+      back_left(back_left),
+      back_right(back_right),
+      odom(odom),
+      df_move(Options::defaults() << move_config.options() << default_options),
+      turn_exit(turn_config.exit),
+      turn_speed(turn_config.speed),
+      heading_gains(default_options.ang_PID.value_or(turn_config.ang_PID)) {}
+
+// four corner inverse kinematics, scaled together so no wheel asks for more than 100%
+void Holonomic::drive(double forward, double strafe, double turn) {
+    std::array<double, 4> speeds = {forward + strafe + turn, forward - strafe - turn,
+                                    forward - strafe + turn, forward + strafe - turn};
+    double largest = 100.0;
+    for (double speed : speeds) largest = std::max(largest, fabs(speed));
+    std::lock_guard<pros::Mutex> lock(holonomic_mutex);
+    front_left.move_voltage(speeds[0] * 12000 / largest);
+    front_right.move_voltage(speeds[1] * 12000 / largest);
+    back_left.move_voltage(speeds[2] * 12000 / largest);
+    back_right.move_voltage(speeds[3] * 12000 / largest);
+}
+
+// rotates the field vector into the robot frame, forward is x and left is y
+void Holonomic::field(double x, double y, double turn) {
+    const Point local = Point{x, y}.rotate(-odom.get().theta);
+    drive(local.x, -local.y, turn);
+}
+
+void Holonomic::drive(pros::Controller& controller, bool field_relative) {
+    sticks(controller.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_X),
+           controller.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_Y),
+           controller.get_analog(pros::E_CONTROLLER_ANALOG_RIGHT_X), field_relative);
+}
+void Holonomic::drive(const Controller& controller, bool field_relative) {
+    const ControllerState state = controller.get();
+    sticks(state.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_X),
+           state.get_analog(pros::E_CONTROLLER_ANALOG_LEFT_Y),
+           state.get_analog(pros::E_CONTROLLER_ANALOG_RIGHT_X), field_relative);
+}
+// field relative sticks point along the heading the odom was zeroed at
+void Holonomic::sticks(int32_t x, int32_t y, int32_t turn, bool field_relative) {
+    if (field_relative) field(y / 1.27, -x / 1.27, turn / 1.27);
+    else drive(y / 1.27, x / 1.27, turn / 1.27);
+}
+
+// target heading in degrees like the chassis, without one the starting heading is held
+Chassis::MotionResult Holonomic::move(Pose target, Options options) {
+    const uint32_t token = cancel_token.fetch_add(1) + 1;
+    target.theta = std::isnan(target.theta) ? odom.get().theta : to_rad(target.theta);
+    const ScheduledGains ang_gains = options.ang_PID.value_or(heading_gains);
+    options = df_move << options;
+    const double speed = options.speed.value(), exit = options.exit.value();
+    const int settle = options.settle.value(), timeout = options.timeout.value();
+    const int period = std::max(1, options.period.value());
+    const ScheduledGains lin_gains = options.lin_PID.value();
+    PID lin_pid(lin_gains.get(0)), ang_pid(ang_gains.get(0));
+
+    Chassis::MotionResult result;
+    const uint32_t start_time = pros::millis();
+    uint32_t now = start_time, settle_time = 0;
+    while (true) {
+        const Pose pose = odom.get();
+        const Point error = target.p() - pose.p();
+        const double distance = error.dist({0, 0});
+        const double heading_error = wrap(target.theta - pose.theta);
+        result.error = distance;
+        result.peak_speed = std::max(result.peak_speed, odom.get_velocity().speed());
+
+        if (cancel_token.load() != token) {
+            result.reason = Chassis::CANCELLED;
+            break;
+        }
+        if (timeout > 0 && now - start_time >= timeout) {
+            result.reason = Chassis::TIMED_OUT;
+            break;
+        }
+        if (distance < exit && fabs(to_deg(heading_error)) < turn_exit) {
+            settle_time += period;
+            if (settle_time >= settle) {
+                result.reason = Chassis::SETTLED;
+                break;
+            }
+        } else settle_time = 0;
+
+        // translation along the error and rotation toward the target heading, together
+        if (lin_gains.scheduled()) lin_pid.set_gains(lin_gains.get(distance));
+        if (ang_gains.scheduled()) ang_pid.set_gains(ang_gains.get(to_deg(heading_error)));
+        const double lin_speed = std::clamp(lin_pid.update(distance, period), -speed, speed);
+        const double ang_speed =
+            std::clamp(ang_pid.update(heading_error, period), -turn_speed, turn_speed);
+        const Point direction = distance > 1e-6 ? error * (1 / distance) : Point{0, 0};
+        const Point local = (direction * lin_speed).rotate(-pose.theta);
+        drive(local.x, -local.y, -ang_speed);
+        pros::c::task_delay_until(&now, period);
+    }
+    if (result.reason != Chassis::CANCELLED) drive(0, 0, 0);
+    result.time = pros::millis() - start_time;
+    return result;
+}
+
+void Holonomic::stop() {
+    cancel_token.fetch_add(1);
+    drive(0, 0, 0);
+}
+
+void Holonomic::set_brake_mode(pros::motor_brake_mode_e mode) {
+    std::lock_guard<pros::Mutex> lock(holonomic_mutex);
+    front_left.set_brake_mode_all(mode);
+    front_right.set_brake_mode_all(mode);
+    back_left.set_brake_mode_all(mode);
+    back_right.set_brake_mode_all(mode);
+}
+
+} // namespace appa
@@ -0,0 +1,87 @@
+#include "appa.h"
+
+namespace appa {
+
+/* SensorHub */
+SensorHub::SensorHub(OdomBase& odom, Chassis* chassis, int every)
+    : odom(odom), chassis(chassis), every(std::max(every, 1)) {}
+
+SensorHub::~SensorHub() {
+    if (hub_task) {
+        if (chassis) chassis->sensor_hub.store(nullptr);
+        odom.unsubscribe((pros::task_t)*hub_task);
+        hub_task->remove();
+        delete hub_task;
+    }
+}
+
+int SensorHub::add(pros::MotorGroup& motors) {
+    if (hub_task || count == capacity) {
+        printf("sensor hub: can't add motors%s\n", hub_task ? " after start" : "");
+        return -1;
+    }
+    groups[count] = &motors;
+    return count++;
+}
+
+// above everything but the odom, so a read follows the loop that woke it
+void SensorHub::start() {
+    if (hub_task == nullptr) hub_task = start_task([this] { task(); }, task_config, "hub_task");
+}
+
+SensorHub::Snapshot SensorHub::get() const { return snapshot.read(); }
+
+std::optional<SensorHub::Snapshot> SensorHub::recent(uint32_t max_age) const {
+    const Snapshot current = snapshot.read();
+    if (current.version == 0 || pros::micros() - current.time > max_age * 1000) return {};
+    return current;
+}
+
+// averages a group's readings, skipping motors that report an error
+template <typename Read> static double average(pros::MotorGroup& motors, Read read) {
+    double total = 0.0;
+    int count = 0;
+    for (int i = 0; i < motors.size(); i++) {
+        const double value = read(i);
+        if (!std::isfinite(value) || value == PROS_ERR) continue;
+        total += value;
+        count++;
+    }
+    return count > 0 ? total / count : NAN;
+}
+
+void SensorHub::task() {
+    odom.subscribe(pros::c::task_get_current());
+    if (chassis) chassis->sensor_hub.store(this);
+    Snapshot next;
+    for (uint32_t tick = 0;; tick++) {
+        // a stopped or failed odom still reads, a period late
+        pros::c::task_notify_take(true, 2 * OdomBase::period);
+        if (tick % every) continue;
+        APPA_PROFILE_SCOPE("hub read");
+
+        next.pose = odom.get();
+        next.twist = odom.get_velocity();
+        next.ticks = odom.get_ticks();
+        if (chassis) {
+            next.drive_velocity = chassis->read_velocity();
+            next.drive_current = chassis->read_current();
+        }
+        const int32_t voltage = pros::battery::get_voltage();
+        const int32_t current = pros::battery::get_current();
+        next.battery_voltage = voltage == PROS_ERR ? NAN : voltage;
+        next.battery_current = current == PROS_ERR ? NAN : battery_current.update(current);
+        for (int i = 0; i < count; i++) {
+            pros::MotorGroup& motors = *groups[i];
+            next.motors[i] = {
+                average(motors, [&](int k) { return motors.get_actual_velocity(k); }),
+                average(motors, [&](int k) { return motors.get_position(k); }),
+                average(motors, [&](int k) { return (double)motors.get_current_draw(k); })};
+        }
+        next.time = pros::micros();
+        next.version++;
+        snapshot.write(next);
+    }
+}
+
+} // namespace appa
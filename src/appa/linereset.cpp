@@ -0,0 +1,134 @@
+#include "appa.h"
+
+namespace appa {
+
+/* LineReset */
+LineReset::LineReset(OdomBase& odom, std::initializer_list<LineSensor> sensors,
+                     std::initializer_list<FieldLine> lines, int period)
+    : odom(odom), lines(lines), period(std::max(1, period)) {
+    for (const LineSensor& sensor : sensors) {
+        const bool adi = (sensor.port >= 'A' && sensor.port <= 'H') ||
+                         (sensor.port >= 'a' && sensor.port <= 'h');
+        if (adi) this->sensors.push_back({pros::adi::LineSensor(sensor.port), sensor.offset});
+        else this->sensors.push_back({pros::Optical(sensor.port), sensor.offset});
+    }
+}
+
+LineReset::~LineReset() {
+    if (line_task) {
+        line_task->remove();
+        delete line_task;
+    }
+}
+
+void LineReset::start() {
+    enabled.store(true);
+    if (line_task == nullptr) {
+        // the led lights the tape the same in any room
+        for (Sensor& sensor : sensors) {
+            if (pros::Optical* optical = std::get_if<pros::Optical>(&sensor.device))
+                optical->set_led_pwm(100);
+        }
+        line_task = start_task([this] { task(); }, task_config, "line_task");
+    }
+}
+
+void LineReset::stop() { enabled.store(false); }
+
+uint32_t LineReset::corrections() const { return accepted.load(std::memory_order_relaxed); }
+uint32_t LineReset::rejected() const { return rejects.load(std::memory_order_relaxed); }
+
+// brighter is higher for both, line trackers read lower the more light comes back
+double LineReset::read(Sensor& sensor) {
+    if (pros::adi::LineSensor* tracker = std::get_if<pros::adi::LineSensor>(&sensor.device)) {
+        const int32_t value = tracker->get_value();
+        return value == PROS_ERR ? NAN : 1.0 - std::clamp(value, 0, 4095) / 4095.0;
+    }
+    const double brightness = std::get<pros::Optical>(sensor.device).get_brightness();
+    return brightness == PROS_ERR_F ? NAN : brightness;
+}
+
+bool LineReset::cross(const Sensor& sensor, uint64_t enter, uint64_t leave) {
+    // where the sensor was on either edge of the tape
+    auto at = [&](uint64_t time) {
+        const Pose pose = odom.get_at(time - (uint64_t)latency * 1000);
+        return Point(pose) + sensor.offset.rotate(pose.theta);
+    };
+    const Point on = at(enter), off = at(leave);
+    const Point middle = (on + off) * 0.5;
+
+    // the nearest line it crossed, from one side of the tape to the other
+    const FieldLine* nearest = nullptr;
+    double error = INFINITY;
+    for (const FieldLine& line : lines) {
+        const bool along_x = line.axis == FieldLine::X;
+        const double across = along_x ? off.y - on.y : off.x - on.x;
+        const double along = along_x ? middle.x : middle.y;
+        if (fabs(across) < width / 2 || fabs(across) > width * 2) continue;
+        if (along < std::min(line.from, line.to) - max_correction ||
+            along > std::max(line.from, line.to) + max_correction)
+            continue;
+        const double line_error = line.position - (along_x ? middle.y : middle.x);
+        if (fabs(line_error) < fabs(error)) {
+            nearest = &line;
+            error = line_error;
+        }
+    }
+    if (!nearest || fabs(error) > max_correction) {
+        rejects.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // a position error is the same now as when it crossed
+    const double correction = std::clamp(gain, 0.0, 1.0) * error;
+    const Pose shift = nearest->axis == FieldLine::X ? Pose{0.0, correction, 0.0}
+                                                     : Pose{correction, 0.0, 0.0};
+    if (blend) odom.blend(shift);
+    else odom.correct(shift);
+    accepted.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void LineReset::task() {
+    uint32_t now = pros::millis();
+    while (true) {
+        for (Sensor& sensor : sensors) {
+            const uint64_t time = pros::micros();
+            const double brightness = read(sensor);
+            if (std::isnan(brightness)) {
+                sensor.over = false;
+                sensor.prev = NAN;
+                continue;
+            }
+            // where between the samples the reading passed the level, as if it changed linearly
+            auto crossed = [&](double level) {
+                if (std::isnan(sensor.prev) || brightness == sensor.prev) return time;
+                const double t = std::clamp((level - sensor.prev) / (brightness - sensor.prev),
+                                            0.0, 1.0);
+                return sensor.prev_time + (uint64_t)(t * (time - sensor.prev_time));
+            };
+            // both edges at the threshold, so the middle isn't moved by the hysteresis
+            if (!sensor.over && brightness > threshold) {
+                sensor.over = true;
+                // on the tape from the start, where it went on isn't known
+                sensor.enter_time = std::isnan(sensor.prev) ? 0 : crossed(threshold);
+                sensor.leave_time = time;
+            } else if (sensor.over) {
+                if (sensor.prev >= threshold && brightness < threshold)
+                    sensor.leave_time = crossed(threshold);
+                if (brightness < threshold - hysteresis) {
+                    sensor.over = false;
+                    const uint64_t enter = sensor.enter_time, leave = sensor.leave_time;
+                    const bool timed = enter > 0 && leave > enter &&
+                                       leave - enter < (uint64_t)max_time * 1000;
+                    if (enabled.load() && timed) cross(sensor, enter, leave);
+                }
+            }
+            sensor.prev = brightness;
+            sensor.prev_time = time;
+        }
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+} // namespace appa
@@ -0,0 +1,58 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Link */
+Link::Link(uint8_t port, OdomBase& odom, Chassis* chassis, int32_t baud, int period)
+    : odom(odom), chassis(chassis), serial(port, baud), period(std::max(1, period)) {}
+
+Link::~Link() {
+    if (link_task) {
+        link_task->remove();
+        delete link_task;
+    }
+}
+
+void Link::start() {
+    if (link_task == nullptr)
+        link_task = start_task([this] { task(); }, task_config, "link_task");
+}
+
+uint32_t Link::dropped() const { return drops.load(std::memory_order_relaxed); }
+
+void Link::task() {
+    uint32_t now = pros::millis();
+    uint8_t frame[wire::max_frame];
+    while (true) {
+        // one snapshot of each, all seqlock reads
+        const Pose pose = odom.get();
+        const Twist twist = odom.get_velocity(true);
+        const LoopTiming odom_timing = odom.get_timing();
+        wire::Sample sample = {.time = pros::millis(),
+                               .x = pose.x,
+                               .y = pose.y,
+                               .theta = pose.theta,
+                               .velocity_linear = twist.vel.x,
+                               .velocity_angular = twist.vel.theta,
+                               .odom_busy = odom_timing.busy,
+                               .odom_overruns = odom_timing.overruns};
+        if (chassis) {
+            const Chassis::Progress progress = chassis->get_progress();
+            const LoopTiming motion_timing = chassis->get_timing();
+            if (progress.running) {
+                sample.error_linear = progress.error.linear;
+                sample.error_angular = progress.error.angular;
+            }
+            sample.motion_busy = motion_timing.busy;
+            sample.motion_overruns = motion_timing.overruns;
+        }
+
+        // a frame is sent whole or not at all, so the receiver only loses it and not its neighbor
+        const size_t size = encoder.encode(sample, frame);
+        if (serial.get_write_free() >= (int32_t)size) serial.write(frame, size);
+        else drops.fetch_add(1, std::memory_order_relaxed);
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+} // namespace appa
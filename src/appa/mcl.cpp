@@ -0,0 +1,243 @@
+#include "appa.h"
+
+// the particles are floats whatever the precision, so neon is used whenever it is there
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define APPA_NEON
+#endif
+
+namespace appa {
+
+/* ParticleFilter */
+ParticleFilter::ParticleFilter(OdomBase& odom, std::initializer_list<DistanceSensor> sensors,
+                               int count, int period)
+    : odom(odom),
+      count(std::clamp((count + 3) / 4 * 4, 4, capacity)),
+      period(std::max(5, period)) {
+    for (const DistanceSensor& sensor : sensors) {
+        this->sensors.emplace_back(sensor.port);
+        offsets.push_back({sensor.offset.x, sensor.offset.y, to_rad(sensor.offset.theta)});
+    }
+}
+
+ParticleFilter::~ParticleFilter() {
+    if (mcl_task) {
+        mcl_task->remove();
+        delete mcl_task;
+    }
+}
+
+void ParticleFilter::start() {
+    const Pose pose = odom.get();
+    reset({pose.x, pose.y, to_deg(pose.theta)});
+    if (mcl_task == nullptr)
+        mcl_task = start_task([this] { task(); }, task_config, "mcl_task");
+}
+
+void ParticleFilter::reset(const Pose& pose, const Pose& deviation) {
+    requested.write({pose.x, pose.y, to_rad(pose.theta)});
+    requested_spread.write({deviation.x, deviation.y, to_rad(deviation.theta)});
+    reset_pending.store(true);
+}
+
+Pose ParticleFilter::get() { return estimate.read(); }
+Pose ParticleFilter::get_deviation() { return spread.read(); }
+
+// xorshift, plenty for scattering particles
+float ParticleFilter::uniform() {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    return (random >> 8) * (1.0f / 16777216);
+}
+
+// the sum of four uniforms, close enough to normal and without logs or roots
+float ParticleFilter::noise() {
+    return (uniform() + uniform() + uniform() + uniform() - 2.0f) * 1.7320508f;
+}
+
+void ParticleFilter::scatter(const Pose& pose, const Pose& deviation) {
+    for (int i = 0; i < count; i++) {
+        const float theta = pose.theta + noise() * deviation.theta;
+        particles.x[i] = pose.x + noise() * deviation.x;
+        particles.y[i] = pose.y + noise() * deviation.y;
+        particles.cos[i] = cosf(theta);
+        particles.sin[i] = sinf(theta);
+        particles.weight[i] = 1.0f / count;
+    }
+}
+
+// motion is the odom's since the last cycle in the robot frame, in and rad
+void ParticleFilter::move(const Pose& motion) {
+    const float position_noise = travel_noise * hypot(motion.x, motion.y) + jitter;
+    const float heading_noise = turn_noise * fabs(motion.theta) + to_rad(jitter);
+    const float dx = motion.x, dy = motion.y;
+    const float turn_cos = cos(motion.theta), turn_sin = sin(motion.theta);
+    for (int i = 0; i < count; i++) {
+        const float c = particles.cos[i], s = particles.sin[i];
+        particles.x[i] += dx * c - dy * s + noise() * position_noise;
+        particles.y[i] += dx * s + dy * c + noise() * position_noise;
+
+        // the odom's turn, then a small noise turn from its series, renormalized to a unit vector
+        const float d = noise() * heading_noise, d2 = d * d;
+        const float noise_cos = 1 - d2 / 2 + d2 * d2 / 24, noise_sin = d * (1 - d2 / 6);
+        const float rc = turn_cos * noise_cos - turn_sin * noise_sin;
+        const float rs = turn_sin * noise_cos + turn_cos * noise_sin;
+        const float nc = c * rc - s * rs, ns = s * rc + c * rs;
+        const float norm = (3 - (nc * nc + ns * ns)) / 2;
+        particles.cos[i] = nc * norm;
+        particles.sin[i] = ns * norm;
+    }
+}
+
+// weights every particle by a cauchy likelihood of the reading against the wall its sensor would
+// see. since is the odom's global motion from when the reading was taken, backed out of each
+// particle. the walls are closed form, the nearer of the x and y wall ahead of the beam
+void ParticleFilter::weigh(size_t sensor, float distance, const Pose& since) {
+    const Pose& mount = offsets[sensor];
+    const Point offset = Point(mount).rotate(-since.theta);
+    const float ox = offset.x, oy = offset.y;
+    const float bx = cos(mount.theta - since.theta), by = sin(mount.theta - since.theta);
+    const float sx0 = since.x, sy0 = since.y, wall = field;
+    const float sigma = std::max(min_sensor_noise, sensor_noise * distance);
+    const float inv_variance = 1 / (sigma * sigma);
+
+    int i = 0;
+#ifdef APPA_NEON
+    const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f), far = vdupq_n_f32(wall);
+    const float32x4_t min_direction = vdupq_n_f32(1e-4f), reading = vdupq_n_f32(distance);
+    const uint32x4_t sign = vdupq_n_u32(0x80000000);
+    // reciprocal estimate with two newton steps
+    const auto reciprocal = [](float32x4_t v) {
+        float32x4_t r = vrecpeq_f32(v);
+        r = vmulq_f32(vrecpsq_f32(v, r), r);
+        return vmulq_f32(vrecpsq_f32(v, r), r);
+    };
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t c = vld1q_f32(&particles.cos[i]), s = vld1q_f32(&particles.sin[i]);
+        const float32x4_t x = vsubq_f32(vld1q_f32(&particles.x[i]), vdupq_n_f32(sx0));
+        const float32x4_t y = vsubq_f32(vld1q_f32(&particles.y[i]), vdupq_n_f32(sy0));
+        const float32x4_t sx = vmlsq_n_f32(vmlaq_n_f32(x, c, ox), s, oy);
+        const float32x4_t sy = vmlaq_n_f32(vmlaq_n_f32(y, s, ox), c, oy);
+        float32x4_t dx = vmlsq_n_f32(vmulq_n_f32(c, bx), s, by);
+        float32x4_t dy = vmlaq_n_f32(vmulq_n_f32(s, bx), c, by);
+        const float32x4_t wall_x = vbslq_f32(vcgtq_f32(dx, zero), far, zero);
+        const float32x4_t wall_y = vbslq_f32(vcgtq_f32(dy, zero), far, zero);
+        dx = vbslq_f32(sign, dx, vmaxq_f32(vabsq_f32(dx), min_direction));
+        dy = vbslq_f32(sign, dy, vmaxq_f32(vabsq_f32(dy), min_direction));
+        const float32x4_t tx = vmulq_f32(vsubq_f32(wall_x, sx), reciprocal(dx));
+        const float32x4_t ty = vmulq_f32(vsubq_f32(wall_y, sy), reciprocal(dy));
+        const float32x4_t error = vsubq_f32(reading, vminq_f32(tx, ty));
+        const float32x4_t q = vmlaq_n_f32(one, vmulq_f32(error, error), inv_variance);
+        vst1q_f32(&particles.weight[i], vmulq_f32(vld1q_f32(&particles.weight[i]), reciprocal(q)));
+    }
+#endif
+    for (; i < count; i++) {
+        const float c = particles.cos[i], s = particles.sin[i];
+        const float sx = particles.x[i] - sx0 + ox * c - oy * s;
+        const float sy = particles.y[i] - sy0 + ox * s + oy * c;
+        const float dx = bx * c - by * s, dy = bx * s + by * c;
+        const float tx = ((dx > 0 ? wall : 0) - sx) / copysignf(std::max(fabsf(dx), 1e-4f), dx);
+        const float ty = ((dy > 0 ? wall : 0) - sy) / copysignf(std::max(fabsf(dy), 1e-4f), dy);
+        const float error = distance - std::min(tx, ty);
+        particles.weight[i] /= 1 + error * error * inv_variance;
+    }
+}
+
+// systematic resampling, one random offset for evenly spaced picks
+void ParticleFilter::resample() {
+    const float step = 1.0f / count;
+    const float start = uniform() * step;
+    float cumulative = particles.weight[0];
+    int j = 0;
+    for (int i = 0; i < count; i++) {
+        const float target = start + i * step;
+        while (target > cumulative && j < count - 1) cumulative += particles.weight[++j];
+        resampled.x[i] = particles.x[j];
+        resampled.y[i] = particles.y[j];
+        resampled.cos[i] = particles.cos[j];
+        resampled.sin[i] = particles.sin[j];
+        resampled.weight[i] = step;
+    }
+    particles = resampled;
+}
+
+void ParticleFilter::task() {
+    Pose prev = odom.get();
+    uint32_t now = pros::millis();
+    while (true) {
+        {
+            APPA_PROFILE_SCOPE("mcl update");
+            if (reset_pending.exchange(false)) {
+                scatter(requested.read(), requested_spread.read());
+                prev = odom.get();
+            }
+
+            // move the particles with the odom
+            const Pose pose = odom.get();
+            const Point moved = Point(pose - prev).rotate(-prev.theta);
+            move({moved.x, moved.y, pose.theta - prev.theta});
+            prev = pose;
+
+            // weigh them with every reading, PROS_ERR when disconnected and 9999 mm with nothing in
+            // range
+            const Pose past = odom.get_at(pros::micros() - (uint64_t)latency * 1000);
+            const Pose since = {pose.x - past.x, pose.y - past.y, pose.theta - past.theta};
+            bool measured = false;
+            for (size_t k = 0; k < sensors.size(); k++) {
+                const int32_t reading = sensors[k].get_distance();
+                if (reading == PROS_ERR || sensors[k].get_confidence() < min_confidence) continue;
+                const double distance = reading / 25.4; // in
+                if (distance <= 0 || distance > max_distance) continue;
+                weigh(k, distance, since);
+                measured = true;
+            }
+
+            // normalize, starting over around the odom if every particle was ruled out, as wide as
+            // the odom's own uncertainty when that is larger
+            float total = 0.0f;
+            for (int i = 0; i < count; i++) total += particles.weight[i];
+            if (!(total > 0.0f) || !std::isfinite(total)) {
+                const Pose odom_spread = odom.get_covariance().deviation();
+                const Pose least = requested_spread.read();
+                scatter(pose, {std::max(odom_spread.x, least.x), std::max(odom_spread.y, least.y),
+                               std::max(odom_spread.theta, least.theta)});
+                total = 1.0f;
+            }
+            float squares = 0.0f, x = 0.0f, y = 0.0f, c = 0.0f, s = 0.0f;
+            for (int i = 0; i < count; i++) {
+                const float w = particles.weight[i] /= total;
+                squares += w * w;
+                x += w * particles.x[i];
+                y += w * particles.y[i];
+                c += w * particles.cos[i];
+                s += w * particles.sin[i];
+            }
+            float vx = 0.0f, vy = 0.0f;
+            for (int i = 0; i < count; i++) {
+                const float w = particles.weight[i];
+                vx += w * (particles.x[i] - x) * (particles.x[i] - x);
+                vy += w * (particles.y[i] - y) * (particles.y[i] - y);
+            }
+            const Pose mean = {x, y, atan2(s, c)};
+            const Pose deviation = {sqrt(vx), sqrt(vy),
+                                    sqrt(-2 * log(std::clamp(hypot(c, s), 1e-6, 1.0)))};
+            estimate.write(mean);
+            spread.write(deviation);
+
+            // resample once most of the weight is on a few particles
+            if (1 / squares < count / 2) resample();
+
+            // pull the odom towards the particles once they agree
+            if (measured && deviation.x < max_deviation && deviation.y < max_deviation) {
+                odom.correct({gain * (mean.x - pose.x), gain * (mean.y - pose.y),
+                              gain * wrap(mean.theta - pose.theta)});
+                prev = odom.get();
+            }
+        }
+
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+} // namespace appa
@@ -0,0 +1,253 @@
+#include "mechanism.h"
+
+namespace appa {
+
+/* Mechanism */
+Mechanism::Mechanism(const std::initializer_list<int8_t>& ports, const Config& config,
+                     int8_t rotation_port)
+    : motors(ports), config(config), position_pid(config.position_pid),
+      velocity_pid(config.velocity_pid), slew(config.slew, config.slew) {
+    if (rotation_port != 0) rotation.emplace(rotation_port);
+}
+
+bool Mechanism::attach(Scheduler& scheduler, int every) {
+    return scheduler.add([this](double dt) { update(dt); }, every);
+}
+
+// the rotation sensor when there is one, otherwise the mean of the motors that answer
+double Mechanism::read_sensor() {
+    if (rotation) {
+        const int32_t centidegrees = rotation->get_position();
+        return centidegrees == PROS_ERR ? prev_sensor : centidegrees / 100.0;
+    }
+    double total = 0.0;
+    int count = 0;
+    for (int i = 0; i < motors.size(); i++) {
+        const double degrees = motors.get_position(i); // not _all, which returns a vector
+        if (degrees == PROS_ERR_F) continue;
+        total += degrees;
+        count++;
+    }
+    return count > 0 ? total / count : prev_sensor;
+}
+
+double Mechanism::read_current() {
+    double total = 0.0;
+    int count = 0;
+    for (int i = 0; i < motors.size(); i++) {
+        const int32_t current = motors.get_current_draw(i);
+        if (current == PROS_ERR) continue;
+        total += current;
+        count++;
+    }
+    return count > 0 ? total / count : 0.0;
+}
+
+// % against gravity at a position, constant for a lift and by the arm's angle from level
+double Mechanism::gravity(double at) const {
+    switch (config.gravity) {
+    case ELEVATOR:
+        return config.kg;
+    case ARM:
+        return config.kg * cos(to_rad(at - config.level));
+    default:
+        return 0.0;
+    }
+}
+
+void Mechanism::update(double dt) {
+    dt = std::max(dt, 1.0);
+    // measure, the rotation sensor's velocity from its travel and the motors' from their own
+    const double sensor = read_sensor();
+    double speed;
+    if (rotation || std::isnan(sensor)) {
+        if (!std::isnan(prev_sensor) && !std::isnan(sensor))
+            rate += ((sensor - prev_sensor) / dt * 1000 - rate) * 0.5;
+        speed = rate;
+    } else {
+        double total = 0.0;
+        int count = 0;
+        for (int i = 0; i < motors.size(); i++) {
+            const double rpm = motors.get_actual_velocity(i);
+            if (rpm == PROS_ERR_F) continue;
+            total += rpm * 6;
+            count++;
+        }
+        speed = count > 0 ? total / count : 0.0;
+    }
+    prev_sensor = sensor;
+
+    std::unique_lock<pros::Mutex> lock(mutex);
+    const double at = (sensor - zero) * config.scale;
+    const double moving = speed * config.scale;
+    position.store(at);
+    velocity.store(moving);
+
+    // nothing to control from until the sensor first answers, the command starts once it does
+    if (std::isnan(at) && (mode == POSITION || mode == VELOCITY)) {
+        lock.unlock();
+        output.store(0.0);
+        if (written != 0) motors.move_voltage(written = 0);
+        return;
+    }
+
+    // a new command starts its profile from where the mechanism is, and its exits over
+    if (restart) {
+        restart = false;
+        settle_time = 0.0;
+        stall_time = {};
+        profile.reset();
+        if (mode == POSITION) {
+            position_pid.reset(target - at);
+            if (config.speed > 0) {
+                profile_start = at;
+                profile_sign = target < at ? -1.0 : 1.0;
+                auto limited = [](double limit) { return limit > 0 ? limit : INFINITY; };
+                const double accel = limited(config.accel);
+                profile.emplace(fabs(target - at), config.speed, accel,
+                                config.decel > 0 ? config.decel : accel, config.jerk);
+            }
+        } else if (mode == VELOCITY) velocity_pid.reset(target - moving);
+    }
+
+    // output of the mode
+    double out = 0.0, error = 0.0;
+    bool done = true; // the profile reached its end
+    switch (mode) {
+    case OPEN_LOOP:
+        out = target;
+        break;
+    case POSITION: {
+        double setpoint = target, setpoint_vel = 0.0, setpoint_accel = 0.0;
+        if (profile) {
+            profile->update(dt);
+            setpoint = profile_start + profile_sign * profile->get_position();
+            setpoint_vel = profile_sign * profile->get_velocity();
+            setpoint_accel = profile_sign * profile->get_acceleration();
+            done = profile->done();
+        }
+        error = target - at;
+        out = config.ff.get(setpoint_vel, setpoint_accel, moving) +
+              position_pid.update(setpoint - at, dt, at) + gravity(at);
+        break;
+    }
+    case VELOCITY:
+        error = target - moving;
+        out = config.ff.get(target, 0.0, moving) + velocity_pid.update(error, dt, moving) +
+              gravity(at);
+        break;
+    default:
+        break;
+    }
+    // past a limit only what holds it there, or drives back
+    const double hold = mode == POSITION || mode == VELOCITY ? gravity(at) : 0.0;
+    if (at >= config.max) out = std::min(out, hold);
+    if (at <= config.min) out = std::max(out, hold);
+    out = std::clamp(out, -100.0, 100.0);
+    if (config.slew > 0) out = slew.update(out, dt);
+    else slew.reset(out);
+    output.store(out);
+
+    // settle and exits, which end the command's wait but not the control
+    if (result.load() == Chassis::RUNNING) {
+        Chassis::Result ended = Chassis::RUNNING;
+        const bool slow = mode != POSITION || config.exit_speed <= 0 ||
+                          fabs(moving) < config.exit_speed;
+        if (done && fabs(error) < config.exit && slow) {
+            settle_time += dt;
+            if (settle_time >= config.settle) ended = Chassis::SETTLED;
+        } else settle_time = 0.0;
+        for (int i = 0; i < exits.size; i++) {
+            const Exit& condition = exits.exits[i];
+            switch (condition.type) {
+            case Exit::TIME:
+                if (pros::millis() - start_time >= condition.value) ended = Chassis::EXITED;
+                break;
+            case Exit::STALL:
+                stall_time[i] = fabs(moving) < condition.value ? stall_time[i] + dt : 0.0;
+                if (stall_time[i] >= condition.time) ended = Chassis::STALLED;
+                break;
+            case Exit::STUCK: {
+                const bool stuck = fabs(moving) < condition.value && fabs(out) >= condition.output;
+                stall_time[i] = stuck ? stall_time[i] + dt : 0.0;
+                if (stall_time[i] >= condition.time) ended = Chassis::STALLED;
+                break;
+            }
+            case Exit::CURRENT:
+                stall_time[i] = read_current() > condition.value ? stall_time[i] + dt : 0.0;
+                if (stall_time[i] >= condition.time) ended = Chassis::STALLED;
+                break;
+            case Exit::BELOW:
+                if (condition.sensor && condition.sensor() < condition.value)
+                    ended = Chassis::EXITED;
+                break;
+            case Exit::ABOVE:
+                if (condition.sensor && condition.sensor() > condition.value)
+                    ended = Chassis::EXITED;
+                break;
+            default: // distance, slip and impact are the chassis'
+                break;
+            }
+        }
+        if (ended != Chassis::RUNNING) result.store(ended);
+    }
+    lock.unlock();
+
+    // only when the command changed
+    const int32_t millivolts = std::lround(out * 120);
+    if (millivolts != written) motors.move_voltage(written = millivolts);
+}
+
+void Mechanism::command(Mode mode, double target, const ExitSet& exits) {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    this->mode = mode;
+    this->target = mode == POSITION ? std::clamp(target, config.min, config.max) : target;
+    this->exits = exits;
+    start_time = pros::millis();
+    restart = true;
+    result.store(mode == POSITION || mode == VELOCITY ? Chassis::RUNNING : Chassis::SETTLED);
+}
+
+void Mechanism::move_to(double position, const ExitSet& exits) {
+    command(POSITION, position, exits);
+}
+void Mechanism::spin(double velocity, const ExitSet& exits) { command(VELOCITY, velocity, exits); }
+void Mechanism::move(double percent) { command(OPEN_LOOP, percent, {}); }
+void Mechanism::stop() { command(IDLE, 0.0, {}); }
+
+// while no command is running, such as after load_gains()
+void Mechanism::set_config(const Config& config) {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    this->config = config;
+    position_pid.set_gains(config.position_pid);
+    velocity_pid.set_gains(config.velocity_pid);
+    slew.set_limits(config.slew, config.slew);
+}
+
+void Mechanism::tare(double position) {
+    const double sensor = read_sensor();
+    std::lock_guard<pros::Mutex> lock(mutex);
+    zero = sensor - position / config.scale;
+    this->position.store(position);
+    restart = true; // a profile in progress starts over from here
+}
+
+Chassis::Result Mechanism::wait(int timeout) {
+    const uint32_t start = pros::millis();
+    while (result.load() == Chassis::RUNNING) {
+        if (timeout > 0 && (int)(pros::millis() - start) >= timeout) {
+            result.store(Chassis::TIMED_OUT);
+            break;
+        }
+        pros::delay(5);
+    }
+    return result.load();
+}
+
+Chassis::Result Mechanism::get_result() { return result.load(); }
+double Mechanism::get_position() { return position.load(); }
+double Mechanism::get_velocity() { return velocity.load(); }
+double Mechanism::get_output() { return output.load(); }
+pros::MotorGroup& Mechanism::get_motors() { return motors; }
+
+} // namespace appa
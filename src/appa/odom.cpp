@@ -2,130 +2,911 @@
 
 namespace appa {
 
-/* Odom */
-Odom::Odom(int8_t x_port, int8_t y_port, Imu imu_port, double tpu, Point tracker_linear_offset,
-           double tracker_angular_offset)
-    : x_tracker(abs(x_port), abs(x_port) + 1, x_port < 0),
-      y_tracker(abs(y_port), abs(y_port) + 1, y_port < 0),
-      imu(std::move(imu_port)),
-      tpu(tpu),
-      tracker_linear_offset(tracker_linear_offset),
-      tracker_angular_offset(to_rad(tracker_angular_offset)) {}
+template class BasicOdom<AnyTracker, AnyTracker, Imu, AnyIntegrator>;
+template class BasicOdom<AdiTracker, AdiTracker, Imu, ArcIntegrator>;
+template class BasicOdom<RotationTracker, RotationTracker, Imu, ArcIntegrator>;
+template class BasicThreeWheelOdom<AnyTracker, AnyTracker, AnyTracker>;
+template class BasicThreeWheelOdom<MotorTracker, MotorTracker, NoTracker>;
 
-Odom::Odom(std::array<int8_t, 2> x_port, std::array<int8_t, 2> y_port, Imu imu_port, double tpu,
-           Point tracker_linear_offset, double tracker_angular_offset)
-    : x_tracker({x_port[0], abs(x_port[1]), abs(x_port[1]) + 1}, x_port[1] < 0),
-      y_tracker({y_port[0], abs(y_port[1]), abs(y_port[1]) + 1}, y_port[1] < 0),
-      imu(std::move(imu_port)),
-      tpu(tpu),
-      tracker_linear_offset(tracker_linear_offset),
-      tracker_angular_offset(to_rad(tracker_angular_offset)) {}
+/* MotorOdom */
+// motor positions are in degrees, so the ticks per inch come from the wheel circumference
+MotorOdom::MotorOdom(std::initializer_list<int8_t> left_motors,
+                     std::initializer_list<int8_t> right_motors, Imu imu, double wheel_diameter,
+                     double gear_ratio, double track_width, Point tracker_linear_offset)
+    : BasicThreeWheelOdom(MotorTracker(left_motors), MotorTracker(right_motors), NoTracker(),
+                          360 / (M_PI * wheel_diameter * gear_ratio), track_width, 0.0,
+                          tracker_linear_offset, std::move(imu)) {
+    imu_weight = 1.0; // wheels slip too much to mix into the heading
+}
+
+MotorOdom::MotorOdom(std::initializer_list<int8_t> left_motors,
+                     std::initializer_list<int8_t> right_motors, double wheel_diameter,
+                     double gear_ratio, double track_width, Point tracker_linear_offset)
+    : BasicThreeWheelOdom(MotorTracker(left_motors), MotorTracker(right_motors), NoTracker(),
+                          360 / (M_PI * wheel_diameter * gear_ratio), track_width, 0.0,
+                          tracker_linear_offset) {}
+
+/* MultiOdom */
+MultiOdom::MultiOdom(double tpu, std::optional<Imu> imu)
+    : OdomBase(tpu, {0.0, 0.0}, 0.0), imu(std::move(imu)) {
+    selectable = true;
+}
+
+int MultiOdom::add(AnyTracker tracker, Point position, double angle, double tpu) {
+    const int index = trackers.size();
+    const bool started = get_status() != IDLE;
+    if (started || index == capacity) {
+        printf("multi odom: can't add a tracker%s\n", started ? " after start" : "");
+        return -1;
+    }
+    angle = to_rad(angle);
+    cosines[index] = cos(angle), sines[index] = sin(angle);
+    levers[index] = position.x * sines[index] - position.y * cosines[index];
+    tpus[index] = tpu;
+    trackers.push_back(std::move(tracker));
+    fit(dropped);
+    return index;
+}
+
+uint32_t MultiOdom::get_dropped() const { return dropped; }
+
+// each tracker reads c dx + s dy + lever dtheta of the robot's travel. the pseudo-inverse of those
+// rows is (A^T A)^-1 A^T, with the heading column left out when the imu gives it
+bool MultiOdom::fit(uint32_t left_out) {
+    const int unknowns = imu ? 2 : 3;
+    double normal[3][3] = {};
+    for (int i = 0; i < (int)trackers.size(); i++) {
+        if (left_out & (1u << i)) continue;
+        const double row[3] = {cosines[i], sines[i], imu ? 0.0 : levers[i]};
+        for (int j = 0; j < 3; j++)
+            for (int k = 0; k < 3; k++) normal[j][k] += row[j] * row[k];
+    }
+    if (imu) normal[2][2] = 1.0;
+
+    // inverse by cofactors, 3x3
+    double adjugate[3][3];
+    for (int j = 0; j < 3; j++)
+        for (int k = 0; k < 3; k++) {
+            const int r1 = (k + 1) % 3, r2 = (k + 2) % 3, c1 = (j + 1) % 3, c2 = (j + 2) % 3;
+            adjugate[j][k] = normal[r1][c1] * normal[r2][c2] - normal[r1][c2] * normal[r2][c1];
+        }
+    const double determinant = normal[0][0] * adjugate[0][0] + normal[0][1] * adjugate[1][0] +
+                               normal[0][2] * adjugate[2][0];
+    if (!(fabs(determinant) > 1e-6)) return false;
+
+    for (int j = 0; j < 3; j++)
+        for (int i = 0; i < capacity; i++) {
+            solve[j][i] = 0.0;
+            if (i >= (int)trackers.size() || (left_out & (1u << i)) || j >= unknowns) continue;
+            const double row[3] = {cosines[i], sines[i], imu ? 0.0 : levers[i]};
+            for (int k = 0; k < 3; k++) solve[j][i] += adjugate[j][k] / determinant * row[k];
+        }
+    return true;
+}
+
+bool MultiOdom::calibrate() {
+    if (!fit(dropped)) {
+        printf("multi odom: the trackers can't measure the robot's %s\n",
+               imu ? "travel" : "travel and heading");
+        return false;
+    }
+    if (!imu) return true; // the trackers need no calibration
+    const bool calibrated = imu->calibrate();
+    if (calibrated) printf("imu calibrated (%d ready)\n", (int)imu->imus.size());
+    return calibrated;
+}
+
+void MultiOdom::bind() {
+    for (AnyTracker& tracker : trackers) bind_device(tracker);
+    if (imu) bind_device(*imu);
+}
 
-void Odom::task() {
+void MultiOdom::task() {
     printf("odom task started\n");
-    Pose prev_track = {0.0, 0.0, 0.0};
+    const int count = trackers.size();
+    const int unknowns = imu ? 2 : 3;
+    std::array<double, capacity> readings{}, prev_readings{}; // in
+    auto read = [&] {
+        for (int i = 0; i < count; i++)
+            readings[i] = trackers[i].get() / (tpus[i] > 0 ? tpus[i] : tpu);
+    };
+    read();
+    prev_readings = readings;
+    if (imu) heading = to_rad(imu->get());
     uint32_t now = pros::millis();
-
-    int count = 0;
+    uint64_t prev_time = pros::micros();
 
     while (true) {
         // get current sensor values
-        Pose track = {x_tracker.get_value() / tpu, y_tracker.get_value() / tpu, to_rad(imu.get())};
+        const uint64_t time = pros::micros();
+        double imu_heading = NAN;
+        {
+            APPA_PROFILE_SCOPE("odom sensors");
+            read();
+            if (imu) {
+                // the trackers' travel alone, so a drifting heading can't hide that they are still
+                Point travel = {0.0, 0.0};
+                for (int i = 0; i < count; i++)
+                    travel = travel + Point(solve[0][i], solve[1][i]) * readings[i];
+                imu->still = trackers_still(time, travel);
+                imu_heading = to_rad(imu->get());
+            }
+        }
 
-        // calculate change in sensor values
-        Point dtrack = track - prev_track;
-        double dtheta = track.theta - prev_track.theta;
+        // the travel that best fits every tracker, less the turn's sweep when the imu gives it
+        std::array<double, capacity> changes;
+        for (int i = 0; i < count; i++) changes[i] = readings[i] - prev_readings[i];
+        prev_readings = readings;
+        const double prev_heading = heading;
+        double dx = 0.0, dy = 0.0;
+        double dtheta = imu && !std::isnan(imu_heading) ? imu_heading - heading : 0.0;
+        for (int i = 0; i < count; i++) {
+            const double change = changes[i] - (imu ? levers[i] * dtheta : 0.0);
+            dx += solve[0][i] * change, dy += solve[1][i] * change;
+            if (!imu) dtheta += solve[2][i] * change;
+        }
+        heading += dtheta;
 
-        // set previous sensor values for next loop
-        prev_track = track;
+        // a tracker that keeps disagreeing with the rest is slipping or unplugged. one spare
+        // tracker shows that something is off but not which, so this takes two, and drops only the
+        // one furthest off
+        const double decay = exp(-(double)(time - prev_time) / (fault_time * 1000.0));
+        prev_time = time;
+        int fitted = 0, worst = -1;
+        for (int i = 0; i < count; i++) fitted += !(dropped & (1u << i));
+        for (int i = 0; i < count && fitted > unknowns + 1; i++) {
+            if (dropped & (1u << i)) continue;
+            residuals[i] = residuals[i] * decay + changes[i] -
+                           (cosines[i] * dx + sines[i] * dy + levers[i] * dtheta);
+            if (fabs(residuals[i]) > fault_travel &&
+                (worst < 0 || fabs(residuals[i]) > fabs(residuals[worst])))
+                worst = i;
+        }
+        if (worst >= 0 && fit(dropped | (1u << worst))) {
+            dropped |= 1u << worst;
+            residuals = {};
+            printf("multi odom: tracker %d disagrees with the others, dropped\n", worst);
+        }
 
-        // arc approximation
-        if (dtheta != 0) dtrack *= 2 * sin(dtheta / 2) / dtheta;
+        update(time,
+               AnyIntegrator::step({dx, dy}, dtheta, prev_heading, heading,
+                                   odom_integrator.load(std::memory_order_relaxed)),
+               dtheta, heading);
+        if (imu && tilt_tracking.load(std::memory_order_relaxed)) update_tilt(time, imu->tilt());
+        APPA_TRACE_SPAN("odom loop", time);
 
-        // rotate tracker differential to global frame
-        dtrack = dtrack.rotate(track.theta + tracker_angular_offset);
+        pros::c::task_delay_until(&now, next_period());
+    }
+}
 
-        // update tracker pose
-        odom_mutex.take();
-        odom_pose += dtrack;
-        odom_pose.theta = track.theta;
-        odom_mutex.give();
+/* Odom */
+// rotates a pose's position by a unit rotation (cosine, sine)
+static Pose turn(const Pose& pose, const Point& rotation) {
+    return {pose.x * rotation.x - pose.y * rotation.y, pose.x * rotation.y + pose.y * rotation.x,
+            pose.theta};
+}
+
+// a tracker frame pose in the corrected frame
+static Pose shift(const Pose& pose, const Pose& correction, const Point& rotation) {
+    return turn(pose, rotation) + correction;
+}
+
+OdomBase::OdomBase(double tpu, Point tracker_linear_offset, double tracker_angular_offset,
+                   const char* tracking_file)
+    : tracking_file(tracking_file),
+      debug_channel([](const Record& r) {
+          printf("\r(%6.2f,%6.2f,%7.2f) +-(%5.2f,%5.2f,%5.2f)", r.values[0], r.values[1],
+                 to_deg(r.values[2]), r.values[3], r.values[4], to_deg(r.values[5]));
+      }),
+      tpu(tpu),
+      tracker_linear_offset(tracker_linear_offset),
+      tracker_angular_offset(to_rad(tracker_angular_offset)) {
+    tracking.write({tpu, tracker_linear_offset, tracker_angular_offset});
+    publish();
+}
+
+OdomBase::~OdomBase() = default;
+
+void OdomBase::update(uint64_t time, const Point& sensor_dtrack, double dtheta,
+                      double sensor_theta) {
+    const pros::task_t simulating = simulator.load(std::memory_order_relaxed);
+    if (simulating && simulating != pros::c::task_get_current()) return;
+    const bool first = prev_time == 0;
+    const uint32_t nominal = loop_period.load(std::memory_order_relaxed) * 1000; // us
+    const uint32_t period_us = first ? nominal : time - prev_time;
+    prev_time = time;
+
+    // update tracker pose, in the frame of the last set
+    odom_mutex.take();
+    const Point dtrack = turn({sensor_dtrack.x, sensor_dtrack.y, 0.0}, offset_rotation);
+    const double theta = sensor_theta + heading_offset;
+    odom_pose += dtrack;
+    odom_pose.theta = theta;
+
+    // ease in blended corrections, the rest at once when it is too small to notice
+    if (pending_correction.x != 0 || pending_correction.y != 0 || pending_correction.theta != 0) {
+        const double fraction = 1 - exp(-(period_us / 1000.0) / std::max(blend_time, 1e-3));
+        Pose step = pending_correction * fraction;
+        if (fabs(pending_correction.x) < 1e-3 && fabs(pending_correction.y) < 1e-3 &&
+            fabs(pending_correction.theta) < 1e-5)
+            step = pending_correction;
+        shift_by(step);
+        pending_correction -= step;
+    }
+
+    // loop timing, the busy time is the previous iteration's so there is none the first time
+    if (!first) odom_timing.record(period_us, busy, nominal);
+
+    // the error moves with the offset point's travel in the corrected frame, and grows with it
+    const double dt = period_us / 1e6; // s
+    const Point offset = tracker_linear_offset.rotate(theta);
+    const Point travel = dtrack + offset - tracker_linear_offset.rotate(theta - dtheta);
+    const Pose moved = turn({travel.x, travel.y, 0.0}, correction_rotation);
+    const double distance = hypot(moved.x, moved.y);
+    odom_covariance.move(moved);
+    odom_covariance.m[0][0] += travel_noise * distance;
+    odom_covariance.m[1][1] += travel_noise * distance;
+    odom_covariance.m[2][2] += turn_noise * fabs(dtheta) + drift_noise * dt;
 
-        // debugging
-        if (!(++count % 20) && debug.load()) {
-            Pose p = get();
-            printf("\r(%6.2f,%6.2f,%7.2f)", p.x, p.y, to_deg(p.theta));
-            fflush(stdout);
-            count = 0;
+    // estimate velocity of the offset point and filter it
+    const double omega = dtheta / dt;
+    const Pose vel = {dtrack.x / dt - omega * offset.y, dtrack.y / dt + omega * offset.x, omega};
+    const Pose prev_vel = odom_twist.vel;
+    odom_twist.vel = velocity_filter.update(vel);
+    odom_twist.accel = accel_filter.update((odom_twist.vel - prev_vel) * (1 / dt));
+    const Pose sample = odom_pose + offset;
+    publish();
+    odom_mutex.give();
+
+    // record pose history in the tracker frame, get_at() applies the latest correction
+    odom_history.push(time, sample);
+
+    // wake tasks waiting for a new pose
+    for (auto& subscriber : subscribers) {
+        pros::task_t handle = subscriber.load();
+        if (handle) pros::c::task_notify(handle);
+    }
+
+    // debugging, printed from the telemetry task
+    if (!(++count % 20) && debug.load()) {
+        const Pose p = get(), d = get_covariance().deviation();
+        debug_channel.push({(uint32_t)(time / 1000),
+                            {(float)p.x, (float)p.y, (float)p.theta, (float)d.x, (float)d.y,
+                             (float)d.theta}});
+        count = 0;
+    }
+
+    busy = pros::micros() - time;
+}
+
+void OdomBase::set_period(uint32_t min, uint32_t max) {
+    min = std::max<uint32_t>(min, 1);
+    min_period.store(min);
+    max_period.store(std::max(min, max));
+    wake();
+}
+
+uint32_t OdomBase::get_period() { return loop_period.load(); }
+
+void OdomBase::wake() { woken.store(true); }
+
+// straight to the fastest period on any motion, doubling towards the slowest once still
+uint32_t OdomBase::next_period() {
+    const uint32_t fastest = min_period.load(std::memory_order_relaxed);
+    const uint32_t slowest = max_period.load(std::memory_order_relaxed);
+    uint32_t next = loop_period.load(std::memory_order_relaxed);
+    if (fastest >= slowest) next = fastest;
+    else {
+        // from where it stopped rather than its speed, which the tick noise of fast loops hides
+        const Pose& pose = odom_pose; // only this task writes it
+        const bool moving = hypot(pose.x - still_pose.x, pose.y - still_pose.y) > still_distance ||
+                            fabs(pose.theta - still_pose.theta) > still_angle;
+        if (woken.exchange(false) || moving) {
+            still_pose = pose;
+            still_time = 0;
+            next = fastest;
+        } else {
+            still_time += next;
+            if (still_time >= backoff_time || pros::competition::is_disabled())
+                next = std::min(next * 2, slowest);
         }
+        next = std::clamp(next, fastest, slowest);
+    }
+    loop_period.store(next, std::memory_order_relaxed);
+    return next;
+}
+
+// from where they stopped, like the backoff, but without the heading the imus are drifting on
+bool OdomBase::trackers_still(uint64_t time, const Point& travel) {
+    if (!(hypot(travel.x - still_travel.x, travel.y - still_travel.y) <= still_distance)) {
+        still_travel = travel;
+        still_since = time;
+    }
+    return time - still_since >= zupt_time * 1000ull;
+}
+
+void OdomBase::start(bool async, std::function<void(bool)> callback) {
+    if (odom_task != nullptr && odom_status != FAILED) return;
+    delete odom_task;
+    odom_status = CALIBRATING;
+
+    // calibrate in the odom task so initialization isn't blocked when async
+    odom_task = start_task(
+        [this, callback] {
+            bind();
+            if (tracking_file) load_tracking(tracking_file);
+            bool calibrated = warm_file && warm_start();
+            if (!calibrated) {
+                printf("calibrating imu...\n");
+                // only this task reads the sensors, and the sets and gets meanwhile never touch
+                // them, so the few seconds it takes don't hold the mutex
+                calibrated = calibrate();
+                if (calibrated) set({0.0, 0.0, 0.0});
+            }
 
-        // loop every 5 ms
-        pros::c::task_delay_until(&now, 5);
+            if (calibrated) {
+                odom_status = RUNNING;
+                if (warm_file && !warm_task)
+                    warm_task = start_task([this] { save_warm(); }, warm_task_config, "warm_task");
+            } else {
+                printf("ERROR: IMU calibration failed with error code %d\n"
+                       "odometry was not started\n",
+                       errno);
+                odom_status = FAILED;
+            }
+
+            if (callback) callback(calibrated);
+            if (calibrated) {
+                telemetry::add(debug_channel);
+                task();
+            }
+        },
+        task_config, "odom_task");
+
+    // block until calibrated if not async
+    while (!async && odom_status == CALIBRATING) {
+        pros::delay(10);
     }
 }
 
-void Odom::start() {
-    printf("calibrating imu...");
-    if (!imu.calibrate()) {
-        printf("\nERROR: IMU reset failed with error code %d\nodometry was not started\n", errno);
+OdomBase::Status OdomBase::get_status() { return odom_status.load(); }
+
+void OdomBase::set_integrator(Integrator integrator) {
+    if (!selectable) printf("set_integrator: this odom's integrator is fixed at compile time\n");
+    odom_integrator.store(integrator);
+}
+
+OdomBase::Tracking OdomBase::get_tracking() { return tracking.read(); }
+
+void OdomBase::set_tracking(const Tracking& geometry) {
+    if (!calibratable) {
+        printf("set_tracking: this odom's tracking is fixed at construction\n");
         return;
     }
-    printf("done\n");
+    if (!(geometry.tpu > 0) || !std::isfinite(geometry.tpu)) {
+        printf("set_tracking: %.3f is not a valid tpu\n", geometry.tpu);
+        return;
+    }
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    tracking.write(geometry);
+    tracking_pending.store(true);
+}
 
-    set({0.0, 0.0, 0.0});
-    if (odom_task == nullptr)
-        odom_task = new pros::Task([this] { task(); }, 16, TASK_STACK_DEPTH_DEFAULT, "odom_task");
+// the tpu and angular offset are only read by the loop, so they change between its iterations
+void OdomBase::apply_tracking() {
+    if (!tracking_pending.exchange(false)) return;
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    const Tracking geometry = tracking.read();
+    tpu = geometry.tpu;
+    tracker_linear_offset = geometry.linear_offset;
+    tracker_angular_offset = to_rad(geometry.angular_offset);
+    publish();
 }
 
-Pose Odom::get() {
-    std::lock_guard<pros::Mutex> lock(odom_mutex);
-    // translate the tracker offsets to the global frame
-    return odom_pose + tracker_linear_offset.rotate(odom_pose.theta);
+bool OdomBase::load_tracking(const char* file) {
+    std::vector<Tracking> buffer;
+    if (!file::read(file, file::tracking_magic, buffer) || buffer.empty()) return false;
+    set_tracking(buffer[0]);
+    return true;
 }
 
-Pose Odom::get_local() {
-    std::lock_guard<pros::Mutex> lock(odom_mutex);
-    return odom_pose;
+bool OdomBase::save_tracking(const char* file) {
+    const Tracking geometry = tracking.read();
+    return file::write(file, file::tracking_magic, &geometry, 1);
+}
+
+Point OdomBase::get_ticks() { return odom_ticks.read(); }
+
+void OdomBase::subscribe(pros::task_t task) {
+    for (auto& subscriber : subscribers) {
+        pros::task_t empty = nullptr;
+        if (subscriber.load() == task || subscriber.compare_exchange_strong(empty, task)) return;
+    }
+}
+
+void OdomBase::unsubscribe(pros::task_t task) {
+    for (auto& subscriber : subscribers) {
+        pros::task_t expected = task;
+        subscriber.compare_exchange_strong(expected, nullptr);
+    }
+}
+
+// must be called with odom_mutex held
+void OdomBase::publish() {
+    const Pose pose = shift(odom_pose, odom_correction, correction_rotation);
+    const Point heading = Point{1.0, 0.0}.rotate(pose.theta);
+    const Pose offset = turn({tracker_linear_offset.x, tracker_linear_offset.y, 0.0}, heading);
+    const Twist twist = {turn(odom_twist.vel, correction_rotation),
+                         turn(odom_twist.accel, correction_rotation)};
+    odom_state.write({pose, {pose.x + offset.x, pose.y + offset.y, pose.theta},
+                      tracker_linear_offset, heading, twist, odom_timing, odom_correction,
+                      correction_rotation, odom_covariance});
+}
+
+// moves the correction into the tracker pose and heading, so sets work in the corrected frame.
+// must be called with odom_mutex held
+void OdomBase::fold() {
+    pose_set.store(true, std::memory_order_relaxed); // every set folds first
+    pending_correction = {0.0, 0.0, 0.0};
+    if (odom_correction.x == 0 && odom_correction.y == 0 && odom_correction.theta == 0) return;
+    place(shift(odom_pose, odom_correction, correction_rotation));
+    odom_correction = {0.0, 0.0, 0.0};
+    correction_rotation = {1.0, 0.0};
+}
+
+void OdomBase::correct(const Pose& error) {
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    shift_by(error);
+    publish();
+}
+
+// the factor applies to the covariance under the same lock, so the loop's growth and other
+// corrections since the filter read it aren't overwritten
+void OdomBase::correct(const Pose& error, const Covariance& factor) {
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    shift_by(error);
+    odom_covariance = factor * odom_covariance;
+    odom_covariance.symmetrize();
+    publish();
 }
 
-void Odom::set(Pose pose) {
-    odom_mutex.lock();
-    pose -= tracker_linear_offset.rotate(odom_pose.theta);
-    odom_mutex.unlock();
-    set_local(pose);
+void OdomBase::blend(const Pose& error) {
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    pending_correction += error;
+}
+
+// replaces what is left to blend, so repeated targets don't add up
+void OdomBase::blend_to(Pose pose) {
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    Pose current = shift(odom_pose, odom_correction, correction_rotation);
+    current += tracker_linear_offset.rotate(current.theta);
+    pending_correction = {std::isnan(pose.x) ? 0.0 : pose.x - current.x,
+                          std::isnan(pose.y) ? 0.0 : pose.y - current.y,
+                          std::isnan(pose.theta) ? 0.0 : wrap(to_rad(pose.theta) - current.theta)};
+}
+
+void OdomBase::set_blend_time(double time) {
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    blend_time = time;
+}
+
+// must be called with odom_mutex held
+void OdomBase::shift_by(const Pose& error) {
+    const Pose pose = shift(odom_pose, odom_correction, correction_rotation);
+    const Point pivot = pose + tracker_linear_offset.rotate(pose.theta);
+
+    // turn the frame about the robot, then move it by the error
+    const Point rotation = Point{1.0, 0.0}.rotate(error.theta);
+    const Pose translation = turn({odom_correction.x - pivot.x, odom_correction.y - pivot.y, 0.0},
+                                  rotation);
+    odom_correction = {translation.x + pivot.x + error.x, translation.y + pivot.y + error.y,
+                       odom_correction.theta + error.theta};
+    correction_rotation = Point{1.0, 0.0}.rotate(odom_correction.theta);
+}
+
+// the tracking center moves with the offset point, whose travel the drive model gives
+void OdomBase::simulate(uint64_t time, double distance, double dtheta) {
+    odom_mutex.take();
+    const double theta = odom_pose.theta;
+    odom_mutex.give();
+    const Point center = Point{distance, 0.0}.rotate(theta + dtheta / 2);
+    const Point dtrack = center - tracker_linear_offset.rotate(theta + dtheta) +
+                         tracker_linear_offset.rotate(theta);
+    update(time, dtrack.rotate(-heading_offset), dtheta, theta + dtheta - heading_offset);
+}
+
+void OdomBase::begin_simulation() {
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    simulated_from = {odom_pose,       odom_correction,     pending_correction, heading_offset,
+                      offset_rotation, correction_rotation, odom_covariance};
+    simulator.store(pros::c::task_get_current());
+}
+
+// the loop takes over again from its next sensor read, its timing starting afresh
+void OdomBase::end_simulation() {
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    const Frames& from = simulated_from;
+    odom_pose = from.pose, odom_correction = from.correction, pending_correction = from.pending;
+    heading_offset = from.heading_offset, offset_rotation = from.offset_rotation;
+    correction_rotation = from.correction_rotation, odom_covariance = from.covariance;
+    odom_twist = {};
+    velocity_filter.reset(), accel_filter.reset();
+    prev_time = 0; // the loop leaves it alone until it updates again
+    publish();
+    simulator.store(nullptr);
+}
+
+Pose OdomBase::get() {
+    APPA_PROFILE_SCOPE("odom get");
+    return odom_state.read().center;
+}
+
+Pose OdomBase::get_raw() {
+    const State state = odom_state.read();
+    const Pose& c = state.correction;
+    const Pose local = turn({state.pose.x - c.x, state.pose.y - c.y, state.pose.theta - c.theta},
+                            Point{1.0, 0.0}.rotate(-c.theta));
+    return local + state.offset.rotate(local.theta);
+}
+
+Pose OdomBase::get_local() { return odom_state.read().pose; }
+
+Twist OdomBase::get_velocity(bool robot_frame) {
+    const State state = odom_state.read();
+    if (!robot_frame) return state.twist;
+    const Point inverse = {state.heading.x, -state.heading.y};
+    return {turn(state.twist.vel, inverse), turn(state.twist.accel, inverse)};
 }
 
-void Odom::set_local(Pose pose) {
+// the pose dt ms from the last sample along the current velocity, to make up for latency
+Pose OdomBase::predict(double dt) {
+    const State state = odom_state.read();
+    const Pose& pose = state.center;
+    const Pose& vel = state.twist.vel;
+    const double t = dt / 1000.0;
+    return {pose.x + vel.x * t, pose.y + vel.y * t, pose.theta + vel.theta * t};
+}
+
+LoopTiming OdomBase::get_timing() { return odom_state.read().timing; }
+
+Covariance OdomBase::get_covariance() { return odom_state.read().covariance; }
+
+void OdomBase::track_tilt(bool enabled) { tilt_tracking.store(enabled); }
+
+OdomBase::Tilt OdomBase::get_tilt() { return odom_tilt.read(); }
+
+// rates from the slope through the last three reads, against the imu's noise
+void OdomBase::update_tilt(uint64_t time, const Point& tilt) {
+    if (std::isnan(tilt.x) || std::isnan(tilt.y)) return;
+    Tilt state = odom_tilt.read();
+    state.pitch = tilt.x;
+    state.roll = tilt.y;
+    state.pitch_rate = pitch_rate.update(tilt.x, time);
+    state.roll_rate = roll_rate.update(tilt.y, time);
+    odom_tilt.write(state);
+}
+
+void OdomBase::set_covariance(const Covariance& covariance) {
     const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    odom_covariance = covariance;
+    odom_covariance.symmetrize();
+    publish();
+}
+
+Pose OdomBase::get_at(uint64_t time) {
+    History<Pose, 200>::Sample before, after;
+    if (!odom_history.find(time, before, after)) return get();
+    const State state = odom_state.read();
+    const Pose& correction = state.correction;
+    const Point& rotation = state.correction_rotation;
+    if (before.time == after.time) return shift(before.value, correction, rotation);
+
+    // interpolate between the surrounding samples
+    const double t = (double)(time - before.time) / (after.time - before.time);
+    const Pose& a = before.value;
+    const Pose& b = after.value;
+    return shift({a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.theta + (b.theta - a.theta) * t},
+                 correction, rotation);
+}
+
+// must be called with odom_mutex held. the heading moves the offset the loop adds to the
+// sensors' instead of the sensors, so the next loop carries on from here
+void OdomBase::place(Pose pose) {
     if (std::isnan(pose.x)) pose.x = odom_pose.x;
     if (std::isnan(pose.y)) pose.y = odom_pose.y;
     if (std::isnan(pose.theta)) pose.theta = odom_pose.theta;
-    imu.set(pose.theta);
+    heading_offset += pose.theta - odom_pose.theta;
+    offset_rotation = Point{1.0, 0.0}.rotate(heading_offset);
     odom_pose = pose;
 }
 
-void Odom::set_x(double x) {
-    std::lock_guard<pros::Mutex> lock(odom_mutex);
-    odom_pose.x = x;
+// every set is one pass under the mutex with no device calls, so the loop sees all of it or none
+void OdomBase::set(Pose pose) {
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    fold();
+    // the offset point goes where it was set, from the heading it is set to
+    const double theta = std::isnan(pose.theta) ? odom_pose.theta : to_rad(pose.theta);
+    const Point offset = tracker_linear_offset.rotate(theta);
+    place({pose.x - offset.x, pose.y - offset.y, theta});
+    if (!std::isnan(pose.x)) odom_covariance.clear(0);
+    if (!std::isnan(pose.y)) odom_covariance.clear(1);
+    if (!std::isnan(pose.theta)) odom_covariance.clear(2);
+    publish();
 }
 
-void Odom::set_y(double y) {
-    std::lock_guard<pros::Mutex> lock(odom_mutex);
-    odom_pose.y = y;
+void OdomBase::set_local(Pose pose) {
+    const std::lock_guard<pros::Mutex> lock(odom_mutex);
+    fold();
+    place({pose.x, pose.y, to_rad(pose.theta)});
+    if (!std::isnan(pose.x)) odom_covariance.clear(0);
+    if (!std::isnan(pose.y)) odom_covariance.clear(1);
+    if (!std::isnan(pose.theta)) odom_covariance.clear(2);
+    publish();
 }
 
-void Odom::set_theta(double theta) {
-    std::lock_guard<pros::Mutex> lock(odom_mutex);
-    imu.set(theta);
-    odom_pose.theta = theta;
+void OdomBase::set_x(double x) { set_local({x, NAN, NAN}); }
+void OdomBase::set_y(double y) { set_local({NAN, y, NAN}); }
+void OdomBase::set_theta(double theta) { set_local({NAN, NAN, theta}); }
+
+void OdomBase::set(Point point, double theta) { set({point.x, point.y, theta}); }
+void OdomBase::set(double x, double y, double theta) { set({x, y, theta}); }
+
+void OdomBase::set_recorder(OdomRecorder* recorder) {
+    if (recorder) recorder->start();
+    odom_recorder.store(recorder);
 }
 
-void Odom::set(Point point, double theta) { set({point.x, point.y, theta}); }
-void Odom::set(double x, double y, double theta) { set({x, y, theta}); }
+// a new recording starts with the tracking, then primes the replay with this loop's readings and
+// sets the pose they led to. sets between loops are sent the same way, after the sample they
+// followed, so a replay takes the exact pose where the robot was set
+void OdomBase::record(uint64_t time, const Pose& track, std::span<const Imu::State> imus) {
+    OdomRecorder* const recorder = odom_recorder.load(std::memory_order_relaxed);
+    const bool started = recorder != recording;
+    recording = recorder;
+    if (!recorder) return;
+    if (started) {
+        recording_start = time;
+        recorder->push({.time = 0,
+                        .kind = OdomRecord::TRACKING,
+                        .values = {tpu, tracker_linear_offset.x, tracker_linear_offset.y,
+                                   to_deg(tracker_angular_offset)}});
+    }
+
+    OdomRecord sample = {.time = (uint32_t)(time - recording_start),
+                         .kind = OdomRecord::SAMPLE,
+                         .imus = (uint8_t)std::min<size_t>(imus.size(), 4),
+                         .values = {track.x, track.y, track.theta, 0.0}};
+    for (int i = 0; i < 4; i++) {
+        const bool read = i < sample.imus && imus[i].valid;
+        sample.rotation[i] = read ? imus[i].rotation : NAN;
+        sample.rate[i] = read ? imus[i].rate : NAN;
+    }
+    recorder->push(sample);
 
-void Odom::set_offset(Point linear) {
+    if (pose_set.exchange(false, std::memory_order_relaxed) || started) {
+        odom_mutex.take();
+        const Pose pose = odom_pose;
+        odom_mutex.give();
+        recorder->push({.time = sample.time,
+                        .kind = OdomRecord::SET,
+                        .values = {pose.x, pose.y, pose.theta, 0.0}});
+    }
+}
+
+void OdomBase::replay(const OdomRecord& record) {
+    switch (record.kind) {
+    case OdomRecord::TRACKING:
+        tracking.write({record.values[0], {record.values[1], record.values[2]}, record.values[3]});
+        tracking_pending.store(true);
+        break;
+    case OdomRecord::SET: {
+        const std::lock_guard<pros::Mutex> lock(odom_mutex);
+        place({record.values[0], record.values[1], record.values[2]});
+        publish();
+        break;
+    }
+    case OdomRecord::SAMPLE:
+        if (!replay_sample(record, !replay_primed) && !replay_primed)
+            printf("replay: this odom can't replay recordings\n");
+        replay_primed = true;
+        break;
+    default: // the truth is for whatever runs the replay
+        break;
+    }
+}
+
+void OdomBase::set_offset(Point linear) {
     std::lock_guard<pros::Mutex> lock(odom_mutex);
     tracker_linear_offset = linear;
+    publish();
+}
+
+/* Warm start */
+void OdomBase::set_warm_start(const char* file, uint32_t period) {
+    if (odom_task) {
+        printf("odom: set_warm_start() has to come before start()\n");
+        return;
+    }
+    warm_file = file;
+    warm_period = std::max<uint32_t>(period, 20);
+}
+
+bool OdomBase::warm_started() { return warm.load(); }
+
+bool OdomBase::warm_start() {
+    std::vector<WarmRecord> buffer;
+    if (!file::read(warm_file, file::warm_magic, buffer) || buffer.empty()) return false;
+    const WarmRecord saved = buffer[0];
+    if (!resume()) return false;
+
+    // still means the heading holds over 100 ms, and the imus can't have been reset or the robot
+    // carried off since the save when they turned less than max_turn
+    const double sensor = sensor_heading();
+    pros::delay(100);
+    const double heading = sensor_heading();
+    const double turned = wrap(heading - saved.sensor);
+    if (!std::isfinite(heading) || fabs(heading - sensor) > to_rad(0.2) ||
+        fabs(turned) > to_rad(max_turn)) {
+        printf("odom: not resuming, the robot moved or the imus were reset\n");
+        return false;
+    }
+
+    // the pose from the sensors' frame now, turned as far as they turned since the save
+    {
+        const std::lock_guard<pros::Mutex> lock(odom_mutex);
+        odom_pose.theta = heading + heading_offset;
+    }
+    set(saved.x, saved.y, to_deg(saved.theta + turned));
+    warm.store(true);
+    printf("odom: resumed at (%.2f, %.2f, %.2f)\n", saved.x, saved.y,
+           to_deg(saved.theta + turned));
+    return true;
+}
+
+// only writes once the pose moved, so a robot sitting still doesn't wear the card
+void OdomBase::save_warm() {
+    WarmRecord prev = {NAN, NAN, NAN, NAN};
+    uint32_t now = pros::millis();
+    while (true) {
+        pros::c::task_delay_until(&now, warm_period);
+        const Pose pose = get();
+        odom_mutex.take();
+        const double sensor = odom_pose.theta - heading_offset;
+        odom_mutex.give();
+        const WarmRecord record = {pose.x, pose.y, pose.theta, sensor};
+        if (hypot(record.x - prev.x, record.y - prev.y) < 0.1 &&
+            fabs(record.theta - prev.theta) < to_rad(0.5))
+            continue;
+        if (!file::write(warm_file, file::warm_magic, &record, 1)) {
+            printf("odom: stopped saving the pose to %s\n", warm_file);
+            return;
+        }
+        prev = record;
+    }
+}
+
+/* Tracker health */
+void OdomBase::set_fallback(std::initializer_list<int8_t> left_motors,
+                            std::initializer_list<int8_t> right_motors, double wheel_diameter,
+                            double gear_ratio) {
+    if (odom_task) {
+        printf("odom: set_fallback() has to come before start()\n");
+        return;
+    }
+    monitor.emplace(Monitor{MotorTracker(left_motors), MotorTracker(right_motors),
+                            360 / (M_PI * wheel_diameter * gear_ratio)});
+}
+
+OdomBase::Health OdomBase::get_health() { return odom_health.read(); }
+
+void OdomBase::reset_health() { health_reset.store(true); }
+
+Pose OdomBase::check_trackers(const Pose& track, double accel) {
+    if (!monitor) return track;
+    Monitor& m = *monitor;
+    const double left = m.left.get(), right = m.right.get();
+    Health health = odom_health.read();
+    if (!m.primed || health_reset.exchange(false)) {
+        // a tracker trusted again carries on from where the drive left it
+        if (m.primed) {
+            if (!health.x) m.bias.x = m.output.x - track.x;
+            if (!health.y) m.bias.y = m.output.y - track.y;
+        }
+        health.x = health.y = true;
+        odom_health.write(health);
+        m.output = Point(track) + m.bias;
+        m.prev_track = track;
+        m.prev_left = left;
+        m.prev_right = right;
+        m.error = m.expected = {};
+        m.prev_moved = {0.0, 0.0};
+        m.window = 0;
+        m.primed = true;
+        return {m.output.x, m.output.y, track.theta};
+    }
+
+    // what each tracker should have read from the drive's travel and the heading's turn, the
+    // tracker point also moves sideways around the center as the robot turns
+    const double travel = ((left - m.prev_left) + (right - m.prev_right)) / 2 / m.tpu;
+    const double dtheta = track.theta - m.prev_track.theta;
+    const Point q = tracker_linear_offset * -1.0;
+    const Point motion = {travel - dtheta * q.y, dtheta * q.x};
+    const Point expected = motion.rotate(-tracker_angular_offset) * tpu;
+    const Point actual = Point(track) - m.prev_track;
+    m.prev_track = track;
+    m.prev_left = left;
+    m.prev_right = right;
+
+    // a bad reading or an unplugged tracker jumps, so it is dropped at once
+    bool healthy[2] = {health.x, health.y};
+    const double expects[2] = {expected.x, expected.y};
+    double moved[2] = {actual.x, actual.y};
+    static const char* names[2] = {"x", "y"};
+    bool changed = false;
+    for (int i = 0; i < 2; i++) {
+        if (!healthy[i] || (std::isfinite(moved[i]) && fabs(moved[i]) <= max_jump * tpu))
+            continue;
+        printf("odom: %s tracker jumped %.1f in, falling back to the drive motors\n", names[i],
+               moved[i] / tpu);
+        healthy[i] = false;
+        changed = true;
+    }
+
+    // a bounce is off the drive and a jolt in the tracker's speed that the imu didn't feel, while
+    // the drive slipping is off it but changes speed smoothly. the loop takes the drive's travel
+    // and the tracker carries on from there
+    const double dt = loop_period.load(std::memory_order_relaxed) / 1000.0;
+    const double jolt = ((std::isfinite(accel) ? accel : 0.0) + bump_accel) * dt * dt * tpu;
+    const double prev_moved[2] = {m.prev_moved.x, m.prev_moved.y};
+    double bumped[2] = {0.0, 0.0}; // ticks taken out
+    for (int i = 0; i < 2 && max_bump > 0; i++) {
+        if (!healthy[i] || fabs(moved[i] - expects[i]) <= max_bump * tpu ||
+            fabs(moved[i] - prev_moved[i]) <= jolt)
+            continue;
+        bumped[i] = moved[i] - expects[i];
+        moved[i] = expects[i];
+        health.bumps++;
+        changed = true;
+    }
+    m.bias = m.bias - Point{bumped[0], bumped[1]};
+    m.prev_moved = {moved[0], moved[1]};
+
+    // a tracker that disagrees with the drive over a window while the other agrees is stuck or
+    // slipping, when both disagree the drive is the one slipping
+    for (int i = 0; i < 2; i++) {
+        m.error[i] += fabs(moved[i] - expects[i]);
+        m.expected[i] += fabs(expects[i]);
+    }
+    if ((m.window += loop_period.load(std::memory_order_relaxed)) >= 100) {
+        const double travelled = min_travel * tpu;
+        for (int i = 0; i < 2; i++) {
+            const int j = 1 - i;
+            const bool compared = m.expected[i] > travelled && m.expected[j] > travelled;
+            const bool agrees = m.error[j] < fault_ratio / 2 * m.expected[j];
+            if (!healthy[i] || !healthy[j] || !compared || !agrees ||
+                m.error[i] <= fault_ratio * m.expected[i])
+                continue;
+            printf("odom: %s tracker was off by %.1f of %.1f in, falling back to the drive "
+                   "motors\n",
+                   names[i], m.error[i] / tpu, m.expected[i] / tpu);
+            healthy[i] = false;
+            changed = true;
+        }
+        m.error = m.expected = {};
+        m.window = 0;
+    }
+
+    if (changed) {
+        health.faults += (health.x && !healthy[0]) + (health.y && !healthy[1]);
+        health.x = healthy[0];
+        health.y = healthy[1];
+        odom_health.write(health);
+    }
+
+    // a failed tracker moves as the drive says, the other as read with what it is off by
+    m.output.x = healthy[0] ? track.x + m.bias.x : m.output.x + expected.x;
+    m.output.y = healthy[1] ? track.y + m.bias.y : m.output.y + expected.y;
+    return {m.output.x, m.output.y, track.theta};
 }
 
 } // namespace appa
@@ -0,0 +1,113 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Partner */
+Partner::Partner(uint8_t port, OdomBase& odom, pros::link_type_e_t type, const std::string& id,
+                 int period)
+    : odom(odom), link(port, id, type), period(std::max(1, period)) {}
+
+Partner::~Partner() {
+    if (partner_task) {
+        partner_task->remove();
+        delete partner_task;
+    }
+}
+
+void Partner::start() {
+    if (partner_task == nullptr)
+        partner_task = start_task([this] { task(); }, task_config, "partner_task");
+}
+
+uint32_t Partner::received() const { return frames.load(std::memory_order_relaxed); }
+uint32_t Partner::dropped() const { return drops.load(std::memory_order_relaxed); }
+
+bool Partner::connected() {
+    const State s = state.read();
+    return link.connected() && s.time > 0 && pros::micros() - s.time < (uint64_t)timeout * 1000;
+}
+
+void Partner::receive(const Frame& frame, uint32_t now) {
+    State s = state.read();
+    // the partner's clock from the round trip of a frame echoed back. half of it is the way here,
+    // and the fastest round trips say the most, so slower ones only replace them by a little.
+    // until a frame comes back the offset includes the radio's latency
+    if (frame.echo != 0) {
+        const int32_t round_trip = (int32_t)(now - frame.echo) - frame.hold;
+        const bool faster = s.round_trip == UINT32_MAX || round_trip <= (int32_t)s.round_trip + 2;
+        if (round_trip >= 0 && faster) {
+            s.offset = (int32_t)(now - round_trip / 2 - frame.time);
+            s.round_trip = round_trip;
+        }
+    } else if (s.round_trip == UINT32_MAX) s.offset = (int32_t)(now - frame.time);
+    echo = frame.time;
+    echo_received = now;
+
+    const uint64_t time = (uint64_t)(uint32_t)(frame.time + s.offset) * 1000;
+    const Pose pose = {frame.x / 100.0, frame.y / 100.0, frame.theta / 1e4};
+    const double linear = frame.linear / 100.0;
+    s.velocity = {linear * cos(pose.theta), linear * sin(pose.theta), frame.angular / 1000.0};
+    if (time > s.time) { // a new offset can't move the history back
+        partner_history.push(time, pose);
+        s.time = time;
+    }
+    state.write(s);
+    frames.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Partner::task() {
+    uint32_t now = pros::millis();
+    Frame frame;
+    while (true) {
+        // what came in first, so the echo goes back with the least hold
+        for (int i = 0; i < 8 && link.raw_receivable_size() > 0; i++) {
+            if (link.receive(&frame, sizeof(frame)) != sizeof(frame)) break;
+            receive(frame, pros::millis());
+        }
+
+        const uint32_t time = pros::millis();
+        const Pose pose = odom.get();
+        const Twist twist = odom.get_velocity(true);
+        frame = {.seq = seq++,
+                 .time = time,
+                 .echo = echo,
+                 .hold = (uint16_t)(echo ? std::min<uint32_t>(time - echo_received, 0xFFFF) : 0),
+                 .x = wire::fixed(pose.x, 100),
+                 .y = wire::fixed(pose.y, 100),
+                 .theta = wire::fixed(wrap(pose.theta), 1e4),
+                 .linear = wire::fixed(twist.vel.x, 100),
+                 .angular = wire::fixed(twist.vel.theta, 1000)};
+        if (link.transmit(&frame, sizeof(frame)) != sizeof(frame))
+            drops.fetch_add(1, std::memory_order_relaxed);
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+Pose Partner::get_at(uint64_t time) {
+    const State s = state.read();
+    History<Pose, 64>::Sample before, after;
+    if (s.time == 0 || !partner_history.find(time, before, after)) return {NAN, NAN, NAN};
+    if (before.time == after.time) {
+        // past the newest pose it carries on at the velocity it was sent with
+        if (time <= before.time) return before.value;
+        const double dt = std::min<uint64_t>(time - before.time, (uint64_t)timeout * 1000) / 1e6;
+        return before.value + s.velocity * dt;
+    }
+    const double t = (double)(time - before.time) / (after.time - before.time);
+    const Pose& a = before.value;
+    const Pose& b = after.value;
+    return {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.theta + wrap(b.theta - a.theta) * t};
+}
+
+Pose Partner::get() { return get_at(pros::micros()); }
+
+Obstacle Partner::obstacle(double radius, double lead) {
+    const uint64_t now = pros::micros();
+    const Pose here = get_at(now);
+    if (std::isnan(here.x)) return {};
+    const Pose there = get_at(now + (uint64_t)(std::max(lead, 0.0) * 1000));
+    const double way = here.p().dist(there.p());
+    return Obstacle::around((here.p() + there.p()) * 0.5, radius + way / 2);
+}
+
+} // namespace appa
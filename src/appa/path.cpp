@@ -0,0 +1,894 @@
+#include "appa.h"
+#include <algorithm>
+
+namespace appa {
+
+/* Path */
+// a spline's points, evaluated a window at a time into the slots they map to, so the points read
+// around one stay where they are when the window moves on
+struct Path::Lazy {
+    static constexpr int slots = 64;
+    Spline spline;
+    size_t count;
+    double step; // in between points
+    std::array<Pose, slots> poses;
+    std::array<real, slots> curvatures;
+    std::array<int, slots> held; // point in each slot, -1 for none
+
+    Lazy(const Spline& spline, size_t count)
+        : spline(spline), count(count), step(spline.length() / (count - 1)) {
+        held.fill(-1);
+    }
+
+    double distance(size_t i) const { return std::min(spline.length(), i * step); }
+
+    // a quarter of the window behind the point, where the follower's searches start
+    void read(size_t i) {
+        if (held[i % slots] == (int)i) return;
+        const int first = std::max((int)i - slots / 4, 0);
+        const int last = std::min(first + slots, (int)count);
+        for (int j = first; j < last; j++) {
+            poses[j % slots] = spline.pose(distance(j), curvatures[j % slots]);
+            held[j % slots] = j;
+        }
+    }
+};
+
+Path::Path(const std::vector<Point>& points, double cell_size, const PathProfile& profile)
+    : cell_size(cell_size) {
+    // headings of the segments into each point
+    pose_store.reserve(points.size());
+    for (int i = 0; i < points.size(); i++) {
+        const double heading = i > 0 ? points[i - 1].angle(points[i])
+                                     : (points.size() > 1 ? points[0].angle(points[1]) : 0.0);
+        pose_store.push_back({points[i], heading});
+    }
+
+    // curvature of the circle through each point and its neighbours
+    curvature_store.assign(points.size(), 0.0);
+    for (int i = 1; i < (int)points.size() - 1; i++) {
+        const Point a = points[i - 1], b = points[i], c = points[i + 1];
+        const double cross = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        const double sides = a.dist(b) * b.dist(c) * c.dist(a);
+        curvature_store[i] = sides > 0 ? 2 * cross / sides : 0.0;
+    }
+
+    build_distances();
+    bind();
+    build_grid();
+    build_profile(profile);
+    build_directions(profile.cusp);
+}
+
+// precomputed headings (rad) and curvatures, such as from a spline
+Path::Path(const std::vector<Pose>& poses, const std::vector<double>& curvatures,
+           double cell_size, const PathProfile& profile)
+    : pose_store(poses), curvature_store(curvatures.begin(), curvatures.end()),
+      cell_size(cell_size) {
+    curvature_store.resize(pose_store.size(), 0.0);
+    build_distances();
+    bind();
+    build_grid();
+    build_profile(profile);
+    build_directions(profile.cusp);
+}
+
+// views existing tables without copying them, they must outlive the path
+Path::Path(std::span<const Pose> poses, std::span<const real> distances,
+           std::span<const real> curvatures, double cell_size, const PathProfile& profile)
+    : poses(poses), distances(distances), curvatures(curvatures), cell_size(cell_size) {
+    build_grid();
+    build_profile(profile);
+    build_directions(profile.cusp);
+}
+
+// a spline sampled every spacing, only its waypoints and arc length table are stored
+Path::Path(const Spline& spline, double spacing, double cell_size, const PathProfile& profile)
+    : lazy(std::make_shared<Lazy>(spline,
+                                  std::max(2, (int)ceil(spline.length() / spacing) + 1))),
+      cell_size(cell_size) {
+    build_grid();
+    build_profile(profile);
+    build_directions(profile.cusp);
+}
+
+// copies keep viewing external tables, but owned data has to be rebound
+Path::Path(const Path& other)
+    : poses(other.poses),
+      distances(other.distances),
+      curvatures(other.curvatures),
+      pose_store(other.pose_store),
+      distance_store(other.distance_store),
+      curvature_store(other.curvature_store),
+      lazy(other.lazy ? std::make_shared<Lazy>(*other.lazy) : nullptr),
+      velocities(other.velocities),
+      markers(other.markers),
+      overrides(other.overrides),
+      reversing(other.reversing),
+      cusps(other.cusps),
+      grid_origin(other.grid_origin),
+      cell_size(other.cell_size),
+      cols(other.cols),
+      rows(other.rows),
+      cell_start(other.cell_start),
+      cell_segments(other.cell_segments) {
+    if (!pose_store.empty()) bind();
+}
+Path& Path::operator=(const Path& other) {
+    if (this != &other) *this = Path(other);
+    return *this;
+}
+
+// reads a path file such as "/usd/skills.path", empty when it can't be loaded
+Path Path::load(const char* name, double cell_size, const PathProfile& profile) {
+    std::vector<PathRecord> records;
+    file::read(name, file::path_magic, records);
+
+    Path path(std::vector<Point>{}, cell_size);
+    path.pose_store.reserve(records.size());
+    path.distance_store.reserve(records.size());
+    path.curvature_store.reserve(records.size());
+    for (auto& record : records) {
+        path.pose_store.push_back({record.x, record.y, record.theta});
+        path.distance_store.push_back(record.distance);
+        path.curvature_store.push_back(record.curvature);
+    }
+    path.bind();
+    path.build_grid();
+    path.build_profile(profile);
+    path.build_directions(profile.cusp);
+    return path;
+}
+
+bool Path::save(const char* name) const {
+    std::vector<PathRecord> records;
+    records.reserve(size());
+    for (int i = 0; i < size(); i++) {
+        records.push_back({(float)pose(i).x, (float)pose(i).y, (float)pose(i).theta,
+                           (float)distance(i), (float)curvature(i)});
+    }
+    return file::write(name, file::path_magic, records.data(), records.size());
+}
+
+// indices ramer-douglas-peucker keeps, always the ends and any point further than tolerance from
+// the segment between the kept points around it. iterative so long recordings can't overflow the
+// task stack
+template <typename F> static std::vector<int> simplified(int size, double tolerance, F point) {
+    std::vector<int> kept;
+    if (size <= 2) {
+        for (int i = 0; i < size; i++) kept.push_back(i);
+        return kept;
+    }
+    std::vector<bool> keep(size, false);
+    keep[0] = keep[size - 1] = true;
+    std::vector<std::pair<int, int>> spans = {{0, size - 1}};
+    while (!spans.empty()) {
+        const auto [first, last] = spans.back();
+        spans.pop_back();
+        const Point a = point(first), ab = point(last) - a;
+        const double length = ab.x * ab.x + ab.y * ab.y;
+        double furthest = tolerance;
+        int index = -1;
+        for (int i = first + 1; i < last; i++) {
+            // distance to the segment, so a closed loop still measures from its ends
+            const Point ap = point(i) - a;
+            const double t = length > 0 ? std::clamp((ap.x * ab.x + ap.y * ab.y) / length, 0.0, 1.0)
+                                        : 0.0;
+            const double distance = point(i).dist(a + ab * t);
+            if (distance > furthest) {
+                furthest = distance;
+                index = i;
+            }
+        }
+        if (index < 0) continue;
+        keep[index] = true;
+        spans.push_back({first, index});
+        spans.push_back({index, last});
+    }
+    for (int i = 0; i < size; i++) {
+        if (keep[i]) kept.push_back(i);
+    }
+    return kept;
+}
+
+std::vector<Point> simplify(const std::vector<Point>& points, double tolerance) {
+    std::vector<Point> result;
+    for (int i : simplified(points.size(), tolerance, [&](int i) { return points[i]; }))
+        result.push_back(points[i]);
+    return result;
+}
+
+Path Path::simplify(double tolerance, const PathProfile& profile) const {
+    // each stretch between cusps on its own, so a cusp in line with its neighbours stays
+    std::vector<int> kept;
+    int first = 0;
+    for (int end : cusps) {
+        const std::vector<int> stretch = simplified(
+            end - first + 1, tolerance, [&](int i) { return pose(first + i).p(); });
+        for (size_t k = kept.empty() ? 0 : 1; k < stretch.size(); k++)
+            kept.push_back(first + stretch[k]);
+        first = end;
+    }
+    std::vector<Pose> kept_poses;
+    std::vector<double> kept_curvatures;
+    kept_poses.reserve(kept.size());
+    kept_curvatures.reserve(kept.size());
+    for (int i : kept) {
+        kept_poses.push_back(pose(i));
+        kept_curvatures.push_back(curvature(i));
+    }
+    Path path(kept_poses, kept_curvatures, cell_size, profile);
+    for (size_t j = 0; j + 1 < kept.size(); j++) path.reversing[j] = reversing[kept[j]];
+    path.build_cusps();
+
+    // overrides move to the last kept point at or before theirs, so a slowdown doesn't start late
+    for (const PathOverride& o : overrides) {
+        size_t j = 0;
+        while (j + 1 < kept.size() && kept[j + 1] <= o.point) j++;
+        path.override(j, o);
+    }
+
+    // markers move with the arc length between the kept points around them
+    for (const Marker& marker : markers) {
+        int j = 1;
+        while (j < (int)kept.size() - 1 && distance(kept[j]) < marker.distance) j++;
+        double distance = marker.distance;
+        if (kept.size() >= 2) {
+            const double from = this->distance(kept[j - 1]), to = this->distance(kept[j]);
+            const double t =
+                to > from ? std::clamp((marker.distance - from) / (to - from), 0.0, 1.0) : 0.0;
+            distance = path.distances[j - 1] + (path.distances[j] - path.distances[j - 1]) * t;
+        }
+        path.insert_marker({distance, marker.callback, marker.task});
+    }
+    return path;
+}
+
+Path Path::transform(const Pose& frame) const { return transform(FieldTransform::offset(frame)); }
+Path Path::mirror(const Pose& line) const { return transform(FieldTransform::mirror(line)); }
+
+Path Path::transform(const FieldTransform& field) const {
+    Path path(*this);
+    path.own();
+    field.apply(path.pose_store, path.pose_store);
+    if (field.mirrored()) {
+        for (auto& curvature : path.curvature_store) curvature = -curvature;
+    }
+    path.build_grid();
+    return path;
+}
+
+// copies viewed tables or evaluates a spline into the owned stores so they can be changed
+void Path::own() {
+    if (lazy) {
+        for (size_t i = 0; i < size(); i++) {
+            pose_store.push_back(pose(i));
+            distance_store.push_back(distance(i));
+            curvature_store.push_back(curvature(i));
+        }
+        lazy.reset();
+    } else if (pose_store.empty()) {
+        pose_store.assign(poses.begin(), poses.end());
+        distance_store.assign(distances.begin(), distances.end());
+        curvature_store.assign(curvatures.begin(), curvatures.end());
+    }
+    bind();
+}
+
+void Path::bind() {
+    poses = pose_store;
+    distances = distance_store;
+    curvatures = curvature_store;
+}
+
+void Path::build_distances() {
+    distance_store.reserve(pose_store.size());
+    double distance = 0.0;
+    for (int i = 0; i < pose_store.size(); i++) {
+        if (i > 0) distance += pose_store[i].dist(pose_store[i - 1]);
+        distance_store.push_back(distance);
+    }
+}
+
+void Path::build_profile(const PathProfile& profile) {
+    // curvature limit
+    velocities.assign(size(), profile.speed);
+    for (int i = 0; i < size() && profile.turn > 0; i++) {
+        const double k = fabs(curvature(i));
+        if (k > 0) velocities[i] = std::min(profile.speed, profile.turn / k);
+    }
+
+    // forward pass limits speeding up out of curves
+    for (int i = 1; i < size() && profile.accel > 0; i++) {
+        const double step = profile.accel * (distance(i) - distance(i - 1));
+        velocities[i] = std::min<double>(velocities[i], velocities[i - 1] + step);
+    }
+    // backward pass limits slowing down into curves
+    for (int i = (int)size() - 2; i >= 0 && profile.decel > 0; i--) {
+        const double step = profile.decel * (distance(i + 1) - distance(i));
+        velocities[i] = std::min<double>(velocities[i], velocities[i + 1] + step);
+    }
+}
+
+void Path::build_grid() {
+    if (size() < 2) return;
+
+    // bounding box of the path
+    Point min = pose(0).p(), max = pose(0).p();
+    for (size_t i = 1; i < size(); i++) {
+        const Pose& p = pose(i);
+        min = {std::min(min.x, p.x), std::min(min.y, p.y)};
+        max = {std::max(max.x, p.x), std::max(max.y, p.y)};
+    }
+    grid_origin = min;
+    cols = (int)((max.x - min.x) / cell_size) + 1;
+    rows = (int)((max.y - min.y) / cell_size) + 1;
+
+    // bucket each segment into every cell its bounding box touches
+    auto cells = [&](int segment, auto fn) {
+        const Pose& a = pose(segment);
+        const Pose& b = pose(segment + 1);
+        const int x0 = (int)((std::min(a.x, b.x) - min.x) / cell_size);
+        const int x1 = (int)((std::max(a.x, b.x) - min.x) / cell_size);
+        const int y0 = (int)((std::min(a.y, b.y) - min.y) / cell_size);
+        const int y1 = (int)((std::max(a.y, b.y) - min.y) / cell_size);
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                fn(y * cols + x);
+            }
+        }
+    };
+    cell_start.assign(cols * rows + 1, 0);
+    for (int i = 0; i < size() - 1; i++) {
+        cells(i, [&](int cell) { cell_start[cell + 1]++; });
+    }
+    for (int i = 0; i < cols * rows; i++) {
+        cell_start[i + 1] += cell_start[i];
+    }
+    cell_segments.resize(cell_start.back());
+    std::vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+    for (int i = 0; i < size() - 1; i++) {
+        cells(i, [&](int cell) { cell_segments[fill[cell]++] = i; });
+    }
+}
+
+size_t Path::size() const { return lazy ? lazy->count : poses.size(); }
+const Pose& Path::operator[](size_t i) const { return pose(i); }
+const Pose& Path::pose(size_t i) const {
+    if (!lazy) return poses[i];
+    lazy->read(i);
+    return lazy->poses[i % Lazy::slots];
+}
+double Path::distance(size_t i) const { return lazy ? lazy->distance(i) : distances[i]; }
+double Path::length() const {
+    if (lazy) return lazy->spline.length();
+    return distances.empty() ? 0.0 : distances.back();
+}
+double Path::curvature(size_t i) const {
+    if (!lazy) return curvatures[i];
+    lazy->read(i);
+    return lazy->curvatures[i % Lazy::slots];
+}
+
+int Path::after(double distance) const {
+    if (lazy) return std::min((int)floor(distance / lazy->step) + 1, (int)size());
+    return std::upper_bound(distances.begin(), distances.end(), distance) - distances.begin();
+}
+
+double Path::curvature(int segment, double distance) const {
+    double sharpest = 0.0;
+    const double end = this->distance(segment) + distance;
+    for (size_t i = segment; i < size() && this->distance(i) <= end; i++)
+        sharpest = std::max(sharpest, fabs((double)curvature(i)));
+    return sharpest;
+}
+
+// target speed at an arc length along the path
+double Path::velocity(double distance) const {
+    if (velocities.empty()) return 0.0;
+    if (distance <= 0) return velocities.front();
+    if (distance >= length()) return velocities.back();
+    const int i = after(distance);
+    const double from = this->distance(i - 1), to = this->distance(i);
+    const double t = (distance - from) / (to - from);
+    return velocities[i - 1] + (velocities[i] - velocities[i - 1]) * t;
+}
+
+Path& Path::profile(const Trajectory& trajectory, double full_speed) {
+    if (trajectory.size() != size() || full_speed <= 0) {
+        printf("path: can't profile %d points from %d samples\n", (int)size(),
+               (int)trajectory.size());
+        return *this;
+    }
+    velocities.resize(size());
+    for (size_t i = 0; i < size(); i++) {
+        velocities[i] = std::min(100.0, 100 * trajectory[i].velocity / full_speed);
+    }
+    // a trajectory starting from rest would hold the follower at the start
+    if (velocities.size() > 1) velocities[0] = std::max(velocities[0], velocities[1]);
+    return *this;
+}
+
+// closest point on a segment
+Point Path::nearest(const Point& point, int segment) const {
+    const Point a = pose(segment).p();
+    const Point ab = pose(segment + 1).p() - a;
+    const double length = ab.x * ab.x + ab.y * ab.y;
+    if (length == 0) return a;
+    const Point ap = point - a;
+    const double t = std::clamp((ap.x * ab.x + ap.y * ab.y) / length, 0.0, 1.0);
+    return a + ab * t;
+}
+
+// index of the segment closest to point, searching the surrounding grid cells first
+int Path::closest(const Point& point) const {
+    if (size() < 2) return 0;
+    int best = -1;
+    double best_dist = INFINITY;
+    auto check = [&](int segment) {
+        const double dist = point.dist(nearest(point, segment));
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = segment;
+        }
+    };
+
+    const int cx = (int)floor((point.x - grid_origin.x) / cell_size);
+    const int cy = (int)floor((point.y - grid_origin.y) / cell_size);
+    for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows - 1); y++) {
+        for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cols - 1); x++) {
+            const int cell = y * cols + x;
+            for (int i = cell_start[cell]; i < cell_start[cell + 1]; i++) {
+                check(cell_segments[i]);
+            }
+        }
+    }
+
+    // fall back to a full search when nothing is nearby or something outside could be closer
+    if (best < 0 || best_dist > cell_size) {
+        for (int i = 0; i < size() - 1; i++) {
+            check(i);
+        }
+    }
+    return best;
+}
+
+// markers keep distance order so the follower only checks the next one
+void Path::insert_marker(Marker marker) {
+    auto it = std::upper_bound(markers.begin(), markers.end(), marker.distance,
+                               [](double d, const Marker& m) { return d < m.distance; });
+    markers.insert(it, std::move(marker));
+}
+Path& Path::marker(double distance, std::function<void()> callback) {
+    insert_marker({distance, std::move(callback), nullptr});
+    return *this;
+}
+Path& Path::marker(double distance, pros::task_t task) {
+    insert_marker({distance, nullptr, task});
+    return *this;
+}
+const std::vector<Marker>& Path::get_markers() const { return markers; }
+
+void PathOverride::apply(const PathOverride& other) {
+    if (!std::isnan(other.speed)) speed = other.speed;
+    if (!std::isnan(other.lookahead)) lookahead = other.lookahead;
+    if (!std::isnan(other.exit)) exit = other.exit;
+}
+
+// overrides at the same point merge, so they can be set one at a time
+Path& Path::override(size_t point, const PathOverride& values) {
+    auto it = std::lower_bound(overrides.begin(), overrides.end(), (int)point,
+                               [](const PathOverride& o, int p) { return o.point < p; });
+    if (it != overrides.end() && it->point == (int)point) it->apply(values);
+    else {
+        PathOverride inserted = values;
+        inserted.point = point;
+        overrides.insert(it, inserted);
+    }
+    return *this;
+}
+const std::vector<PathOverride>& Path::get_overrides() const { return overrides; }
+
+PathOverride Path::overrides_at(int point) const {
+    PathOverride merged;
+    for (const PathOverride& o : overrides) {
+        if (o.point > point) break;
+        merged.apply(o);
+    }
+    merged.point = point;
+    return merged;
+}
+
+// a turn back further than cusp (deg) between a point's segments flips the direction after it
+void Path::build_directions(double cusp) {
+    reversing.assign(size() > 1 ? size() - 1 : 0, false);
+    bool reverse = false;
+    for (int i = 1; i < (int)size() - 1; i++) {
+        const Point in = pose(i).p() - pose(i - 1).p(), out = pose(i + 1).p() - pose(i).p();
+        const double turn =
+            fabs(atan2(in.x * out.y - in.y * out.x, in.x * out.x + in.y * out.y));
+        if (cusp > 0 && turn > to_rad(cusp)) reverse = !reverse;
+        reversing[i] = reverse;
+    }
+    build_cusps();
+}
+
+void Path::build_cusps() {
+    cusps.clear();
+    for (int i = 1; i < reversing.size(); i++) {
+        if (reversing[i] != reversing[i - 1]) cusps.push_back(i);
+    }
+    if (size() > 0) cusps.push_back(size() - 1);
+}
+
+Path& Path::reverse(size_t first, size_t last, bool reverse) {
+    for (size_t i = first; i < last && i < reversing.size(); i++) reversing[i] = reverse;
+    build_cusps();
+    return *this;
+}
+
+bool Path::reversed(size_t segment) const {
+    return segment < reversing.size() && reversing[segment];
+}
+
+int Path::cusp(int segment) const {
+    return *std::upper_bound(cusps.begin(), cusps.end() - 1, segment);
+}
+
+const std::vector<int>& Path::get_cusps() const { return cusps; }
+
+// point at an arc length along the path
+Point Path::at(double distance) const {
+    if (distance <= 0) return pose(0).p();
+    if (distance >= length()) return pose(size() - 1).p();
+    const int i = after(distance);
+    const double from = this->distance(i - 1), to = this->distance(i);
+    const double t = (distance - from) / (to - from);
+    return pose(i - 1).p() + (pose(i).p() - pose(i - 1).p()) * t;
+}
+
+// closest segment searching forward from segment, so progress never goes backwards
+int Path::advance(const Point& point, int segment, double window) const {
+    int best = segment;
+    double best_dist = point.dist(nearest(point, segment));
+    const double end = distance(segment + 1) + window;
+    const int stop = cusp(segment);
+    for (int i = segment + 1; i < stop && distance(i) <= end; i++) {
+        const double dist = point.dist(nearest(point, i));
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// arc length of the closest point on a segment
+double Path::progress(const Point& point, int segment) const {
+    return distance(segment) + pose(segment).dist(nearest(point, segment));
+}
+
+// furthest intersection of a circle with the path ahead of progress
+Point Path::intersect(const Point& point, double radius, int segment, double progress) const {
+    const int stop = cusp(segment);
+    for (int i = segment; i < stop; i++) {
+        // keep going while the segment ends inside the circle
+        if (point.dist(pose(i + 1)) < radius) continue;
+
+        // solve |a + t * d - point| = radius for the far root
+        const Point a = pose(i).p();
+        const Point d = pose(i + 1).p() - a;
+        const Point f = a - point;
+        const double qa = d.x * d.x + d.y * d.y;
+        const double qb = 2 * (f.x * d.x + f.y * d.y);
+        const double qc = f.x * f.x + f.y * f.y - radius * radius;
+        const double disc = qb * qb - 4 * qa * qc;
+        if (qa > 0 && disc >= 0) {
+            const double t = (-qb + sqrt(disc)) / (2 * qa);
+            if (t >= 0 && t <= 1 && distance(i) + t * sqrt(qa) >= progress) return a + d * t;
+        }
+        break;
+    }
+    // the circle doesn't reach the path ahead, or the end of the stretch is inside it
+    const bool end_inside = point.dist(pose(stop)) < radius;
+    if (end_inside) return pose(stop).p();
+    return at(std::min<double>(progress + radius, distance(stop)));
+}
+
+/* Trajectory */
+Trajectory::Trajectory(const std::vector<TrajectorySample>& samples) : samples(samples) {}
+
+// largest speed v at a point where a wheel runs at v s, after a point at speed prev where it ran at
+// v prev_s, so that its speed changes by at most accel over the time 2 ds / (prev + v) between
+// them: the larger root of (v s - prev prev_s) (v + prev) = 2 accel ds. a wheel driving backwards
+// at either point, on a curve tighter than half the track width, only limits the path speed
+static double wheel_limit(double s, double prev_s, double prev, double accel, double ds) {
+    if (s <= 0 || prev_s <= 0) return sqrt(prev * prev + 2 * accel * ds);
+    const double b = (s - prev_s) * prev;
+    return (-b + sqrt(b * b + 4 * s * (prev_s * prev * prev + 2 * accel * ds))) / (2 * s);
+}
+
+// forward and backward passes over the arc length, as in Path::build_profile but in wheel units.
+// at curvature k a wheel runs at v (1 +- k w / 2), which bounds the speed at each point, and the
+// wheel speeds at neighbouring points bound how quickly the speed can change between them, so a
+// change in curvature slows the robot down as much as a change in speed would. each segment is
+// timed at the mean of its end speeds, the exact time under constant acceleration
+Trajectory Trajectory::generate(const Path& path, const Kinematics& kinematics,
+                                const TrajectoryLimits& limits) {
+    Trajectory trajectory(std::vector<TrajectorySample>{});
+    const int n = path.size();
+    const double wheel_speed = limits.velocity > 0 ? limits.velocity : kinematics.max_speed();
+    if (n < 2 || wheel_speed <= 0) {
+        printf("trajectory: can't generate from %d points at %.1f in/s\n", n, wheel_speed);
+        return trajectory;
+    }
+    const double decel = limits.decel > 0 ? limits.decel : limits.accel;
+    // wheel speed per unit of path speed, left then right
+    auto scale = [&](int i, double side) {
+        return 1 + side * path.curvature(i) * kinematics.track_width / 2;
+    };
+
+    std::vector<double> v(n);
+    for (int i = 0; i < n; i++) {
+        const double curvature = fabs(path.curvature(i));
+        v[i] = wheel_speed / std::max(scale(i, -1), scale(i, 1));
+        if (limits.centripetal > 0 && curvature > 0)
+            v[i] = std::min(v[i], sqrt(limits.centripetal / curvature));
+    }
+    v.front() = std::min(v.front(), limits.start_velocity);
+    v.back() = std::min(v.back(), limits.end_velocity);
+
+    // a pass slowing one wheel can make the other change speed faster than the pass before it
+    // allowed, when the curvature changes sharply, so they repeat until neither lowers a speed
+    bool lowered = true;
+    for (int round = 0; round < 16 && lowered; round++) {
+        lowered = false;
+        auto lower = [&](int i, double limit) {
+            if (limit < v[i] - 1e-9) v[i] = limit, lowered = true;
+        };
+        for (int i = 1; i < n && limits.accel > 0; i++) {
+            const double ds = path.distance(i) - path.distance(i - 1);
+            for (double side : {-1.0, 1.0}) {
+                const double s = scale(i, side), prev_s = scale(i - 1, side);
+                lower(i, wheel_limit(s, prev_s, v[i - 1], limits.accel, ds));
+            }
+        }
+        for (int i = n - 2; i >= 0 && decel > 0; i--) {
+            const double ds = path.distance(i + 1) - path.distance(i);
+            for (double side : {-1.0, 1.0}) {
+                const double s = scale(i, side), next_s = scale(i + 1, side);
+                lower(i, wheel_limit(s, next_s, v[i + 1], decel, ds));
+            }
+        }
+    }
+
+    trajectory.samples.reserve(n);
+    double time = 0.0;
+    for (int i = 0; i < n; i++) {
+        if (i > 0) {
+            const double ds = path.distance(i) - path.distance(i - 1);
+            if (ds > 0 && v[i - 1] + v[i] > 0) time += 2 * ds / (v[i - 1] + v[i]);
+        }
+        trajectory.samples.push_back({time, path[i], v[i], v[i] * path.curvature(i)});
+    }
+    return trajectory;
+}
+
+// reads a trajectory file such as "/usd/skills.traj", empty when it can't be loaded
+Trajectory Trajectory::load(const char* name) {
+    std::vector<TrajectoryRecord> records;
+    file::read(name, file::trajectory_magic, records);
+
+    Trajectory trajectory(std::vector<TrajectorySample>{});
+    trajectory.samples.reserve(records.size());
+    for (auto& record : records) {
+        trajectory.samples.push_back({record.time,
+                                      {record.x, record.y, record.theta},
+                                      record.velocity,
+                                      record.omega});
+    }
+    return trajectory;
+}
+
+bool Trajectory::save(const char* name) const {
+    std::vector<TrajectoryRecord> records;
+    records.reserve(samples.size());
+    for (auto& sample : samples) {
+        records.push_back({(float)sample.time, (float)sample.pose.x, (float)sample.pose.y,
+                           (float)sample.pose.theta, (float)sample.velocity,
+                           (float)sample.omega});
+    }
+    return file::write(name, file::trajectory_magic, records.data(), records.size());
+}
+
+Trajectory Trajectory::transform(const FieldTransform& field) const {
+    Trajectory trajectory(*this);
+    for (auto& sample : trajectory.samples) {
+        sample.pose = field.pose(sample.pose);
+        if (field.mirrored()) sample.omega = -sample.omega;
+    }
+    return trajectory;
+}
+
+size_t Trajectory::size() const { return samples.size(); }
+const TrajectorySample& Trajectory::operator[](size_t i) const { return samples[i]; }
+double Trajectory::duration() const { return samples.empty() ? 0.0 : samples.back().time; }
+
+// sample interpolated at a time from the start
+TrajectorySample Trajectory::at(double time) const {
+    if (samples.empty()) return {time, {0.0, 0.0, 0.0}, 0.0, 0.0};
+    if (time <= samples.front().time) return samples.front();
+    if (time >= duration()) return samples.back();
+    auto next = std::upper_bound(samples.begin(), samples.end(), time,
+                                 [](double t, const TrajectorySample& s) { return t < s.time; });
+    const TrajectorySample& a = *(next - 1);
+    const TrajectorySample& b = *next;
+    const double t = (time - a.time) / (b.time - a.time);
+    const double theta = a.pose.theta + wrap(b.pose.theta - a.pose.theta) * t;
+    return {time, Pose(a.pose.p() + (b.pose.p() - a.pose.p()) * t, theta),
+            a.velocity + (b.velocity - a.velocity) * t, a.omega + (b.omega - a.omega) * t};
+}
+
+/* TrajectoryCache */
+// fnv-1a over the bit patterns of the inputs
+static void mix(uint64_t& hash, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; i++) hash = (hash ^ ((bits >> (8 * i)) & 0xFF)) * 0x100000001B3;
+}
+
+static uint64_t hash(const Kinematics& kinematics, const TrajectoryLimits& limits) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (double value : {kinematics.track_width, kinematics.wheel_diameter, kinematics.gear_ratio,
+                         kinematics.motor_rpm, limits.velocity, limits.accel, limits.decel,
+                         limits.centripetal, limits.start_velocity, limits.end_velocity})
+        mix(hash, value);
+    return hash;
+}
+
+TrajectoryCache::TrajectoryCache(size_t capacity) : entries(std::max<size_t>(capacity, 1)) {}
+
+const Trajectory& TrajectoryCache::get(uint64_t key, const std::function<Trajectory()>& generate) {
+    Entry* oldest = &entries[0];
+    for (Entry& entry : entries) {
+        if (entry.used > 0 && entry.key == key) {
+            entry.used = ++clock;
+            hit_count++;
+            return entry.trajectory;
+        }
+        if (entry.used < oldest->used) oldest = &entry;
+    }
+    miss_count++;
+    oldest->key = key;
+    oldest->used = ++clock;
+    oldest->trajectory = generate();
+    return oldest->trajectory;
+}
+
+const Trajectory& TrajectoryCache::get(const std::vector<Point>& waypoints,
+                                       const Kinematics& kinematics,
+                                       const TrajectoryLimits& limits,
+                                       const std::function<Path()>& build) {
+    uint64_t key = hash(kinematics, limits);
+    for (const Point& point : waypoints) {
+        mix(key, point.x);
+        mix(key, point.y);
+    }
+    return get(key, [&] { return Trajectory::generate(build(), kinematics, limits); });
+}
+
+const Trajectory& TrajectoryCache::get(const Path& path, const Kinematics& kinematics,
+                                       const TrajectoryLimits& limits) {
+    uint64_t key = hash(kinematics, limits);
+    for (size_t i = 0; i < path.size(); i++) {
+        mix(key, path[i].x);
+        mix(key, path[i].y);
+        mix(key, path.curvature(i));
+    }
+    return get(key, [&] { return Trajectory::generate(path, kinematics, limits); });
+}
+
+void TrajectoryCache::clear() {
+    for (Entry& entry : entries) entry = Entry();
+    clock = 0;
+}
+
+uint32_t TrajectoryCache::hits() const { return hit_count; }
+uint32_t TrajectoryCache::misses() const { return miss_count; }
+
+/* Learning */
+PathLearning::PathLearning(const char* file, const LearningConfig& config)
+    : file(file), config(config) {
+    this->config.spacing = std::max(config.spacing, 0.1);
+}
+
+int PathLearning::bin(double distance) const {
+    if (corrections.empty()) return -1;
+    return std::clamp((int)lround(distance / config.spacing), 0, (int)corrections.size() - 1);
+}
+
+bool PathLearning::load() {
+    std::vector<LearningRecord> records;
+    if (!file::read(file, file::learning_magic, records)) return false;
+    corrections = std::move(records);
+    learned_runs = 0;
+    return true;
+}
+
+bool PathLearning::save() const {
+    return file::write(file, file::learning_magic, corrections.data(), corrections.size());
+}
+
+void PathLearning::clear() {
+    std::fill(corrections.begin(), corrections.end(), LearningRecord{0.0f, 0.0f});
+    learned_runs = 0;
+}
+
+int PathLearning::runs() const { return learned_runs; }
+
+void PathLearning::begin(double length) {
+    const size_t bins = (size_t)ceil(std::max(length, 0.0) / config.spacing) + 1;
+    if (corrections.size() != bins) {
+        if (!corrections.empty())
+            printf("learning: %s was learned on another route, starting over\n", file);
+        corrections.assign(bins, {0.0f, 0.0f});
+        learned_runs = 0;
+    }
+    cross_track.assign(bins, 0.0f);
+    short_of.assign(bins, 0.0f);
+    samples.assign(bins, 0);
+}
+
+void PathLearning::record(double distance, double cross_track, double short_of) {
+    const int i = bin(distance);
+    if (i < 0 || i >= samples.size() || samples[i] == UINT16_MAX) return;
+    this->cross_track[i] += cross_track;
+    this->short_of[i] += short_of;
+    samples[i]++;
+}
+
+LearningRecord PathLearning::correction(double distance) const {
+    const int i = bin(distance);
+    return i < 0 ? LearningRecord{0.0f, 0.0f} : corrections[i];
+}
+
+void PathLearning::finish(bool settled) {
+    if (!settled || samples.empty()) return;
+    // the run's mean error in each bin, bins it never reached learn nothing
+    const int bins = corrections.size();
+    std::vector<LearningRecord> error(bins, {0.0f, 0.0f});
+    std::vector<uint8_t> seen(bins, 0);
+    for (int i = 0; i < bins; i++) {
+        if (samples[i] == 0) continue;
+        error[i] = {short_of[i] / samples[i], cross_track[i] / samples[i]};
+        seen[i] = 1;
+    }
+    // each bin learns from the error lead ahead, smoothed 1 2 1 over the bins around it
+    const int lead = lround(config.lead / config.spacing);
+    const double keep = 1 - std::clamp(config.forget, 0.0, 1.0);
+    for (int i = 0; i < bins; i++) {
+        double linear = 0.0, angular = 0.0, weight = 0.0;
+        for (int k = -1; k <= 1; k++) {
+            const int j = i + lead + k;
+            if (j < 0 || j >= bins || !seen[j]) continue;
+            const double w = k == 0 ? 2.0 : 1.0;
+            linear += w * error[j].linear;
+            angular += w * error[j].angular;
+            weight += w;
+        }
+        LearningRecord& c = corrections[i];
+        c.linear *= keep;
+        c.angular *= keep;
+        if (weight > 0) {
+            // short of the speed adds output, left of the path steers right
+            c.linear += config.speed * linear / weight;
+            c.angular -= config.steer * angular / weight;
+        }
+        c.linear = std::clamp<double>(c.linear, -config.limit, config.limit);
+        c.angular = std::clamp<double>(c.angular, -config.limit, config.limit);
+    }
+    learned_runs++;
+    save();
+}
+
+} // namespace appa
@@ -0,0 +1,588 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Obstacle */
+Obstacle Obstacle::rectangle(const Point& corner, const Point& opposite) {
+    return {{corner, {opposite.x, corner.y}, opposite, {corner.x, opposite.y}}};
+}
+
+Obstacle Obstacle::around(const Point& center, double radius) {
+    Obstacle octagon;
+    const double reach = radius / cos(M_PI / 8); // corners out far enough for the edges to touch
+    for (int i = 0; i < 8; i++)
+        octagon.corners.push_back(center + Point{cos(i * M_PI_4), sin(i * M_PI_4)} * reach);
+    return octagon;
+}
+
+/* Planner */
+static constexpr double tolerance = 1e-6; // in, touching an obstacle doesn't block
+enum : uint8_t { UNSEEN, OPEN, CLOSED };
+
+static double cross(const Point& a, const Point& b) { return a.x * b.y - a.y * b.x; }
+
+// whether the segment passes through the polygon's inside, by separating axes: the edge normals
+// and the segment's
+static bool crosses(const std::vector<Point>& polygon, const Point& a, const Point& b) {
+    auto separated = [&](Point axis) {
+        const double norm = hypot(axis.x, axis.y);
+        if (norm == 0) return false;
+        axis *= 1 / norm;
+        double lo = INFINITY, hi = -INFINITY;
+        for (const Point& p : polygon) {
+            const double d = p.x * axis.x + p.y * axis.y;
+            lo = std::min(lo, d);
+            hi = std::max(hi, d);
+        }
+        const double da = a.x * axis.x + a.y * axis.y, db = b.x * axis.x + b.y * axis.y;
+        return std::max(da, db) <= lo + tolerance || std::min(da, db) >= hi - tolerance;
+    };
+    for (size_t i = 0; i < polygon.size(); i++) {
+        const Point edge = polygon[(i + 1) % polygon.size()] - polygon[i];
+        if (separated({edge.y, -edge.x})) return false;
+    }
+    return !separated({a.y - b.y, b.x - a.x});
+}
+
+// whether the point is inside the counterclockwise polygon, touching it isn't
+static bool contains(const std::vector<Point>& polygon, const Point& point) {
+    for (size_t i = 0; i < polygon.size(); i++) {
+        if (cross(polygon[(i + 1) % polygon.size()] - polygon[i], point - polygon[i]) <= tolerance)
+            return false;
+    }
+    return true;
+}
+
+// the obstacle grown by the radius, moving each corner out along its bisector so the edges move
+// out by the radius. counterclockwise, empty for fewer than 3 corners
+static std::vector<Point> grow(const Obstacle& obstacle, double radius) {
+    std::vector<Point> corners = obstacle.corners;
+    const size_t n = corners.size();
+    if (n < 3) return {};
+    double area = 0.0;
+    for (size_t i = 0; i < n; i++) area += cross(corners[i], corners[(i + 1) % n]);
+    if (area < 0) std::reverse(corners.begin(), corners.end());
+
+    std::vector<Point> grown;
+    for (size_t i = 0; i < n; i++) {
+        const Point& prev = corners[(i + n - 1) % n];
+        const Point& corner = corners[i];
+        const Point& next = corners[(i + 1) % n];
+        const Point in = corner - prev, out = next - corner;
+        const Point n1 = Point{in.y, -in.x} * (1 / hypot(in.x, in.y));
+        const Point n2 = Point{out.y, -out.x} * (1 / hypot(out.x, out.y));
+        Point bisector = n1 + n2;
+        bisector *= 1 / hypot(bisector.x, bisector.y);
+        grown.push_back(corner + bisector * (radius / (bisector.x * n1.x + bisector.y * n1.y)));
+    }
+    return grown;
+}
+
+Planner::Planner(const std::vector<Obstacle>& obstacles, double radius, double field,
+                 double spacing)
+    : low(radius), high(field - radius), spacing(std::max(spacing, 0.5)), radius(radius),
+      cell(field / 24), cells(24) {
+    for (const Obstacle& obstacle : obstacles) {
+        std::vector<Point> grown = grow(obstacle, radius);
+        if (!grown.empty()) polygons.push_back(std::move(grown));
+    }
+
+    // each obstacle in the cells its bounds overlap, counted then filled
+    auto bounds = [&](const std::vector<Point>& polygon, int& x0, int& y0, int& x1, int& y1) {
+        double lx = INFINITY, ly = INFINITY, hx = -INFINITY, hy = -INFINITY;
+        for (const Point& p : polygon) {
+            lx = std::min<double>(lx, p.x), hx = std::max<double>(hx, p.x);
+            ly = std::min<double>(ly, p.y), hy = std::max<double>(hy, p.y);
+        }
+        x0 = std::clamp((int)floor(lx / cell), 0, cells - 1);
+        x1 = std::clamp((int)floor(hx / cell), 0, cells - 1);
+        y0 = std::clamp((int)floor(ly / cell), 0, cells - 1);
+        y1 = std::clamp((int)floor(hy / cell), 0, cells - 1);
+    };
+    cell_start.assign(cells * cells + 1, 0);
+    for (const std::vector<Point>& polygon : polygons) {
+        int x0, y0, x1, y1;
+        bounds(polygon, x0, y0, x1, y1);
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) cell_start[y * cells + x + 1]++;
+        }
+    }
+    for (int i = 0; i < cells * cells; i++) cell_start[i + 1] += cell_start[i];
+    cell_obstacles.resize(cell_start.back());
+    std::vector<int> filled(cell_start.begin(), cell_start.end() - 1);
+    for (int k = 0; k < polygons.size(); k++) {
+        int x0, y0, x1, y1;
+        bounds(polygons[k], x0, y0, x1, y1);
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) cell_obstacles[filled[y * cells + x]++] = k;
+        }
+    }
+
+    // corners the robot can reach, so not past the walls or inside another obstacle
+    for (size_t k = 0; k < polygons.size(); k++) {
+        for (const Point& corner : polygons[k]) {
+            if (corner.x < low || corner.x > high || corner.y < low || corner.y > high) continue;
+            bool covered = false;
+            for (size_t j = 0; j < polygons.size() && !covered; j++)
+                covered = j != k && contains(polygons[j], corner);
+            if (!covered) nodes.push_back(corner);
+        }
+    }
+
+    // every pair of corners that see each other
+    edge_start.push_back(0);
+    for (int i = 0; i < nodes.size(); i++) {
+        for (int j = 0; j < nodes.size(); j++) {
+            if (i != j && visible(nodes[i], nodes[j])) edges.push_back(j);
+        }
+        edge_start.push_back(edges.size());
+    }
+    set_moving({});
+}
+
+bool Planner::visible(const Point& a, const Point& b, int ignore) const {
+    for (int k = 0; k < polygons.size(); k++) {
+        if (k != ignore && crosses(polygons[k], a, b)) return false;
+    }
+    return true;
+}
+
+bool Planner::clear(const Point& a, const Point& b, int ignore) const {
+    for (int k = 0; k < moving.size(); k++) {
+        if (k != ignore && crosses(moving[k], a, b)) return false;
+    }
+    return true;
+}
+
+int Planner::inside(const Point& point) const {
+    for (int k = 0; k < polygons.size(); k++) {
+        if (contains(polygons[k], point)) return k;
+    }
+    return -1;
+}
+
+int Planner::inside_moving(const Point& point) const {
+    for (int k = 0; k < moving.size(); k++) {
+        if (contains(moving[k], point)) return k;
+    }
+    return -1;
+}
+
+void Planner::set_moving(const std::vector<Obstacle>& obstacles) {
+    moving.clear();
+    moving_nodes.clear();
+    for (const Obstacle& obstacle : obstacles) {
+        std::vector<Point> grown = grow(obstacle, radius);
+        if (!grown.empty()) moving.push_back(std::move(grown));
+    }
+    for (size_t k = 0; k < moving.size(); k++) {
+        for (const Point& corner : moving[k]) {
+            if (corner.x < low || corner.x > high || corner.y < low || corner.y > high) continue;
+            bool covered = inside(corner) >= 0;
+            for (size_t j = 0; j < moving.size() && !covered; j++)
+                covered = j != k && contains(moving[j], corner);
+            if (!covered) moving_nodes.push_back(corner);
+        }
+    }
+
+    // the fixed edges the moving obstacles leave open, and the edges to their corners
+    const int n = nodes.size(), m = moving_nodes.size();
+    edge_open.assign(edges.size(), 1);
+    if (!moving.empty()) {
+        for (int i = 0; i < n; i++) {
+            for (int e = edge_start[i]; e < edge_start[i + 1]; e++)
+                edge_open[e] = clear(nodes[i], nodes[edges[e]]);
+        }
+    }
+    moving_sees.assign(m * (n + m), 0);
+    for (int j = 0; j < m; j++) {
+        for (int i = 0; i < n + m; i++) {
+            const Point& other = i < n ? nodes[i] : moving_nodes[i - n];
+            if (i != n + j)
+                moving_sees[j * (n + m) + i] =
+                    visible(moving_nodes[j], other) && clear(moving_nodes[j], other);
+        }
+    }
+
+    const size_t count = n + m + 2;
+    cost.resize(count);
+    parent.resize(count);
+    state.resize(count);
+    from_start.resize(n + m);
+    to_goal.resize(n + m);
+}
+
+std::vector<Point> Planner::route(const Point& start, const Point& goal) {
+    APPA_PROFILE_SCOPE("planner route");
+    if (goal.x < low || goal.x > high || goal.y < low || goal.y > high || inside(goal) >= 0 ||
+        inside_moving(goal) >= 0) {
+        printf("planner: (%.1f, %.1f) can't be reached\n", goal.x, goal.y);
+        return {};
+    }
+    const int ignore = inside(start), ignore_moving = inside_moving(start);
+    if (visible(start, goal, ignore) && clear(start, goal, ignore_moving)) return {start, goal};
+
+    // link the start and goal to the corners they see, the moving obstacles' corners after the rest
+    const int n = nodes.size(), m = moving_nodes.size(), s = n + m, g = s + 1;
+    auto point = [&](int i) {
+        return i == s ? start : i == g ? goal : i < n ? nodes[i] : moving_nodes[i - n];
+    };
+    for (int i = 0; i < n + m; i++) {
+        from_start[i] = visible(start, point(i), ignore) && clear(start, point(i), ignore_moving);
+        to_goal[i] = visible(point(i), goal) && clear(point(i), goal);
+    }
+
+    // a* with the straight line to the goal as the estimate. the graph is a few hundred corners at
+    // most, so the open set is scanned instead of kept in a heap
+    std::fill(state.begin(), state.end(), UNSEEN);
+    cost[s] = 0.0;
+    parent[s] = -1;
+    state[s] = OPEN;
+    while (true) {
+        int best = -1;
+        double best_f = INFINITY;
+        for (int i = 0; i < n + m + 2; i++) {
+            if (state[i] != OPEN) continue;
+            const double f = cost[i] + point(i).dist(goal);
+            if (f < best_f) best = i, best_f = f;
+        }
+        if (best < 0) {
+            printf("planner: no route to (%.1f, %.1f)\n", goal.x, goal.y);
+            return {};
+        }
+        if (best == g) break;
+        state[best] = CLOSED;
+
+        auto relax = [&](int next) {
+            if (state[next] == CLOSED) return;
+            const double c = cost[best] + point(best).dist(point(next));
+            if (state[next] == OPEN && c >= cost[next]) return;
+            cost[next] = c;
+            parent[next] = best;
+            state[next] = OPEN;
+        };
+        if (best == s) {
+            for (int i = 0; i < n + m; i++)
+                if (from_start[i]) relax(i);
+        } else if (best < n) {
+            for (int e = edge_start[best]; e < edge_start[best + 1]; e++)
+                if (edge_open[e]) relax(edges[e]);
+            for (int j = 0; j < m; j++)
+                if (moving_sees[j * (n + m) + best]) relax(n + j);
+            if (to_goal[best]) relax(g);
+        } else {
+            for (int i = 0; i < n + m; i++)
+                if (moving_sees[(best - n) * (n + m) + i]) relax(i);
+            if (to_goal[best]) relax(g);
+        }
+    }
+
+    std::vector<Point> corners;
+    for (int i = g; i >= 0; i = parent[i]) corners.push_back(point(i));
+    std::reverse(corners.begin(), corners.end());
+    return corners;
+}
+
+Path Planner::plan(const Point& start, const Point& goal, const PathProfile& profile) {
+    const std::vector<Point> corners = route(start, goal);
+    std::vector<Point> points;
+    for (size_t i = 0; i + 1 < corners.size(); i++) {
+        const int steps = std::max(1, (int)ceil(corners[i].dist(corners[i + 1]) / spacing));
+        for (int k = 0; k < steps; k++)
+            points.push_back(corners[i] + (corners[i + 1] - corners[i]) * ((double)k / steps));
+    }
+    if (!corners.empty()) points.push_back(corners.back());
+    return Path(points, 12.0, profile);
+}
+
+// the fixed obstacles listed in the cells around the segment, which is at most a cell long, the
+// moving ones and the walls. each hit is narrowed down by halving the part of the segment it
+// leaves clear
+Planner::Collision Planner::sweep(const Point& a, const Point& b) const {
+    Collision hit;
+    double first = INFINITY; // of the segment
+    auto test = [&](const std::vector<Point>& polygon, Collision::Kind kind, int k) {
+        const bool within = contains(polygon, a);
+        if (!within && !crosses(polygon, a, b)) return;
+        double clear = 0.0, blocked = within ? 0.0 : 1.0;
+        for (int i = 0; i < 12 && blocked > 0; i++) {
+            const double mid = (clear + blocked) / 2;
+            if (crosses(polygon, a, a + (b - a) * mid)) blocked = mid;
+            else clear = mid;
+        }
+        if (blocked < first) first = blocked, hit.kind = kind, hit.obstacle = k;
+    };
+    auto index = [&](double v) { return std::clamp((int)floor(v / cell), 0, cells - 1); };
+    for (int y = index(std::min(a.y, b.y)); y <= index(std::max(a.y, b.y)); y++) {
+        for (int x = index(std::min(a.x, b.x)); x <= index(std::max(a.x, b.x)); x++) {
+            for (int i = cell_start[y * cells + x]; i < cell_start[y * cells + x + 1]; i++)
+                test(polygons[cell_obstacles[i]], Collision::OBSTACLE, cell_obstacles[i]);
+        }
+    }
+    for (int k = 0; k < moving.size(); k++) test(moving[k], Collision::MOVING, k);
+
+    // the fraction of the way to b where the center leaves the band inside the walls
+    auto wall = [&](double from, double to) {
+        if (from < low - tolerance || from > high + tolerance) return 0.0;
+        if (to < low - tolerance) return (from - low) / (from - to);
+        if (to > high + tolerance) return (high - from) / (to - from);
+        return HUGE_VAL;
+    };
+    const double out = std::min(wall(a.x, b.x), wall(a.y, b.y));
+    if (out < first) first = out, hit.kind = Collision::WALL, hit.obstacle = -1;
+
+    if (hit) {
+        hit.point = a + (b - a) * first;
+        hit.distance = a.dist(b) * first;
+    }
+    return hit;
+}
+
+// the first hit along the points, in pieces of at most a cell, with the segment and the fraction
+// of it where
+template <typename PointAt, typename Sweep>
+static Planner::Collision along(int size, PointAt point, Sweep sweep, double cell, int& segment,
+                                double& fraction) {
+    for (int i = 0; i < size; i++) {
+        const Point a = point(i), b = point(std::min(i + 1, size - 1));
+        const double length = a.dist(b);
+        const int pieces = std::max(1, (int)ceil(length / cell));
+        for (int j = 0; j < pieces; j++) {
+            Planner::Collision hit =
+                sweep(a + (b - a) * ((double)j / pieces), a + (b - a) * ((double)(j + 1) / pieces));
+            if (!hit) continue;
+            segment = i;
+            fraction = length > 0 ? (length * j / pieces + hit.distance) / length : 0.0;
+            return hit;
+        }
+    }
+    return {};
+}
+
+Planner::Collision Planner::check(const Path& path) const {
+    int segment;
+    double fraction;
+    Collision hit = along(
+        path.size(), [&](int i) { return path[i].p(); },
+        [&](const Point& a, const Point& b) { return sweep(a, b); }, cell, segment, fraction);
+    if (hit) {
+        const double start = path.distance(segment);
+        const double end = path.distance(std::min<size_t>(segment + 1, path.size() - 1));
+        hit.distance = start + (end - start) * fraction;
+    }
+    return hit;
+}
+
+Planner::Collision Planner::check(const Trajectory& trajectory) const {
+    int segment;
+    double fraction;
+    Collision hit = along(
+        trajectory.size(), [&](int i) { return trajectory[i].pose.p(); },
+        [&](const Point& a, const Point& b) { return sweep(a, b); }, cell, segment, fraction);
+    if (hit) {
+        const size_t next = std::min<size_t>(segment + 1, trajectory.size() - 1);
+        hit.time = trajectory[segment].time + (trajectory[next].time - trajectory[segment].time) *
+                                                  fraction;
+        hit.distance = 0.0;
+        for (int i = 0; i < segment; i++)
+            hit.distance += trajectory[i].pose.p().dist(trajectory[i + 1].pose.p());
+        hit.distance += trajectory[segment].pose.p().dist(trajectory[next].pose.p()) * fraction;
+    }
+    return hit;
+}
+
+size_t Planner::size() const { return nodes.size(); }
+
+/* Geofence */
+Geofence::Geofence(const std::vector<Zone>& zones, double field, double cell)
+    : cells(std::max(1, (int)ceil(field / std::max(cell, 0.5)))),
+      cell(std::max(cell, 0.5)),
+      field(field) {
+    grid.assign(cells * cells, 100);
+    // even odd crossings along each row of cell centers
+    for (const Zone& zone : zones) {
+        const std::vector<Point>& corners = zone.corners;
+        const uint8_t cap = std::clamp(std::lround(zone.speed), 0l, 100l);
+        for (int row = 0; row < cells; row++) {
+            const double y = (row + 0.5) * this->cell;
+            for (int col = 0; col < cells; col++) {
+                const double x = (col + 0.5) * this->cell;
+                bool in = false;
+                for (size_t i = 0, j = corners.size() - 1; i < corners.size(); j = i++) {
+                    const Point& a = corners[i];
+                    const Point& b = corners[j];
+                    if ((a.y > y) != (b.y > y) && x < a.x + (y - a.y) * (b.x - a.x) / (b.y - a.y))
+                        in = !in;
+                }
+                uint8_t& value = grid[row * cells + col];
+                if (in) value = std::min(value, cap);
+            }
+        }
+    }
+}
+
+Geofence& Geofence::walls(double margin, double speed) {
+    const uint8_t cap = std::clamp(std::lround(speed), 0l, 100l);
+    for (int row = 0; row < cells; row++) {
+        const double y = (row + 0.5) * cell;
+        for (int col = 0; col < cells; col++) {
+            const double x = (col + 0.5) * cell;
+            uint8_t& value = grid[row * cells + col];
+            if (std::min({x, y, field - x, field - y}) < margin) value = std::min(value, cap);
+        }
+    }
+    return *this;
+}
+
+double Geofence::speed(const Point& position) const {
+    if (std::isnan(position.x) || std::isnan(position.y)) return 100.0;
+    // past the walls reads as the nearest cell
+    const int col = std::clamp((int)floor(position.x / cell), 0, cells - 1);
+    const int row = std::clamp((int)floor(position.y / cell), 0, cells - 1);
+    return grid[row * cells + col];
+}
+
+/* FieldObjects */
+FieldObjects::FieldObjects(double field, double cell)
+    : side(std::max((int)ceil(field / std::max(cell, 1.0)), 1)), cell(std::max(cell, 1.0)) {
+    heads.assign(side * side, -1);
+    next.fill(-1);
+    cells.fill(-1);
+}
+
+// positions off the field are kept in the cells along its edge
+int FieldObjects::cell_of(const Point& position) const {
+    const int x = std::clamp((int)floor(position.x / cell), 0, side - 1);
+    const int y = std::clamp((int)floor(position.y / cell), 0, side - 1);
+    return y * side + x;
+}
+
+void FieldObjects::link(int id) {
+    const int index = cell_of(objects[id].position);
+    cells[id] = index;
+    next[id] = heads[index];
+    heads[index] = id;
+}
+
+void FieldObjects::unlink(int id) {
+    int16_t* at = &heads[cells[id]];
+    while (*at != id) at = &next[*at];
+    *at = next[id];
+    cells[id] = -1;
+}
+
+int FieldObjects::add(const Point& position, int kind) {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    if (!std::isfinite(position.x) || !std::isfinite(position.y)) return -1;
+    for (int id = 0; id < capacity; id++) {
+        if (cells[id] >= 0) continue;
+        objects[id] = {id, position, kind, pros::millis()};
+        link(id);
+        count++;
+        return id;
+    }
+    return -1;
+}
+
+bool FieldObjects::move(int id, const Point& position) {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    if (id < 0 || id >= capacity || cells[id] < 0) return false;
+    if (!std::isfinite(position.x) || !std::isfinite(position.y)) return false;
+    objects[id].position = position;
+    objects[id].time = pros::millis();
+    if (cell_of(position) != cells[id]) {
+        unlink(id);
+        link(id);
+    }
+    return true;
+}
+
+bool FieldObjects::remove(int id) {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    if (id < 0 || id >= capacity || cells[id] < 0) return false;
+    unlink(id);
+    count--;
+    return true;
+}
+
+void FieldObjects::clear() {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    heads.assign(heads.size(), -1);
+    next.fill(-1);
+    cells.fill(-1);
+    count = 0;
+}
+
+int FieldObjects::expire(uint32_t max_age) {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    const uint32_t now = pros::millis();
+    int removed = 0;
+    for (int id = 0; id < capacity; id++) {
+        if (cells[id] < 0 || now - objects[id].time <= max_age) continue;
+        unlink(id);
+        count--;
+        removed++;
+    }
+    return removed;
+}
+
+std::optional<FieldObjects::Object> FieldObjects::get(int id) const {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    if (id < 0 || id >= capacity || cells[id] < 0) return std::nullopt;
+    return objects[id];
+}
+
+size_t FieldObjects::size() const {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    return count;
+}
+
+std::optional<FieldObjects::Object>
+FieldObjects::nearest(const Point& from, int kind, double max_distance,
+                      const std::function<bool(const Object&)>& filter) const {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    if (count == 0 || !std::isfinite(from.x) || !std::isfinite(from.y)) return std::nullopt;
+    const int center = cell_of(from);
+    const int cx = center % side, cy = center / side;
+    int best = -1;
+    double best_distance = max_distance;
+
+    auto visit = [&](int x, int y) {
+        if (x < 0 || x >= side || y < 0 || y >= side) return;
+        for (int id = heads[y * side + x]; id >= 0; id = next[id]) {
+            const Object& object = objects[id];
+            if (kind != any && object.kind != kind) continue;
+            const double distance = from.dist(object.position);
+            if (distance > best_distance || (filter && !filter(object))) continue;
+            best = id;
+            best_distance = distance;
+        }
+    };
+
+    // ring r is the cells r away from the point's cell, so at least r - 1 cells from the point,
+    // and once the best is closer than that neither it nor a ring past it can beat it
+    for (int r = 0; r < side && (r - 1) * cell <= best_distance; r++) {
+        for (int x = cx - r; x <= cx + r; x++) {
+            visit(x, cy - r);
+            if (r > 0) visit(x, cy + r);
+        }
+        for (int y = cy - r + 1; y < cy + r; y++) {
+            visit(cx - r, y);
+            visit(cx + r, y);
+        }
+    }
+    if (best < 0) return std::nullopt;
+    return objects[best];
+}
+
+std::vector<Obstacle> FieldObjects::obstacles(int kind, double radius) const {
+    std::lock_guard<pros::Mutex> lock(mutex);
+    std::vector<Obstacle> found;
+    for (int id = 0; id < capacity; id++) {
+        if (cells[id] >= 0 && (kind == any || objects[id].kind == kind))
+            found.push_back(Obstacle::around(objects[id].position, radius));
+    }
+    return found;
+}
+
+} // namespace appa
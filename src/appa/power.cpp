@@ -0,0 +1,126 @@
+#include "appa.h"
+
+namespace appa {
+
+/* PowerManager */
+PowerManager::PowerManager(int period) : period(std::max(period, 10)) {}
+
+PowerManager::~PowerManager() {
+    if (power_task) {
+        power_task->remove();
+        delete power_task;
+    }
+}
+
+int PowerManager::add(Subsystem subsystem) {
+    if (power_task || count == capacity) {
+        printf("power: can't add motors%s\n", power_task ? " after start" : "");
+        return -1;
+    }
+    for (pros::MotorGroup* group : subsystem.motors)
+        if (group) subsystem.count += group->size();
+    subsystem.count = std::max(subsystem.count, 1);
+    subsystems[count] = subsystem;
+    return count++;
+}
+
+int PowerManager::add(pros::MotorGroup& motors, int priority, double floor) {
+    return add({{&motors, nullptr}, 0, priority, floor});
+}
+
+int PowerManager::add(Chassis& chassis, int priority, double floor) {
+    this->chassis = &chassis;
+    return add({{&chassis.left_motors, &chassis.right_motors}, 0, priority, floor, true});
+}
+
+// below the user's tasks, the loops it serves are in no hurry for a limit a period late
+void PowerManager::start() {
+    if (power_task == nullptr)
+        power_task = start_task([this] { task(); }, task_config, "power_task");
+}
+
+PowerManager::Status PowerManager::get() const { return status.read(); }
+
+void PowerManager::task() {
+    std::array<double, capacity> given; // mA of each group
+    std::array<int, capacity> order;    // groups by priority, highest first
+    while (true) {
+        const double blend = 1 - exp(-period / std::max(smoothing, 1.0));
+        const bool driving = chassis && chassis->active.load() > 0;
+
+        // what each group draws now
+        Status now;
+        now.driving = driving;
+        double floors = 0.0;
+        int motors = 0;
+        for (int i = 0; i < count; i++) {
+            Subsystem& subsystem = subsystems[i];
+            double draw = 0.0;
+            for (pros::MotorGroup* group : subsystem.motors) {
+                if (group == nullptr) continue;
+                for (int j = 0; j < group->size(); j++) {
+                    const int32_t current = group->get_current_draw(j);
+                    if (current != PROS_ERR) draw += abs(current);
+                }
+            }
+            subsystem.draw += (draw - subsystem.draw) * blend;
+            now.draw += subsystem.draw;
+            now.groups[i].draw = subsystem.draw;
+            floors += std::min(subsystem.floor, max_limit) * subsystem.count;
+            motors += subsystem.count;
+            order[i] = i;
+        }
+        auto rank = [&](int i) {
+            return subsystems[i].drive && driving ? INT_MAX : subsystems[i].priority;
+        };
+        std::stable_sort(order.begin(), order.begin() + count,
+                         [&](int a, int b) { return rank(a) > rank(b); });
+
+        // floors first, cut together when they alone are over the budget
+        const double cut = floors > budget ? budget / floors : 1.0;
+        double left = std::max(budget - floors * cut, 0.0);
+        for (int i = 0; i < count; i++)
+            given[i] = std::min(subsystems[i].floor, max_limit) * subsystems[i].count * cut;
+
+        // then what each is drawing and room to speed up, all it can take for a driving drive
+        for (int k = 0; k < count; k++) {
+            const int i = order[k];
+            const Subsystem& subsystem = subsystems[i];
+            const double most = max_limit * subsystem.count;
+            const double want = subsystem.drive && driving
+                                    ? most
+                                    : std::min(subsystem.draw + headroom * subsystem.count, most);
+            const double more = std::clamp(want - given[i], 0.0, left);
+            given[i] += more;
+            left -= more;
+        }
+
+        // and the rest by motors, so a group that starts loading has it before the next period
+        for (int k = 0; k < count && left > 0; k++) {
+            const int i = order[k];
+            const Subsystem& subsystem = subsystems[i];
+            const double share = left * subsystem.count / std::max(motors, 1);
+            const double more = std::clamp(max_limit * subsystem.count - given[i], 0.0, share);
+            given[i] += more;
+            left -= more;
+            motors -= subsystem.count;
+        }
+
+        // only changes, a limit that moved less than 50 mA isn't worth the write
+        for (int i = 0; i < count; i++) {
+            Subsystem& subsystem = subsystems[i];
+            int32_t limit = std::lround(given[i] / subsystem.count);
+            const int32_t hold = subsystem.drive ? chassis->hold_limit.load() : 0;
+            if (hold > 0) limit = std::min(limit, hold);
+            now.groups[i].limit = limit;
+            if (abs(limit - subsystem.written) < 50) continue;
+            subsystem.written = limit;
+            for (pros::MotorGroup* group : subsystem.motors)
+                if (group) group->set_current_limit_all(limit);
+        }
+        status.write(now);
+        pros::delay(period);
+    }
+}
+
+} // namespace appa
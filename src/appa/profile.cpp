@@ -0,0 +1,137 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Trace */
+namespace trace {
+
+std::atomic<bool> recording{false};
+static std::unique_ptr<Event[]> events;
+static size_t capacity = 0;
+static std::atomic<uint32_t> head{0}; // events recorded since start()
+
+// tasks by the index events carry, with their names copied the first time, since a task can be
+// deleted before the trace is saved
+static std::array<std::atomic<pros::task_t>, max_tasks> tasks{};
+static std::array<std::array<char, 32>, max_tasks> names{};
+
+static int task_index() {
+    const pros::task_t self = pros::c::task_get_current();
+    for (int i = 0; i < max_tasks; i++) {
+        pros::task_t task = tasks[i].load(std::memory_order_acquire);
+        if (task == self) return i;
+        if (task != nullptr) continue;
+        // an empty slot, named by the task that claims it
+        if (tasks[i].compare_exchange_strong(task, self, std::memory_order_acq_rel)) {
+            const char* name = pros::c::task_get_name(self);
+            snprintf(names[i].data(), names[i].size(), "%s", name && *name ? name : "task");
+            return i;
+        }
+        if (task == self) return i;
+    }
+    return max_tasks - 1; // shared by every task past the table
+}
+
+void record(const char* name, uint64_t start, uint32_t duration) {
+    const uint32_t index = head.fetch_add(1, std::memory_order_relaxed);
+    events[index % capacity] = {name, start, duration, (uint8_t)task_index()};
+}
+
+void start(size_t capacity) {
+    recording.store(false);
+    if (!events) {
+        trace::capacity = std::max<size_t>(capacity, 16);
+        events = std::make_unique<Event[]>(trace::capacity);
+    }
+    head.store(0);
+    recording.store(true);
+}
+
+void stop() { recording.store(false); }
+
+bool save(const char* file) {
+    stop();
+    pros::delay(2); // for a task that was between the check and its store
+    FILE* out = fopen(file, "w");
+    if (!out) {
+        printf("trace: can't open %s\n", file);
+        return false;
+    }
+    const uint32_t count = head.load();
+    const uint32_t first = count > capacity ? count - capacity : 0;
+    // a row per task, then a complete event per span
+    const char* separator = "";
+    fprintf(out, "{\"traceEvents\":[");
+    for (int i = 0; i < max_tasks && tasks[i].load(); i++) {
+        fprintf(out, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                     "\"args\":{\"name\":\"%s\"}}",
+                separator, i, names[i].data());
+        separator = ",";
+    }
+    for (uint32_t i = first; i < count; i++) {
+        const Event& event = events[i % capacity];
+        fprintf(out,
+                "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%u}",
+                separator, event.name, event.task, (unsigned long long)event.start,
+                (unsigned)event.duration);
+        separator = ",";
+    }
+    fprintf(out, "\n]}\n");
+    const bool written = !ferror(out);
+    fclose(out);
+    printf("trace: %u events to %s%s\n", (unsigned)(count - first), file,
+           first ? ", the earlier ones were overwritten" : "");
+    return written;
+}
+
+} // namespace trace
+
+/* Profile */
+namespace profile {
+
+static std::array<std::atomic<Site*>, max_sites> sites{};
+static std::atomic<int> site_count{0};
+
+Site::Site(const char* name) : name(name) {
+    const int index = site_count.fetch_add(1);
+    if (index < max_sites) sites[index].store(this, std::memory_order_release);
+    else printf("Too many profile scopes, %s is not reported\n", name);
+}
+
+double Stats::mean() const { return count ? (double)total / count : 0; }
+
+std::vector<Stats> get() {
+    std::vector<Stats> stats;
+    const int count = std::min(site_count.load(), max_sites);
+    for (int i = 0; i < count; i++) {
+        const Site* site = sites[i].load(std::memory_order_acquire);
+        if (!site) continue; // still registering
+        stats.push_back({site->name, site->count.load(std::memory_order_relaxed),
+                         site->max.load(std::memory_order_relaxed),
+                         site->total.load(std::memory_order_relaxed)});
+    }
+    return stats;
+}
+
+void print() {
+    const std::vector<Stats> stats = get();
+    if (stats.empty()) printf("No profile scopes have run, build with -DAPPA_PROFILE\n");
+    for (const Stats& s : stats)
+        printf("%-22s %8u calls %9.1f us mean %6u us max %10.1f ms total\n", s.name,
+               (unsigned)s.count, s.mean(), (unsigned)s.max, s.total / 1000.0);
+}
+
+void reset() {
+    const int count = std::min(site_count.load(), max_sites);
+    for (int i = 0; i < count; i++) {
+        Site* site = sites[i].load(std::memory_order_acquire);
+        if (!site) continue;
+        site->count.store(0, std::memory_order_relaxed);
+        site->max.store(0, std::memory_order_relaxed);
+        site->total.store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace profile
+
+} // namespace appa
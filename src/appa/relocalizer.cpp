@@ -0,0 +1,78 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Relocalizer */
+Relocalizer::Relocalizer(OdomBase& odom, std::initializer_list<DistanceSensor> sensors, int period)
+    : odom(odom), period(std::max(5, period)) {
+    for (const DistanceSensor& sensor : sensors) {
+        this->sensors.emplace_back(sensor.port);
+        offsets.push_back({sensor.offset.x, sensor.offset.y, to_rad(sensor.offset.theta)});
+    }
+}
+
+Relocalizer::~Relocalizer() {
+    if (relocalize_task) {
+        relocalize_task->remove();
+        delete relocalize_task;
+    }
+}
+
+void Relocalizer::start() {
+    enabled.store(true);
+    if (relocalize_task == nullptr)
+        relocalize_task = start_task([this] { task(); }, task_config, "relocalize_task");
+}
+
+void Relocalizer::stop() { enabled.store(false); }
+
+uint32_t Relocalizer::corrections() const { return accepted.load(std::memory_order_relaxed); }
+
+bool Relocalizer::relocalize() {
+    // the pose the readings were taken at, a position error is the same now
+    const Pose pose = odom.get_at(pros::micros() - (uint64_t)latency * 1000);
+    double errors[2] = {0.0, 0.0}; // in, summed over the sensors facing x and y walls
+    int counts[2] = {0, 0};
+
+    for (size_t i = 0; i < sensors.size(); i++) {
+        // PROS_ERR when disconnected and 9999 mm with nothing in range
+        const int32_t reading = sensors[i].get_distance();
+        if (reading == PROS_ERR || sensors[i].get_confidence() < min_confidence) continue;
+        const double distance = reading / 25.4; // in
+        if (distance <= 0 || distance > max_distance) continue;
+
+        // only sensors square to a wall, k is the wall it faces: +x, +y, -x then -y
+        const Point sensor = Point(pose) + Point(offsets[i]).rotate(pose.theta);
+        const double beam = pose.theta + offsets[i].theta;
+        const double quarter = std::round(beam / (M_PI / 2));
+        const double skew = beam - quarter * (M_PI / 2);
+        if (fabs(skew) > to_rad(max_angle)) continue;
+        const int k = ((int)quarter % 4 + 4) % 4;
+
+        // where the wall puts the sensor along the wall's normal
+        const double along = distance * cos(skew);
+        const double measured = k < 2 ? field - along : along;
+        const double error = measured - (k % 2 ? sensor.y : sensor.x);
+        if (fabs(error) > max_correction) continue;
+
+        errors[k % 2] += error;
+        counts[k % 2]++;
+        accepted.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // sensors on the same axis are averaged
+    if (!counts[0] && !counts[1]) return false;
+    odom.correct({counts[0] ? gain * errors[0] / counts[0] : 0.0,
+                  counts[1] ? gain * errors[1] / counts[1] : 0.0, 0.0});
+    return true;
+}
+
+void Relocalizer::task() {
+    uint32_t now = pros::millis();
+    while (true) {
+        if (enabled.load()) relocalize();
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+} // namespace appa
@@ -0,0 +1,87 @@
+#include "appa.h"
+
+namespace appa {
+
+/* DriveRecorder */
+DriveRecorder::DriveRecorder(OdomBase& odom, Chassis* chassis, uint32_t max_time, int period)
+    : odom(odom),
+      chassis(chassis),
+      period(std::max(1, period)),
+      capacity(max_time / std::max(1, period) + 1) {
+    // allocated once, so recording never reallocates
+    samples.reserve(capacity);
+    commands.reserve(capacity);
+}
+
+DriveRecorder::~DriveRecorder() {
+    if (record_task) {
+        record_task->remove();
+        delete record_task;
+    }
+}
+
+void DriveRecorder::start() {
+    std::lock_guard<pros::Mutex> lock(record_mutex);
+    samples.clear();
+    commands.clear();
+    recording.store(true);
+    if (record_task == nullptr)
+        record_task = start_task([this] { task(); }, task_config, "drive_recorder_task");
+}
+
+void DriveRecorder::stop() { recording.store(false); }
+bool DriveRecorder::is_recording() const { return recording.load(); }
+
+void DriveRecorder::task() {
+    uint32_t now = pros::millis(), start_time = now;
+    bool was_recording = false;
+    while (true) {
+        const bool active = recording.load();
+        if (active && !was_recording) start_time = now;
+        was_recording = active;
+        if (active) {
+            const Pose pose = odom.get();
+            const Twist twist = odom.get_velocity(true);
+            const Point command = chassis ? chassis->get_command() : Point{0.0, 0.0};
+            std::lock_guard<pros::Mutex> lock(record_mutex);
+            if (samples.size() < capacity) {
+                const double time = (now - start_time) / 1000.0;
+                samples.push_back({time, pose, twist.vel.x, twist.vel.theta});
+                commands.push_back(command);
+            } else {
+                printf("DriveRecorder is full after %.1f s\n", samples.back().time);
+                recording.store(false);
+            }
+        }
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+Trajectory DriveRecorder::trajectory() {
+    std::lock_guard<pros::Mutex> lock(record_mutex);
+    auto moving = [](const TrajectorySample& s) {
+        return fabs(s.velocity) > 0.5 || fabs(s.omega) > 0.05; // in/s, rad/s
+    };
+    size_t first = 0, last = samples.size();
+    while (first < last && !moving(samples[first])) first++;
+    while (last > first && !moving(samples[last - 1])) last--;
+    if (first == last) return Trajectory(std::vector<TrajectorySample>{});
+
+    // keep the still samples either side, the start and end of the movement
+    first = first > 0 ? first - 1 : 0;
+    last = std::min(last + 1, samples.size());
+    std::vector<TrajectorySample> moved(samples.begin() + first, samples.begin() + last);
+    const double offset = moved.front().time;
+    for (TrajectorySample& sample : moved) sample.time -= offset;
+    return Trajectory(moved);
+}
+
+std::vector<Point> DriveRecorder::get_commands() {
+    std::lock_guard<pros::Mutex> lock(record_mutex);
+    return commands;
+}
+
+// a trajectory file that Trajectory::load reads back
+bool DriveRecorder::save(const char* name) { return trajectory().save(name); }
+
+} // namespace appa
@@ -0,0 +1,134 @@
+#include "routine.h"
+
+namespace appa {
+
+/* Routine */
+Routine Routine::promise_type::get_return_object() { return Routine(Handle::from_promise(*this)); }
+
+// hands back to the awaiting routine, or for a when_all to the routine awaiting all of them once
+// the last one ends
+std::coroutine_handle<>
+Routine::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+    promise_type& promise = h.promise();
+    if (promise.pending && --*promise.pending > 0) return std::noop_coroutine();
+    if (promise.continuation) return promise.continuation;
+    return std::noop_coroutine();
+}
+
+#ifdef APPA_NO_HEAP
+// a bit per frame, taken and given back without a lock so any task can start a routine
+alignas(alignof(std::max_align_t)) static unsigned char
+    frames[Routine::promise_type::frame_count][Routine::promise_type::frame_size];
+static std::atomic<uint32_t> frames_used{0};
+static_assert(Routine::promise_type::frame_count <= 32, "one bit per frame");
+
+void* Routine::promise_type::operator new(size_t size) noexcept {
+    if (size > frame_size) {
+        printf("routine: its frame is %u bytes, more than %u\n", (unsigned)size,
+               (unsigned)frame_size);
+        return nullptr;
+    }
+    uint32_t used = frames_used.load();
+    while (true) {
+        int free = 0;
+        while (free < frame_count && (used >> free & 1)) free++;
+        if (free == frame_count) {
+            printf("routine: all %d frames are in use\n", frame_count);
+            return nullptr;
+        }
+        if (frames_used.compare_exchange_weak(used, used | 1u << free)) return frames[free];
+    }
+}
+
+void Routine::promise_type::operator delete(void* frame) {
+    const int index = (static_cast<unsigned char*>(frame) - frames[0]) / frame_size;
+    frames_used.fetch_and(~(1u << index));
+}
+
+Routine Routine::promise_type::get_return_object_on_allocation_failure() {
+    return Routine(nullptr);
+}
+#endif
+
+Routine::Routine(Handle handle) : handle(handle) {}
+Routine::Routine(Routine&& other) : handle(std::exchange(other.handle, nullptr)) {}
+Routine& Routine::operator=(Routine&& other) {
+    if (this != &other) {
+        if (handle) handle.destroy();
+        handle = std::exchange(other.handle, nullptr);
+    }
+    return *this;
+}
+Routine::~Routine() {
+    if (handle) handle.destroy();
+}
+
+bool Routine::done() const { return !handle || handle.done(); }
+
+std::coroutine_handle<> Routine::Awaiter::await_suspend(Handle parent) {
+    handle.promise().runner = parent.promise().runner;
+    handle.promise().continuation = parent;
+    return handle;
+}
+
+Routine::Awaiter Routine::operator co_await() const { return {handle}; }
+
+Routine step(Routine routine) { return routine; }
+Routine step(Chassis::MotionResult motion) { co_await motion; }
+
+/* Runner */
+Runner::Runner(Chassis& chassis, int period) : chassis(chassis), period(std::max(period, 1)) {}
+
+void Runner::wait(Waiter* waiter) {
+    waiter->next = nullptr;
+    if (tail) tail->next = waiter;
+    else head = waiter;
+    tail = waiter;
+}
+
+Chassis& Runner::get_chassis() { return chassis; }
+
+void Runner::run(Routine routine) {
+    if (routine.done()) return;
+    const pros::task_t previous = chassis.routine_task.exchange(pros::c::task_get_current());
+    routine.handle.promise().runner = this;
+    routine.handle.resume();
+
+    // each tick resumes the waiters that are ready in the order they started waiting. a resumed
+    // routine that waits again goes on the new list, so it is checked next tick
+    uint32_t now = pros::millis();
+    while (!routine.done()) {
+        pros::c::task_delay_until(&now, period);
+        Waiter* waiter = head;
+        head = tail = nullptr;
+        while (waiter) {
+            Waiter* next = waiter->next;
+            if (waiter->ready()) waiter->handle.resume();
+            else wait(waiter);
+            waiter = next;
+        }
+    }
+    head = tail = nullptr;
+    chassis.routine_task.store(previous);
+}
+
+/* Awaitables */
+void MotionAwaiter::await_suspend(Routine::Handle h) {
+    handle = h;
+    chassis = &h.promise().runner->get_chassis();
+    h.promise().runner->wait(this);
+}
+
+bool MotionAwaiter::ready() { return chassis->finished(result.id); }
+
+// the result the motion ended with, or cancelled when it was dropped before it ran
+Chassis::MotionResult MotionAwaiter::await_resume() {
+    if (!chassis) return result;
+    Chassis::MotionResult last = chassis->get_result();
+    if (last.id == result.id) return last;
+    last = {Chassis::CANCELLED};
+    last.id = result.id;
+    return last;
+}
+
+} // namespace appa
@@ -0,0 +1,57 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Scheduler */
+Scheduler::Scheduler(OdomBase& odom) : odom(odom) {}
+
+Scheduler::~Scheduler() {
+    if (scheduler_task) {
+        odom.unsubscribe((pros::task_t)*scheduler_task);
+        scheduler_task->remove();
+        delete scheduler_task;
+    }
+}
+
+bool Scheduler::add(Update update, int every) {
+    if (scheduler_task || count == capacity || !update) {
+        printf("scheduler: can't add a subsystem%s\n", scheduler_task ? " after start" : "");
+        return false;
+    }
+    subsystems[count++] = {std::move(update), std::max(every, 1)};
+    return true;
+}
+
+// just below the odom, so a tick runs as soon as the odom loop that woke it is done
+void Scheduler::start() {
+    if (scheduler_task == nullptr)
+        scheduler_task = start_task([this] { task(); }, task_config, "scheduler_task");
+}
+
+LoopTiming Scheduler::get_timing() { return timing.read(); }
+
+void Scheduler::task() {
+    odom.subscribe(pros::c::task_get_current());
+    LoopTiming loop;
+    uint64_t prev_time = 0;
+    for (uint32_t tick = 0;; tick++) {
+        // a stopped or failed odom still ticks, a period late
+        pros::c::task_notify_take(true, 2 * OdomBase::period);
+        const uint64_t time = pros::micros();
+        for (int i = 0; i < count; i++) {
+            Subsystem& subsystem = subsystems[i];
+            if (tick % subsystem.every) continue;
+            const double dt = subsystem.last ? (time - subsystem.last) / 1000.0
+                                             : subsystem.every * (double)OdomBase::period;
+            subsystem.last = time;
+            subsystem.update(dt);
+        }
+        const uint32_t busy = pros::micros() - time;
+        APPA_TRACE_SPAN("scheduler tick", time);
+        loop.record(prev_time ? time - prev_time : 0, busy, OdomBase::period * 1000);
+        timing.write(loop);
+        prev_time = time;
+    }
+}
+
+} // namespace appa
@@ -0,0 +1,152 @@
+#include "script.h"
+
+namespace appa {
+
+/* Script */
+Script::Script(Chassis& chassis) : chassis(chassis) {}
+
+Script& Script::action(const char* name, Action action) {
+    actions.push_back({name, std::move(action)});
+    return *this;
+}
+
+// sets the option an OPTION record holds, false for a key this version doesn't know
+static bool apply(Options& options, const ScriptRecord& record) {
+    switch (record.key) {
+    case ScriptRecord::SPEED:
+        options.speed = record.values[0];
+        break;
+    case ScriptRecord::ACCEL:
+        options.accel = record.values[0];
+        break;
+    case ScriptRecord::DECEL:
+        options.decel = record.values[0];
+        break;
+    case ScriptRecord::LEAD:
+        options.lead = record.values[0];
+        break;
+    case ScriptRecord::LOOKAHEAD:
+        options.lookahead = record.values[0];
+        break;
+    case ScriptRecord::EXIT:
+        options.exit = record.values[0];
+        break;
+    case ScriptRecord::EXIT_SPEED:
+        options.exit_speed = record.values[0];
+        break;
+    case ScriptRecord::SETTLE:
+        options.settle = record.values[0];
+        break;
+    case ScriptRecord::TIMEOUT:
+        options.timeout = record.values[0];
+        break;
+    case ScriptRecord::DIR:
+        options.dir = (Direction)record.values[0];
+        break;
+    case ScriptRecord::ASYNC:
+        options.async = record.values[0] != 0;
+        break;
+    case ScriptRecord::THRU:
+        options.thru = record.values[0] != 0;
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+bool Script::load(const char* file) {
+    steps.clear();
+    motions.clear();
+    std::vector<ScriptRecord> records;
+    if (!file::read(file, file::script_magic, records)) return false;
+
+    Options options; // of the next motion, from the OPTION records before it
+    auto add = [&](Chassis::Prepared prepared) {
+        steps.push_back({Step::MOTION, (uint32_t)motions.size()});
+        motions.push_back(std::move(prepared));
+        options = {};
+    };
+    for (size_t i = 0; i < records.size(); i++) {
+        const ScriptRecord& record = records[i];
+        const float* v = record.values;
+        switch (record.op) {
+        case ScriptRecord::MOVE:
+            add(chassis.prepare_move(v[0], options));
+            break;
+        case ScriptRecord::MOVE_TO:
+            add(chassis.prepare_move({v[0], v[1]}, options));
+            break;
+        case ScriptRecord::MOVE_POSE:
+            add(chassis.prepare_move({v[0], v[1], v[2]}, options));
+            break;
+        case ScriptRecord::TURN:
+            add(chassis.prepare_turn(v[0], options));
+            break;
+        case ScriptRecord::TURN_TO:
+            add(chassis.prepare_turn({v[0], v[1]}, options));
+            break;
+        case ScriptRecord::ARC:
+            add(chassis.prepare_arc(v[0], v[1], options));
+            break;
+        case ScriptRecord::FOLLOW: {
+            std::vector<Point> points;
+            for (; i + 1 < records.size() && records[i + 1].op == ScriptRecord::POINT; i++)
+                points.push_back({records[i + 1].values[0], records[i + 1].values[1]});
+            if (points.size() != record.count) printf("%s: a follow is missing points\n", file);
+            add(chassis.prepare_follow(points, options));
+            break;
+        }
+        case ScriptRecord::WAIT:
+            steps.push_back({Step::WAIT, 0});
+            break;
+        case ScriptRecord::DELAY:
+            steps.push_back({Step::DELAY, (uint32_t)std::max(v[0], 0.0f)});
+            break;
+        case ScriptRecord::ACTION: {
+            const std::string name(record.name, strnlen(record.name, sizeof(record.name)));
+            auto found = std::find_if(actions.begin(), actions.end(),
+                                      [&](const Named& named) { return named.name == name; });
+            if (found == actions.end()) {
+                printf("%s: no action named %s\n", file, name.c_str());
+                steps.clear();
+                motions.clear();
+                return false;
+            }
+            steps.push_back({Step::ACTION, (uint32_t)(found - actions.begin())});
+            break;
+        }
+        case ScriptRecord::OPTION:
+            if (!apply(options, record)) printf("%s: unknown option %d\n", file, record.key);
+            break;
+        default:
+            printf("%s: unknown instruction %d\n", file, record.op);
+        }
+    }
+    return true;
+}
+
+Chassis::MotionResult Script::run() {
+    Chassis::MotionResult result;
+    for (const Step& step : steps) {
+        switch (step.kind) {
+        case Step::MOTION:
+            result = chassis.run(motions[step.index]);
+            break;
+        case Step::WAIT:
+            result = chassis.wait();
+            break;
+        case Step::DELAY:
+            pros::delay(step.index);
+            break;
+        case Step::ACTION:
+            actions[step.index].action();
+            break;
+        }
+    }
+    return result;
+}
+
+size_t Script::size() const { return steps.size(); }
+
+} // namespace appa
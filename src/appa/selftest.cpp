@@ -0,0 +1,99 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Self test */
+// mean period of the iterations between two snapshots, ms
+static double mean_period(const LoopTiming& before, const LoopTiming& after) {
+    const uint32_t count = after.count - before.count;
+    return count > 0 ? (after.total_period - before.total_period) / 1000.0 / count : NAN;
+}
+
+SelfTest self_test(Chassis& chassis, OdomBase& odom, const SelfTestLimits& limits, double speed) {
+    SelfTest result;
+    chassis.stop(true);
+    const pros::task_t current = pros::c::task_get_current();
+    pros::c::task_notify_clear(current);
+    odom.subscribe(current);
+
+    // odom loop, idle
+    const LoopTiming odom_before = odom.get_timing();
+    pros::delay(500);
+
+    // drives the sides for ms, on every odom loop noting the first motor and heading movement and
+    // each new heading and tick reading
+    int headings = 0, ticks = 0;
+    uint32_t moving_time = 0; // ms driven
+    auto drive = [&](double left, double right, uint32_t ms, bool timed) {
+        const Pose start = odom.get_raw();
+        double heading = start.theta;
+        Point tick = odom.get_ticks();
+        const uint64_t commanded = pros::micros();
+        chassis.tank(left, right);
+        while (pros::micros() - commanded < ms * 1000) {
+            pros::c::task_notify_take(true, 2 * OdomBase::period);
+            const double elapsed = (pros::micros() - commanded) / 1000.0;
+            const Point wheels = chassis.get_velocity();
+            if (timed && std::isnan(result.motor_latency) &&
+                std::max(fabs(wheels.left), fabs(wheels.right)) > 2.0)
+                result.motor_latency = elapsed;
+            const Pose pose = odom.get_raw();
+            if (timed && std::isnan(result.motion_latency) &&
+                fabs(wrap(pose.theta - start.theta)) > to_rad(0.5))
+                result.motion_latency = elapsed;
+            if (timed && pose.theta != heading) headings++;
+            heading = pose.theta;
+            const Point next = odom.get_ticks();
+            if (next.x != tick.x || next.y != tick.y) ticks++;
+            tick = next;
+        }
+        moving_time += ms;
+        if (timed && std::isnan(result.motor_latency)) result.motor_latency = INFINITY;
+        if (timed && std::isnan(result.motion_latency)) result.motion_latency = INFINITY;
+        chassis.tank(0, 0);
+        pros::delay(300);
+    };
+    const Pose start = odom.get();
+    drive(-speed, speed, 600, true);
+    result.heading_interval = headings > 0 ? 600.0 / headings : INFINITY;
+    drive(speed, speed, 600, false);
+    drive(-speed, -speed, 600, false);
+    const LoopTiming odom_after = odom.get_timing();
+    odom.unsubscribe(current);
+    result.odom_period = mean_period(odom_before, odom_after);
+    if (!std::isnan(odom.get_ticks().x) || !std::isnan(odom.get_ticks().y))
+        result.tracker_interval = ticks > 0 ? (double)moving_time / ticks : INFINITY;
+
+    // control loop, turning back with a motion
+    const LoopTiming chassis_before = chassis.get_timing();
+    chassis.turn(to_deg(wrap(start.theta - odom.get().theta)),
+                 {.speed = speed, .timeout = 2000, .relative = true, .async = false});
+    const LoopTiming chassis_after = chassis.get_timing();
+    result.chassis_period = mean_period(chassis_before, chassis_after);
+    result.overruns = odom_after.overruns - odom_before.overruns + chassis_after.overruns -
+                      chassis_before.overruns;
+
+    // each value against its limit, unmeasured ones pass
+    result.passed = true;
+    auto check = [&](const char* name, double value, double limit) {
+        const bool pass = !(value > limit);
+        result.passed &= pass;
+        if (std::isnan(value)) printf("self test: %-16s not measured\n", name);
+        else printf("self test: %-16s %6.1f ms (limit %.1f) %s\n", name, value, limit,
+                    pass ? "pass" : "FAIL");
+    };
+    check("odom period", result.odom_period, limits.odom_period);
+    check("control period", result.chassis_period, limits.chassis_period);
+    check("heading interval", result.heading_interval, limits.heading_interval);
+    check("tracker interval", result.tracker_interval, limits.tracker_interval);
+    check("motor latency", result.motor_latency, limits.motor_latency);
+    check("motion latency", result.motion_latency, limits.motion_latency);
+    const bool overruns = result.overruns <= limits.overruns;
+    result.passed &= overruns;
+    printf("self test: %-16s %6u (limit %u) %s\n", "overruns", (unsigned)result.overruns,
+           (unsigned)limits.overruns, overruns ? "pass" : "FAIL");
+    printf("self test: %s\n", result.passed ? "passed" : "FAILED");
+    return result;
+}
+
+} // namespace appa
@@ -0,0 +1,147 @@
+#include "appa.h"
+#include <algorithm>
+#if defined(__ARM_NEON) && defined(APPA_SINGLE_PRECISION)
+#include <arm_neon.h>
+#define APPA_NEON
+#endif
+
+namespace appa {
+
+/* Spline */
+Spline::Spline(const std::vector<Waypoint>& waypoints) {
+    points.reserve(waypoints.size());
+    for (auto& waypoint : waypoints) {
+        points.push_back(waypoint.point);
+    }
+    build_tangents(waypoints);
+    build_lengths();
+}
+
+// given headings keep the chord length as magnitude, otherwise catmull-rom
+void Spline::build_tangents(const std::vector<Waypoint>& waypoints) {
+    const int n = points.size();
+    tangents.assign(n, {0.0, 0.0});
+    for (int i = 0; i < n && n > 1; i++) {
+        const Point prev = points[std::max(i - 1, 0)];
+        const Point next = points[std::min(i + 1, n - 1)];
+        const double scale = (i == 0 || i == n - 1) ? 1.0 : 0.5;
+        if (std::isnan(waypoints[i].heading)) {
+            tangents[i] = (next - prev) * scale;
+        } else {
+            const double heading = to_rad(waypoints[i].heading);
+            const double magnitude = prev.dist(next) * scale;
+            tangents[i] = Point{cos(heading), sin(heading)} * magnitude;
+        }
+    }
+}
+
+// cumulative arc length at evenly spaced parameters of each segment
+void Spline::build_lengths() {
+    lengths.clear();
+    double length = 0.0;
+    std::array<Point, samples_per_segment + 1> samples;
+    for (int segment = 0; segment + 1 < points.size(); segment++) {
+        positions(segment, samples.data());
+        lengths.push_back(length);
+        for (int i = 1; i <= samples_per_segment; i++) {
+            length += samples[i].dist(samples[i - 1]);
+            lengths.push_back(length);
+        }
+    }
+}
+
+// the position at each arc length sample of a segment, four at a time with neon
+void Spline::positions(int segment, Point* out) const {
+    int i = 0;
+#ifdef APPA_NEON
+    const Point p0 = points[segment], m0 = tangents[segment];
+    const Point p1 = points[segment + 1], m1 = tangents[segment + 1];
+    const float32x4_t four = vdupq_n_f32(4.0f), one = vdupq_n_f32(1.0f);
+    float32x4_t index = {0.0f, 1.0f, 2.0f, 3.0f};
+    for (; i + 4 <= samples_per_segment + 1; i += 4, index = vaddq_f32(index, four)) {
+        const float32x4_t t = vmulq_n_f32(index, 1.0f / samples_per_segment);
+        const float32x4_t t2 = vmulq_f32(t, t), t3 = vmulq_f32(t2, t);
+        // hermite basis, the same as position()
+        const float32x4_t h01 = vmlsq_n_f32(vmulq_n_f32(t2, 3.0f), t3, 2.0f);
+        const float32x4_t h00 = vsubq_f32(one, h01);
+        const float32x4_t h11 = vsubq_f32(t3, t2);
+        const float32x4_t h10 = vaddq_f32(vsubq_f32(h11, t2), t);
+        float32x4x2_t v;
+        v.val[0] = vmlaq_n_f32(vmulq_n_f32(h00, p0.x), h10, m0.x);
+        v.val[0] = vmlaq_n_f32(vmlaq_n_f32(v.val[0], h01, p1.x), h11, m1.x);
+        v.val[1] = vmlaq_n_f32(vmulq_n_f32(h00, p0.y), h10, m0.y);
+        v.val[1] = vmlaq_n_f32(vmlaq_n_f32(v.val[1], h01, p1.y), h11, m1.y);
+        vst2q_f32(&out[i].x, v);
+    }
+#endif
+    for (; i <= samples_per_segment; i++) {
+        out[i] = position(segment, (double)i / samples_per_segment);
+    }
+}
+
+Point Spline::position(int segment, double t) const {
+    const double t2 = t * t, t3 = t2 * t;
+    return points[segment] * (2 * t3 - 3 * t2 + 1) + tangents[segment] * (t3 - 2 * t2 + t) +
+           points[segment + 1] * (-2 * t3 + 3 * t2) + tangents[segment + 1] * (t3 - t2);
+}
+
+Point Spline::derivative(int segment, double t) const {
+    const double t2 = t * t;
+    return points[segment] * (6 * t2 - 6 * t) + tangents[segment] * (3 * t2 - 4 * t + 1) +
+           points[segment + 1] * (-6 * t2 + 6 * t) + tangents[segment + 1] * (3 * t2 - 2 * t);
+}
+
+Point Spline::second_derivative(int segment, double t) const {
+    return points[segment] * (12 * t - 6) + tangents[segment] * (6 * t - 4) +
+           points[segment + 1] * (-12 * t + 6) + tangents[segment + 1] * (6 * t - 2);
+}
+
+double Spline::length() const { return lengths.empty() ? 0.0 : lengths.back(); }
+
+Pose Spline::pose(double distance, real& curvature) const {
+    // invert the arc length table
+    const int found = std::upper_bound(lengths.begin(), lengths.end(), distance) - lengths.begin();
+    const int index = std::clamp(found - 1, 0, (int)lengths.size() - 2);
+    const int segment = std::min(index / (samples_per_segment + 1), (int)points.size() - 2);
+    const int base = segment * (samples_per_segment + 1);
+    const int step = std::clamp(index - base, 0, samples_per_segment - 1);
+    const double span = lengths[base + step + 1] - lengths[base + step];
+    const double fraction =
+        span > 0 ? std::clamp((distance - lengths[base + step]) / span, 0.0, 1.0) : 0.0;
+    const double t = (step + fraction) / samples_per_segment;
+
+    // heading and signed curvature from the derivatives
+    const Point d1 = derivative(segment, t), d2 = second_derivative(segment, t);
+    const double speed = sqrt(d1.x * d1.x + d1.y * d1.y);
+    curvature = speed > 0 ? (d1.x * d2.y - d1.y * d2.x) / (speed * speed * speed) : 0.0;
+    return {position(segment, t), atan2(d1.y, d1.x)};
+}
+
+// evaluates the spline once into headings and curvatures, so the follower never does
+Path Spline::sample(double spacing, double cell_size, const PathProfile& profile) const {
+    std::vector<Pose> poses;
+    std::vector<double> curvatures;
+    if (points.size() < 2 || spacing <= 0) {
+        for (auto& point : points) {
+            poses.push_back({point, 0.0});
+        }
+        return Path(poses, curvatures, cell_size, profile);
+    }
+
+    const int count = std::max(2, (int)ceil(length() / spacing) + 1);
+    poses.reserve(count);
+    curvatures.reserve(count);
+    for (int i = 0; i < count; i++) {
+        real curvature;
+        poses.push_back(pose(std::min(length(), i * length() / (count - 1)), curvature));
+        curvatures.push_back(curvature);
+    }
+    return Path(poses, curvatures, cell_size, profile);
+}
+
+Path Spline::lazy(double spacing, double cell_size, const PathProfile& profile) const {
+    if (points.size() < 2 || spacing <= 0) return sample(spacing, cell_size, profile);
+    return Path(*this, spacing, cell_size, profile);
+}
+
+} // namespace appa
@@ -0,0 +1,338 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Channel */
+Channel::Channel(Format format) : format(format) {}
+
+// never blocks the producer, records are dropped when the queue is full
+void Channel::push(const Record& record) {
+    if (!queue.push(record)) drops.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Channel::drain() {
+    Record record;
+    bool drained = false;
+    while (queue.pop(record)) {
+        format(record);
+        drained = true;
+    }
+    return drained;
+}
+
+uint32_t Channel::dropped() const { return drops.load(std::memory_order_relaxed); }
+
+/* Telemetry */
+namespace telemetry {
+
+static std::array<std::atomic<Channel*>, 8> channels{};
+static pros::Task* telemetry_task = nullptr;
+TaskConfig task_config = {TASK_PRIORITY_MIN};
+static pros::Mutex telemetry_mutex;
+
+void add(Channel& channel) {
+    std::lock_guard<pros::Mutex> lock(telemetry_mutex);
+    for (auto& slot : channels) {
+        if (slot.load() == &channel) return;
+        if (slot.load() == nullptr) {
+            slot.store(&channel);
+            break;
+        }
+    }
+    if (telemetry_task == nullptr)
+        telemetry_task = start_task(task, task_config, "telemetry_task");
+}
+
+void task() {
+    while (true) {
+        bool drained = false;
+        for (auto& slot : channels) {
+            Channel* channel = slot.load();
+            if (channel && channel->drain()) drained = true;
+        }
+        if (drained) fflush(stdout);
+        pros::delay(20);
+    }
+}
+
+} // namespace telemetry
+
+/* Recorder */
+Recorder::Recorder(const char* name, Output output, int reserve) : name(name), output(output) {
+    samples.reserve(reserve);
+}
+
+Recorder::~Recorder() {
+    if (recorder_task) {
+        recorder_task->remove();
+        delete recorder_task;
+    }
+}
+
+void Recorder::start() {
+    std::lock_guard<pros::Mutex> lock(recorder_mutex);
+    if (recorder_task == nullptr)
+        recorder_task = start_task([this] { task(); }, task_config, "recorder_task");
+}
+
+// called by the motion task, never blocks and drops the sample when the queue is full
+void Recorder::push(const MotionRecord& sample) {
+    if (!queue.push(sample)) drops.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t Recorder::dropped() const { return drops.load(std::memory_order_relaxed); }
+
+uint32_t Recorder::written() const { return count.load(); }
+
+void Recorder::task() {
+    while (true) {
+        MotionRecord sample;
+        while (queue.pop(sample)) {
+            // a sample from a new command also ends the motion, in case its last one was dropped
+            if (!samples.empty() && samples.back().id != sample.id) write();
+            samples.push_back(sample);
+            if (sample.result != 0) write();
+        }
+        pros::delay(20);
+    }
+}
+
+void Recorder::write() {
+    char file_name[64];
+    snprintf(file_name, sizeof(file_name), "%s_%u.%s", name, (unsigned)count.fetch_add(1),
+             output == BINARY ? "bin" : "csv");
+    if (output == BINARY) {
+        file::write(file_name, file::recording_magic, samples.data(), samples.size());
+        samples.clear();
+        return;
+    }
+
+    FILE* file = output == SERIAL ? stdout : fopen(file_name, "w");
+    if (!file) {
+        printf("Could not open %s for writing\n", file_name);
+        samples.clear();
+        return;
+    }
+    if (output == SERIAL) fprintf(file, "%s\n", file_name);
+    fprintf(file, "id,time,motion,result,settling,target_x,target_y,target_theta,x,y,theta,"
+                  "error_linear,error_angular,lin_p,lin_i,lin_d,ang_p,ang_i,ang_d,command_left,"
+                  "command_right,velocity_linear,velocity_angular\n");
+    for (const MotionRecord& s : samples) {
+        fprintf(file,
+                "%u,%u,%u,%u,%u,%.3f,%.3f,%.4f,%.3f,%.3f,%.4f,%.3f,%.4f,%.2f,%.2f,%.2f,%.2f,%.2f,"
+                "%.2f,%.2f,%.2f,%.2f,%.4f\n",
+                (unsigned)s.id, (unsigned)s.time, s.motion, s.result, s.settling, s.target_x,
+                s.target_y, s.target_theta, s.x, s.y, s.theta, s.error_linear, s.error_angular,
+                s.lin_p, s.lin_i, s.lin_d, s.ang_p, s.ang_i, s.ang_d, s.command_left,
+                s.command_right, s.velocity_linear, s.velocity_angular);
+    }
+    if (output == SERIAL) fflush(file);
+    else fclose(file);
+    samples.clear();
+}
+
+/* Log */
+Log::Log(const char* name, size_t max_size, int blocks)
+    : blocks(new Block[std::clamp(blocks, 2, max_blocks)]), name(name), max_size(max_size) {
+    for (int i = 0; i < std::clamp(blocks, 2, max_blocks); i++) free.push(i);
+}
+
+Log::~Log() {
+    if (log_task) {
+        log_task->remove();
+        delete log_task;
+    }
+    if (file) fclose(file);
+}
+
+void Log::start() {
+    std::lock_guard<pros::Mutex> lock(log_mutex);
+    if (log_task == nullptr)
+        log_task = start_task([this] { task(); }, task_config, "log_task");
+}
+
+// makes room for size bytes in the current block, must be called with log_mutex held
+bool Log::reserve(size_t size) {
+    if (current >= 0 && blocks[current].size + size <= block_size) return true;
+    if (current >= 0) full.push(current); // never full, it holds every block
+    current = -1;
+    uint8_t next;
+    if (!free.pop(next)) return false;
+    current = next;
+    blocks[current].size = blocks[current].records = 0;
+    blocks[current].time = pros::millis();
+    return true;
+}
+
+bool Log::write(const void* data, size_t size) {
+    if (size > block_size || !log_mutex.take(0)) {
+        drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    const bool ok = reserve(size);
+    if (ok) {
+        Block& block = blocks[current];
+        memcpy(block.data + block.size, data, size);
+        block.size += size;
+        block.records++;
+    } else drops.fetch_add(1, std::memory_order_relaxed);
+    log_mutex.give();
+    return ok;
+}
+
+// formats straight into the current block, moving on to the next one if it doesn't fit
+bool Log::print(const char* format, ...) {
+    if (!log_mutex.take(0)) {
+        drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    bool ok = false;
+    while (!ok && reserve(1)) {
+        Block& block = blocks[current];
+        const size_t room = block_size - block.size;
+        va_list args;
+        va_start(args, format);
+        const int length = vsnprintf(block.data + block.size, room, format, args);
+        va_end(args);
+        if (length < 0 || (size_t)length >= block_size) break; // longer than a whole block
+        if ((size_t)length < room) {
+            block.size += length;
+            block.records++;
+            ok = true;
+        } else if (!reserve(room + 1)) break; // hands the block over and starts the next
+    }
+    if (!ok) drops.fetch_add(1, std::memory_order_relaxed);
+    log_mutex.give();
+    return ok;
+}
+
+uint32_t Log::dropped() const { return drops.load(std::memory_order_relaxed); }
+
+void Log::task() {
+    // continue the numbering of the files already there
+    char file_name[64];
+    while (strchr(name, '%')) {
+        snprintf(file_name, sizeof(file_name), name, (unsigned)index);
+        FILE* existing = fopen(file_name, "r");
+        if (!existing) break;
+        fclose(existing);
+        index++;
+    }
+
+    const uint32_t flush_interval = 250; // ms a partly filled block waits before it is written
+    while (true) {
+        log_mutex.take();
+        if (current >= 0 && blocks[current].size > 0 &&
+            pros::millis() - blocks[current].time >= flush_interval) {
+            full.push(current);
+            current = -1;
+        }
+        log_mutex.give();
+
+        uint8_t next;
+        bool wrote = false;
+        while (full.pop(next)) {
+            write(blocks[next]);
+            free.push(next);
+            wrote = true;
+        }
+        if (wrote && file) fflush(file);
+        pros::delay(10);
+    }
+}
+
+void Log::write(Block& block) {
+    if (file && file_size + block.size > max_size) {
+        fclose(file);
+        file = nullptr;
+        index++;
+    }
+    if (!file) {
+        char file_name[64];
+        snprintf(file_name, sizeof(file_name), name, (unsigned)index);
+        file = fopen(file_name, "w");
+        file_size = 0;
+        if (!file && !open_failed) printf("Could not open %s for writing\n", file_name);
+        open_failed = !file; // reported once until a file opens again
+    }
+    if (file && fwrite(block.data, 1, block.size, file) == block.size) file_size += block.size;
+    else drops.fetch_add(block.records, std::memory_order_relaxed);
+}
+
+/* OdomRecorder */
+OdomRecorder::OdomRecorder(const char* name, size_t max_size) : log(name, max_size) {}
+
+void OdomRecorder::start() { log.start(); }
+
+bool OdomRecorder::push(const OdomRecord& record) { return log.write(&record, sizeof(record)); }
+
+void OdomRecorder::truth(const Pose& pose) {
+    const OdomRecord record = {
+        .time = 0, .kind = OdomRecord::TRUTH, .values = {pose.x, pose.y, to_rad(pose.theta), 0.0}};
+    // the loop may still be writing its last sample
+    for (int i = 0; i < 10 && !push(record); i++) pros::delay(1);
+}
+
+uint32_t OdomRecorder::dropped() const { return log.dropped(); }
+
+/* PerformanceLog */
+PerformanceLog::PerformanceLog(const char* name, size_t max_size)
+    : log(name, max_size), name(name) {}
+
+// the bin of a kind of motion and the power of two its extent is in
+static int performance_bin(uint8_t motion, double extent) {
+    const int size = extent < 2 ? 0 : std::min((int)log2(extent), PerformanceLog::sizes - 1);
+    return std::min<int>(motion, PerformanceLog::kinds - 1) * PerformanceLog::sizes + size;
+}
+
+// only motions that settled say how long one takes, a timeout is the timeout's own length
+void PerformanceLog::add(const PerformanceRecord& record) {
+    if (record.result != Chassis::SETTLED || !std::isfinite(record.extent)) return;
+    Durations& bin = durations[performance_bin(record.motion, record.extent)];
+    bin.time[bin.count % history] = record.time;
+    bin.count++;
+}
+
+int PerformanceLog::load() {
+    std::lock_guard<pros::Mutex> lock(performance_mutex);
+    int read = 0;
+    char file_name[64];
+    std::array<PerformanceRecord, 64> records;
+    for (unsigned index = 0; strchr(name, '%'); index++) {
+        snprintf(file_name, sizeof(file_name), name, index);
+        FILE* file = fopen(file_name, "rb");
+        if (!file) break;
+        size_t count;
+        while ((count = fread(records.data(), sizeof(PerformanceRecord), records.size(), file))) {
+            for (size_t i = 0; i < count; i++) add(records[i]);
+            read += count;
+        }
+        fclose(file);
+    }
+    return read;
+}
+
+void PerformanceLog::start() { log.start(); }
+
+bool PerformanceLog::push(const PerformanceRecord& record) {
+    {
+        std::lock_guard<pros::Mutex> lock(performance_mutex);
+        add(record);
+    }
+    return log.write(&record, sizeof(record));
+}
+
+double PerformanceLog::timeout(uint8_t motion, double extent) {
+    std::lock_guard<pros::Mutex> lock(performance_mutex);
+    const Durations& bin = durations[performance_bin(motion, extent)];
+    const int n = std::min<uint32_t>(bin.count, history);
+    if (n < std::max(min_samples, 1)) return NAN;
+    std::array<float, history> times = bin.time;
+    const int rank = (int)ceil(0.99 * n) - 1;
+    std::nth_element(times.begin(), times.begin() + rank, times.begin() + n);
+    return times[rank] * margin;
+}
+
+uint32_t PerformanceLog::dropped() const { return log.dropped(); }
+
+} // namespace appa
@@ -0,0 +1,67 @@
+#include "appa.h"
+
+namespace appa {
+
+/* Triggers */
+Triggers::Triggers(int period) : period(std::max(period, 1)) {}
+
+Triggers::~Triggers() {
+    if (triggers_task) {
+        triggers_task->remove();
+        delete triggers_task;
+    }
+}
+
+bool Triggers::add(Trigger trigger) {
+    if (triggers_task || count == capacity || !trigger.callback) {
+        printf("triggers: can't add a trigger%s\n", triggers_task ? " after start" : "");
+        return false;
+    }
+    trigger.level = read(trigger); // an input already pressed isn't an edge
+    triggers[count++] = std::move(trigger);
+    return true;
+}
+
+bool Triggers::add(uint8_t adi_port, Edge edge, Callback callback) {
+    Trigger trigger;
+    trigger.input.emplace(adi_port);
+    trigger.edge = edge;
+    trigger.callback = std::move(callback);
+    return add(std::move(trigger));
+}
+
+bool Triggers::add(double (*sensor)(), double threshold, Edge edge, Callback callback) {
+    if (!sensor) return add(Trigger());
+    Trigger trigger;
+    trigger.sensor = sensor;
+    trigger.threshold = threshold;
+    trigger.edge = edge;
+    trigger.callback = std::move(callback);
+    return add(std::move(trigger));
+}
+
+bool Triggers::read(const Trigger& trigger) const {
+    if (trigger.sensor) return trigger.sensor() > trigger.threshold;
+    return trigger.input && trigger.input->get_value() == 1;
+}
+
+void Triggers::start() {
+    if (triggers_task == nullptr)
+        triggers_task = start_task([this] { task(); }, task_config, "triggers_task");
+}
+
+void Triggers::task() {
+    uint32_t now = pros::millis();
+    while (true) {
+        for (int i = 0; i < count; i++) {
+            Trigger& trigger = triggers[i];
+            const bool level = read(trigger);
+            if (level == trigger.level) continue;
+            trigger.level = level;
+            if (trigger.edge == BOTH || (trigger.edge == RISING) == level) trigger.callback();
+        }
+        pros::c::task_delay_until(&now, period);
+    }
+}
+
+} // namespace appa
@@ -0,0 +1,147 @@
+#include "appa.h"
+#include "pathfile.h"
+#include <cstdlib>
+
+namespace appa {
+
+/* Tuning */
+static constexpr int tuning_version = 1;
+
+struct TuningKey {
+    const char* name;
+    double* value;
+};
+
+// every key, pointing into the configs being loaded or saved
+static std::array<TuningKey, 30> tuning_keys(MoveConfig& move, TurnConfig& turn) {
+    Gains &lin = move.lin_PID.entries[0].gains, &ang = move.ang_PID.entries[0].gains;
+    Gains& turn_gains = turn.ang_PID.entries[0].gains;
+    return {{{"move.exit", &move.exit},
+             {"move.speed", &move.speed},
+             {"move.lead", &move.lead},
+             {"move.lookahead", &move.lookahead},
+             {"move.lin_p", &lin.p},
+             {"move.lin_i", &lin.i},
+             {"move.lin_d", &lin.d},
+             {"move.ang_p", &ang.p},
+             {"move.ang_i", &ang.i},
+             {"move.ang_d", &ang.d},
+             {"move.track_width", &move.track_width},
+             {"move.velocity", &move.velocity},
+             {"move.min_lookahead", &move.min_lookahead},
+             {"move.max_lookahead", &move.max_lookahead},
+             {"move.ks", &move.ks},
+             {"move.ff_s", &move.feedforward.s},
+             {"move.ff_v", &move.feedforward.v},
+             {"move.ff_a", &move.feedforward.a},
+             {"move.ff_p", &move.feedforward.p},
+             {"turn.exit", &turn.exit},
+             {"turn.speed", &turn.speed},
+             {"turn.ang_p", &turn_gains.p},
+             {"turn.ang_i", &turn_gains.i},
+             {"turn.ang_d", &turn_gains.d},
+             {"turn.velocity", &turn.velocity},
+             {"turn.ks", &turn.ks},
+             {"turn.ff_s", &turn.feedforward.s},
+             {"turn.ff_v", &turn.feedforward.v},
+             {"turn.ff_a", &turn.feedforward.a},
+             {"turn.ff_p", &turn.feedforward.p}}};
+}
+
+// the text with spaces and a comment cut from both ends
+static std::string_view trim(std::string_view text) {
+    text = text.substr(0, text.find('#'));
+    while (!text.empty() && isspace((unsigned char)text.front())) text.remove_prefix(1);
+    while (!text.empty() && isspace((unsigned char)text.back())) text.remove_suffix(1);
+    return text;
+}
+
+bool load_tuning(const char* name, MoveConfig& move_config, TurnConfig& turn_config) {
+    FILE* file = fopen(name, "rb");
+    if (!file) {
+        printf("Could not open %s\n", name);
+        return false;
+    }
+    std::string text;
+    char chunk[512];
+    size_t size;
+    while ((size = fread(chunk, 1, sizeof(chunk), file)) > 0) text.append(chunk, size);
+    fclose(file);
+
+    // parsed into copies, so the configs only change once the whole file checks out
+    MoveConfig move = move_config;
+    TurnConfig turn = turn_config;
+    const auto keys = tuning_keys(move, turn);
+    int version = 0, line_number = 0;
+    for (size_t start = 0; start < text.size();) {
+        const size_t end = std::min(text.find('\n', start), text.size());
+        const std::string_view line = trim(std::string_view(text).substr(start, end - start));
+        const size_t line_start = start;
+        start = end + 1;
+        line_number++;
+        if (line.empty()) continue;
+
+        const size_t equals = line.find('=');
+        const std::string key(trim(line.substr(0, std::min(equals, line.size()))));
+        const std::string value(equals == line.npos ? "" : trim(line.substr(equals + 1)));
+        char* parsed_end;
+        if (key == "crc") {
+            const uint32_t crc = strtoul(value.c_str(), &parsed_end, 16);
+            if (*parsed_end != '\0' || crc != file::crc32(text.data(), line_start)) {
+                printf("%s failed its crc check\n", name);
+                return false;
+            }
+            break; // anything after the crc isn't covered by it
+        }
+        const double number = strtod(value.c_str(), &parsed_end);
+        if (value.empty() || *parsed_end != '\0' || !std::isfinite(number)) {
+            printf("%s:%d: expected key = number\n", name, line_number);
+            return false;
+        }
+        if (key == "version") {
+            version = number;
+            continue;
+        }
+        auto found = std::find_if(keys.begin(), keys.end(),
+                                  [&](const TuningKey& k) { return key == k.name; });
+        if (found == keys.end()) printf("%s:%d: unknown key %s\n", name, line_number, key.c_str());
+        else *found->value = number;
+    }
+    if (version != tuning_version) {
+        printf("%s is not a version %d tuning file\n", name, tuning_version);
+        return false;
+    }
+    // gains set on a config without any give it a single entry
+    for (ScheduledGains* gains : {&move.lin_PID, &move.ang_PID, &turn.ang_PID}) {
+        const Gains& first = gains->entries[0].gains;
+        if (gains->size == 0 && (first.p || first.i || first.d)) gains->size = 1;
+    }
+    move_config = move;
+    turn_config = turn;
+    return true;
+}
+
+bool save_tuning(const char* name, const MoveConfig& move_config, const TurnConfig& turn_config) {
+    MoveConfig move = move_config;
+    TurnConfig turn = turn_config;
+    std::string text = "version = " + std::to_string(tuning_version) + "\n";
+    char line[96];
+    for (const TuningKey& key : tuning_keys(move, turn)) {
+        snprintf(line, sizeof(line), "%s = %.9g\n", key.name, *key.value);
+        text += line;
+    }
+    snprintf(line, sizeof(line), "crc = %08x\n", (unsigned)file::crc32(text.data(), text.size()));
+    text += line;
+
+    FILE* file = fopen(name, "wb");
+    if (!file) {
+        printf("Could not open %s for writing\n", name);
+        return false;
+    }
+    const bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+    fclose(file);
+    if (!ok) printf("Could not write %s\n", name);
+    return ok;
+}
+
+} // namespace appa
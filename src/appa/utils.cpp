@@ -1,104 +1,785 @@
 #include "appa.h"
+#include <algorithm>
+#if defined(__ARM_NEON) && defined(APPA_SINGLE_PRECISION)
+#include <arm_neon.h>
+#define APPA_NEON
+#endif
 
 namespace appa {
 
+/* Fixed */
+// restoring division a bit at a time, the same 48 steps for any operands
+Fixed Fixed::operator/(Fixed other) const {
+    if (raw == nan_raw || other.raw == nan_raw || (raw == 0 && other.raw == 0))
+        return from_raw(nan_raw);
+    if (other.raw == 0) return from_raw(raw < 0 ? -INT32_MAX : INT32_MAX);
+    const bool negative = (raw < 0) != (other.raw < 0);
+    const uint64_t n = (uint64_t)std::abs((int64_t)raw) << 16;
+    const uint64_t d = std::abs((int64_t)other.raw);
+    uint64_t quotient = 0, remainder = 0;
+    for (int bit = 47; bit >= 0; bit--) {
+        remainder = (remainder << 1) | ((n >> bit) & 1);
+        const uint64_t take = remainder >= d;
+        remainder -= d & (0 - take);
+        quotient |= take << bit;
+    }
+    quotient += 2 * remainder >= d; // rounded to nearest
+    return from_raw(saturate(negative ? -(int64_t)quotient : (int64_t)quotient));
+}
+
+// integer square root of the sum of squares in raw units, 32 steps for any operands
+Fixed Fixed::length(Fixed x, Fixed y) {
+    if (x.raw == nan_raw || y.raw == nan_raw) return from_raw(nan_raw);
+    uint64_t rest = (uint64_t)((int64_t)x.raw * x.raw) + (uint64_t)((int64_t)y.raw * y.raw);
+    uint64_t root = 0, bit = 1ull << 62;
+    for (int i = 0; i < 32; i++) {
+        const uint64_t take = rest >= root + bit;
+        rest -= (root + bit) & (0 - take);
+        root = (root >> 1) + (bit & (0 - take));
+        bit >>= 2;
+    }
+    return from_raw(saturate(root));
+}
+
+// nearest whole turn taken off, with 2pi and its inverse in q32 so far out angles stay close
+Fixed wrap(Fixed angle) {
+    if (angle.raw == Fixed::nan_raw) return angle;
+    constexpr int64_t turn = 26986075409, inverse = 683565276; // 2pi and 1 / 2pi, * 2^32
+    const int64_t turns = ((int64_t)angle.raw * inverse + (1ll << 47)) >> 48;
+    int64_t raw = angle.raw - ((turns * turn + (1 << 15)) >> 16);
+    constexpr int64_t half = 205887, whole = 411775; // pi and 2pi, * 2^16
+    if (raw > half) raw -= whole;
+    else if (raw <= -half) raw += whole;
+    return Fixed::from_raw((int32_t)raw);
+}
+
 /* PID */
-PID::PID(Gains k) : k(k) { reset(0.0); }
-PID::PID(double kp, double ki, double kd) : k(kp, ki, kd) { reset(0.0); }
+template <typename T> BasicPID<T>::BasicPID(Gains k) : prev_dt(T(NAN)) {
+    set_gains(k);
+    reset();
+}
+template <typename T>
+BasicPID<T>::BasicPID(double kp, double ki, double kd) : BasicPID(Gains{kp, ki, kd}) {}
 
-void PID::reset(double error) {
+template <typename T> void BasicPID<T>::reset(T error, bool clear_integral) {
     prev_error = error;
-    total_error = 0.0;
+    prev_measurement = T(NAN);
+    derivative = T(0.0);
+    if (clear_integral) total_error = T(0.0);
 }
-double PID::update(double error, int dt) {
-    double dt_s = (double)dt / 1000.0;
-    double derivative = (error - prev_error) / dt_s;
-    total_error += error * dt_s;
+template <typename T> void BasicPID<T>::set_gains(Gains k) {
+    this->k = k;
+    p = T(k.p), i = T(k.i), d = T(k.d);
+    i_zone = T(k.i_zone);
+    i_limit = T(k.i_max > 0 && k.i != 0 ? k.i_max / fabs(k.i) : -1.0);
+    filter = T(k.filter), unfiltered = T(1 - k.filter);
+}
+
+// measurement is what the error is taken from, used for the derivative when on_measurement is set
+template <typename T> T BasicPID<T>::update(T error, T dt, T measurement) {
+    APPA_PROFILE_SCOPE("pid update");
+    if (!(dt == prev_dt)) { // the period rarely changes, so most updates don't divide
+        prev_dt = dt;
+        seconds = dt / T(1000.0);
+        rate = T(1000.0) / dt;
+    }
+
+    // derivative of the error, or of the measurement so setpoint jumps don't kick
+    T raw = (error - prev_error) * rate;
+    if (k.on_measurement && !is_missing(measurement))
+        raw = is_missing(prev_measurement) ? T(0.0) : -(measurement - prev_measurement) * rate;
+    derivative = filter * derivative + unfiltered * raw;
+
+    // integral, limited to a zone around the target and a max contribution
+    const T zero(0.0);
+    const bool crossed = (error < zero && prev_error > zero) || (error > zero && prev_error < zero);
+    if (k.sign_reset && crossed) total_error = zero;
+    if (i_zone <= zero || fabs(error) < i_zone) total_error += error * seconds;
+    if (i_limit > zero) total_error = std::clamp(total_error, -i_limit, i_limit);
+
     prev_error = error;
-    return (k.p * error) + (k.i * total_error) + (k.d * derivative);
+    prev_measurement = measurement;
+    return (p * error) + (i * total_error) + (d * derivative);
+}
+
+template <typename T> typename BasicPID<T>::Terms BasicPID<T>::terms() const {
+    return {(double)(p * prev_error), (double)(i * total_error), (double)(d * derivative)};
+}
+
+template class BasicPID<double>;
+template class BasicPID<Fixed>;
+
+// linear between the surrounding entries, flags from the lower one
+Gains ScheduledGains::get(double value) const {
+    if (size == 0) return Gains();
+    value = fabs(value);
+    if (size == 1 || value <= entries[0].at) return entries[0].gains;
+    int i = 1;
+    while (i < size - 1 && entries[i].at < value) i++;
+    const Entry &a = entries[i - 1], &b = entries[i];
+    if (value >= b.at) return b.gains;
+    const double t = (value - a.at) / (b.at - a.at);
+    auto lerp = [&](double x, double y) { return x + (y - x) * t; };
+    Gains gains = a.gains;
+    gains.p = lerp(a.gains.p, b.gains.p);
+    gains.i = lerp(a.gains.i, b.gains.i);
+    gains.d = lerp(a.gains.d, b.gains.d);
+    gains.i_zone = lerp(a.gains.i_zone, b.gains.i_zone);
+    gains.i_max = lerp(a.gains.i_max, b.gains.i_max);
+    gains.filter = lerp(a.gains.filter, b.gains.filter);
+    return gains;
+}
+bool ScheduledGains::scheduled() const { return size > 1; }
+
+bool load_gains(const char* name, Gains& gains) {
+    std::vector<GainsRecord> buffer;
+    if (!file::read(name, file::gains_magic, buffer) || buffer.empty()) return false;
+    const GainsRecord& r = buffer[0];
+    gains = {r.p, r.i, r.d, r.i_zone, r.i_max, r.filter, r.sign_reset != 0, r.on_measurement != 0};
+    return true;
+}
+bool save_gains(const char* name, const Gains& gains) {
+    const GainsRecord record = {(float)gains.p,      (float)gains.i,      (float)gains.d,
+                                (float)gains.i_zone, (float)gains.i_max,  (float)gains.filter,
+                                gains.sign_reset,    gains.on_measurement, 0};
+    return file::write(name, file::gains_magic, &record, 1);
+}
+
+double Feedforward::get(double velocity, double accel, double measured) const {
+    const double sign = velocity > 0 ? 1.0 : (velocity < 0 ? -1.0 : 0.0);
+    return s * sign + v * velocity + a * accel + p * (velocity - measured);
+}
+Feedforward::operator bool() const { return s != 0 || v != 0 || a != 0 || p != 0; }
+
+// the heading and rate follow rate' = (u - v * rate) / a, held over each period
+LqrGains solve_lqr(const Feedforward& model, const LqrWeights& weights, double dt) {
+    if (model.v <= 0 || model.a <= 0 || dt <= 0 || weights.effort <= 0) return {};
+    const double pole = model.v / model.a, decay = exp(-pole * dt);
+    const double a01 = (1 - decay) / pole, a11 = decay;
+    const double b0 = (dt - a01) / pole / model.a, b1 = a01 / model.a;
+    // iterate the riccati equation to a fixed point, p is symmetric
+    double p00 = weights.error, p01 = 0.0, p11 = weights.rate;
+    LqrGains k;
+    for (int i = 0; i < 10000; i++) {
+        // k = (r + b'pb)^-1 b'pa
+        const double pb0 = p00 * b0 + p01 * b1, pb1 = p01 * b0 + p11 * b1;
+        const double scale = 1 / (weights.effort + b0 * pb0 + b1 * pb1);
+        const LqrGains next = {scale * pb0, scale * (pb0 * a01 + pb1 * a11)};
+        // p = q + a'p(a - bk)
+        const double c00 = 1 - b0 * next.error, c01 = a01 - b0 * next.rate;
+        const double c10 = -b1 * next.error, c11 = a11 - b1 * next.rate;
+        const double m00 = p00 * c00 + p01 * c10, m01 = p00 * c01 + p01 * c11;
+        const double m10 = p01 * c00 + p11 * c10, m11 = p01 * c01 + p11 * c11;
+        p00 = weights.error + m00;
+        p01 = a01 * m00 + a11 * m10;
+        p11 = weights.rate + a01 * m01 + a11 * m11;
+        const bool settled = fabs(next.error - k.error) <= 1e-9 * fabs(next.error) &&
+                             fabs(next.rate - k.rate) <= 1e-9 * fabs(next.rate);
+        k = next;
+        if (settled) break;
+    }
+    return k;
+}
+
+/* Slew */
+Slew::Slew(double accel, double decel) : accel(accel), decel(decel) {}
+void Slew::set_limits(double accel, double decel) {
+    this->accel = accel;
+    this->decel = decel;
+}
+void Slew::reset(double value) { this->value = value; }
+
+// limits speeding up with accel and slowing down with decel, in either direction
+double Slew::update(double target, double dt) {
+    const double dt_s = dt / 1000.0;
+    const bool slowing = value != 0 && (target * value < 0 || fabs(target) < fabs(value));
+    if (slowing) {
+        // slow down towards zero before reversing
+        const double goal = target * value < 0 ? 0.0 : target;
+        value = decel > 0 ? value + limit(goal - value, decel * dt_s) : goal;
+        if (value == 0 && decel <= 0) value = accel > 0 ? limit(target, accel * dt_s) : target;
+    } else value = accel > 0 ? value + limit(target - value, accel * dt_s) : target;
+    return value;
+}
+double Slew::get() const { return value; }
+
+/* Curve */
+Curve::Curve() : Curve(0.0) {}
+Curve::Curve(double deadzone, double expo, double min_output)
+    : Curve([=](double x) {
+          if (fabs(x) < deadzone) return 0.0;
+          const double t = std::clamp((fabs(x) - deadzone) / (100 - deadzone), 0.0, 1.0);
+          const double shaped = (1 - expo) * t + expo * t * t * t;
+          return std::copysign(min_output + (100 - min_output) * shaped, x);
+      }) {}
+Curve::Curve(const std::function<double(double)>& shape) {
+    for (int i = 0; i < 256; i++) {
+        table[i] = std::clamp(shape(std::clamp((i - 128) / 1.27, -100.0, 100.0)), -100.0, 100.0);
+    }
+}
+
+// linear between points, from 0 at the deadzone and holding the last output past the end
+Curve Curve::piecewise(std::initializer_list<Point> points, double deadzone) {
+    const std::vector<Point> list(points);
+    return Curve([=](double x) {
+        const double in = fabs(x);
+        if (in < deadzone) return 0.0;
+        Point prev(deadzone, 0.0);
+        for (const Point& point : list) {
+            if (in <= point.x) {
+                const double span = point.x - prev.x;
+                const double t = span > 0 ? (in - prev.x) / span : 1.0;
+                return std::copysign(prev.y + (point.y - prev.y) * t, x);
+            }
+            prev = point;
+        }
+        return std::copysign(prev.y, x);
+    });
+}
+
+double Curve::operator()(int32_t value) const {
+    return table[std::clamp<int32_t>(value, -128, 127) + 128];
+}
+
+/* Profile */
+// trapezoidal profile, or s-curve when jerk is limited, in units of distance per second
+Profile::Profile(double distance, double speed, double accel, double decel, double jerk)
+    : distance(fabs(distance)), speed(speed), accel(accel), decel(decel), jerk(jerk) {}
+
+void Profile::update(double dt) {
+    const double dt_s = dt / 1000.0;
+    if (done() || dt_s <= 0) return;
+
+    // fastest speed that can still stop in the remaining distance, leaving room to ramp decel. an
+    // infinite decel stops on the spot
+    double remaining = distance - position;
+    if (jerk > 0 && std::isfinite(decel))
+        remaining = std::max(0.0, remaining - velocity * decel / jerk / 2);
+    const double target = remaining > 0 ? std::min(speed, sqrt(2 * decel * remaining)) : 0.0;
+
+    // accelerate towards the target speed
+    const double desired = std::clamp((target - velocity) / dt_s, -decel, accel);
+    if (jerk > 0)
+        acceleration += std::clamp(desired - acceleration, -jerk * dt_s, jerk * dt_s);
+    else acceleration = desired;
+
+    velocity = std::max(0.0, velocity + acceleration * dt_s);
+    position += velocity * dt_s;
+    if (position >= distance || (velocity == 0 && acceleration <= 0 && target == 0)) {
+        position = distance;
+        velocity = acceleration = 0.0;
+    }
 }
 
+void Profile::retarget(double distance) {
+    this->distance = std::max(distance, 0.0);
+    if (position >= this->distance) {
+        position = this->distance;
+        velocity = acceleration = 0.0;
+    }
+}
+
+double Profile::get_position() const { return position; }
+double Profile::get_velocity() const { return velocity; }
+double Profile::get_acceleration() const { return acceleration; }
+bool Profile::done() const { return position >= distance; }
+
+/* Kinematics */
+double Kinematics::max_speed() const { return M_PI * wheel_diameter * motor_rpm * gear_ratio / 60; }
+Point Kinematics::inverse(double linear, double angular) const {
+    return {linear - angular * track_width / 2, linear + angular * track_width / 2};
+}
+Point Kinematics::forward(const Point& wheels) const {
+    return {(wheels.left + wheels.right) / 2, (wheels.right - wheels.left) / track_width};
+}
+Kinematics::operator bool() const { return track_width > 0 && wheel_diameter > 0; }
+
 /* Imu */
 Imu::Imu(std::initializer_list<uint8_t> ports) {
+    scales.fill(1.0);
     for (auto port : ports) {
         imus.emplace_back(port);
     }
 }
-Imu::Imu(uint8_t port) { imus.emplace_back(port); }
+Imu::Imu(uint8_t port) {
+    scales.fill(1.0);
+    imus.emplace_back(port);
+}
+
+// pros::Imu isn't assignable, so rebuild the vector with the imus to keep
+template <typename F> static void keep_imus(std::vector<pros::Imu>& imus, F keep) {
+    std::vector<pros::Imu> kept;
+    for (auto& imu : imus) {
+        if (keep(imu)) kept.push_back(imu);
+    }
+    imus.swap(kept);
+}
 
 bool Imu::calibrate() {
+    if (scale_file) load_scales(scale_file);
+
+    // start calibrating every imu at once, dropping any that can't be reset
+    keep_imus(imus, [](pros::Imu& imu) { return imu.reset(false) != PROS_ERR; });
     for (auto& imu : imus) {
-        imu.reset(false);
         imu.set_data_rate(5);
     }
+
+    // wait until every imu has finished or failed
     uint32_t start = pros::millis();
-    bool all_calibrated = false;
-    while ((pros::millis() - start < 3000) && !all_calibrated) {
-        all_calibrated = true;
+    bool all_done = false;
+    while ((pros::millis() - start < 3000) && !all_done) {
+        pros::delay(50);
+        all_done = true;
         for (auto& imu : imus) {
-            if (imu.is_calibrating()) all_calibrated = false;
+            if (imu.is_calibrating()) all_done = false;
         }
-        pros::delay(50);
     }
-    return all_calibrated;
+
+    // keep only the imus that are ready
+    keep_imus(imus, [](pros::Imu& imu) {
+        return !imu.is_calibrating() && imu.get_status() != pros::ImuStatus::error;
+    });
+    states.assign(imus.size(), {}); // calibrating zeroes them, so the offsets from set() go too
+    heading = 0.0;
+    return !imus.empty();
 }
-double Imu::get() {
-    double rotation = 0;
+bool Imu::resume() {
+    if (imus.empty()) return false;
     for (auto& imu : imus) {
-        rotation -= imu.get_rotation();
+        if (imu.is_calibrating() || imu.get_status() != pros::ImuStatus::ready) return false;
     }
-    return rotation / imus.size();
+    if (scale_file) load_scales(scale_file);
+    for (auto& imu : imus) {
+        imu.set_data_rate(5);
+    }
+    states.assign(imus.size(), {});
+    heading = 0.0;
+    prev_time = 0;
+    return true;
 }
+
+double Imu::get() {
+    APPA_PROFILE_SCOPE("imu read");
+    if (states.size() != imus.size()) states.assign(imus.size(), {});
+    const uint64_t time = pros::micros();
+
+    // read every imu, checking for disconnects at a low rate
+    const bool check_status = !(reads++ % 100);
+    const int count = std::min<int>(imus.size(), 21);
+    std::array<double, 21> rotations, rates;
+    bool fresh = false;
+    for (int i = 0; i < count; i++) {
+        State& state = states[i];
+        if (check_status) state.connected = imus[i].get_status() == pros::ImuStatus::ready;
+        double rotation = -imus[i].get_rotation() * scales[imus[i].get_port()] + state.offset;
+        rotations[i] = state.connected && std::isfinite(rotation) ? rotation : NAN;
+        if (rotations[i] != state.rotation && !std::isnan(rotations[i])) {
+            // over the time since this imu's last new reading
+            if (state.valid && state.time && bias_gain > 0) {
+                const double dt = (time - state.time) / 1e6;
+                const double change = rotations[i] - state.rotation;
+                if (still && fabs(change) <= max_drift * dt) {
+                    state.bias += bias_gain * (change / dt - state.bias);
+                    state.offset -= change;
+                    rotations[i] = state.rotation;
+                } else {
+                    state.offset -= state.bias * dt;
+                    rotations[i] -= state.bias * dt;
+                }
+            }
+            state.time = time;
+            if (rotations[i] != state.rotation) fresh = true;
+        }
+        rates[i] = NAN;
+    }
+
+    // gyro rates are only needed when no imu has a new rotation
+    for (int i = 0; gyro && !fresh && i < count; i++) {
+        if (!std::isnan(rotations[i]))
+            rates[i] = -imus[i].get_gyro_rate().z * scales[imus[i].get_port()] - states[i].bias;
+    }
+    return fuse(time, {rotations.data(), (size_t)count}, {rates.data(), (size_t)count});
+}
+
+double Imu::fuse(uint64_t time, std::span<const double> rotations, std::span<const double> rates) {
+    if (states.size() < rotations.size()) states.resize(rotations.size());
+    const double dt = prev_time ? (time - prev_time) / 1e6 : 0.0;
+    prev_time = time;
+
+    std::array<double, 21> readings;
+    int count = 0;
+    bool fresh = false;
+    for (int i = 0; i < states.size(); i++) {
+        State& state = states[i];
+        state.valid = i < std::min<int>(rotations.size(), 21) && std::isfinite(rotations[i]);
+        state.rate = i < rates.size() ? rates[i] : NAN;
+        if (!state.valid) continue;
+        if (rotations[i] != state.rotation) fresh = true;
+        state.rotation = rotations[i];
+        readings[count++] = rotations[i];
+    }
+    if (count == 0) return heading; // hold the last heading
+
+    // fuse readings
+    double fused = 0.0;
+    if (weighted) {
+        // reject readings far from the median when there are enough to compare
+        const int mid = count / 2;
+        std::nth_element(readings.begin(), readings.begin() + mid, readings.begin() + count);
+        const double median = readings[mid];
+        double total_weight = 0.0;
+        for (auto& state : states) {
+            if (!state.valid || (count > 2 && fabs(state.rotation - median) > outlier)) continue;
+            const double weight = 1.0 / std::max(state.variance, 1e-4);
+            fused += state.rotation * weight;
+            total_weight += weight;
+        }
+        fused /= total_weight;
+    } else {
+        for (int i = 0; i < count; i++) {
+            fused += readings[i];
+        }
+        fused /= count;
+    }
+
+    // track residual variance of each imu
+    if (weighted) {
+        for (auto& state : states) {
+            if (!state.valid) continue;
+            const double residual = state.rotation - fused;
+            state.variance += 0.01 * (residual * residual - state.variance);
+        }
+    }
+
+    // integrate gyro rate when no imu has a new rotation
+    double rate = 0.0;
+    int rated = 0;
+    for (const State& state : states) {
+        if (state.valid && !std::isnan(state.rate)) rate += state.rate, rated++;
+    }
+    if (gyro && !fresh && dt > 0 && rated > 0) heading += rate / rated * dt;
+    else heading = fused;
+
+    return heading;
+}
+// offsets the readings instead of setting the devices' rotation, so it makes no device calls
 void Imu::set(double angle) {
+    if (states.size() != imus.size()) states.assign(imus.size(), {});
+    for (auto& state : states) {
+        state.offset += angle - state.rotation;
+        state.rotation = angle;
+    }
+    heading = angle;
+}
+
+// a record per imu, for the imus it was saved with
+struct ImuScale {
+    uint32_t port;
+    double scale;
+};
+
+Point Imu::tilt() {
     for (auto& imu : imus) {
-        imu.set_rotation(-angle);
+        const double pitch = imu.get_pitch(), roll = imu.get_roll();
+        if (pitch != PROS_ERR_F && roll != PROS_ERR_F) return {pitch, roll};
     }
+    return {NAN, NAN};
 }
 
-/* Options */
-Options Options::defaults() {
-    return Options(
-        AUTO, AUTO, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0, 0, Gains(), Gains(), false, false, false);
+double Imu::accel() {
+    for (auto& imu : imus) {
+        const auto accel = imu.get_accel();
+        if (accel.x != PROS_ERR_F && accel.y != PROS_ERR_F) return hypot(accel.x, accel.y) * 386.09;
+    }
+    return NAN;
+}
+
+bool Imu::load_scales(const char* file) {
+    std::vector<ImuScale> buffer;
+    if (!file::read(file, file::imu_magic, buffer)) return false;
+    for (const ImuScale& record : buffer) {
+        if (record.port < scales.size() && record.scale > 0) scales[record.port] = record.scale;
+    }
+    return true;
+}
+
+bool Imu::save_scales(const char* file) const {
+    std::array<ImuScale, 21> records;
+    uint32_t count = 0;
+    for (auto& imu : imus) records[count++] = {imu.get_port(), scales[imu.get_port()]};
+    return file::write(file, file::imu_magic, records.data(), count);
+}
+
+/* Tracker */
+Tracker::~Tracker() = default;
+
+AdiTracker::AdiTracker(int8_t port) : port(abs(port)), reversed(port < 0) {}
+AdiTracker::AdiTracker(std::array<int8_t, 2> port)
+    : expander(port[0]), port(abs(port[1])), reversed(port[1] < 0) {}
+
+void AdiTracker::bind() {
+    if (encoder) return;
+    if (expander == 0) encoder.emplace(port, port + 1, reversed);
+    else encoder.emplace(pros::adi::ext_adi_port_tuple_t{expander, port, port + 1}, reversed);
+}
+
+RotationTracker::RotationTracker(int8_t port, uint32_t data_rate)
+    : rotation(port), data_rate(data_rate) {}
+
+void RotationTracker::bind() { rotation.set_data_rate(data_rate); }
+
+MotorTracker::MotorTracker(std::initializer_list<int8_t> ports)
+    : motors(std::make_unique<pros::MotorGroup>(ports)) {}
+double MotorTracker::get() {
+    std::array<double, 8> readings;
+    int count = 0;
+    for (int i = 0; i < motors->size() && count < (int)readings.size(); i++) {
+        const double position = motors->get_position(i); // not _all, which returns a vector
+        if (std::isfinite(position)) readings[count++] = position;
+    }
+    if (count == 0) return last; // hold the last position
+
+    // median, the mean of the middle two for an even count
+    const int mid = count / 2;
+    std::nth_element(readings.begin(), readings.begin() + mid, readings.begin() + count);
+    last = readings[mid];
+    if (count % 2 == 0) {
+        last = (last + *std::max_element(readings.begin(), readings.begin() + mid)) / 2;
+    }
+    return last;
 }
 
-Options Options::operator<<(const Options& other) const {
-    Options result = *this;
+AnyTracker::AnyTracker(int8_t port) : tracker(std::make_unique<AdiTracker>(port)) {}
+AnyTracker::AnyTracker(int8_t expander, int8_t port)
+    : tracker(std::make_unique<AdiTracker>(std::array<int8_t, 2>{expander, port})) {}
+AnyTracker::AnyTracker(std::unique_ptr<Tracker> tracker) : tracker(std::move(tracker)) {}
 
-    if (other.dir) result.dir = other.dir;
-    if (other.turn) result.turn = other.turn;
-    if (other.speed) result.speed = other.speed;
-    if (other.accel) result.accel = other.accel;
-    if (other.lead) result.lead = other.lead;
-    if (other.lookahead) result.lookahead = other.lookahead;
-    if (other.exit) result.exit = other.exit;
-    if (other.offset) result.offset = other.offset;
-    if (other.settle) result.settle = other.settle;
-    if (other.timeout) result.timeout = other.timeout;
-    if (other.lin_PID) result.lin_PID = other.lin_PID;
-    if (other.ang_PID) result.ang_PID = other.ang_PID;
-    if (other.thru) result.thru = other.thru;
-    if (other.relative) result.relative = other.relative;
-    if (other.async) result.async = other.async;
-    if (other.exit_fn) result.exit_fn = other.exit_fn;
+/* ExitFn */
+#ifdef APPA_NO_HEAP
+bool ExitFn::operator()() const { return ops && ops->call(storage); }
+#else
+bool ExitFn::operator()() const { return block && block->fn(); }
+#endif
+
+/* PackedOptions */
+static_assert(std::is_trivially_copyable_v<PackedOptions>, "packed options must copy as bytes");
+static_assert(PackedOptions::EXITS < 64, "options have to fit in the field bits");
+
+PackedOptions::PackedOptions(const Options& options) {
+    auto pack = [&](Field field, const auto& option, auto& value) {
+        if (!option) return;
+        fields |= 1ull << field;
+        value = *option;
+    };
+    auto pack_flag = [&](Field field, const std::optional<bool>& option) {
+        if (!option) return;
+        fields |= 1ull << field;
+        set_flag(field, *option);
+    };
+
+    pack(DIR, options.dir, dir);
+    pack(TURN, options.turn, turn);
+    pack(SPEED, options.speed, speed);
+    pack(ACCEL, options.accel, accel);
+    pack(DECEL, options.decel, decel);
+    pack(JERK, options.jerk, jerk);
+    pack(LEAD, options.lead, lead);
+    pack(CLOSE, options.close, close);
+    pack(DRIFT, options.drift, drift);
+    pack(LOOKAHEAD, options.lookahead, lookahead);
+    pack(STANLEY, options.stanley, stanley);
+    pack(EXIT, options.exit, exit);
+    pack(EXIT_SPEED, options.exit_speed, exit_speed);
+    pack(OFFSET, options.offset, offset);
+    pack(BLEND, options.blend, blend);
+    pack(LATENCY, options.latency, latency);
+    pack(WARP, options.warp, warp);
+    pack(HEADING, options.heading, heading);
+    pack(SETTLE, options.settle, settle);
+    pack(TIMEOUT, options.timeout, timeout);
+    pack(PERIOD, options.period, period);
+    pack(LIN_PID, options.lin_PID, lin_PID);
+    pack(ANG_PID, options.ang_PID, ang_PID);
+    if (options.tool) {
+        fields |= 1ull << TOOL;
+        tool_x = options.tool->x, tool_y = options.tool->y;
+    }
+    pack(BRAKE, options.brake, brake);
+    pack_flag(THRU, options.thru);
+    pack_flag(RELATIVE, options.relative);
+    pack_flag(ASYNC, options.async);
+    pack_flag(SYNC, options.sync);
+    pack_flag(QUEUE, options.queue);
+    pack_flag(PROFILE, options.profile);
+    pack_flag(PREDICT, options.predict);
+    pack_flag(MPC, options.mpc);
+    pack_flag(UNWRAP, options.unwrap);
+    pack(EXITS, options.exits, exits);
+}
+
+bool PackedOptions::has(Field field) const { return fields & (1ull << field); }
+bool PackedOptions::flag(Field field) const { return flags & (1ull << field); }
+void PackedOptions::set_flag(Field field, bool value) {
+    if (value) flags |= 1ull << field;
+    else flags &= ~(1ull << field);
+}
+
+PackedOptions PackedOptions::operator<<(const PackedOptions& other) const {
+    PackedOptions result = *this;
+
+    if (other.has(DIR)) result.dir = other.dir;
+    if (other.has(TURN)) result.turn = other.turn;
+    if (other.has(SPEED)) result.speed = other.speed;
+    if (other.has(ACCEL)) result.accel = other.accel;
+    if (other.has(DECEL)) result.decel = other.decel;
+    if (other.has(JERK)) result.jerk = other.jerk;
+    if (other.has(LEAD)) result.lead = other.lead;
+    if (other.has(CLOSE)) result.close = other.close;
+    if (other.has(DRIFT)) result.drift = other.drift;
+    if (other.has(LOOKAHEAD)) result.lookahead = other.lookahead;
+    if (other.has(STANLEY)) result.stanley = other.stanley;
+    if (other.has(EXIT)) result.exit = other.exit;
+    if (other.has(EXIT_SPEED)) result.exit_speed = other.exit_speed;
+    if (other.has(OFFSET)) result.offset = other.offset;
+    if (other.has(BLEND)) result.blend = other.blend;
+    if (other.has(LATENCY)) result.latency = other.latency;
+    if (other.has(WARP)) result.warp = other.warp;
+    if (other.has(HEADING)) result.heading = other.heading;
+    if (other.has(SETTLE)) result.settle = other.settle;
+    if (other.has(TIMEOUT)) result.timeout = other.timeout;
+    if (other.has(PERIOD)) result.period = other.period;
+    if (other.has(LIN_PID)) result.lin_PID = other.lin_PID;
+    if (other.has(ANG_PID)) result.ang_PID = other.ang_PID;
+    if (other.has(TOOL)) result.tool_x = other.tool_x, result.tool_y = other.tool_y;
+    if (other.has(BRAKE)) result.brake = other.brake;
+    if (other.has(EXITS)) result.exits = other.exits;
+    // bools merge in one step
+    result.flags = (flags & ~other.fields) | (other.flags & other.fields);
+    result.fields |= other.fields;
 
     return result;
 }
-Options Options::operator>>(const Options& other) const { return other << *this; }
-void Options::operator<<=(const Options& other) { *this = *this << other; }
-void Options::operator>>=(const Options& other) { *this = *this >> other; }
+void PackedOptions::operator<<=(const PackedOptions& other) { *this = *this << other; }
+
+/* Fast math */
+namespace fast {
+// reduced to [-pi/4, pi/4] around the nearest quarter turn, then taylor series to the 10th power
+void sincos(double x, double& sine, double& cosine) {
+    if (!(fabs(x) < 1e5)) { // the reduction loses precision far out, and nan falls through
+        sine = ::sin(x);
+        cosine = ::cos(x);
+        return;
+    }
+    const double quarter = std::nearbyint(x * M_2_PI);
+    // pi / 2 split in two so the reduction stays exact
+    const double r = (x - quarter * 1.57079632673412561417) - quarter * 6.07710050650619224932e-11;
+    const double r2 = r * r;
+    double s = 1 / 362880.0, c = -1 / 3628800.0;
+    for (const double k : {-1 / 5040.0, 1 / 120.0, -1 / 6.0, 1.0}) s = s * r2 + k;
+    for (const double k : {1 / 40320.0, -1 / 720.0, 1 / 24.0, -0.5, 1.0}) c = c * r2 + k;
+    s *= r;
+    switch ((int64_t)quarter & 3) {
+    case 0:
+        sine = s, cosine = c;
+        break;
+    case 1:
+        sine = c, cosine = -s;
+        break;
+    case 2:
+        sine = -s, cosine = -c;
+        break;
+    default:
+        sine = -c, cosine = s;
+        break;
+    }
+}
 
-Options MoveConfig::options() const {
-    return Options{.speed = speed,
-                   .lead = lead,
-                   .lookahead = lookahead,
-                   .exit = exit,
-                   .lin_PID = lin_PID,
-                   .ang_PID = ang_PID};
+// reduced to an argument within tan(pi/8) of 0, then taylor series to the 13th power
+double atan2(double y, double x) {
+    const double ax = fabs(x), ay = fabs(y);
+    if (ax == 0 && ay == 0) return ::atan2(y, x); // keeps the signed zero cases
+    if (std::isnan(x) || std::isnan(y) || std::isinf(ax) || std::isinf(ay)) return ::atan2(y, x);
+    double t = std::min(ax, ay) / std::max(ax, ay), base = 0.0;
+    if (t > 0.41421356237309504880) { // atan(t) = pi/4 + atan((t - 1) / (t + 1))
+        t = (t - 1) / (t + 1);
+        base = M_PI_4;
+    }
+    const double t2 = t * t;
+    double series = 1 / 13.0;
+    for (const double c : {-1 / 11.0, 1 / 9.0, -1 / 7.0, 1 / 5.0, -1 / 3.0, 1.0}) {
+        series = series * t2 + c;
+    }
+    double angle = base + t * series;
+    if (ay > ax) angle = M_PI_2 - angle;
+    if (x < 0) angle = M_PI - angle;
+    return y < 0 ? -angle : angle;
 }
-Options TurnConfig::options() const {
-    return Options{.speed = speed, .exit = exit, .ang_PID = ang_PID};
+
+// the same reductions with the series cut where q16.16 runs out of bits
+void sincos(Fixed x, Fixed& sine, Fixed& cosine) {
+    if (x.raw == Fixed::nan_raw) {
+        sine = cosine = x;
+        return;
+    }
+    constexpr int64_t quarter_turn = 6746518852, inverse = 2734261102; // pi/2 and 2/pi, * 2^32
+    const int64_t quarter = ((int64_t)x.raw * inverse + (1ll << 47)) >> 48;
+    const int64_t taken = (quarter * quarter_turn + (1 << 15)) >> 16;
+    const Fixed r = Fixed::from_raw((int32_t)(x.raw - taken));
+    const Fixed r2 = r * r;
+    Fixed s = -1 / 5040.0, c = 1 / 40320.0;
+    for (const Fixed k : {1 / 120.0, -1 / 6.0, 1.0}) s = s * r2 + k;
+    for (const Fixed k : {-1 / 720.0, 1 / 24.0, -0.5, 1.0}) c = c * r2 + k;
+    s *= r;
+    switch (quarter & 3) {
+    case 0:
+        sine = s, cosine = c;
+        break;
+    case 1:
+        sine = c, cosine = -s;
+        break;
+    case 2:
+        sine = -s, cosine = -c;
+        break;
+    default:
+        sine = -c, cosine = s;
+        break;
+    }
 }
 
+Fixed atan2(Fixed y, Fixed x) {
+    if (x.raw == Fixed::nan_raw || y.raw == Fixed::nan_raw) return Fixed::from_raw(Fixed::nan_raw);
+    const Fixed ax = fabs(x), ay = fabs(y), zero(0.0);
+    if (ax == zero && ay == zero) return zero;
+    Fixed t = std::min(ax, ay) / std::max(ax, ay), base = zero;
+    if (t > Fixed(0.41421356237309504880)) {
+        t = (t - Fixed(1.0)) / (t + Fixed(1.0));
+        base = M_PI_4;
+    }
+    const Fixed t2 = t * t;
+    Fixed series = 1 / 13.0;
+    for (const Fixed c : {-1 / 11.0, 1 / 9.0, -1 / 7.0, 1 / 5.0, -1 / 3.0, 1.0}) {
+        series = series * t2 + c;
+    }
+    Fixed angle = base + t * series;
+    if (ay > ax) angle = Fixed(M_PI_2) - angle;
+    if (x < zero) angle = Fixed(M_PI) - angle;
+    return y < zero ? -angle : angle;
+}
+} // namespace fast
+
+#ifdef APPA_FAST_MATH
+static inline void sin_cos(double x, double& sine, double& cosine) {
+    fast::sincos(x, sine, cosine);
+}
+static inline double arctan2(double y, double x) { return fast::atan2(y, x); }
+#else
+static inline void sin_cos(double x, double& sine, double& cosine) {
+    sine = sin(x);
+    cosine = cos(x);
+}
+static inline double arctan2(double y, double x) { return atan2(y, x); }
+#endif
+
 /* Point */
 Point Point::operator+(const Point& other) const { return Point({x + other.x, y + other.y}); }
 Point Point::operator-(const Point& other) const { return Point({x - other.x, y - other.y}); }
@@ -125,12 +806,12 @@ double Point::dist(const Point& other) const {
 }
 double Point::angle(const Point& other, double offset) const {
     Point diff = other - *this;
-    return std::remainder(atan2(diff.y, diff.x) - offset, 2 * M_PI);
+    return wrap(arctan2(diff.y, diff.x) - offset);
 }
 Point Point::rotate(double theta) const {
     if (theta == 0) return *this;
-    double sine = sin(theta);
-    double cosine = cos(theta);
+    double sine, cosine;
+    sin_cos(theta, sine, cosine);
     return {x * cosine - y * sine, x * sine + y * cosine};
 }
 
@@ -154,15 +835,16 @@ void Pose::operator=(const Point& p) {
 
 Pose Pose::operator+(const Pose& p) const { return Pose(x + p.x, y + p.y, theta + p.theta); }
 Pose Pose::operator-(const Pose& p) const { return Pose(x - p.x, y - p.y, theta - p.theta); }
+Pose Pose::operator*(double scalar) const { return Pose(x * scalar, y * scalar, theta * scalar); }
 void Pose::operator+=(const Pose& p) {
     x += p.x;
     y += p.y;
-    theta += theta;
+    theta += p.theta;
 }
 void Pose::operator-=(const Pose& p) {
     x -= p.x;
     y -= p.y;
-    theta -= theta;
+    theta -= p.theta;
 }
 void Pose::operator=(const Pose& p) {
     x = p.x;
@@ -172,13 +854,220 @@ void Pose::operator=(const Pose& p) {
 
 double Pose::dist(const Point& other) const { return p().dist(other); }
 double Pose::angle(const Point& other) const { return p().angle(other, theta); }
-Point Pose::project(double d) const { return p() + Point{d * cos(theta), d * sin(theta)}; }
+Point Pose::project(double d) const {
+    double sine, cosine;
+    sin_cos(theta, sine, cosine);
+    return p() + Point{d * cosine, d * sine};
+}
+
+/* Twist */
+double Twist::speed() const { return sqrt(vel.x * vel.x + vel.y * vel.y); }
+Twist Twist::rotate(double theta) const {
+    return {Pose(vel.p().rotate(theta), vel.theta), Pose(accel.p().rotate(theta), accel.theta)};
+}
+
+/* FieldTransform */
+FieldTransform FieldTransform::offset(const Pose& frame) {
+    double sine, cosine;
+    sin_cos(frame.theta, sine, cosine);
+    return {cosine, -sine, frame.x, sine, cosine, frame.y, 1.0, frame.theta};
+}
+
+FieldTransform FieldTransform::mirror(const Pose& line) {
+    double sine, cosine;
+    sin_cos(2 * line.theta, sine, cosine);
+    return {cosine, sine,    line.x - cosine * line.x - sine * line.y,
+            sine,   -cosine, line.y - sine * line.x + cosine * line.y,
+            -1.0,   2 * line.theta};
+}
+
+FieldTransform FieldTransform::then(const FieldTransform& next) const {
+    return {next.xx * xx + next.xy * yx, next.xx * xy + next.xy * yy,
+            next.xx * x0 + next.xy * y0 + next.x0, next.yx * xx + next.yy * yx,
+            next.yx * xy + next.yy * yy, next.yx * x0 + next.yy * y0 + next.y0,
+            next.turn * turn, next.turn * theta0 + next.theta0};
+}
+
+bool FieldTransform::mirrored() const { return turn < 0; }
+bool FieldTransform::identity() const {
+    return xx == 1 && xy == 0 && x0 == 0 && yx == 0 && yy == 1 && y0 == 0 && turn == 1 &&
+           theta0 == 0;
+}
+
+Point FieldTransform::point(const Point& p) const {
+    return {xx * p.x + xy * p.y + x0, yx * p.x + yy * p.y + y0};
+}
+Pose FieldTransform::pose(const Pose& p) const { return {point(p.p()), heading(p.theta)}; }
+double FieldTransform::heading(double theta) const { return turn * theta + theta0; }
+
+void FieldTransform::apply(std::span<const Point> from, std::span<Point> to) const {
+    const size_t size = std::min(from.size(), to.size());
+    size_t i = 0;
+#ifdef APPA_NEON
+    static_assert(sizeof(Point) == 2 * sizeof(float), "points have to be packed for vld2");
+    const float32x4_t tx = vdupq_n_f32(x0), ty = vdupq_n_f32(y0);
+    for (; i + 4 <= size; i += 4) {
+        float32x4x2_t v = vld2q_f32(&from[i].x);
+        const float32x4_t x = v.val[0], y = v.val[1];
+        v.val[0] = vmlaq_n_f32(vmlaq_n_f32(tx, x, xx), y, xy);
+        v.val[1] = vmlaq_n_f32(vmlaq_n_f32(ty, x, yx), y, yy);
+        vst2q_f32(&to[i].x, v);
+    }
+#endif
+    for (; i < size; i++) to[i] = point(from[i]);
+}
+
+void FieldTransform::apply(std::span<const Pose> from, std::span<Pose> to) const {
+    const size_t size = std::min(from.size(), to.size());
+    size_t i = 0;
+#ifdef APPA_NEON
+    static_assert(sizeof(Pose) == 3 * sizeof(float), "poses have to be packed for vld3");
+    const float32x4_t tx = vdupq_n_f32(x0), ty = vdupq_n_f32(y0), dtheta = vdupq_n_f32(theta0);
+    for (; i + 4 <= size; i += 4) {
+        float32x4x3_t v = vld3q_f32(&from[i].x);
+        const float32x4_t x = v.val[0], y = v.val[1];
+        v.val[0] = vmlaq_n_f32(vmlaq_n_f32(tx, x, xx), y, xy);
+        v.val[1] = vmlaq_n_f32(vmlaq_n_f32(ty, x, yx), y, yy);
+        v.val[2] = vmlaq_n_f32(dtheta, v.val[2], turn);
+        vst3q_f32(&to[i].x, v);
+    }
+#endif
+    for (; i < size; i++) to[i] = pose(from[i]);
+}
+
+/* LoopTiming */
+void LoopTiming::record(uint32_t period, uint32_t busy, uint32_t nominal) {
+    auto bucket = [nominal](uint32_t us) {
+        return nominal ? std::min<uint32_t>(us * 4 / nominal, buckets - 1) : 0;
+    };
+    this->nominal = nominal;
+    this->busy = busy;
+    max_busy = std::max(max_busy, busy);
+    ++busy_histogram[bucket(busy)];
+    ++count;
+    if (period == 0) return;
+    this->period = period;
+    max_period = std::max(max_period, period);
+    max_jitter = std::max(max_jitter, period > nominal ? period - nominal : nominal - period);
+    if (period * 2 > nominal * 3) ++overruns;
+    total_period += period;
+    total_busy += busy;
+    ++period_histogram[bucket(period)];
+}
+
+double LoopTiming::load() const { return total_period ? (double)total_busy / total_period : 0; }
+
+/* Tasks */
+// in libpros, but not declared by its headers
+extern "C" pros::task_t task_create_static(void (*function)(void*), void* parameters,
+                                           uint32_t prio, size_t stack_depth, const char* name,
+                                           uint32_t* stack, void* control);
+
+extern "C" uint16_t task_get_stack_high_water_mark(pros::task_t task);
+
+static void run_stored(void* storage) { static_cast<TaskStorage*>(storage)->function(); }
+
+// every task start_task() started, which are never deleted
+static constexpr int max_tasks = 32;
+static std::array<std::pair<pros::task_t, tasks::Usage>, max_tasks> started;
+static std::atomic<int> started_count{0};
+
+static pros::Task* enroll(pros::Task* task, const char* name, uint16_t depth, bool stored) {
+    const int index = started_count.load();
+    if (index < max_tasks) {
+        started[index] = {static_cast<pros::task_t>(*task), {name, depth, depth, stored}};
+        started_count.store(index + 1);
+    }
+    return task;
+}
+
+pros::Task* start_task(std::function<void()> function, const TaskConfig& config, const char* name) {
+    TaskStorage* storage = config.storage;
+    if (storage && storage->used) {
+        printf("%s: its task storage is already used, allocating instead\n", name);
+        storage = nullptr;
+    }
+    if (storage == nullptr) {
+        pros::Task* task =
+            new pros::Task(std::move(function), config.priority, config.stack_depth, name);
+        return enroll(task, name, config.stack_depth, false);
+    }
+
+    storage->used = true;
+    storage->function = std::move(function);
+    pros::Task* task = new pros::Task(task_create_static(
+        run_stored, storage, config.priority, storage->depth, name, storage->stack,
+        storage->control));
+    return enroll(task, name, storage->depth, true);
+}
+
+namespace tasks {
+int count() { return started_count.load(); }
+
+Usage usage(int index) {
+    if (index < 0 || index >= count()) return {};
+    Usage task = started[index].second;
+    task.unused = task_get_stack_high_water_mark(started[index].first);
+    return task;
+}
+
+void report() {
+    for (int i = 0; i < count(); i++) {
+        const Usage task = usage(i);
+        printf("%s: %u of %u words of stack used at most%s\n", task.name,
+               (unsigned)(task.depth - task.unused), (unsigned)task.depth,
+               task.stored ? ", stored" : "");
+    }
+    printf("heap: %u bytes in use, %u of them task stacks\n", (unsigned)heap::in_use(),
+           (unsigned)heap::stacks());
+}
+} // namespace tasks
+
+namespace heap {
+size_t stacks() {
+    size_t bytes = 0;
+    for (int i = 0; i < tasks::count(); i++) {
+        if (!started[i].second.stored) bytes += started[i].second.depth * sizeof(uint32_t);
+    }
+    return bytes;
+}
+} // namespace heap
 
 /* Utils */
 double to_rad(double deg) { return deg * M_PI / 180; }
 double to_deg(double rad) { return rad * 180 / M_PI; }
+double wrap(double angle) {
+    // a couple of turns at most in the loops, further out remainder is as fast
+    if (fabs(angle) > 4 * M_PI) angle = std::remainder(angle, 2 * M_PI);
+    while (angle > M_PI) angle -= 2 * M_PI;
+    while (angle <= -M_PI) angle += 2 * M_PI;
+    return angle;
+}
 double limit(double val, double limit) {
     return val > limit ? limit : (val < -limit ? -limit : val);
 }
+// scales both sides by the same factor in either direction, keeping the curvature
+Point desaturate(const Point& speeds, double max) {
+    const double largest = std::max(fabs(speeds.left), fabs(speeds.right));
+    return largest > max ? speeds * (max / largest) : speeds;
+}
+
+void transform(std::span<const Point> from, std::span<Point> to, const Pose& frame) {
+    FieldTransform::offset(frame).apply(from, to);
+}
+void transform(std::span<const Pose> from, std::span<Pose> to, const Pose& frame) {
+    FieldTransform::offset(frame).apply(from, to);
+}
+void transform(std::span<Point> points, const Pose& frame) { transform(points, points, frame); }
+void transform(std::span<Pose> poses, const Pose& frame) { transform(poses, poses, frame); }
+
+void mirror(std::span<const Point> from, std::span<Point> to, const Pose& line) {
+    FieldTransform::mirror(line).apply(from, to);
+}
+void mirror(std::span<const Pose> from, std::span<Pose> to, const Pose& line) {
+    FieldTransform::mirror(line).apply(from, to);
+}
+void mirror(std::span<Point> points, const Pose& line) { mirror(points, points, line); }
+void mirror(std::span<Pose> poses, const Pose& line) { mirror(poses, poses, line); }
 
 } // namespace appa
@@ -0,0 +1,119 @@
+#include "appa.h"
+
+namespace appa {
+
+/* ObjectSensor */
+ObjectSensor::~ObjectSensor() = default;
+
+// us ago, not before the program started
+static uint64_t before(uint64_t ago) {
+    const uint64_t now = pros::micros();
+    return now - std::min(now, ago);
+}
+
+/* VisionSensor */
+VisionSensor::VisionSensor(uint8_t port, uint8_t signature, const Pose& offset)
+    : vision(port), signature(signature), offset({offset.x, offset.y, to_rad(offset.theta)}) {}
+
+Sighting VisionSensor::sight() {
+    // the largest blob, an error or an empty frame reads as signature 255
+    const pros::vision_object_s_t blob = vision.get_by_sig(0, signature);
+    if (blob.signature != signature || blob.width < min_width) return {};
+    Sighting sighting;
+    sighting.seen = true;
+    sighting.time = before(latency * 1000);
+
+    // pinhole camera, focal length in px from the field of view
+    const double focal = image_width / 2.0 / tan(to_rad(fov) / 2);
+    const double bearing = atan((image_width / 2.0 - blob.x_middle_coord) / focal);
+    if (object_width <= 0) {
+        sighting.bearing = wrap(offset.theta + bearing);
+        return sighting;
+    }
+
+    // depth along the camera's axis from the apparent width, then from the tracking center
+    const double depth = object_width * focal / blob.width;
+    const Point object = offset.p() + Point{depth, depth * tan(bearing)}.rotate(offset.theta);
+    sighting.bearing = atan2(object.y, object.x);
+    sighting.distance = object.dist({0.0, 0.0});
+    return sighting;
+}
+
+/* RangeSensor */
+RangeSensor::RangeSensor(uint8_t port, const Pose& offset)
+    : sensor(port), offset({offset.x, offset.y, to_rad(offset.theta)}) {}
+
+Sighting RangeSensor::sight() {
+    // 9999 with nothing in range, PROS_ERR when unplugged
+    const int32_t reading = sensor.get_distance();
+    const double distance = reading / 25.4;
+    if (reading >= 0 && reading != PROS_ERR && distance <= max_distance &&
+        (min_confidence <= 0 || sensor.get_confidence() >= min_confidence)) {
+        readings[count % readings.size()] = {distance, before(latency * 1000)};
+        count++;
+    }
+
+    // the median of the latest readings from the last 100 ms, with the time it was taken
+    const uint64_t oldest = before((latency + 100) * 1000);
+    std::array<std::pair<double, uint64_t>, 3> latest;
+    int n = 0;
+    for (int i = 0; i < std::min<int>(count, readings.size()); i++)
+        if (readings[i].second >= oldest) latest[n++] = readings[i];
+    if (n == 0) return {};
+    std::sort(latest.begin(), latest.begin() + n);
+    const auto& [range, time] = latest[(n - 1) / 2];
+    const Point object = offset.p() + Point{range, 0.0}.rotate(offset.theta);
+    return {true, atan2(object.y, object.x), object.dist({0.0, 0.0}), time};
+}
+
+double RangeSensor::reach(double range) const {
+    return (offset.p() + Point{range, 0.0}.rotate(offset.theta)).dist({0.0, 0.0});
+}
+
+/* MovingTarget */
+MovingTarget::MovingTarget(OdomBase& odom, std::function<Point()> position)
+    : odom(odom), position(std::move(position)) {}
+
+MovingTarget::MovingTarget(OdomBase& odom, const FieldObjects& objects, int id)
+    : odom(odom), objects(&objects), id(id) {}
+
+Sighting MovingTarget::sight() {
+    // an object is where it was last moved to, when it was moved
+    const uint64_t now = pros::micros();
+    Point target = {NAN, NAN};
+    uint64_t time = now;
+    bool moved;
+    if (objects) {
+        const std::optional<FieldObjects::Object> object = objects->get(id);
+        if (object) target = object->position, time = object->time * 1000ull;
+        moved = object && object->time != moved_at;
+        if (moved) moved_at = object->time;
+    } else {
+        if (position) target = position();
+        moved = target.x != last.x || target.y != last.y;
+    }
+    if (!std::isfinite(target.x) || !std::isfinite(target.y)) return {};
+
+    // the rates take new positions, and one that stays put every 100 ms, so a slow source doesn't
+    // read as stops and starts but a target that stops does
+    const bool stale = now - std::min(now, last_time) >= 100000;
+    if (moved || stale) {
+        if (!moved) time = now;
+        x_rate.update(target.x, time);
+        y_rate.update(target.y, time);
+        last = target, last_time = time;
+    }
+    if (lead > 0) {
+        const double ahead = lead / 1000 + (double)(now - std::min(now, last_time)) / 1e6;
+        target = target + velocity() * ahead;
+    }
+
+    // from where the robot is now
+    const Pose pose = odom.get();
+    const Point local = (target - pose.p()).rotate(-pose.theta);
+    return {true, atan2(local.y, local.x), local.dist({0.0, 0.0}), now};
+}
+
+Point MovingTarget::velocity() const { return {x_rate.get(), y_rate.get()}; }
+
+} // namespace appa
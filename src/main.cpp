@@ -49,8 +49,10 @@ void autonomous() {
     pros::delay(500);
 }
 
+appa::Controller master(CONTROLLER_MASTER);
+
 void opcontrol() {
-    pros::Controller master(CONTROLLER_MASTER);
+    master.start();
     bot.set_brake_mode(MOTOR_BRAKE_COAST);
     printf("opcontrol started\n");
 
@@ -0,0 +1,25 @@
+// host side run of the hot path benchmarks, built against the simulated PROS layer:
+//   g++ -std=gnu++20 -O2 -Itools/sim -Iinclude/appa src/appa/*.cpp tools/sim/sim.cpp
+//       tools/bench.cpp -o appa_bench
+//   ./appa_bench [iterations] [host MHz]
+// exits with 1 when the fixed point path is off the double one by more than its tolerance
+// on the brain call appa::bench::print(appa::bench::run()) from a task instead
+#include "appa.h"
+#include <chrono>
+
+static uint64_t host_micros() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv) {
+    const int iterations = argc >= 2 ? atoi(argv[1]) : 2000000;
+    const double mhz = argc >= 3 ? atof(argv[2]) : 3000.0;
+    printf("%d iterations, cycles at %.0f MHz\n", iterations, mhz);
+    const std::vector<appa::bench::Result> results = appa::bench::run(iterations, mhz, host_micros);
+    appa::bench::print(results);
+    bool failed = false;
+    for (const appa::bench::Result& result : results) failed |= result.deviation > result.tolerance;
+    fflush(stdout);
+    std::_Exit(failed ? 1 : 0);
+}
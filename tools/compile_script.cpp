@@ -0,0 +1,179 @@
+// host side compiler for autonomous scripts, built outside of PROS:
+//   g++ -std=c++20 -Iinclude/appa tools/compile_script.cpp -o compile_script
+//   ./compile_script auton.txt /media/sd/auton.scr
+// a line per step, # starts a comment, and a motion's options follow it as key=value or a flag:
+//   move 24                       relative straight (in)
+//   move 24 12                    to a point
+//   move 48 24 90 speed=80        to a pose (in, in, deg), boomerang
+//   turn 90                       to a heading (deg)
+//   turn 24 24 timeout=800        to face a point
+//   arc 18 90 reverse             radius (in) and angle (deg)
+//   follow 0,0 24,24 48,0 async   through the points
+//   wait                          for the last motion to end
+//   delay 250                     ms
+//   action intake_on              calls what Script::action registered by that name
+// options are speed, accel, decel, lead, lookahead, exit, exit_speed, settle, timeout and
+// dir=forward|reverse|ccw|cw, and the flags async, thru, forward and reverse
+#include "pathfile.h"
+#include <cstdlib>
+#include <string>
+
+using namespace appa;
+
+static int line_number = 0;
+
+static bool fail(const char* message, const std::string& token) {
+    printf("line %d: %s %s\n", line_number, message, token.c_str());
+    return false;
+}
+
+static bool number(const std::string& token, float& value) {
+    char* end = nullptr;
+    value = strtof(token.c_str(), &end);
+    return end != token.c_str() && *end == '\0';
+}
+
+static ScriptRecord record(ScriptRecord::Op op, float a = 0, float b = 0, float c = 0) {
+    ScriptRecord record{};
+    record.op = op;
+    record.values[0] = a, record.values[1] = b, record.values[2] = c;
+    return record;
+}
+
+// an option token as the OPTION record it compiles to
+static bool option(const std::string& token, std::vector<ScriptRecord>& out) {
+    static const struct {
+        const char* name;
+        ScriptRecord::Key key;
+    } keys[] = {{"speed", ScriptRecord::SPEED},
+                {"accel", ScriptRecord::ACCEL},
+                {"decel", ScriptRecord::DECEL},
+                {"lead", ScriptRecord::LEAD},
+                {"lookahead", ScriptRecord::LOOKAHEAD},
+                {"exit", ScriptRecord::EXIT},
+                {"exit_speed", ScriptRecord::EXIT_SPEED},
+                {"settle", ScriptRecord::SETTLE},
+                {"timeout", ScriptRecord::TIMEOUT}};
+    static const char* directions[] = {"auto", "forward", "reverse", "ccw", "cw"};
+
+    ScriptRecord set = record(ScriptRecord::OPTION, 1);
+    const size_t equals = token.find('=');
+    const std::string key = token.substr(0, equals);
+    const std::string value = equals == std::string::npos ? "" : token.substr(equals + 1);
+    if (equals == std::string::npos) { // flags
+        if (key == "async") set.key = ScriptRecord::ASYNC;
+        else if (key == "thru") set.key = ScriptRecord::THRU;
+        else if (key == "forward" || key == "reverse") {
+            set.key = ScriptRecord::DIR;
+            set.values[0] = key == "forward" ? 1 : 2;
+        } else return fail("unknown flag", token);
+        out.push_back(set);
+        return true;
+    }
+    if (key == "dir") {
+        set.key = ScriptRecord::DIR;
+        int i = 0;
+        while (i < 5 && value != directions[i]) i++;
+        if (i == 5) return fail("unknown direction", value);
+        set.values[0] = i;
+        out.push_back(set);
+        return true;
+    }
+    for (const auto& entry : keys) {
+        if (key != entry.name) continue;
+        set.key = entry.key;
+        if (!number(value, set.values[0])) return fail("not a number:", value);
+        out.push_back(set);
+        return true;
+    }
+    return fail("unknown option", key);
+}
+
+// one line as its records, options ahead of the motion they're for
+static bool compile(const std::vector<std::string>& tokens, std::vector<ScriptRecord>& out) {
+    const std::string& command = tokens[0];
+    std::vector<float> numbers;
+    std::vector<ScriptRecord> points;
+    size_t i = 1;
+    for (; i < tokens.size(); i++) {
+        const std::string& token = tokens[i];
+        const size_t comma = token.find(',');
+        float x, y;
+        if (command == "follow" && comma != std::string::npos) {
+            if (!number(token.substr(0, comma), x) || !number(token.substr(comma + 1), y))
+                return fail("not a point:", token);
+            points.push_back(record(ScriptRecord::POINT, x, y));
+        } else if (command != "action" && number(token, x)) numbers.push_back(x);
+        else break;
+    }
+    if (command == "action") {
+        if (tokens.size() != 2) return fail("action takes one name:", command);
+        if (tokens[1].size() > sizeof(ScriptRecord::name)) return fail("name too long:", tokens[1]);
+        ScriptRecord call = record(ScriptRecord::ACTION);
+        memset(call.name, 0, sizeof(call.name));
+        memcpy(call.name, tokens[1].data(), tokens[1].size());
+        out.push_back(call);
+        return true;
+    }
+    for (; i < tokens.size(); i++)
+        if (!option(tokens[i], out)) return false;
+
+    const size_t n = numbers.size();
+    auto count = [&](bool ok) { return ok || fail("wrong number of values for", command); };
+    if (command == "move") {
+        if (!count(n >= 1 && n <= 3)) return false;
+        const ScriptRecord::Op ops[] = {ScriptRecord::MOVE, ScriptRecord::MOVE_TO,
+                                        ScriptRecord::MOVE_POSE};
+        numbers.resize(3);
+        out.push_back(record(ops[n - 1], numbers[0], numbers[1], numbers[2]));
+    } else if (command == "turn") {
+        if (!count(n == 1 || n == 2)) return false;
+        numbers.resize(2);
+        out.push_back(record(n == 1 ? ScriptRecord::TURN : ScriptRecord::TURN_TO, numbers[0],
+                             numbers[1]));
+    } else if (command == "arc") {
+        if (!count(n == 2)) return false;
+        out.push_back(record(ScriptRecord::ARC, numbers[0], numbers[1]));
+    } else if (command == "follow") {
+        if (!count(n == 0) || points.size() < 2) return fail("follow needs two points or more", "");
+        ScriptRecord follow = record(ScriptRecord::FOLLOW);
+        follow.count = points.size();
+        out.push_back(follow);
+        out.insert(out.end(), points.begin(), points.end());
+    } else if (command == "wait") {
+        if (!count(n == 0)) return false;
+        out.push_back(record(ScriptRecord::WAIT));
+    } else if (command == "delay") {
+        if (!count(n == 1)) return false;
+        out.push_back(record(ScriptRecord::DELAY, numbers[0]));
+    } else return fail("unknown command", command);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        printf("usage: %s script.txt out.scr\n", argv[0]);
+        return 1;
+    }
+    FILE* file = fopen(argv[1], "r");
+    if (!file) {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<ScriptRecord> records;
+    bool ok = true;
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        if (char* comment = strchr(line, '#')) *comment = '\0';
+        std::vector<std::string> tokens;
+        for (char* token = strtok(line, " \t\r\n"); token; token = strtok(nullptr, " \t\r\n"))
+            tokens.push_back(token);
+        if (!tokens.empty()) ok &= compile(tokens, records);
+    }
+    fclose(file);
+    if (!ok) return 1;
+    if (!file::write(argv[2], file::script_magic, records.data(), records.size())) return 1;
+    printf("%zu records to %s\n", records.size(), argv[2]);
+    return 0;
+}
@@ -0,0 +1,191 @@
+// host side comparison of the path controllers on the simulated robot, built against the
+// simulated PROS layer:
+//   g++ -std=gnu++20 -O2 -Itools/sim -Iinclude/appa src/appa/*.cpp tools/sim/sim.cpp
+//       tools/controller_bench.cpp -o appa_controller_bench
+//   ./appa_controller_bench [route]   every route, or the ones whose name starts with route
+// runs a fixed set of routes with boomerang moves, mpc moves, pure pursuit, stanley and ramsete,
+// and pure pursuit again on the path saved to a file and loaded back, and prints a table of
+// completion time, final error against the simulated pose, peak acceleration and cpu per control
+// step, so releases can be compared on the same robot. runs that don't settle, or a loaded path
+// that doesn't match the one saved, are listed after the table, and fail the exit status
+#include "sim.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace appa;
+
+// the same robot as tools/sim/main.cpp
+static const Kinematics kinematics = {12.0, 3.25, 0.75, 600.0};
+
+Odom odom({2, 3}, {2, 1}, {13, 5}, 321.5, {2, 0}, 45);
+
+MoveConfig move_config(1.0, 85, 0.5, 6, {10, 0, 1}, {60, 0, 4}, 0.0, 0.0, {}, kinematics);
+TurnConfig turn_config(2.0, 50, {10, 0, 0});
+
+Chassis bot({-10, -9, 8, 3, -1}, {17, 19, -18, -12, 11}, odom, move_config, turn_config,
+            {.accel = 100});
+
+struct Route {
+    const char* name;
+    std::vector<Waypoint> waypoints; // the first is the start, headings in deg
+};
+
+// what autons drive most: straights, a turn onto a new heading, s curves and coming back
+static const std::vector<Route> routes = {
+    {"straight 72", {{{0, 0}, 0}, {{72, 0}, 0}}},
+    {"corner", {{{0, 0}, 0}, {{36, 0}}, {{48, 36}, 90}}},
+    {"s curve", {{{0, 0}, 0}, {{24, 24}}, {{48, 48}, 0}}},
+    {"u turn", {{{0, 0}, 0}, {{36, 6}}, {{36, 30}}, {{0, 36}, 180}}},
+    {"zigzag", {{{0, 0}, 0}, {{24, 18}}, {{48, -6}}, {{72, 18}}, {{96, 0}, 0}}},
+};
+
+enum Follower { BOOMERANG, MPC, PURE_PURSUIT, STANLEY, RAMSETE, LOADED };
+static const char* follower_names[] = {"boomerang", "mpc",     "pure pursuit",
+                                       "stanley",   "ramsete", "loaded path"};
+
+struct Run {
+    Chassis::Result reason = Chassis::RUNNING;
+    uint32_t time = 0;         // ms of virtual time
+    double error = NAN;        // in of the simulated pose from the end
+    double heading = NAN;      // deg
+    double peak_accel = 0.0;   // in/s² of the simulated robot
+    double step_ns = NAN;      // host cpu per control step, without the odom and physics
+};
+
+// the simulated robot's acceleration from its pose every 10 ms, while a run is going
+static std::atomic<bool> sampling{false};
+static double peak_accel = 0.0;
+
+static void sample() {
+    Point prev_position, prev_velocity;
+    bool primed = false, moving = false;
+    uint32_t now = pros::millis();
+    while (true) {
+        if (!sampling.load()) primed = moving = false;
+        else {
+            const Point position = sim::truth();
+            const Point velocity = (position - prev_position) * 100.0;
+            if (moving) peak_accel = std::max(peak_accel, velocity.dist(prev_velocity) * 100.0);
+            moving = primed;
+            primed = true;
+            prev_position = position;
+            prev_velocity = velocity;
+        }
+        pros::c::task_delay_until(&now, 10);
+    }
+}
+
+static double host_ns() {
+    using namespace std::chrono;
+    return duration<double, std::nano>(steady_clock::now().time_since_epoch()).count();
+}
+
+// puts the robot at the start of a route, still
+static void place(const Route& route) {
+    const Waypoint& start = route.waypoints.front();
+    sim::Config config;
+    config.drivetrain.left = {-10, -9, 8, 3, -1};
+    config.drivetrain.right = {17, 19, -18, -12, 11};
+    config.trackers = {{2, 3, 45.0, {-2, 0}, 321.5}, {2, 1, 135.0, {-2, 0}, 321.5}};
+    config.start = {start.point.x, start.point.y, start.heading};
+    sim::configure(config);
+    pros::delay(50);
+    odom.set(start.point, start.heading);
+    pros::delay(50);
+}
+
+static Chassis::MotionResult drive(const Route& route, Follower controller, const Path& path,
+                                   const Trajectory& trajectory) {
+    const Options options = {.timeout = 8000};
+    switch (controller) {
+    case BOOMERANG:
+    case MPC: {
+        // through each waypoint, arriving on the heading of the last one
+        Chassis::MotionResult result;
+        for (int i = 1; i < route.waypoints.size(); i++) {
+            const Waypoint& waypoint = route.waypoints[i];
+            const bool last = i + 1 == route.waypoints.size();
+            const Pose target = {waypoint.point.x, waypoint.point.y, last ? waypoint.heading : NAN};
+            const uint32_t time = result.time;
+            Options step = last ? Options{} : Options{.exit = 6, .thru = true};
+            step.mpc = controller == MPC;
+            result = bot.move(target, options, step);
+            result.time += time;
+        }
+        return result;
+    }
+    case PURE_PURSUIT:
+    case LOADED: return bot.follow(path, options);
+    case STANLEY: return bot.follow(path, options, {.stanley = 2.0});
+    default: return bot.track(trajectory, options);
+    }
+}
+
+// the path as Path::load reads it back from a file, so a loaded path follows like a built one
+static Path reload(const Path& path) {
+    static const char* name = "appa_controller_bench.path";
+    if (!path.save(name)) return Path(std::vector<Point>{});
+    Path loaded = Path::load(name);
+    std::remove(name);
+    return loaded;
+}
+
+static Run run(const Route& route, Follower controller, double idle_ns_per_ms) {
+    const Path built = Spline(route.waypoints).sample(1.0);
+    const Path path = controller == LOADED ? reload(built) : built;
+    if (path.size() != built.size() || path.get_cusps() != built.get_cusps()) return {};
+    const Trajectory trajectory = Trajectory::generate(
+        built, kinematics, {.velocity = 60, .accel = 80, .centripetal = 100});
+    place(route);
+
+    const uint32_t steps = bot.get_timing().count, start_time = sim::time();
+    peak_accel = 0.0;
+    sampling.store(true);
+    const double start = host_ns();
+    const Chassis::MotionResult result = drive(route, controller, path, trajectory);
+    const double cpu = host_ns() - start;
+    sampling.store(false);
+    const uint32_t time = sim::time() - start_time, count = bot.get_timing().count - steps;
+
+    const Waypoint& end = route.waypoints.back();
+    const Pose actual = sim::truth();
+    Run run = {result.reason, time, actual.p().dist(end.point), NAN, peak_accel, NAN};
+    if (!std::isnan(end.heading)) run.heading = to_deg(wrap(actual.theta - to_rad(end.heading)));
+    if (count > 0) run.step_ns = std::max(cpu - idle_ns_per_ms * time, 0.0) / count;
+    return run;
+}
+
+int main(int argc, char** argv) {
+    const char* only = argc >= 2 ? argv[1] : nullptr;
+    odom.start();
+    start_task(sample, {}, "sample_task");
+    place(routes.front());
+
+    // what the odom, physics and scheduler cost per ms of virtual time, taken out of the runs
+    const double idle_start = host_ns();
+    pros::delay(2000);
+    const double idle_ns_per_ms = (host_ns() - idle_start) / 2000;
+
+    static const char* reasons[] = {"running", "settled", "timed out", "exited", "stalled",
+                                    "cancelled"};
+    printf("%-12s %-13s %-9s %7s %8s %8s %10s %9s\n", "route", "controller", "result", "ms",
+           "error in", "deg", "accel in/s2", "ns/step");
+    std::vector<std::string> failed;
+    for (const Route& route : routes) {
+        if (only && strncmp(route.name, only, strlen(only))) continue;
+        for (const Follower controller : {BOOMERANG, MPC, PURE_PURSUIT, STANLEY, RAMSETE, LOADED}) {
+            const Run r = run(route, controller, idle_ns_per_ms);
+            printf("%-12s %-13s %-9s %7u %8.2f %8.2f %10.0f %9.0f\n", route.name,
+                   follower_names[controller], reasons[r.reason], (unsigned)r.time, r.error,
+                   r.heading, r.peak_accel, r.step_ns);
+            if (r.reason != Chassis::SETTLED)
+                failed.push_back(std::string(route.name) + " with " + follower_names[controller] +
+                                 " " + reasons[r.reason]);
+        }
+    }
+    for (const std::string& run : failed) printf("failed: %s\n", run.c_str());
+    fflush(stdout);
+    std::_Exit(failed.empty() ? 0 : 1); // the chassis and odom tasks are still parked on the simulated scheduler
+}
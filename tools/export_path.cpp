@@ -0,0 +1,86 @@
+// host side exporter for path and trajectory files, built outside of PROS:
+//   g++ -std=c++20 -Iinclude/appa tools/export_path.cpp -o export_path
+//   ./export_path path route.csv /media/sd/route.path
+//   ./export_path trajectory route.csv /media/sd/route.traj
+// path rows are "x,y" (in) or "x,y,theta,distance,curvature" (in, rad, 1/in)
+// trajectory rows are "time,x,y,theta,velocity,omega" (s, in, rad, in/s, rad/s)
+#include "pathfile.h"
+#include <cmath>
+#include <cstdlib>
+
+using namespace appa;
+
+static std::vector<std::vector<float>> read_csv(const char* name) {
+    std::vector<std::vector<float>> rows;
+    FILE* file = fopen(name, "r");
+    if (!file) {
+        printf("Could not open %s\n", name);
+        return rows;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        std::vector<float> row;
+        char* cursor = line;
+        char* end = nullptr;
+        for (float value = strtof(cursor, &end); end != cursor; value = strtof(cursor, &end)) {
+            row.push_back(value);
+            cursor = end + (*end == ',');
+        }
+        if (!row.empty()) rows.push_back(row);
+    }
+    fclose(file);
+    return rows;
+}
+
+// headings, distances and curvatures the same way as appa::Path does for points
+static std::vector<PathRecord> path_records(const std::vector<std::vector<float>>& rows) {
+    std::vector<PathRecord> records;
+    for (auto& row : rows) {
+        if (row.size() >= 5) {
+            records.push_back({row[0], row[1], row[2], row[3], row[4]});
+        } else if (row.size() >= 2) {
+            records.push_back({row[0], row[1], 0, 0, 0});
+        }
+    }
+    if (rows.empty() || rows[0].size() >= 5) return records;
+
+    for (int i = 0; i < records.size(); i++) {
+        const PathRecord& a = records[i > 0 ? i - 1 : 0];
+        const PathRecord& b = records[i > 0 ? i : std::min<int>(1, records.size() - 1)];
+        records[i].theta = atan2f(b.y - a.y, b.x - a.x);
+        if (i > 0) records[i].distance = records[i - 1].distance + hypotf(b.x - a.x, b.y - a.y);
+    }
+    for (int i = 1; i + 1 < (int)records.size(); i++) {
+        const PathRecord &a = records[i - 1], &b = records[i], &c = records[i + 1];
+        const float cross = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        const float sides = hypotf(b.x - a.x, b.y - a.y) * hypotf(c.x - b.x, c.y - b.y) *
+                            hypotf(a.x - c.x, a.y - c.y);
+        records[i].curvature = sides > 0 ? 2 * cross / sides : 0.0f;
+    }
+    return records;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        printf("Usage: %s path|trajectory input.csv output\n", argv[0]);
+        return 1;
+    }
+    const auto rows = read_csv(argv[2]);
+    bool ok = false;
+    if (!strcmp(argv[1], "path")) {
+        const auto records = path_records(rows);
+        ok = file::write(argv[3], file::path_magic, records.data(), records.size());
+        if (ok) printf("Wrote %zu path points to %s\n", records.size(), argv[3]);
+    } else if (!strcmp(argv[1], "trajectory")) {
+        std::vector<TrajectoryRecord> records;
+        for (auto& row : rows) {
+            if (row.size() < 6) continue;
+            records.push_back({row[0], row[1], row[2], row[3], row[4], row[5]});
+        }
+        ok = file::write(argv[3], file::trajectory_magic, records.data(), records.size());
+        if (ok) printf("Wrote %zu trajectory samples to %s\n", records.size(), argv[3]);
+    } else {
+        printf("Unknown file type %s\n", argv[1]);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+// host side replay of appa::OdomRecorder files through the odom integration, built against the
+// simulated PROS layer:
+//   g++ -std=gnu++20 -O2 -Itools/sim -Iinclude/appa src/appa/*.cpp tools/sim/sim.cpp
+//       tools/odom_replay.cpp -o appa_odom_replay
+//   ./appa_odom_replay odom_0.bin [odom_1.bin ...]  files of one log in order, as they roll over
+// every recording is replayed through each variant below, printing where it ended against the
+// pose truth() recorded and what a loop cost. change the library, or add variants, and run it
+// again on the same files to see whether the odom got better
+#include "appa.h"
+#include <chrono>
+
+using namespace appa;
+
+// the library's odom loop with the trackers and imus replaced by the recording
+using ReplayOdom = BasicOdom<NoTracker, NoTracker, Imu, AnyIntegrator>;
+
+struct Variant {
+    const char* name;
+    OdomBase::Integrator integrator;
+    bool weighted, gyro; // imu fusion settings
+};
+
+static const Variant variants[] = {
+    {"arc", OdomBase::ARC, false, false},
+    {"exponential", OdomBase::EXPONENTIAL, false, false},
+    {"arc, weighted imus", OdomBase::ARC, true, false},
+    {"arc, gyro", OdomBase::ARC, false, true},
+};
+
+struct Recording {
+    std::vector<OdomRecord> records;
+    Pose truth = {NAN, NAN, NAN};
+    int samples = 0, imus = 0;
+};
+
+static bool load(const char* name, std::vector<OdomRecord>& records) {
+    FILE* file = fopen(name, "rb");
+    if (!file) {
+        printf("Could not open %s\n", name);
+        return false;
+    }
+    OdomRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) records.push_back(record);
+    fclose(file);
+    return true;
+}
+
+// a recording runs from its tracking to its truth, samples outside of one belong to none
+static std::vector<Recording> split(const std::vector<OdomRecord>& records) {
+    std::vector<Recording> recordings;
+    bool open = false;
+    for (const OdomRecord& record : records) {
+        if (record.kind == OdomRecord::TRACKING) {
+            recordings.emplace_back();
+            open = true;
+        }
+        if (!open) continue;
+        Recording& recording = recordings.back();
+        if (record.kind == OdomRecord::TRUTH) {
+            recording.truth = {record.values[0], record.values[1], record.values[2]};
+            open = false;
+        } else if (record.kind <= OdomRecord::SET) {
+            recording.records.push_back(record);
+            if (record.kind != OdomRecord::SAMPLE) continue;
+            recording.samples++;
+            recording.imus = std::max<int>(recording.imus, record.imus);
+        } else printf("skipping a record of unknown kind %u\n", record.kind);
+    }
+    return recordings;
+}
+
+static void replay(const Recording& recording, const Variant& variant) {
+    // ports only name the simulated imus, the readings come from the recording
+    Imu imu(std::initializer_list<uint8_t>{});
+    for (int i = 0; i < recording.imus; i++) imu.imus.emplace_back(i + 1);
+    imu.weighted = variant.weighted;
+    imu.gyro = variant.gyro;
+    ReplayOdom odom({}, {}, std::move(imu), 1.0, {0.0, 0.0}, 0.0);
+    odom.set_integrator(variant.integrator);
+
+    using namespace std::chrono;
+    const auto start = steady_clock::now();
+    for (const OdomRecord& record : recording.records) odom.replay(record);
+    const double ns = duration<double, std::nano>(steady_clock::now() - start).count();
+
+    const Pose pose = odom.get(), truth = recording.truth;
+    printf("  %-20s {%8.2f, %8.2f, %8.2f}", variant.name, pose.x, pose.y, to_deg(pose.theta));
+    if (!std::isnan(truth.x)) {
+        printf("  error %6.2f in %6.2f deg", hypot(pose.x - truth.x, pose.y - truth.y),
+               to_deg(wrap(pose.theta - truth.theta)));
+    }
+    printf("  %7.0f ns per loop\n", ns / std::max(recording.samples, 1));
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s odom_0.bin [odom_1.bin ...]\n", argv[0]);
+        return 1;
+    }
+    std::vector<OdomRecord> records;
+    for (int i = 1; i < argc; i++) {
+        if (!load(argv[i], records)) return 1;
+    }
+
+    const std::vector<Recording> recordings = split(records);
+    for (int i = 0; i < recordings.size(); i++) {
+        const Recording& recording = recordings[i];
+        printf("recording %d: %d loops, %.1f s, %d imus", i, recording.samples,
+               recording.records.empty() ? 0.0 : recording.records.back().time / 1e6,
+               recording.imus);
+        const Pose truth = recording.truth;
+        if (!std::isnan(truth.x))
+            printf(", ended at {%.2f, %.2f, %.2f}", truth.x, truth.y, to_deg(truth.theta));
+        printf("\n");
+        for (const Variant& variant : variants) replay(recording, variant);
+    }
+    if (recordings.empty()) printf("no recordings found\n");
+    fflush(stdout);
+    std::_Exit(0);
+}
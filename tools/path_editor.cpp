@@ -0,0 +1,266 @@
+// host side path editor and previewer, built against the simulated PROS layer so paths and
+// trajectories come from the library's own spline, profile and trajectory code:
+//   g++ -std=gnu++20 -O2 -Itools/sim -Iinclude/appa src/appa/*.cpp tools/sim/sim.cpp
+//       tools/path_editor.cpp -o appa_path_editor
+//   ./appa_path_editor route.txt [--watch]
+// the route is a text file of waypoints "x y [heading]" (in, deg), # starts a comment, and
+// settings as "key = value":
+//   spacing                       in between the path's points (1)
+//   speed accel decel turn cusp   the path's velocity profile, as in PathProfile
+//   track wheel ratio rpm         the drivetrain, as in Kinematics (12, 3.25, 0.75, 600)
+//   velocity max_accel max_decel centripetal   the trajectory's limits, as in TrajectoryLimits
+//   image                         a field picture drawn under the preview
+//   field origin_x origin_y       in across the field (144), and where 0, 0 is from its corner
+// every run writes, next to the route, route.svg with the path over the field coloured by speed
+// and its velocity and curvature along it, route.path and route.traj for Path::load() and
+// Trajectory::load(), and route.h with the path as a constexpr PathTable. --watch writes them
+// again whenever the route is saved, so a browser showing the svg follows the edits
+#include "appa.h"
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace appa;
+
+struct Route {
+    std::vector<Waypoint> waypoints;
+    double spacing = 1.0;
+    PathProfile profile;
+    Kinematics kinematics = {12.0, 3.25, 0.75, 600.0};
+    TrajectoryLimits limits;
+    std::string image;
+    double field = 144.0, origin_x = 0.0, origin_y = 0.0;
+};
+
+static bool parse(const char* name, Route& route) {
+    FILE* file = fopen(name, "r");
+    if (!file) {
+        printf("Could not open %s\n", name);
+        return false;
+    }
+    const std::pair<const char*, double*> settings[] = {
+        {"spacing", &route.spacing},
+        {"speed", &route.profile.speed},
+        {"accel", &route.profile.accel},
+        {"decel", &route.profile.decel},
+        {"turn", &route.profile.turn},
+        {"cusp", &route.profile.cusp},
+        {"track", &route.kinematics.track_width},
+        {"wheel", &route.kinematics.wheel_diameter},
+        {"ratio", &route.kinematics.gear_ratio},
+        {"rpm", &route.kinematics.motor_rpm},
+        {"velocity", &route.limits.velocity},
+        {"max_accel", &route.limits.accel},
+        {"max_decel", &route.limits.decel},
+        {"centripetal", &route.limits.centripetal},
+        {"field", &route.field},
+        {"origin_x", &route.origin_x},
+        {"origin_y", &route.origin_y},
+    };
+    char line[256];
+    int number = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file)) {
+        number++;
+        if (char* comment = strchr(line, '#')) *comment = '\0';
+        char key[64], text[192];
+        if (sscanf(line, " %63[a-z_] = %191s", key, text) == 2) {
+            if (!strcmp(key, "image")) {
+                route.image = text;
+                continue;
+            }
+            bool known = false;
+            for (const auto& [setting, value] : settings) {
+                if (strcmp(key, setting)) continue;
+                *value = strtod(text, nullptr);
+                known = true;
+            }
+            if (!known) printf("line %d: unknown setting %s\n", number, key), ok = false;
+            continue;
+        }
+        double x, y, heading = NAN;
+        const int read = sscanf(line, "%lf %lf %lf", &x, &y, &heading);
+        if (read >= 2) route.waypoints.push_back({{x, y}, read == 3 ? heading : NAN});
+        else if (strspn(line, " \t\r\n") != strlen(line)) {
+            printf("line %d: expected a waypoint or a setting\n", number);
+            ok = false;
+        }
+    }
+    fclose(file);
+    if (ok && route.waypoints.size() < 2) {
+        printf("%s needs at least two waypoints\n", name);
+        ok = false;
+    }
+    return ok;
+}
+
+// blue when slow through red at the fastest
+static std::string colour(double speed, double fastest) {
+    const double share = fastest > 0 ? std::clamp(speed / fastest, 0.0, 1.0) : 0.0;
+    return "hsl(" + std::to_string((int)(240 * (1 - share))) + ",90%,45%)";
+}
+
+// a line chart of values along the path under the field, with its range in the corner
+static void chart(FILE* svg, const char* title, const std::vector<double>& x,
+                  const std::vector<double>& y, double top, double width, double height) {
+    double low = 0.0, high = 0.0;
+    for (double value : y) low = std::min(low, value), high = std::max(high, value);
+    if (high - low < 1e-9) high = low + 1;
+    const double span = std::max(x.back(), 1e-9);
+    fprintf(svg, "<rect x='0' y='%.1f' width='%.1f' height='%.1f' fill='#f4f4f4'/>\n", top,
+            width, height);
+    const double zero = top + height * high / (high - low);
+    fprintf(svg, "<line x1='0' y1='%.1f' x2='%.1f' y2='%.1f' stroke='#bbb'/>\n", zero, width, zero);
+    fprintf(svg, "<polyline fill='none' stroke='#333' stroke-width='1.5' points='");
+    for (size_t i = 0; i < x.size(); i++)
+        fprintf(svg, "%.1f,%.1f ", x[i] / span * width,
+                top + height * (high - y[i]) / (high - low));
+    fprintf(svg, "'/>\n<text x='4' y='%.1f' font-size='12'>%s, %.3g to %.3g</text>\n", top + 14,
+            title, low, high);
+}
+
+static bool render(const char* name) {
+    Route route;
+    if (!parse(name, route)) return false;
+    const Spline spline(route.waypoints);
+    const Path path = spline.sample(route.spacing, 12.0, route.profile);
+    const Trajectory trajectory = Trajectory::generate(path, route.kinematics, route.limits);
+
+    std::string base = name;
+    const size_t dot = base.rfind('.');
+    if (dot != std::string::npos && dot > base.find_last_of('/') + 1) base.resize(dot);
+
+    // summary, with the time each waypoint is reached at
+    double fastest = 0.0, sharpest = 0.0;
+    for (size_t i = 0; i < trajectory.size(); i++)
+        fastest = std::max(fastest, fabs(trajectory[i].velocity));
+    for (size_t i = 0; i < path.size(); i++) sharpest = std::max(sharpest, fabs(path.curvature(i)));
+    printf("%s: %zu points, %.1f in, %.2f s, peak %.1f in/s, sharpest radius %.1f in\n", name,
+           path.size(), path.length(), trajectory.duration(), fastest,
+           sharpest > 0 ? 1 / sharpest : INFINITY);
+    for (size_t i = 0; i < route.waypoints.size(); i++) {
+        // the nearer end of the closest segment
+        const Point waypoint = route.waypoints[i].point;
+        int point = path.closest(waypoint);
+        if (point + 1 < (int)path.size() &&
+            Point(path[point + 1]).dist(waypoint) < Point(path[point]).dist(waypoint))
+            point++;
+        printf("  waypoint %zu {%.1f, %.1f} at %.1f in, %.2f s\n", i, waypoint.x, waypoint.y,
+               path.distance(point),
+               point < (int)trajectory.size() ? trajectory[point].time : NAN);
+    }
+
+    // the field 4 px per inch with y up, then the charts under it
+    const double scale = 4.0, size = route.field * scale, chart_height = 120.0;
+    auto px = [&](const Point& p) {
+        return Point{(p.x + route.origin_x) * scale, size - (p.y + route.origin_y) * scale};
+    };
+    FILE* svg = fopen((base + ".svg").c_str(), "w");
+    if (!svg) {
+        printf("Could not write %s.svg\n", base.c_str());
+        return false;
+    }
+    fprintf(svg,
+            "<svg xmlns='http://www.w3.org/2000/svg' width='%.0f' height='%.0f' "
+            "font-family='sans-serif'>\n",
+            size, size + 2 * chart_height + 20);
+    if (!route.image.empty())
+        fprintf(svg, "<image href='%s' width='%.0f' height='%.0f' opacity='0.6'/>\n",
+                route.image.c_str(), size, size);
+    else fprintf(svg, "<rect width='%.0f' height='%.0f' fill='#e8e8e8'/>\n", size, size);
+    for (double tile = 0; tile <= route.field; tile += 24)
+        fprintf(svg,
+                "<path d='M%.0f 0V%.0fM0 %.0fH%.0f' stroke='#999' stroke-width='0.5'/>\n",
+                tile * scale, size, tile * scale, size);
+    for (size_t i = 1; i < path.size(); i++) {
+        const Point a = px(path[i - 1]), b = px(path[i]);
+        const double speed = i < trajectory.size() ? fabs(trajectory[i].velocity) : 0.0;
+        fprintf(svg,
+                "<line x1='%.1f' y1='%.1f' x2='%.1f' y2='%.1f' stroke='%s' stroke-width='3'/>\n",
+                a.x, a.y, b.x, b.y, colour(speed, fastest).c_str());
+    }
+    for (size_t i = 0; i < route.waypoints.size(); i++) {
+        const Waypoint& waypoint = route.waypoints[i];
+        const Point p = px(waypoint.point);
+        fprintf(svg, "<circle cx='%.1f' cy='%.1f' r='5' fill='white' stroke='black'/>\n", p.x, p.y);
+        if (!std::isnan(waypoint.heading)) {
+            const Point tip = p + Point{cos(to_rad(waypoint.heading)),
+                                        -sin(to_rad(waypoint.heading))} * 16;
+            fprintf(svg, "<line x1='%.1f' y1='%.1f' x2='%.1f' y2='%.1f' stroke='black'/>\n", p.x,
+                    p.y, tip.x, tip.y);
+        }
+        fprintf(svg, "<text x='%.1f' y='%.1f' font-size='12'>%zu</text>\n", p.x + 7, p.y - 7, i);
+    }
+    fprintf(svg, "<text x='4' y='%.0f' font-size='12'>%.1f in, %.2f s, peak %.1f in/s</text>\n",
+            size - 6, path.length(), trajectory.duration(), fastest);
+
+    std::vector<double> distances, velocities, curvatures;
+    for (size_t i = 0; i < path.size() && i < trajectory.size(); i++) {
+        distances.push_back(path.distance(i));
+        velocities.push_back(trajectory[i].velocity);
+        curvatures.push_back(path.curvature(i));
+    }
+    chart(svg, "velocity (in/s) by distance", distances, velocities, size + 10, size,
+          chart_height);
+    chart(svg, "curvature (1/in) by distance", distances, curvatures, size + chart_height + 20,
+          size, chart_height);
+    fprintf(svg, "</svg>\n");
+    fclose(svg);
+
+    // the same path as a table in flash, so the brain builds nothing but the grid and profile
+    std::string symbol = base.substr(base.find_last_of('/') + 1);
+    for (char& c : symbol)
+        if (!isalnum((unsigned char)c)) c = '_';
+    if (symbol.empty() || isdigit((unsigned char)symbol[0])) symbol = "route_" + symbol;
+    FILE* source = fopen((base + ".h").c_str(), "w");
+    if (!source) {
+        printf("Could not write %s.h\n", base.c_str());
+        return false;
+    }
+    fprintf(source, "// generated by tools/path_editor.cpp from %s, %.2f s at its limits\n", name,
+            trajectory.duration());
+    fprintf(source, "#pragma once\n\n#include \"appa/appa.h\"\n\n");
+    fprintf(source, "static constexpr appa::PathTable<%zu> %s = {\n    {{\n", path.size(),
+            symbol.c_str());
+    for (size_t i = 0; i < path.size(); i++)
+        fprintf(source, "        appa::Pose(%.9g, %.9g, %.9g),\n", (double)path[i].x,
+                (double)path[i].y, (double)path[i].theta);
+    fprintf(source, "    }},\n    {{");
+    for (size_t i = 0; i < path.size(); i++)
+        fprintf(source, "%s%.9g,", i % 8 ? " " : "\n        ", path.distance(i));
+    fprintf(source, "\n    }},\n    {{");
+    for (size_t i = 0; i < path.size(); i++)
+        fprintf(source, "%s%.9g,", i % 8 ? " " : "\n        ", path.curvature(i));
+    fprintf(source, "\n    }}};\n");
+    fclose(source);
+
+    const bool saved = path.save((base + ".path").c_str()) &&
+                       trajectory.save((base + ".traj").c_str());
+    if (!saved) printf("Could not write %s.path or %s.traj\n", base.c_str(), base.c_str());
+    else printf("Wrote %s.svg, .path, .traj and .h\n", base.c_str());
+    return saved;
+}
+
+static long long modified(const char* name) {
+    struct stat info;
+    return stat(name, &info) == 0 ? (long long)info.st_mtime : -1;
+}
+
+int main(int argc, char** argv) {
+    const bool watch = argc == 3 && !strcmp(argv[2], "--watch");
+    if (argc != 2 && !watch) {
+        printf("usage: %s route.txt [--watch]\n", argv[0]);
+        return 1;
+    }
+    bool ok = render(argv[1]);
+    for (long long seen = modified(argv[1]); watch;) {
+        fflush(stdout);
+        usleep(250000);
+        const long long now = modified(argv[1]);
+        if (now == seen) continue;
+        seen = now;
+        ok = render(argv[1]);
+    }
+    fflush(stdout);
+    std::_Exit(ok ? 0 : 1);
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+// host stand-in for the parts of the PROS api that appa uses, backed by the simulator in sim.cpp
+// tasks run one at a time on a virtual clock, so a run is deterministic and faster than real time
+// the standard headers are the ones the PROS api brings in for appa
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#define PROS_ERR (INT32_MAX)
+#define PROS_ERR_F (INFINITY)
+#define PROS_ERR_BYTE (INT8_MAX)
+#define TIMEOUT_MAX ((uint32_t)0xffffffffUL)
+#define TASK_PRIORITY_MAX 16
+#define TASK_PRIORITY_MIN 1
+#define TASK_PRIORITY_DEFAULT 8
+#define TASK_STACK_DEPTH_DEFAULT 0x2000
+
+namespace sim {
+struct Access;
+} // namespace sim
+
+namespace pros {
+typedef void* task_t;
+
+uint32_t millis();
+uint64_t micros();
+void delay(uint32_t milliseconds);
+
+namespace c {
+void task_delay_until(uint32_t* prev_time, uint32_t delta);
+uint32_t task_notify(task_t task);
+uint32_t task_notify_take(bool clear_on_exit, uint32_t timeout);
+bool task_notify_clear(task_t task);
+task_t task_get_current();
+const char* task_get_name(task_t task);
+} // namespace c
+
+/* Tasks */
+class Task {
+    task_t task;
+
+  public:
+    Task(std::function<void()> function, uint32_t prio = TASK_PRIORITY_DEFAULT,
+         uint16_t stack_depth = TASK_STACK_DEPTH_DEFAULT, const char* name = "");
+    Task(std::function<void()> function, const char* name);
+    explicit Task(task_t task) : task(task) {}
+    void remove();
+    uint32_t notify();
+    explicit operator task_t() { return task; }
+};
+
+class Mutex {
+    friend struct sim::Access;
+    task_t owner = nullptr;
+
+  public:
+    bool take(uint32_t timeout = TIMEOUT_MAX);
+    bool give();
+    void lock() { take(); }
+    void unlock() { give(); }
+    bool try_lock() { return take(0); }
+};
+
+/* Motors */
+typedef enum motor_brake_mode_e {
+    E_MOTOR_BRAKE_COAST = 0,
+    E_MOTOR_BRAKE_BRAKE = 1,
+    E_MOTOR_BRAKE_HOLD = 2,
+    E_MOTOR_BRAKE_INVALID = INT32_MAX
+} motor_brake_mode_e_t;
+
+enum class MotorBrake { coast = 0, brake = 1, hold = 2, invalid = INT32_MAX };
+enum class MotorGears {
+    ratio_36_to_1 = 0,
+    red = ratio_36_to_1,
+    ratio_18_to_1 = 1,
+    green = ratio_18_to_1,
+    ratio_6_to_1 = 2,
+    blue = ratio_6_to_1,
+    invalid = INT32_MAX
+};
+
+class MotorGroup {
+    std::vector<int8_t> ports;
+
+  public:
+    MotorGroup(std::initializer_list<int8_t> ports, MotorGears gearset = MotorGears::blue);
+    int32_t move_voltage(int32_t voltage) const; // mV
+    int32_t set_brake_mode_all(MotorBrake mode) const;
+    int32_t set_brake_mode_all(motor_brake_mode_e_t mode) const;
+    MotorBrake get_brake_mode(uint8_t index = 0) const;
+    int32_t size() const;
+    double get_actual_velocity(uint8_t index = 0) const; // rpm
+    double get_position(uint8_t index = 0) const;        // degrees
+    MotorGears get_gearing(uint8_t index = 0) const;
+    int32_t get_current_draw(uint8_t index = 0) const; // mA
+    int32_t set_current_limit_all(int32_t limit) const; // mA
+    int32_t get_current_limit(uint8_t index = 0) const; // mA
+    double get_efficiency(uint8_t index = 0) const;    // %
+    double get_temperature(uint8_t index = 0) const;   // °C
+    int32_t is_over_temp(uint8_t index = 0) const;
+    int8_t get_port(uint8_t index = 0) const;
+    std::vector<double> get_actual_velocity_all() const; // rpm
+    std::vector<double> get_position_all() const;        // degrees
+    std::vector<MotorGears> get_gearing_all() const;
+    std::vector<int32_t> get_current_draw_all() const; // mA
+};
+
+/* Sensors */
+enum class ImuStatus { ready = 0, calibrating = 19, error = 0xFF };
+struct imu_gyro_s_t {
+    double x, y, z; // deg/s
+};
+struct imu_accel_s_t {
+    double x, y, z; // g
+};
+
+class Imu {
+    uint8_t port;
+
+  public:
+    Imu(uint8_t port);
+    int32_t reset(bool blocking = false) const;
+    int32_t set_data_rate(uint32_t rate) const;
+    bool is_calibrating() const;
+    ImuStatus get_status() const;
+    double get_rotation() const; // deg clockwise
+    imu_gyro_s_t get_gyro_rate() const;
+    imu_accel_s_t get_accel() const;
+    double get_pitch() const; // deg
+    double get_roll() const;  // deg
+    int32_t set_rotation(double rotation) const;
+    uint8_t get_port() const { return port; }
+};
+
+struct gps_status_s_t {
+    double x, y;             // m from the field center
+    double pitch, roll, yaw; // deg, yaw clockwise from the field's y axis
+};
+
+class Gps {
+    uint8_t port;
+
+  public:
+    Gps(uint8_t port);
+    gps_status_s_t get_position_and_orientation() const;
+    double get_error() const; // m
+};
+
+class Distance {
+    uint8_t port;
+
+  public:
+    Distance(uint8_t port);
+    int32_t get_distance();   // mm, 9999 with nothing in range
+    int32_t get_confidence(); // 0 to 63
+};
+
+#define VISION_OBJECT_ERR_SIG 255
+typedef enum vision_zero { E_VISION_ZERO_TOPLEFT = 0, E_VISION_ZERO_CENTER = 1 } vision_zero_e_t;
+struct vision_object_s_t {
+    uint16_t signature; // VISION_OBJECT_ERR_SIG when there is no such object
+    int16_t left_coord, top_coord, width, height; // px
+    int16_t x_middle_coord, y_middle_coord;        // px
+};
+
+class Vision {
+    uint8_t port;
+
+  public:
+    Vision(uint8_t port, vision_zero_e_t zero_point = E_VISION_ZERO_TOPLEFT);
+    // the size_id'th largest object of a signature in the latest frame
+    vision_object_s_t get_by_sig(uint32_t size_id, uint32_t sig_id) const;
+};
+
+class Rotation {
+    uint8_t port;
+
+  public:
+    Rotation(int8_t port);
+    int32_t set_data_rate(uint32_t rate) const;
+    int32_t get_position() const; // centidegrees
+};
+
+class Optical {
+    uint8_t port;
+
+  public:
+    Optical(uint8_t port);
+    double get_brightness();
+    int32_t set_led_pwm(uint8_t value);
+};
+
+namespace adi {
+using ext_adi_port_tuple_t = std::tuple<uint8_t, uint8_t, uint8_t>;
+
+class AnalogIn {
+    uint8_t adi_port;
+
+  public:
+    explicit AnalogIn(uint8_t adi_port);
+    int32_t get_value() const; // 0 to 4095
+};
+using LineSensor = AnalogIn;
+
+class DigitalIn {
+    uint8_t adi_port;
+
+  public:
+    explicit DigitalIn(uint8_t adi_port);
+    int32_t get_value() const; // 0 or 1, sim::set_input
+};
+
+class Encoder {
+    uint8_t smart_port, adi_port;
+    bool reversed;
+
+  public:
+    Encoder(uint8_t adi_port_top, uint8_t adi_port_bottom, bool reversed = false);
+    Encoder(ext_adi_port_tuple_t port_tuple, bool reversed = false);
+    int32_t get_value() const; // ticks
+};
+} // namespace adi
+
+class Serial {
+    uint8_t port;
+
+  public:
+    Serial(uint8_t port, int32_t baudrate);
+    int32_t get_read_avail() const;
+    int32_t read(uint8_t* buffer, int32_t length) const;
+    int32_t get_write_free() const;
+    int32_t write(uint8_t* buffer, int32_t length) const;
+};
+
+typedef enum link_type_e { E_LINK_RECIEVER = 0, E_LINK_TRANSMITTER } link_type_e_t;
+constexpr link_type_e_t E_LINK_RX = E_LINK_RECIEVER, E_LINK_TX = E_LINK_TRANSMITTER;
+
+// radios with the same link id pass packets to each other
+class Link {
+    uint8_t port;
+    std::string id;
+
+  public:
+    Link(uint8_t port, const std::string link_id, link_type_e_t type, bool ov = true);
+    bool connected();
+    uint32_t raw_receivable_size();
+    uint32_t transmit(void* data, uint16_t data_size);
+    uint32_t receive(void* dest, uint16_t data_size); // PROS_ERR without a whole packet
+};
+
+namespace battery {
+int32_t get_voltage(); // mV
+int32_t get_current(); // mA
+} // namespace battery
+
+namespace competition {
+uint8_t is_disabled();
+} // namespace competition
+
+/* Controller */
+typedef enum { E_CONTROLLER_MASTER = 0, E_CONTROLLER_PARTNER } controller_id_e_t;
+typedef enum {
+    E_CONTROLLER_ANALOG_LEFT_X = 0,
+    E_CONTROLLER_ANALOG_LEFT_Y,
+    E_CONTROLLER_ANALOG_RIGHT_X,
+    E_CONTROLLER_ANALOG_RIGHT_Y
+} controller_analog_e_t;
+typedef enum {
+    E_CONTROLLER_DIGITAL_L1 = 6,
+    E_CONTROLLER_DIGITAL_L2,
+    E_CONTROLLER_DIGITAL_R1,
+    E_CONTROLLER_DIGITAL_R2,
+    E_CONTROLLER_DIGITAL_UP,
+    E_CONTROLLER_DIGITAL_DOWN,
+    E_CONTROLLER_DIGITAL_LEFT,
+    E_CONTROLLER_DIGITAL_RIGHT,
+    E_CONTROLLER_DIGITAL_X,
+    E_CONTROLLER_DIGITAL_B,
+    E_CONTROLLER_DIGITAL_Y,
+    E_CONTROLLER_DIGITAL_A
+} controller_digital_e_t;
+
+class Controller {
+    controller_id_e_t id;
+
+  public:
+    explicit Controller(controller_id_e_t id);
+    int32_t is_connected();
+    int32_t get_analog(controller_analog_e_t channel);
+    int32_t get_digital(controller_digital_e_t button);
+    int32_t get_digital_new_press(controller_digital_e_t button);
+};
+} // namespace pros
+
+#define MOTOR_BRAKE_COAST pros::E_MOTOR_BRAKE_COAST
+#define MOTOR_BRAKE_BRAKE pros::E_MOTOR_BRAKE_BRAKE
+#define MOTOR_BRAKE_HOLD pros::E_MOTOR_BRAKE_HOLD
+#define CONTROLLER_MASTER pros::E_CONTROLLER_MASTER
+#define CONTROLLER_PARTNER pros::E_CONTROLLER_PARTNER
+#define ANALOG_LEFT_X pros::E_CONTROLLER_ANALOG_LEFT_X
+#define ANALOG_LEFT_Y pros::E_CONTROLLER_ANALOG_LEFT_Y
+#define ANALOG_RIGHT_X pros::E_CONTROLLER_ANALOG_RIGHT_X
+#define ANALOG_RIGHT_Y pros::E_CONTROLLER_ANALOG_RIGHT_Y
+#define DIGITAL_L1 pros::E_CONTROLLER_DIGITAL_L1
+#define DIGITAL_L2 pros::E_CONTROLLER_DIGITAL_L2
+#define DIGITAL_R1 pros::E_CONTROLLER_DIGITAL_R1
+#define DIGITAL_R2 pros::E_CONTROLLER_DIGITAL_R2
+#define DIGITAL_UP pros::E_CONTROLLER_DIGITAL_UP
+#define DIGITAL_DOWN pros::E_CONTROLLER_DIGITAL_DOWN
+#define DIGITAL_LEFT pros::E_CONTROLLER_DIGITAL_LEFT
+#define DIGITAL_RIGHT pros::E_CONTROLLER_DIGITAL_RIGHT
+#define DIGITAL_X pros::E_CONTROLLER_DIGITAL_X
+#define DIGITAL_B pros::E_CONTROLLER_DIGITAL_B
+#define DIGITAL_Y pros::E_CONTROLLER_DIGITAL_Y
+#define DIGITAL_A pros::E_CONTROLLER_DIGITAL_A
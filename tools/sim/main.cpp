@@ -0,0 +1,81 @@
+// host simulator for autons and tunings, built outside of PROS:
+//   g++ -std=gnu++20 -O2 -Itools/sim -Iinclude/appa src/appa/*.cpp tools/sim/*.cpp -o appa_sim
+//   ./appa_sim           runs the routine with the gains below
+//   ./appa_sim 12 0 2    runs it with linear p, i and d from the command line
+// everything runs on a virtual clock, so a run takes milliseconds and is the same every time
+#include "sim.h"
+#include <cstdlib>
+
+// the same robot as src/main.cpp, with ports the simulated sensors are wired to
+appa::Odom odom({2, 3},  // x tracker port
+                {2, 1},  // y tracker port
+                {13, 5}, // imu port(s)
+                321.5,   // encoder ticks per unit (inches)
+                {2, 0},  // tracker linear offset (inches)
+                45);     // tracker angular offset (degrees)
+
+appa::MoveConfig move_config(1.0,        // exit (inches)
+                             85,         // speed (%)
+                             0.5,        // lead (%)
+                             6,          // lookahead (inches)
+                             {10, 0, 1}, // linear pid gains
+                             {60, 0, 4}, // angular pid gains
+                             0.0,        // track width, from the kinematics
+                             0.0,        // velocity, from the kinematics
+                             {},         // feedforward
+                             {12.0, 3.25, 0.75, 600.0}); // kinematics, for estimates
+
+appa::TurnConfig turn_config(2.0,         // exit (degrees)
+                             50,          // speed (%)
+                             {10, 0, 0}); // angular pid gains
+
+appa::Chassis bot({-10, -9, 8, 3, -1},    // left motors
+                  {17, 19, -18, -12, 11}, // right motors
+                  odom,                   // odom
+                  move_config,            // move configuration
+                  turn_config,            // turn configuration
+                  {.accel = 100});        // default options
+
+static void report(const char* name, const appa::Chassis::MotionResult& result, double estimate) {
+    static const char* reasons[] = {"running", "settled", "timed out", "exited", "stalled",
+                                    "cancelled"};
+    const appa::Pose pose = odom.get(), actual = sim::truth();
+    printf("%-10s %-9s %5u ms (est %5.0f)  error %6.2f  peak %6.1f  odom {%6.2f, %6.2f, %7.2f}  "
+           "actual {%6.2f, %6.2f, %7.2f}\n",
+           name, reasons[result.reason], (unsigned)result.time, estimate, result.error,
+           result.peak_speed, pose.x, pose.y, appa::to_deg(pose.theta), actual.x, actual.y,
+           appa::to_deg(actual.theta));
+}
+
+int main(int argc, char** argv) {
+    // trackers 2in behind the drive center, so the odom offset points at it, measuring along the
+    // odom's 45 degree offset axes
+    sim::Config config;
+    config.drivetrain.left = {-10, -9, 8, 3, -1};
+    config.drivetrain.right = {17, 19, -18, -12, 11};
+    config.trackers = {{2, 3, 45.0, {-2, 0}, 321.5}, {2, 1, 135.0, {-2, 0}, 321.5}};
+    sim::configure(config);
+
+    appa::Gains gains{10, 0, 1};
+    if (argc >= 2)
+        gains = {atof(argv[1]), argc >= 3 ? atof(argv[2]) : 0.0, argc >= 4 ? atof(argv[3]) : 0.0};
+    printf("linear gains {%.3f, %.3f, %.3f}\n", gains.p, gains.i, gains.d);
+
+    odom.start();
+    const appa::Options options = {.timeout = 4000, .lin_PID = gains};
+    const char* names[] = {"move 24", "turn 90", "move pose", "back 12", "turn 0"};
+    const appa::Chassis::Prepared routine[] = {
+        bot.prepare_move({24, 0}, options), bot.prepare_turn(90, {.timeout = 3000}),
+        bot.prepare_move({48, 24, 90}, options), bot.prepare_move(-12, options),
+        bot.prepare_turn(0, {.timeout = 3000})};
+    printf("estimated %.0f ms\n", bot.estimate(routine).time);
+    for (int i = 0; i < 5; i++) {
+        const double estimate = bot.estimate(routine[i]).time;
+        report(names[i], bot.run(routine[i]), estimate);
+    }
+    printf("done at %u ms of virtual time\n", (unsigned)sim::time());
+    appa::bench::print("odom", odom.get_timing());
+    appa::bench::print("motion", bot.get_timing());
+    fflush(stdout);
+    std::_Exit(0); // the chassis and odom tasks are still parked on the simulated scheduler
+}
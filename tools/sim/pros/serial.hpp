@@ -0,0 +1,4 @@
+#pragma once
+
+// pros::Serial is part of the simulated api
+#include "api.h"
@@ -0,0 +1,893 @@
+#include "sim.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <random>
+#include <thread>
+
+namespace sim {
+
+/* Scheduler */
+// every task is a thread, but only the one holding current runs, so runs are deterministic.
+// when every task is waiting the clock jumps to the next wake up and the physics catch up
+struct TaskRecord {
+    enum State { READY, SLEEPING, NOTIFY, MUTEX, DONE };
+    uint32_t priority;
+    State state = READY;
+    uint64_t wake = 0;  // us, for sleeping and timed waits
+    bool timed = false; // wake is a timeout for notify and mutex waits
+    uint32_t notify_value = 0;
+    const pros::Mutex* mutex = nullptr;
+    uint64_t order = 0; // round robin between equal priorities
+    uint16_t depth = 0; // words asked for
+    std::string name = "main";
+    std::condition_variable cv;
+};
+
+struct Scheduler {
+    std::mutex lock;
+    std::vector<TaskRecord*> tasks;
+    TaskRecord* current = nullptr;
+    uint64_t now = 0; // us
+    uint64_t order = 0;
+};
+
+// never destroyed, tasks that were never removed are still parked on it at exit. built on first
+// use, since devices and tasks are made by static constructors in other files
+static Scheduler& scheduler() {
+    static Scheduler* scheduler = new Scheduler;
+    return *scheduler;
+}
+static thread_local TaskRecord* self = nullptr;
+
+struct Access {
+    static bool owned(const pros::Mutex* mutex) { return mutex->owner != nullptr; }
+};
+
+static void step(uint64_t dt);
+
+static bool runnable(const TaskRecord* task, uint64_t now) {
+    switch (task->state) {
+    case TaskRecord::READY: return true;
+    case TaskRecord::SLEEPING: return task->wake <= now;
+    case TaskRecord::NOTIFY: return task->notify_value > 0 || (task->timed && task->wake <= now);
+    case TaskRecord::MUTEX:
+        return !Access::owned(task->mutex) || (task->timed && task->wake <= now);
+    default: return false;
+    }
+}
+
+static TaskRecord* choose() {
+    TaskRecord* next = nullptr;
+    for (TaskRecord* task : scheduler().tasks) {
+        if (!runnable(task, scheduler().now)) continue;
+        if (!next || task->priority > next->priority ||
+            (task->priority == next->priority && task->order < next->order))
+            next = task;
+    }
+    return next;
+}
+
+// advances the clock to the next timed wake up, stepping the physics every ms on the way
+static void advance() {
+    uint64_t wake = UINT64_MAX;
+    for (TaskRecord* task : scheduler().tasks) {
+        const bool timed_wait =
+            (task->state == TaskRecord::NOTIFY || task->state == TaskRecord::MUTEX) && task->timed;
+        if (task->state == TaskRecord::SLEEPING || timed_wait) wake = std::min(wake, task->wake);
+    }
+    if (wake == UINT64_MAX) {
+        printf("sim: every task is blocked forever at %llu ms\n",
+               (unsigned long long)(scheduler().now / 1000));
+        fflush(stdout);
+        std::_Exit(1);
+    }
+    uint64_t& now = scheduler().now;
+    while (now < wake) {
+        const uint64_t dt = std::min<uint64_t>(1000 - now % 1000, wake - now);
+        now += dt;
+        step(dt);
+    }
+}
+
+// hands over to the next runnable task after the current one changed its state
+static void yield(std::unique_lock<std::mutex>& lock) {
+    TaskRecord* me = self;
+    me->order = ++scheduler().order;
+    TaskRecord* next;
+    while (!(next = choose())) advance();
+    next->state = TaskRecord::READY;
+    scheduler().current = next;
+    if (next == me) return;
+    next->cv.notify_one();
+    if (me->state == TaskRecord::DONE) return;
+    me->cv.wait(lock, [me] { return scheduler().current == me; });
+}
+
+// the first thread to use the api, normally main during static initialization, is a task too
+static TaskRecord* current_task(std::unique_lock<std::mutex>& lock) {
+    if (self) return self;
+    self = new TaskRecord{TASK_PRIORITY_DEFAULT};
+    self->order = ++scheduler().order;
+    scheduler().tasks.push_back(self);
+    if (scheduler().current == nullptr) scheduler().current = self;
+    else self->cv.wait(lock, [] { return scheduler().current == self; });
+    return self;
+}
+
+static void wait(std::unique_lock<std::mutex>& lock, TaskRecord::State state, uint64_t wake,
+                 bool timed) {
+    TaskRecord* me = current_task(lock);
+    me->state = state;
+    me->wake = wake;
+    me->timed = timed;
+    yield(lock);
+}
+
+/* Devices */
+struct Side {
+    double voltage = 0.0;  // mV, forward
+    double velocity = 0.0; // in/s
+    double position = 0.0; // in
+    bool coast = true;
+};
+
+struct Imu {
+    double offset = 0.0; // deg, added to the reported rotation
+    double sample = 0.0; // deg clockwise, the latest reading
+    double rate = 0.0;   // deg/s clockwise
+    double pitch = 0.0, roll = 0.0; // deg, the latest reading
+    uint32_t data_rate = 10;
+    uint64_t calibrated = 0; // us when calibration finishes
+};
+
+struct World {
+    Config config;
+    appa::Pose pose = {0, 0, 0}; // in and rad
+    double turned = 0.0;         // rad, unwrapped
+    double linear = 0.0;         // in/s of the previous step
+    appa::Point accel = {0, 0};  // in/s², forward and left
+    double pitch = 0.0, roll = 0.0; // deg the robot leans, settling over 0.1 s
+    Side left, right;
+    std::map<int, double> ticks;     // by tracker key
+    std::map<int, pros::MotorBrake> brakes; // by motor port
+    std::map<int, int32_t> limits;          // mA by motor port, 2500 until set
+    std::map<int, double> commands;  // mV by motor port, positive rolls the motor forward
+    std::map<int, double> temperatures; // °C by motor port
+    std::map<int, Imu> imus;
+    std::deque<std::pair<uint64_t, appa::Pose>> poses; // us, the recent truth for sensor latency
+    appa::Pose fix = {NAN, NAN, NAN};                   // in and rad, the latest gps fix
+    std::vector<pros::vision_object_s_t> frame;         // the latest vision frame, largest first
+    std::mt19937 random{1};                              // the same noise every run
+    std::map<int, std::vector<uint8_t>> serial; // by smart port
+    std::map<int, std::deque<uint8_t>> serial_in;
+    struct Packet {
+        uint8_t from;
+        uint64_t arrives; // us
+        std::vector<uint8_t> data;
+    };
+    std::map<std::string, std::vector<Packet>> links;   // in flight, by link id
+    std::map<std::string, std::vector<uint8_t>> radios; // ports of each link id
+    std::array<int32_t, 4> analog{};
+    uint16_t buttons = 0, pressed = 0;
+    uint8_t inputs = 0; // bit per adi port from 'A'
+};
+static World& world() {
+    static World* world = new World;
+    return *world;
+}
+
+static int tracker_key(uint8_t smart_port, uint8_t adi_port) { return smart_port * 16 + adi_port; }
+
+// wheel position of the side a motor drives, and its sign on that side
+static Side* side_of(int8_t port, double& sign) {
+    for (int8_t p : world().config.drivetrain.left) {
+        if (abs(p) == abs(port)) {
+            sign = (p < 0) == (port < 0) ? 1.0 : -1.0;
+            return &world().left;
+        }
+    }
+    for (int8_t p : world().config.drivetrain.right) {
+        if (abs(p) == abs(port)) {
+            sign = (p < 0) == (port < 0) ? 1.0 : -1.0;
+            return &world().right;
+        }
+    }
+    return nullptr;
+}
+
+static double wheel_speed() {
+    const Drivetrain& d = world().config.drivetrain;
+    return M_PI * d.wheel_diameter * d.motor_rpm * d.gear_ratio / 60; // in/s
+}
+
+static bool unplugged(int8_t port) {
+    for (int8_t p : world().config.drivetrain.unplugged)
+        if (abs(p) == abs(port)) return true;
+    return false;
+}
+
+// share of the stall current a motor draws, from how far the back emf is from the applied voltage
+static double load(int8_t port) {
+    double sign = 1.0;
+    const sim::Side* side = side_of(port, sign);
+    const double speed = side ? side->velocity / wheel_speed() : 0.0;
+    const double applied = side ? side->voltage / 12000 : 0.0;
+    return std::min(fabs(applied - speed), 1.0);
+}
+
+// heats with the square of the current and cools toward the air
+static double& temperature(int8_t port) {
+    auto [entry, added] = world().temperatures.try_emplace(abs(port));
+    if (added) entry->second = world().config.drivetrain.temperature;
+    return entry->second;
+}
+
+static void update_side(Side& side, const std::vector<int8_t>& ports, double dt) {
+    double total = 0.0;
+    int count = 0;
+    for (int8_t port : ports) {
+        if (unplugged(port)) continue;
+        total += world().commands[abs(port)] * (port < 0 ? -1 : 1);
+        count++;
+    }
+    side.voltage = count ? total / count : 0.0;
+    side.coast = ports.empty() || world().brakes[abs(ports[0])] == pros::MotorBrake::coast;
+
+    const Drivetrain& d = world().config.drivetrain;
+    const double driving =
+        std::copysign(std::max(fabs(side.voltage) - d.friction, 0.0), side.voltage);
+    const double target = driving / 12000 * wheel_speed();
+    const double tau = side.voltage == 0 && side.coast ? d.coast_time_constant : d.time_constant;
+    side.velocity += (target - side.velocity) * (1 - exp(-dt / tau));
+    side.position += side.velocity * dt;
+
+    for (int8_t port : ports) {
+        double& heat = temperature(port);
+        heat += (d.heating * load(port) * load(port) -
+                 (heat - d.temperature) / d.cooling_time_constant) *
+                dt;
+    }
+}
+
+// casts the beam at the walls, the nearest one it hits is the reading
+static const sim::Distance* distance_sensor(uint8_t port) {
+    for (const sim::Distance& sensor : world().config.distances)
+        if (sensor.port == port) return &sensor;
+    return nullptr;
+}
+
+static double beam_length(const sim::Distance& sensor, double& incidence) {
+    const appa::Pose& pose = world().pose;
+    const appa::Point origin = appa::Point(pose) + appa::Point(sensor.mount).rotate(pose.theta);
+    const double beam = pose.theta + appa::to_rad(sensor.mount.theta);
+    const double dx = cos(beam), dy = sin(beam);
+    const double tx = dx > 0 ? (144 - origin.x) / dx : dx < 0 ? -origin.x / dx : INFINITY;
+    const double ty = dy > 0 ? (144 - origin.y) / dy : dy < 0 ? -origin.y / dy : INFINITY;
+    incidence = acos(tx < ty ? fabs(dx) : fabs(dy));
+    return std::min(tx, ty);
+}
+
+// how much of a line sensor's spot is over tape, 0 to 1
+static double tape_cover(uint8_t port) {
+    const appa::Pose& pose = world().pose;
+    for (const sim::Line& line : world().config.lines) {
+        if (line.port != port) continue;
+        const appa::Point spot = appa::Point(pose) + line.mount.rotate(pose.theta);
+        double cover = 0.0;
+        for (const sim::Tape& tape : world().config.tapes) {
+            const appa::Point axis = tape.to - tape.from;
+            const double length = hypot(axis.x, axis.y);
+            if (length <= 0) continue;
+            const appa::Point off = spot - tape.from;
+            const double along = (off.x * axis.x + off.y * axis.y) / length;
+            const double across = fabs(off.x * axis.y - off.y * axis.x) / length;
+            if (along < 0 || along > length) continue;
+            const double edge = (tape.width / 2 - across) / std::max(line.spot, 1e-3) + 0.5;
+            cover = std::max(cover, std::clamp(edge, 0.0, 1.0));
+        }
+        return cover;
+    }
+    return NAN;
+}
+
+// the truth from latency ago, null until the history goes back that far
+static const appa::Pose* delayed(uint32_t latency) {
+    const uint64_t now = scheduler().now;
+    const auto& poses = world().poses;
+    for (auto it = poses.rbegin(); it != poses.rend(); it++)
+        if (it->first + latency * 1000 <= now) return &it->second;
+    return nullptr;
+}
+
+// the blobs of the elements in front of the camera, through a pinhole with its field of view
+static std::vector<pros::vision_object_s_t> vision_frame(const Vision& vision,
+                                                         const appa::Pose& pose) {
+    const appa::Point camera = appa::Point(pose) + appa::Point(vision.mount).rotate(pose.theta);
+    const double facing = pose.theta + appa::to_rad(vision.mount.theta);
+    const double focal = vision.width / 2.0 / tan(appa::to_rad(vision.fov) / 2);
+    std::normal_distribution<double> normal;
+    std::vector<pros::vision_object_s_t> frame;
+    for (const Element& element : world().config.elements) {
+        const appa::Point seen = (element.position - camera).rotate(-facing);
+        if (seen.x <= 0) continue;
+        const double x = vision.width / 2.0 - focal * seen.y / seen.x +
+                         normal(world().random) * vision.noise;
+        const double width = element.width * focal / seen.x;
+        if (x < 0 || x >= vision.width || width < 1) continue;
+        const int16_t w = std::min<double>(std::lround(width), vision.width);
+        const int16_t h = std::min<int16_t>(w, vision.height);
+        frame.push_back({element.signature, (int16_t)std::lround(x - w / 2.0),
+                         (int16_t)((vision.height - h) / 2), w, h, (int16_t)std::lround(x),
+                         (int16_t)(vision.height / 2)});
+    }
+    std::sort(frame.begin(), frame.end(), [](const auto& a, const auto& b) {
+        return a.width > b.width;
+    });
+    return frame;
+}
+
+static void step(uint64_t dt_us) {
+    const double dt = dt_us / 1e6;
+    const Config& config = world().config;
+    update_side(world().left, config.drivetrain.left, dt);
+    update_side(world().right, config.drivetrain.right, dt);
+
+    // body twist, integrated along the arc at the middle heading
+    double linear = (world().left.velocity + world().right.velocity) / 2;
+    double angular =
+        (world().right.velocity - world().left.velocity) / config.drivetrain.track_width;
+
+    // a wall stops the robot, as a circle, and its wheels slip. pushing into it squares the robot
+    // up against it
+    if (config.radius > 0) {
+        const double x = world().pose.x + linear * cos(world().pose.theta) * dt;
+        const double y = world().pose.y + linear * sin(world().pose.theta) * dt;
+        const double low = config.radius, high = 144 - config.radius;
+        if (x < low || x > high || y < low || y > high) {
+            const double square = std::round(world().pose.theta / (M_PI / 2)) * (M_PI / 2);
+            angular = (square - world().pose.theta) * (1 - exp(-dt / 0.1)) / dt;
+            linear = 0.0;
+        }
+    }
+    const double heading = world().pose.theta + angular * dt / 2;
+    world().pose.x += linear * cos(heading) * dt;
+    world().pose.y += linear * sin(heading) * dt;
+    world().pose.theta += angular * dt;
+    world().turned += angular * dt;
+
+    // the robot leans against its acceleration, forward and sideways
+    if (dt > 0) {
+        const double settle = 1 - exp(-dt / 0.1);
+        world().pitch += (config.tip * (linear - world().linear) / dt - world().pitch) * settle;
+        world().roll += (config.tip * linear * angular - world().roll) * settle;
+        world().accel = {(linear - world().linear) / dt, linear * angular};
+    }
+    world().linear = linear;
+
+    // trackers see the velocity of their point along their axis
+    for (const Tracker& tracker : config.trackers) {
+        const double axis = appa::to_rad(tracker.angle);
+        const double vx = linear - angular * tracker.position.y;
+        const double vy = angular * tracker.position.x;
+        world().ticks[tracker_key(tracker.smart_port, tracker.adi_port)] +=
+            (vx * cos(axis) + vy * sin(axis)) * dt * tracker.ticks_per_inch;
+    }
+
+    // imus only take a new sample at their data rate
+    const uint64_t now = scheduler().now;
+    for (auto& [port, imu] : world().imus) {
+        imu.rate = -appa::to_deg(angular) * config.imu_scale;
+        if (now % (imu.data_rate * 1000) != 0) continue;
+        imu.sample = -appa::to_deg(world().turned) * config.imu_scale -
+                     config.imu_drift * now / 1e6 + imu.offset;
+        imu.pitch = world().pitch;
+        imu.roll = world().roll;
+    }
+
+    // the gps and vision sensor report at their period on the pose from their latency ago
+    const Gps& gps = config.gps;
+    const Vision& vision = config.vision;
+    if (gps.port == 0 && vision.port == 0) return;
+    const uint32_t keep =
+        std::max(gps.port ? gps.latency : 0, vision.port ? vision.latency : 0); // ms
+    auto& poses = world().poses;
+    poses.push_back({now, world().pose});
+    while (poses.size() > 1 && poses[1].first + keep * 1000 <= now) poses.pop_front();
+    const appa::Pose* seen = gps.port ? delayed(gps.latency) : nullptr;
+    if (seen && now % (gps.period * 1000) == 0) {
+        std::normal_distribution<double> normal;
+        world().fix = {seen->x + normal(world().random) * gps.noise,
+                       seen->y + normal(world().random) * gps.noise,
+                       seen->theta + appa::to_rad(normal(world().random) * gps.heading_noise)};
+    }
+    seen = vision.port ? delayed(vision.latency) : nullptr;
+    if (seen && now % (vision.period * 1000) == 0) world().frame = vision_frame(vision, *seen);
+}
+
+/* Sim */
+void configure(const Config& config) {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    world().config = config;
+    world().pose = {config.start.x, config.start.y, appa::to_rad(config.start.theta)};
+    world().left = world().right = Side();
+    world().linear = world().pitch = world().roll = 0.0;
+    world().temperatures.clear();
+    world().poses.clear();
+    world().fix = {NAN, NAN, NAN};
+    world().frame.clear();
+}
+
+appa::Pose truth() {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    return world().pose;
+}
+
+uint32_t time() { return scheduler().now / 1000; }
+
+const std::vector<uint8_t>& serial_output(uint8_t port) { return world().serial[port]; }
+
+void serial_input(uint8_t port, const std::vector<uint8_t>& bytes) {
+    world().serial_in[port].insert(world().serial_in[port].end(), bytes.begin(), bytes.end());
+}
+
+void set_analog(pros::controller_analog_e_t channel, int32_t value) {
+    world().analog[channel] = std::clamp(value, -127, 127);
+}
+void set_digital(pros::controller_digital_e_t button, bool held) {
+    const uint16_t bit = 1 << (button - pros::E_CONTROLLER_DIGITAL_L1);
+    if (held && !(world().buttons & bit)) world().pressed |= bit;
+    world().buttons = held ? world().buttons | bit : world().buttons & ~bit;
+}
+void skip(uint8_t smart_port, uint8_t adi_port, double inches) {
+    for (const Tracker& tracker : world().config.trackers) {
+        if (tracker.smart_port == smart_port && tracker.adi_port == adi_port)
+            world().ticks[tracker_key(smart_port, adi_port)] += inches * tracker.ticks_per_inch;
+    }
+}
+
+void set_input(uint8_t adi_port, bool high) {
+    const uint8_t bit = 1 << ((adi_port - 'A') & 7);
+    world().inputs = high ? world().inputs | bit : world().inputs & ~bit;
+}
+
+} // namespace sim
+
+/* Pros */
+namespace pros {
+using sim::scheduler;
+using sim::TaskRecord;
+using sim::world;
+
+uint32_t millis() { return scheduler().now / 1000; }
+uint64_t micros() { return scheduler().now; }
+
+void delay(uint32_t milliseconds) {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    sim::wait(lock, TaskRecord::SLEEPING, scheduler().now + milliseconds * 1000ull, true);
+}
+
+namespace c {
+void task_delay_until(uint32_t* prev_time, uint32_t delta) {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    *prev_time += delta;
+    const uint64_t wake = std::max<uint64_t>(*prev_time * 1000ull, scheduler().now);
+    sim::wait(lock, TaskRecord::SLEEPING, wake, true);
+}
+
+uint32_t task_notify(task_t task) {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    return ++static_cast<TaskRecord*>(task)->notify_value;
+}
+
+uint32_t task_notify_take(bool clear_on_exit, uint32_t timeout) {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    TaskRecord* me = sim::current_task(lock);
+    if (me->notify_value == 0 && timeout > 0) {
+        const bool timed = timeout != TIMEOUT_MAX;
+        sim::wait(lock, TaskRecord::NOTIFY, scheduler().now + timeout * 1000ull, timed);
+    }
+    const uint32_t value = me->notify_value;
+    if (value > 0) me->notify_value = clear_on_exit ? 0 : value - 1;
+    return value;
+}
+
+bool task_notify_clear(task_t task) {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    TaskRecord* record = static_cast<TaskRecord*>(task);
+    const bool pending = record->notify_value > 0;
+    record->notify_value = 0;
+    return pending;
+}
+
+task_t task_get_current() {
+    // without the lock once registered, so an allocator can call it from inside the scheduler
+    if (sim::self) return sim::self;
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    return sim::current_task(lock);
+}
+
+const char* task_get_name(task_t task) {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    return static_cast<TaskRecord*>(task)->name.c_str();
+}
+} // namespace c
+
+/* Tasks */
+Task::Task(std::function<void()> function, uint32_t prio, uint16_t depth, const char* name) {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    sim::current_task(lock); // the creator is a task before its child is
+    TaskRecord* record = new TaskRecord{prio};
+    record->name = name ? name : "";
+    record->depth = depth;
+    record->order = ++scheduler().order;
+    scheduler().tasks.push_back(record);
+    task = record;
+
+    std::thread([record, function = std::move(function)] {
+        std::unique_lock<std::mutex> lock(scheduler().lock);
+        sim::self = record;
+        record->cv.wait(lock, [record] { return scheduler().current == record; });
+        lock.unlock();
+        function();
+        lock.lock();
+        record->state = TaskRecord::DONE;
+        sim::yield(lock);
+    }).detach();
+}
+
+// the thread stays parked, it is only never scheduled again
+void Task::remove() {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    TaskRecord* record = static_cast<TaskRecord*>(task);
+    record->state = TaskRecord::DONE;
+    if (record == sim::self) sim::yield(lock);
+}
+
+Task::Task(std::function<void()> function, const char* name)
+    : Task(std::move(function), TASK_PRIORITY_DEFAULT, TASK_STACK_DEPTH_DEFAULT, name) {}
+
+uint32_t Task::notify() { return c::task_notify(task); }
+
+// a thread like any other task, the storage only backs the stack on the brain
+extern "C" task_t task_create_static(void (*function)(void*), void* parameters, uint32_t prio,
+                                     size_t stack_depth, const char* name, uint32_t*, void*) {
+    return (task_t)pros::Task([function, parameters] { function(parameters); }, prio, stack_depth,
+                              name);
+}
+
+// threads have stacks of their own, so none of the one asked for is ever used
+extern "C" uint16_t task_get_stack_high_water_mark(task_t task) {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    return static_cast<TaskRecord*>(task)->depth;
+}
+
+bool Mutex::take(uint32_t timeout) {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    TaskRecord* me = sim::current_task(lock);
+    const uint64_t wake = scheduler().now + (uint64_t)timeout * 1000;
+    while (owner != nullptr) {
+        if (owner == me || timeout == 0) return false;
+        if (timeout != TIMEOUT_MAX && scheduler().now >= wake) return false;
+        me->mutex = this;
+        sim::wait(lock, TaskRecord::MUTEX, wake, timeout != TIMEOUT_MAX);
+    }
+    owner = me;
+    return true;
+}
+
+bool Mutex::give() {
+    std::unique_lock<std::mutex> lock(scheduler().lock);
+    if (owner != sim::self) return false;
+    owner = nullptr;
+    return true;
+}
+
+/* Motors */
+MotorGroup::MotorGroup(std::initializer_list<int8_t> ports, MotorGears) : ports(ports) {
+    for (int8_t port : ports) {
+        if (!world().brakes.count(abs(port))) world().brakes[abs(port)] = MotorBrake::coast;
+    }
+}
+
+int32_t MotorGroup::move_voltage(int32_t voltage) const {
+    voltage = std::clamp(voltage, -12000, 12000);
+    for (int8_t port : ports) world().commands[abs(port)] = port < 0 ? -voltage : voltage;
+    return 1;
+}
+
+int32_t MotorGroup::set_brake_mode_all(MotorBrake mode) const {
+    for (int8_t port : ports) world().brakes[abs(port)] = mode;
+    return 1;
+}
+int32_t MotorGroup::set_brake_mode_all(motor_brake_mode_e_t mode) const {
+    return set_brake_mode_all(static_cast<MotorBrake>(mode));
+}
+MotorBrake MotorGroup::get_brake_mode(uint8_t index) const {
+    return index < ports.size() ? world().brakes[abs(ports[index])] : MotorBrake::invalid;
+}
+
+int32_t MotorGroup::size() const { return ports.size(); }
+
+double MotorGroup::get_actual_velocity(uint8_t index) const {
+    if (index >= ports.size() || sim::unplugged(ports[index])) return PROS_ERR_F;
+    double sign = 1.0;
+    const sim::Side* side = sim::side_of(ports[index], sign);
+    const double rpm = world().config.drivetrain.motor_rpm;
+    return side ? sign * side->velocity / sim::wheel_speed() * rpm : 0.0;
+}
+
+double MotorGroup::get_position(uint8_t index) const {
+    if (index >= ports.size() || sim::unplugged(ports[index])) return PROS_ERR_F;
+    const sim::Drivetrain& d = world().config.drivetrain;
+    double sign = 1.0;
+    const sim::Side* side = sim::side_of(ports[index], sign);
+    const double wheel_turns = side ? side->position / (M_PI * d.wheel_diameter) : 0.0;
+    return sign * wheel_turns / d.gear_ratio * 360;
+}
+
+MotorGears MotorGroup::get_gearing(uint8_t index) const {
+    if (index >= ports.size()) return MotorGears::invalid;
+    const double rpm = world().config.drivetrain.motor_rpm;
+    return rpm <= 100 ? MotorGears::red : rpm <= 200 ? MotorGears::green : MotorGears::blue;
+}
+
+// capped by the limit, which only shows in the reading, the drive's torque isn't limited
+int32_t MotorGroup::get_current_draw(uint8_t index) const {
+    if (index >= ports.size() || sim::unplugged(ports[index])) return PROS_ERR;
+    const double stall = world().config.drivetrain.stall_current;
+    return std::min<int32_t>(std::lround(sim::load(ports[index]) * stall), get_current_limit(index));
+}
+
+int32_t MotorGroup::set_current_limit_all(int32_t limit) const {
+    for (int8_t port : ports) world().limits[abs(port)] = std::clamp(limit, 0, 2500);
+    return 1;
+}
+
+int32_t MotorGroup::get_current_limit(uint8_t index) const {
+    if (index >= ports.size()) return PROS_ERR;
+    auto limit = world().limits.find(abs(ports[index]));
+    return limit == world().limits.end() ? 2500 : limit->second;
+}
+
+// output over input power, which for a dc motor is its speed over the speed the voltage drives
+double MotorGroup::get_efficiency(uint8_t index) const {
+    if (index >= ports.size() || sim::unplugged(ports[index])) return PROS_ERR_F;
+    double sign = 1.0;
+    const sim::Side* side = sim::side_of(ports[index], sign);
+    const double speed = side ? side->velocity / sim::wheel_speed() : 0.0;
+    const double applied = side ? side->voltage / 12000 : 0.0;
+    return applied != 0 ? std::clamp(speed / applied, 0.0, 1.0) * 100 : 0.0;
+}
+
+// in steps of 5 °C like the real motors
+double MotorGroup::get_temperature(uint8_t index) const {
+    if (index >= ports.size() || sim::unplugged(ports[index])) return PROS_ERR_F;
+    return floor(sim::temperature(ports[index]) / 5) * 5;
+}
+
+int32_t MotorGroup::is_over_temp(uint8_t index) const {
+    if (index >= ports.size() || sim::unplugged(ports[index])) return PROS_ERR;
+    return get_temperature(index) >= 55;
+}
+
+int8_t MotorGroup::get_port(uint8_t index) const {
+    return index < ports.size() ? ports[index] : PROS_ERR_BYTE;
+}
+
+std::vector<double> MotorGroup::get_actual_velocity_all() const {
+    std::vector<double> rpms;
+    for (int i = 0; i < size(); i++) rpms.push_back(get_actual_velocity(i));
+    return rpms;
+}
+
+std::vector<double> MotorGroup::get_position_all() const {
+    std::vector<double> positions;
+    for (int i = 0; i < size(); i++) positions.push_back(get_position(i));
+    return positions;
+}
+
+std::vector<MotorGears> MotorGroup::get_gearing_all() const {
+    std::vector<MotorGears> gears;
+    for (int i = 0; i < size(); i++) gears.push_back(get_gearing(i));
+    return gears;
+}
+
+std::vector<int32_t> MotorGroup::get_current_draw_all() const {
+    std::vector<int32_t> currents;
+    for (int i = 0; i < size(); i++) currents.push_back(get_current_draw(i));
+    return currents;
+}
+
+/* Sensors */
+Imu::Imu(uint8_t port) : port(port) { world().imus[port]; }
+
+int32_t Imu::reset(bool) const {
+    sim::Imu& imu = world().imus[port];
+    imu.calibrated = scheduler().now + 2000000;
+    set_rotation(0);
+    return 1;
+}
+int32_t Imu::set_data_rate(uint32_t rate) const {
+    world().imus[port].data_rate = std::max<uint32_t>(5, rate / 5 * 5);
+    return 1;
+}
+bool Imu::is_calibrating() const { return scheduler().now < world().imus[port].calibrated; }
+ImuStatus Imu::get_status() const {
+    return is_calibrating() ? ImuStatus::calibrating : ImuStatus::ready;
+}
+double Imu::get_rotation() const {
+    return is_calibrating() ? PROS_ERR_F : world().imus[port].sample;
+}
+imu_gyro_s_t Imu::get_gyro_rate() const { return {0.0, 0.0, world().imus[port].rate}; }
+imu_accel_s_t Imu::get_accel() const {
+    if (is_calibrating()) return {PROS_ERR_F, PROS_ERR_F, PROS_ERR_F};
+    return {world().accel.x / 386.09, world().accel.y / 386.09, 1.0};
+}
+double Imu::get_pitch() const { return is_calibrating() ? PROS_ERR_F : world().imus[port].pitch; }
+double Imu::get_roll() const { return is_calibrating() ? PROS_ERR_F : world().imus[port].roll; }
+int32_t Imu::set_rotation(double rotation) const {
+    sim::Imu& imu = world().imus[port];
+    imu.offset += rotation - imu.sample;
+    imu.sample = rotation;
+    return 1;
+}
+
+Gps::Gps(uint8_t port) : port(port) {}
+gps_status_s_t Gps::get_position_and_orientation() const {
+    const appa::Pose& fix = world().fix;
+    if (port != world().config.gps.port || std::isnan(fix.x))
+        return {PROS_ERR_F, PROS_ERR_F, PROS_ERR_F, PROS_ERR_F, PROS_ERR_F};
+    return {(fix.x - 72) * 0.0254, (fix.y - 72) * 0.0254, 0.0, 0.0,
+            std::remainder(90 - appa::to_deg(fix.theta), 360)};
+}
+double Gps::get_error() const {
+    return port == world().config.gps.port ? world().config.gps.noise * 0.0254 : PROS_ERR_F;
+}
+
+Distance::Distance(uint8_t port) : port(port) {}
+int32_t Distance::get_distance() {
+    const sim::Distance* sensor = sim::distance_sensor(port);
+    if (!sensor) return PROS_ERR;
+    double incidence;
+    std::normal_distribution<double> normal;
+    const double length =
+        sim::beam_length(*sensor, incidence) + normal(world().random) * sensor->noise;
+    return length * 25.4 > 2000 ? 9999 : std::lround(std::max(length, 0.0) * 25.4);
+}
+int32_t Distance::get_confidence() {
+    const sim::Distance* sensor = sim::distance_sensor(port);
+    if (!sensor) return PROS_ERR;
+    double incidence;
+    const double length = sim::beam_length(*sensor, incidence);
+    return length * 25.4 > 2000 ? 0 : incidence < appa::to_rad(30) ? 63 : 20;
+}
+
+Vision::Vision(uint8_t port, vision_zero_e_t) : port(port) {}
+vision_object_s_t Vision::get_by_sig(uint32_t size_id, uint32_t sig_id) const {
+    if (port == world().config.vision.port) {
+        for (const vision_object_s_t& object : world().frame)
+            if (object.signature == sig_id && size_id-- == 0) return object;
+    }
+    vision_object_s_t none{};
+    none.signature = VISION_OBJECT_ERR_SIG;
+    return none;
+}
+
+Rotation::Rotation(int8_t port) : port(abs(port)) {}
+int32_t Rotation::set_data_rate(uint32_t) const { return 1; }
+int32_t Rotation::get_position() const {
+    return std::lround(world().ticks[sim::tracker_key(port, 0)]);
+}
+
+Optical::Optical(uint8_t port) : port(port) {}
+double Optical::get_brightness() {
+    const double cover = sim::tape_cover(port);
+    if (std::isnan(cover)) return PROS_ERR_F;
+    std::normal_distribution<double> normal;
+    return std::clamp(0.15 + 0.75 * cover + normal(world().random) * 0.02, 0.0, 1.0);
+}
+int32_t Optical::set_led_pwm(uint8_t) { return 1; }
+
+namespace adi {
+AnalogIn::AnalogIn(uint8_t adi_port) : adi_port(adi_port) {}
+int32_t AnalogIn::get_value() const {
+    const double cover = sim::tape_cover(adi_port);
+    if (std::isnan(cover)) return PROS_ERR;
+    std::normal_distribution<double> normal;
+    return std::clamp<int32_t>(std::lround(2800 - 2500 * cover + normal(world().random) * 40), 0,
+                               4095);
+}
+
+DigitalIn::DigitalIn(uint8_t adi_port) : adi_port(adi_port) {}
+int32_t DigitalIn::get_value() const { return world().inputs >> ((adi_port - 'A') & 7) & 1; }
+
+Encoder::Encoder(uint8_t adi_port_top, uint8_t, bool reversed)
+    : smart_port(0), adi_port(adi_port_top), reversed(reversed) {}
+Encoder::Encoder(ext_adi_port_tuple_t port_tuple, bool reversed)
+    : smart_port(std::get<0>(port_tuple)), adi_port(std::get<1>(port_tuple)), reversed(reversed) {}
+int32_t Encoder::get_value() const {
+    const int32_t ticks = std::lround(world().ticks[sim::tracker_key(smart_port, adi_port)]);
+    return reversed ? -ticks : ticks;
+}
+} // namespace adi
+
+/* Serial */
+// an unlimited buffer that is read back with sim::serial_output, and one sim::serial_input fills
+Serial::Serial(uint8_t port, int32_t) : port(port) {}
+int32_t Serial::get_read_avail() const { return world().serial_in[port].size(); }
+int32_t Serial::read(uint8_t* buffer, int32_t length) const {
+    std::deque<uint8_t>& input = world().serial_in[port];
+    const int32_t count = std::min<int32_t>(length, input.size());
+    std::copy_n(input.begin(), count, buffer);
+    input.erase(input.begin(), input.begin() + count);
+    return count;
+}
+int32_t Serial::get_write_free() const { return INT32_MAX; }
+int32_t Serial::write(uint8_t* buffer, int32_t length) const {
+    std::vector<uint8_t>& output = world().serial[port];
+    output.insert(output.end(), buffer, buffer + length);
+    return length;
+}
+
+/* Link */
+// packets arrive link_latency after they are sent, at every other radio with the link's id
+Link::Link(uint8_t port, const std::string link_id, link_type_e_t, bool)
+    : port(port), id(link_id) {
+    world().radios[id].push_back(port);
+}
+bool Link::connected() { return world().radios[id].size() > 1; }
+uint32_t Link::raw_receivable_size() {
+    uint32_t size = 0;
+    for (const auto& packet : world().links[id]) {
+        if (packet.from != port && packet.arrives <= micros()) size += packet.data.size();
+    }
+    return size;
+}
+uint32_t Link::transmit(void* data, uint16_t data_size) {
+    if (!connected()) return PROS_ERR;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    world().links[id].push_back({port, micros() + (uint64_t)(world().config.link_latency * 1000),
+                                 {bytes, bytes + data_size}});
+    return data_size;
+}
+uint32_t Link::receive(void* dest, uint16_t data_size) {
+    auto& packets = world().links[id];
+    for (auto it = packets.begin(); it != packets.end(); it++) {
+        if (it->from == port || it->arrives > micros()) continue;
+        if (it->data.size() != data_size) {
+            packets.erase(it);
+            return PROS_ERR;
+        }
+        memcpy(dest, it->data.data(), data_size);
+        packets.erase(it);
+        return data_size;
+    }
+    return PROS_ERR;
+}
+
+namespace battery {
+int32_t get_voltage() { return std::lround(world().config.battery * 1000); }
+int32_t get_current() { return 0; } // the battery only supplies a fixed voltage here
+} // namespace battery
+
+namespace competition {
+uint8_t is_disabled() { return world().config.disabled; }
+} // namespace competition
+
+/* Controller */
+Controller::Controller(controller_id_e_t id) : id(id) {}
+int32_t Controller::is_connected() { return id == E_CONTROLLER_MASTER; }
+int32_t Controller::get_analog(controller_analog_e_t channel) {
+    return id == E_CONTROLLER_MASTER ? world().analog[channel] : 0;
+}
+int32_t Controller::get_digital(controller_digital_e_t button) {
+    return id == E_CONTROLLER_MASTER && (world().buttons >> (button - E_CONTROLLER_DIGITAL_L1)) & 1;
+}
+int32_t Controller::get_digital_new_press(controller_digital_e_t button) {
+    const uint16_t bit = 1 << (button - E_CONTROLLER_DIGITAL_L1);
+    const bool pressed = id == E_CONTROLLER_MASTER && (world().pressed & bit);
+    world().pressed &= ~bit;
+    return pressed;
+}
+} // namespace pros
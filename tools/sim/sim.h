@@ -0,0 +1,123 @@
+#pragma once
+
+#include "appa.h"
+
+namespace sim {
+
+/* Config */
+// differential drive physics, each side is one wheel speed with a first order response
+struct Drivetrain {
+    std::vector<int8_t> left, right;  // motor ports, the same as the chassis
+    double track_width = 12.0;        // in
+    double wheel_diameter = 3.25;     // in
+    double gear_ratio = 0.75;         // wheel turns per motor turn
+    double motor_rpm = 600.0;         // cartridge free speed
+    double time_constant = 0.08;      // s, wheel speed response to voltage
+    double coast_time_constant = 0.6; // s, wheel speed decay at 0 V when coasting
+    double stall_current = 2500.0;    // mA per motor from standstill at full voltage
+    double temperature = 25.0;        // °C of the air, and of the motors at the start
+    double heating = 0.5;             // °C/s per motor drawing its stall current
+    double cooling_time_constant = 300.0; // s, motor temperature decay toward the air's
+    std::vector<int8_t> unplugged;    // motor ports that don't answer or drive, like a bad cable
+    double friction = 0.0;            // mV of each side's voltage lost to friction
+};
+
+// an adi encoder or rotation sensor measuring the travel of a point on the robot along an axis
+struct Tracker {
+    uint8_t smart_port = 0;         // rotation sensor or adi expander port, 0 for the brain's adi
+    uint8_t adi_port = 0;           // top adi port, 0 for a rotation sensor
+    double angle = 0.0;             // deg counterclockwise from forward of the measured axis
+    appa::Point position = {0, 0};  // in from the tracking center, x forward and y left
+    double ticks_per_inch = 321.5;  // like the odom tpu, centidegrees for a rotation sensor
+};
+
+// a vex gps at the tracking center, reporting a noisy fix from latency ago every period. its field
+// is centered on 72, 72 with the same axes
+struct Gps {
+    uint8_t port = 0;           // 0 for none
+    double noise = 0.5;         // in, 1 sigma
+    double heading_noise = 1.0; // deg, 1 sigma
+    uint32_t latency = 20;      // ms
+    uint32_t period = 20;       // ms
+};
+
+// a distance sensor seeing the walls of a 144in field with its corner at the origin
+struct Distance {
+    uint8_t port = 0;
+    appa::Pose mount = {0, 0, 0}; // in from the tracking center, and deg counterclockwise from
+                                  // forward the sensor faces
+    double noise = 0.2;           // in, 1 sigma
+};
+
+// a vision sensor seeing the elements on the field, reporting a frame from latency ago every
+// period. elements out of its field of view or behind it aren't seen, nothing blocks them
+struct Vision {
+    uint8_t port = 0;              // 0 for none
+    appa::Pose mount = {0, 0, 0};  // in from the tracking center, and deg counterclockwise from
+                                   // forward the camera faces
+    double fov = 61.0;             // deg across the image
+    int width = 316, height = 212; // px
+    double noise = 1.0;            // px of the blob center, 1 sigma
+    uint32_t latency = 30;         // ms
+    uint32_t period = 20;          // ms
+};
+
+// a strip of white tape on the field, and a line tracker or optical sensor looking down at it.
+// line trackers read low over the tape and optical sensors bright
+struct Tape {
+    appa::Point from, to; // in, along its middle
+    double width = 2.0;   // in
+};
+struct Line {
+    uint8_t port = 0;           // 'A' to 'H' for a line tracker, 1 to 21 for an optical sensor
+    appa::Point mount = {0, 0}; // in from the tracking center
+    double spot = 0.25;         // in, the reading ramps across the tape's edge over this
+};
+
+// a round game element, seen by the vision sensor as its signature
+struct Element {
+    appa::Point position;  // in
+    double width = 3.5;    // in
+    uint8_t signature = 1;
+};
+
+struct Config {
+    Drivetrain drivetrain;
+    std::vector<Tracker> trackers;
+    std::vector<Distance> distances;
+    std::vector<Tape> tapes;
+    std::vector<Line> lines;
+    Gps gps;
+    Vision vision;
+    std::vector<Element> elements;
+    double imu_drift = 0.0;        // deg/s
+    double imu_scale = 1.0;        // rotation reported per rotation turned
+    double tip = 0.0;              // deg the robot leans per in/s² of acceleration, back when
+                                   // speeding up forward and outward in turns
+    double battery = 12.8;         // V
+    double radius = 0.0;           // in to the bumpers, the walls of a 144in field stop the robot
+    appa::Pose start = {0, 0, 0};  // in and deg, counterclockwise
+    double link_latency = 20.0;    // ms a vexlink packet takes to arrive
+    bool disabled = false;         // what the competition control reports
+};
+
+// replaces the simulated robot, sensors keep their own zero like the real ones
+void configure(const Config& config);
+
+appa::Pose truth(); // in and rad, counterclockwise
+uint32_t time();    // ms of virtual time
+
+// bytes written to a generic serial port so far
+const std::vector<uint8_t>& serial_output(uint8_t port);
+// bytes for a generic serial port to receive, as if another device sent them
+void serial_input(uint8_t port, const std::vector<uint8_t>& bytes);
+
+// driver input for opcontrol routines
+void set_analog(pros::controller_analog_e_t channel, int32_t value);
+void set_digital(pros::controller_digital_e_t button, bool held);
+// a tracker's wheel skipping inches at once, as if it bounced on a tile seam
+void skip(uint8_t smart_port, uint8_t adi_port, double inches);
+// what a switch on an adi port reads, 'A' to 'H', such as a bumper pressed against a wall
+void set_input(uint8_t adi_port, bool high);
+
+} // namespace sim
@@ -0,0 +1,57 @@
+// host side decoder for appa::Link telemetry, built outside of PROS:
+//   g++ -std=c++20 -Iinclude/appa tools/telemetry.cpp -o appa_telemetry
+//   ./appa_telemetry /dev/ttyUSB0 115200   live from a usb serial adapter on the link's port
+//   ./appa_telemetry capture.bin           from a file of captured bytes, - for stdin
+// prints a csv row per frame as it arrives, so it can be piped into a live plotter
+#include "wire.h"
+#include <cstdio>
+#include <cstdlib>
+#include <termios.h>
+#include <unistd.h>
+
+using namespace appa;
+
+// raw 8N1 at the given baud when reading a serial port
+static void configure(FILE* file, long baud) {
+    const int fd = fileno(file);
+    termios tty;
+    if (!isatty(fd) || tcgetattr(fd, &tty) != 0) return;
+    cfmakeraw(&tty);
+    const speed_t speed = baud >= 230400 ? B230400
+                          : baud >= 115200 ? B115200
+                          : baud >= 57600  ? B57600
+                                           : B9600;
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+    tcsetattr(fd, TCSANOW, &tty);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s <port or file> [baud]\n", argv[0]);
+        return 1;
+    }
+    const bool stdin_input = argv[1][0] == '-' && argv[1][1] == 0;
+    FILE* file = stdin_input ? stdin : fopen(argv[1], "rb");
+    if (!file) {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+    configure(file, argc >= 3 ? atol(argv[2]) : 115200);
+
+    printf("time,x,y,theta,velocity_linear,velocity_angular,error_linear,error_angular,odom_busy,"
+           "motion_busy,odom_overruns,motion_overruns\n");
+    wire::Decoder decoder;
+    wire::Sample sample;
+    for (int byte = fgetc(file); byte != EOF; byte = fgetc(file)) {
+        if (!decoder.push(byte, sample)) continue;
+        printf("%u,%.3f,%.3f,%.4f,%.2f,%.3f,%.2f,%.4f,%u,%u,%u,%u\n", (unsigned)sample.time,
+               sample.x, sample.y, sample.theta, sample.velocity_linear, sample.velocity_angular,
+               sample.error_linear, sample.error_angular, (unsigned)sample.odom_busy,
+               (unsigned)sample.motion_busy, (unsigned)sample.odom_overruns,
+               (unsigned)sample.motion_overruns);
+        fflush(stdout);
+    }
+    fprintf(stderr, "%u bad or missed frames\n", (unsigned)decoder.errors);
+    if (!stdin_input) fclose(file);
+}